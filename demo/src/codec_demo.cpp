@@ -0,0 +1,204 @@
+/*
+ * File description: codec_demo.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "serialization/master.h"
+#include "serialization/format/snappy_compressor.h"
+#include "serialization/format/lz4_compressor.h"
+#include "serialization/format/zstd_compressor.h"
+#include "util/string_convert.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace axon::util;
+using namespace axon::serialization;
+
+// Times the delta codecs for primitive arrays (XOR for floats, delta and
+// varint for integers) against the raw arrays, with and without the whole
+// message compressed afterwards. Prints the size of the output, and the
+// values per second in each direction, from the best of the runs.
+//
+// Usage: codec_demo [values] [runs] [snappy|lz4|zstd]
+template<typename T>
+struct Series
+{
+	vector<T> Values;
+	bool Delta = false;
+};
+
+template<typename T>
+void BindStruct(const CStructBinder &a_binder, Series<T> &a_series)
+{
+	if (a_series.Delta)
+		a_binder("Values", a_series.Values, SerializationFlags::Delta);
+	else
+		a_binder("Values", a_series.Values);
+}
+
+template<typename Fn>
+double BestOf(size_t a_runs, Fn a_fn)
+{
+	double l_best = 0;
+
+	for (size_t i = 0; i < a_runs; ++i)
+	{
+		auto l_start = high_resolution_clock::now();
+
+		a_fn();
+
+		const double l_secs = duration<double>(high_resolution_clock::now() - l_start).count();
+
+		if (i == 0 || l_secs < l_best)
+			l_best = l_secs;
+	}
+
+	return l_best;
+}
+
+ICompressor::Ptr MakeCompressor(const string &a_name)
+{
+	if (a_name == "snappy")
+		return ICompressor::Ptr(new CSnappyCompressor());
+	if (a_name == "lz4")
+		return ICompressor::Ptr(new CLZ4Compressor());
+	if (a_name == "zstd")
+		return ICompressor::Ptr(new CZstdCompressor());
+
+	throw runtime_error("Unknown compressor '" + a_name + "'.");
+}
+
+template<typename T>
+bool Run(const string &a_name, const vector<T> &a_vals, const ICompressor &a_compressor, size_t a_runs)
+{
+	CAxonSerializer l_ser;
+
+	for (int l_mode = 0; l_mode < 4; ++l_mode)
+	{
+		const bool l_delta = l_mode >= 2;
+		const bool l_compress = l_mode & 1;
+
+		Series<T> l_series;
+		l_series.Values = a_vals;
+		l_series.Delta = l_delta;
+
+		string l_buff;
+		unique_ptr<char[]> l_compressed;
+		size_t l_compressedSize = 0;
+
+		const double l_write = BestOf(a_runs,
+			[&] ()
+			{
+				l_buff = l_ser.Serialize(l_series);
+
+				if (l_compress)
+					a_compressor.Compress(l_buff.data(), l_buff.size(), l_compressed, l_compressedSize);
+			});
+
+		Series<T> l_read;
+
+		const double l_readTime = BestOf(a_runs,
+			[&] ()
+			{
+				if (l_compress)
+				{
+					unique_ptr<char[]> l_raw = a_compressor.Decompress(l_compressed.get(), l_compressedSize, l_buff.size());
+
+					l_ser.Deserialize(l_raw.get(), l_raw.get() + l_buff.size(), l_read);
+				}
+				else
+				{
+					l_ser.Deserialize(l_buff.data(), l_buff.data() + l_buff.size(), l_read);
+				}
+			});
+
+		// Compared bitwise, so that NaNs would count as equal
+		if (l_read.Values.size() != a_vals.size() ||
+			(!a_vals.empty() && memcmp(l_read.Values.data(), a_vals.data(), a_vals.size() * sizeof(T))))
+		{
+			cout << "The values didn't round trip." << endl;
+			return false;
+		}
+
+		string l_codec = l_delta ? (is_floating_point<T>::value ? "xor" : "delta") : "raw";
+
+		if (l_compress)
+			l_codec += "+" + a_compressor.Name();
+
+		const size_t l_size = l_compress ? l_compressedSize : l_buff.size();
+
+		cout << left << setw(14) << a_name
+			 << setw(14) << l_codec
+			 << right << fixed << setprecision(1)
+			 << setw(12) << l_size / 1024.0
+			 << setw(14) << a_vals.size() / l_write / 1e6
+			 << setw(14) << a_vals.size() / l_readTime / 1e6 << endl;
+	}
+
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t l_numValues = 1 << 20;
+	size_t l_numRuns = 10;
+	string l_compressorName = "snappy";
+
+	if (argc > 1)
+		l_numValues = StringTo<size_t>(argv[1]);
+	if (argc > 2)
+		l_numRuns = max<size_t>(1, StringTo<size_t>(argv[2]));
+	if (argc > 3)
+		l_compressorName = argv[3];
+
+	const ICompressor::Ptr l_compressor = MakeCompressor(l_compressorName);
+
+	// Slowly varying series, like the ones telemetry is made of: a random
+	// walk, the same walk rounded to 2 decimals, a sensor that only changes
+	// every 16 samples, and the microsecond timestamps of the samples
+	mt19937_64 l_rand(l_numValues);
+	normal_distribution<double> l_step(0, 0.01);
+	uniform_int_distribution<int64_t> l_jitter(-50, 50);
+
+	vector<double> l_walk, l_rounded;
+	vector<float> l_steps;
+	vector<int64_t> l_times;
+
+	double l_val = 20;
+
+	for (size_t i = 0; i < l_numValues; ++i)
+	{
+		l_val += l_step(l_rand);
+
+		l_walk.push_back(l_val);
+		l_rounded.push_back(round(l_val * 100) / 100);
+		l_steps.push_back(float(sin(double(i / 16) * 0.01)));
+		l_times.push_back(int64_t(1400000000000000ll + i * 1000 + l_jitter(l_rand)));
+	}
+
+	cout << left << setw(14) << "Series"
+		 << setw(14) << "Codec"
+		 << right << setw(12) << "Size(KB)"
+		 << setw(14) << "Write(M/s)"
+		 << setw(14) << "Read(M/s)" << endl;
+
+	if (!Run("double walk", l_walk, *l_compressor, l_numRuns) ||
+		!Run("double 0.01", l_rounded, *l_compressor, l_numRuns) ||
+		!Run("float steps", l_steps, *l_compressor, l_numRuns) ||
+		!Run("int64 times", l_times, *l_compressor, l_numRuns))
+		return 1;
+
+	return 0;
+}
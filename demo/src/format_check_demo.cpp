@@ -0,0 +1,1391 @@
+/*
+ * File description: format_check_demo.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <exception>
+#include <fstream>
+#include <limits>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include "serialization/master.h"
+#include "serialization/format/snappy_compressor.h"
+#include "serialization/format/lz4_compressor.h"
+#include "serialization/format/zstd_compressor.h"
+
+using namespace std;
+using namespace axon;
+using namespace axon::serialization;
+
+// Round trips values through each of the optional encodings of the Axon
+// format, and feeds the decoder truncated and corrupted copies of them.
+// Bad input has to be rejected with an exception. Anything worse, like a
+// read past the end of the input, is left for a sanitizer build to catch.
+// Prints every check that fails, and returns non-zero if any did.
+//
+// Usage: format_check_demo
+size_t s_numChecks = 0;
+size_t s_numFailed = 0;
+string s_section;
+
+void Section(const string &a_name)
+{
+	s_section = a_name;
+
+	cout << a_name << endl;
+}
+
+void Check(bool a_ok, const string &a_what)
+{
+	++s_numChecks;
+
+	if (!a_ok)
+	{
+		++s_numFailed;
+
+		cout << "FAILED: " << s_section << ": " << a_what << endl;
+	}
+}
+
+template<typename Fn>
+void CheckThrows(const string &a_what, Fn a_fn)
+{
+	bool l_threw = false;
+
+	try
+	{
+		a_fn();
+	}
+	catch (const exception &)
+	{
+		l_threw = true;
+	}
+
+	Check(l_threw, a_what + " is rejected");
+}
+
+// Every strict prefix of a message has to be rejected
+void CheckTruncations(const ASerializer &a_ser, const string &a_buff, const string &a_what)
+{
+	size_t l_numAccepted = 0;
+
+	for (size_t i = 0; i < a_buff.size(); ++i)
+	{
+		try
+		{
+			a_ser.DeserializeData(a_buff.data(), a_buff.data() + i);
+
+			++l_numAccepted;
+		}
+		catch (const exception &)
+		{
+		}
+	}
+
+	Check(l_numAccepted == 0, a_what + " rejects every truncation");
+}
+
+// Overwrites each byte in turn. A corrupted message may still decode to
+// something, but it must not take the decoder outside of the input
+void CheckCorruptions(const ASerializer &a_ser, const string &a_buff)
+{
+	const char l_values[] = { char(0x00), char(0x01), char(0x7F), char(0x80), char(0xFF) };
+
+	for (size_t i = 0; i < a_buff.size(); ++i)
+	{
+		for (char l_value : l_values)
+		{
+			string l_corrupt = a_buff;
+			l_corrupt[i] = l_value;
+
+			try
+			{
+				a_ser.DeserializeData(l_corrupt.data(), l_corrupt.data() + l_corrupt.size());
+			}
+			catch (const exception &)
+			{
+			}
+		}
+	}
+}
+
+template<typename T>
+T RoundTrip(const ASerializer &a_ser, const T &a_val, string *a_buff = nullptr)
+{
+	const string l_buff = a_ser.Serialize(a_val);
+
+	if (a_buff)
+		*a_buff = l_buff;
+
+	return a_ser.Deserialize<T>(l_buff);
+}
+
+struct Point
+{
+	int X = 0;
+	int Y = 0;
+	string Name;
+
+	bool operator==(const Point &a_other) const
+	{
+		return X == a_other.X && Y == a_other.Y && Name == a_other.Name;
+	}
+};
+
+void BindStruct(const CStructBinder &a_binder, Point &a_val)
+{
+	a_binder("X", a_val.X)
+			("Y", a_val.Y)
+			("Name", a_val.Name);
+}
+
+// The same names as Point and one more, first used in another order
+struct Shifted
+{
+	int Y = 0;
+	double Z = 0;
+	int X = 0;
+
+	bool operator==(const Shifted &a_other) const
+	{
+		return Y == a_other.Y && Z == a_other.Z && X == a_other.X;
+	}
+};
+
+void BindStruct(const CStructBinder &a_binder, Shifted &a_val)
+{
+	a_binder("Y", a_val.Y)
+			("Z", a_val.Z)
+			("X", a_val.X);
+}
+
+struct Shape
+{
+	Point Origin;
+	vector<Point> Points;
+	Shifted Offset;
+
+	bool operator==(const Shape &a_other) const
+	{
+		return Origin == a_other.Origin && Points == a_other.Points && Offset == a_other.Offset;
+	}
+};
+
+void BindStruct(const CStructBinder &a_binder, Shape &a_val)
+{
+	a_binder("Origin", a_val.Origin)
+			("Points", a_val.Points)
+			("Offset", a_val.Offset);
+}
+
+Point MakePoint(int a_i)
+{
+	Point l_ret;
+	l_ret.X = a_i;
+	l_ret.Y = -a_i;
+	l_ret.Name = "p" + to_string(a_i);
+	return l_ret;
+}
+
+// The name tables of each message shape are cached by the serializer, so
+// alternating shapes, and copies of the serializer that share the cache,
+// must keep decoding to the same values
+void CheckNameTables()
+{
+	Section("Name tables");
+
+	CAxonSerializer l_ser;
+
+	Shape l_shape;
+	l_shape.Origin = MakePoint(1);
+	l_shape.Points = { MakePoint(2), MakePoint(3) };
+	l_shape.Offset.Y = 4;
+	l_shape.Offset.Z = 0.5;
+	l_shape.Offset.X = 5;
+
+	for (int i = 0; i < 3; ++i)
+	{
+		Check(RoundTrip(l_ser, l_shape) == l_shape, "a struct with nested structs round trips");
+		Check(RoundTrip(l_ser, l_shape.Origin) == l_shape.Origin, "a struct round trips");
+		Check(RoundTrip(l_ser, l_shape.Offset) == l_shape.Offset, "a reordered struct round trips");
+
+		l_shape.Points.push_back(MakePoint(i + 10));
+	}
+
+	const CAxonSerializer l_copy = l_ser;
+
+	Check(RoundTrip(l_copy, l_shape) == l_shape, "a copy of the serializer round trips");
+
+	string l_buff;
+	RoundTrip(l_ser, l_shape, &l_buff);
+
+	CheckTruncations(l_ser, l_buff, "a struct");
+	CheckCorruptions(l_ser, l_buff);
+}
+
+struct Tree
+{
+	int Value = 0;
+	vector<Tree> Children;
+
+	bool operator==(const Tree &a_other) const
+	{
+		return Value == a_other.Value && Children == a_other.Children;
+	}
+};
+
+void BindStruct(const CStructBinder &a_binder, Tree &a_val)
+{
+	a_binder("Value", a_val.Value)
+			("Children", a_val.Children);
+}
+
+Tree MakeChain(int a_depth)
+{
+	Tree l_ret;
+	l_ret.Value = a_depth;
+
+	if (a_depth > 0)
+		l_ret.Children.push_back(MakeChain(a_depth - 1));
+
+	return l_ret;
+}
+
+// Input that is well formed, but nested too deeply or too large, is
+// rejected before it is decoded
+void CheckDecodeLimits()
+{
+	Section("Decode limits");
+
+	CAxonSerializer l_ser;
+
+	const Tree l_chain = MakeChain(20);
+
+	string l_buff;
+	Check(RoundTrip(l_ser, l_chain, &l_buff) == l_chain, "a nested value round trips");
+
+	CAxonSerializer l_shallow;
+	l_shallow.SetMaxDepth(10);
+
+	CheckThrows("a value nested past the depth limit", [&] () { l_shallow.Deserialize<Tree>(l_buff); });
+
+	const vector<int> l_vals(1000, 7);
+
+	Check(RoundTrip(l_ser, l_vals, &l_buff) == l_vals, "an array round trips");
+
+	CAxonSerializer l_small;
+	l_small.SetMaxElements(100);
+
+	CheckThrows("an array past the element limit", [&] () { l_small.Deserialize<vector<int>>(l_buff); });
+
+	CheckTruncations(l_ser, l_buff, "an array");
+
+	RoundTrip(l_ser, MakeChain(3), &l_buff);
+
+	CheckCorruptions(l_ser, l_buff);
+}
+
+template<typename T>
+string SerializeWithDict(const CAxonSerializer &a_ser, const T &a_val, CAxonNameDictionary &a_dict)
+{
+	auto l_data = Serialize(a_val);
+
+	string l_buff(a_ser.CalcSize(*l_data, a_dict), '\0');
+	l_buff.resize(a_ser.SerializeInto(*l_data, &l_buff[0], l_buff.size(), a_dict));
+
+	return l_buff;
+}
+
+template<typename T>
+T DeserializeWithDict(const CAxonSerializer &a_ser, const string &a_buff, CAxonNameDictionary &a_dict)
+{
+	auto l_data = a_ser.DeserializeData(a_buff.data(), a_buff.data() + a_buff.size(), a_dict);
+
+	T l_ret;
+	Deserialize(*l_data, l_ret);
+	return l_ret;
+}
+
+// The sender and receiver dictionaries have to stay in step, with names
+// only sent the first time, and a receiver that is out of step has to
+// reject the message instead of using the wrong names
+void CheckNameDictionary()
+{
+	Section("Name dictionary");
+
+	CAxonSerializer l_ser;
+
+	Shape l_shape;
+	l_shape.Origin = MakePoint(1);
+	l_shape.Points = { MakePoint(2) };
+	l_shape.Offset.X = 3;
+
+	// With room for 5 names, the names of Shape never fit, but the names of
+	// Point are learned, and are then left out of the next Shape
+	for (size_t l_maxNames : { size_t(CAxonNameDictionary::DEFAULT_MAX_NAMES), size_t(5) })
+	{
+		CAxonNameDictionary l_send(l_maxNames), l_receive(l_maxNames);
+
+		const string l_first = SerializeWithDict(l_ser, l_shape, l_send);
+		Check(DeserializeWithDict<Shape>(l_ser, l_first, l_receive) == l_shape, "the first message round trips");
+
+		const string l_point = SerializeWithDict(l_ser, l_shape.Origin, l_send);
+		Check(DeserializeWithDict<Point>(l_ser, l_point, l_receive) == l_shape.Origin, "a known shape round trips");
+
+		const string l_second = SerializeWithDict(l_ser, l_shape, l_send);
+		Check(DeserializeWithDict<Shape>(l_ser, l_second, l_receive) == l_shape, "a repeated message round trips");
+
+		Check(l_send.Size() == l_receive.Size(), "both dictionaries hold the same names");
+		Check(l_send.Size() <= l_maxNames, "the dictionary stays within its limit");
+
+		Check(l_second.size() < l_first.size(), "known names aren't sent again");
+
+		// A receiver that missed the earlier messages
+		CAxonNameDictionary l_empty(l_maxNames);
+
+		CheckThrows("a message for a different dictionary",
+				[&] () { DeserializeWithDict<Shape>(l_ser, l_second, l_empty); });
+		CheckThrows("a dictionary message without a dictionary",
+				[&] () { l_ser.Deserialize<Shape>(l_second); });
+
+		size_t l_numAccepted = 0;
+
+		for (size_t i = 0; i < l_second.size(); ++i)
+		{
+			CAxonNameDictionary l_copy = l_receive;
+
+			try
+			{
+				l_ser.DeserializeData(l_second.data(), l_second.data() + i, l_copy);
+
+				++l_numAccepted;
+			}
+			catch (const exception &)
+			{
+			}
+		}
+
+		Check(l_numAccepted == 0, "a dictionary message rejects every truncation");
+
+		for (size_t i = 0; i < l_second.size(); ++i)
+		{
+			string l_corrupt = l_second;
+			l_corrupt[i] = char(~l_corrupt[i]);
+
+			CAxonNameDictionary l_copy = l_receive;
+
+			try
+			{
+				l_ser.DeserializeData(l_corrupt.data(), l_corrupt.data() + l_corrupt.size(), l_copy);
+			}
+			catch (const exception &)
+			{
+			}
+		}
+	}
+}
+
+// Small values, with the limits of the type and the lengths where a value
+// needs another byte mixed in, so that arrays of each length go through
+// both the block decoder and the value at a time one
+template<typename T>
+vector<T> MakeIntegers(size_t a_count)
+{
+	const T l_edges[] = {
+		numeric_limits<T>::min(), numeric_limits<T>::max(), T(-1),
+		T(63), T(64), T(127), T(128), T(16383), T(16384), T(numeric_limits<T>::max() / 3)
+	};
+
+	vector<T> l_ret;
+
+	for (size_t i = 0; i < a_count; ++i)
+	{
+		if (i % 3 == 2)
+			l_ret.push_back(l_edges[(i / 3) % (sizeof(l_edges) / sizeof(T))]);
+		else
+			l_ret.push_back(T(i % 50));
+	}
+
+	return l_ret;
+}
+
+template<typename T>
+void CheckPackedType(const CAxonSerializer &a_ser, const string &a_type)
+{
+	for (size_t l_count : { 0, 1, 15, 16, 17, 40, 100 })
+	{
+		const vector<T> l_vals = MakeIntegers<T>(l_count);
+
+		string l_buff;
+		Check(RoundTrip(a_ser, l_vals, &l_buff) == l_vals,
+				to_string(l_count) + " packed " + a_type + " values round trip");
+
+		if (l_count == 40)
+		{
+			CheckTruncations(a_ser, l_buff, "a packed " + a_type + " array");
+			CheckCorruptions(a_ser, l_buff);
+		}
+	}
+
+	CAxonSerializer l_plain;
+
+	const vector<T> l_small(100, T(1));
+
+	Check(a_ser.Serialize(l_small).size() < l_plain.Serialize(l_small).size(),
+			"small " + a_type + " values are packed");
+}
+
+void CheckPackedIntegers()
+{
+	Section("Packed integers");
+
+	CAxonSerializer l_ser;
+	l_ser.SetPackIntegerArrays(true);
+
+	CheckPackedType<int16_t>(l_ser, "short");
+	CheckPackedType<uint16_t>(l_ser, "ushort");
+	CheckPackedType<int32_t>(l_ser, "int");
+	CheckPackedType<uint32_t>(l_ser, "uint");
+	CheckPackedType<int64_t>(l_ser, "long");
+	CheckPackedType<uint64_t>(l_ser, "ulong");
+}
+
+// Lengths on either side of a byte and of a 64 bit word, since the values
+// are packed a word at a time
+void CheckPackedBools()
+{
+	Section("Packed bools");
+
+	CAxonSerializer l_ser;
+	l_ser.SetPackBoolArrays(true);
+
+	for (size_t l_count : { 0, 1, 7, 8, 9, 63, 64, 65, 200 })
+	{
+		vector<bool> l_vals;
+
+		for (size_t i = 0; i < l_count; ++i)
+			l_vals.push_back(i % 3 == 0 || i % 7 == 0);
+
+		string l_buff;
+		Check(RoundTrip(l_ser, l_vals, &l_buff) == l_vals,
+				to_string(l_count) + " packed bools round trip");
+
+		if (l_count == 65)
+		{
+			CheckTruncations(l_ser, l_buff, "a packed bool array");
+			CheckCorruptions(l_ser, l_buff);
+		}
+	}
+
+	CAxonSerializer l_plain;
+
+	const vector<bool> l_vals(200, true);
+
+	Check(l_ser.Serialize(l_vals).size() < l_plain.Serialize(l_vals).size(), "bools are packed");
+	Check(l_plain.Deserialize<vector<bool>>(l_ser.Serialize(l_vals)) == l_vals,
+			"packed bools are read without the option set");
+}
+
+void CheckColumnarArrays()
+{
+	Section("Columnar arrays");
+
+	CAxonSerializer l_ser;
+	l_ser.SetColumnarArrays(true);
+
+	for (size_t l_count : { 0, 1, 2, 50 })
+	{
+		vector<Point> l_points;
+
+		for (size_t i = 0; i < l_count; ++i)
+			l_points.push_back(MakePoint(int(i)));
+
+		string l_buff;
+		Check(RoundTrip(l_ser, l_points, &l_buff) == l_points,
+				to_string(l_count) + " structs round trip as columns");
+
+		if (l_count == 2)
+		{
+			CheckTruncations(l_ser, l_buff, "a columnar array");
+			CheckCorruptions(l_ser, l_buff);
+		}
+	}
+
+	// Columns of structs that hold columnar arrays themselves
+	vector<Shape> l_shapes(3);
+
+	for (size_t i = 0; i < l_shapes.size(); ++i)
+	{
+		l_shapes[i].Origin = MakePoint(int(i));
+		l_shapes[i].Points.assign(i, MakePoint(int(i) + 10));
+		l_shapes[i].Offset.Z = double(i) / 4;
+	}
+
+	string l_buff;
+	Check(RoundTrip(l_ser, l_shapes, &l_buff) == l_shapes, "nested columns round trip");
+
+	CAxonSerializer l_plain;
+
+	Check(l_buff != l_plain.Serialize(l_shapes), "the structs are written as columns");
+	Check(l_plain.Deserialize<vector<Shape>>(l_buff) == l_shapes,
+			"columns are read without the option set");
+}
+
+template<typename T>
+struct DeltaArray
+{
+	vector<T> Values;
+};
+
+template<typename T>
+void BindStruct(const CStructBinder &a_binder, DeltaArray<T> &a_val)
+{
+	a_binder("Values", a_val.Values, SerializationFlags::Delta);
+}
+
+// Compared bitwise, so that NaNs and the sign of zero count
+template<typename T>
+bool SameBits(const vector<T> &a_left, const vector<T> &a_right)
+{
+	return a_left.size() == a_right.size() &&
+		(a_left.empty() || 0 == memcmp(a_left.data(), a_right.data(), a_left.size() * sizeof(T)));
+}
+
+template<typename T>
+void CheckDeltaType(const CAxonSerializer &a_ser, const vector<T> &a_special, const string &a_type)
+{
+	for (size_t l_count : { 0, 1, 2, 17, 100 })
+	{
+		DeltaArray<T> l_array;
+
+		// A slowly changing series, with the special values spread through it
+		for (size_t i = 0; i < l_count; ++i)
+		{
+			if (i % 5 == 4)
+				l_array.Values.push_back(a_special[(i / 5) % a_special.size()]);
+			else
+				l_array.Values.push_back(T(1000 + i / 2));
+		}
+
+		string l_buff;
+		Check(SameBits(RoundTrip(a_ser, l_array, &l_buff).Values, l_array.Values),
+				to_string(l_count) + " delta coded " + a_type + " values round trip");
+
+		if (l_count == 17)
+		{
+			CheckTruncations(a_ser, l_buff, "a delta coded " + a_type + " array");
+			CheckCorruptions(a_ser, l_buff);
+		}
+	}
+
+	DeltaArray<T> l_series;
+
+	for (size_t i = 0; i < 100; ++i)
+		l_series.Values.push_back(T(1000 + i / 4));
+
+	Check(a_ser.Serialize(l_series).size() < a_ser.Serialize(l_series.Values).size(),
+			"a slowly changing " + a_type + " series is smaller delta coded");
+}
+
+// Integer differences that overflow the type have to wrap around, and
+// float values are XORed bitwise, so NaNs, infinities, denormals and
+// negative zero have to come back unchanged
+void CheckDeltaCoding()
+{
+	Section("Delta coding");
+
+	CAxonSerializer l_ser;
+
+	CheckDeltaType<int16_t>(l_ser, { numeric_limits<int16_t>::min(), numeric_limits<int16_t>::max(), -1 }, "short");
+	CheckDeltaType<uint32_t>(l_ser, { 0, numeric_limits<uint32_t>::max(), 1 }, "uint");
+	CheckDeltaType<int64_t>(l_ser, { numeric_limits<int64_t>::min(), numeric_limits<int64_t>::max(), -1 }, "long");
+	CheckDeltaType<uint64_t>(l_ser, { 0, numeric_limits<uint64_t>::max(), 1 }, "ulong");
+
+	CheckDeltaType<float>(l_ser, {
+			numeric_limits<float>::quiet_NaN(), numeric_limits<float>::infinity(),
+			-0.0f, numeric_limits<float>::denorm_min(), numeric_limits<float>::max() }, "float");
+	CheckDeltaType<double>(l_ser, {
+			numeric_limits<double>::quiet_NaN(), -numeric_limits<double>::infinity(),
+			-0.0, numeric_limits<double>::denorm_min(), numeric_limits<double>::lowest() }, "double");
+}
+
+struct Blob
+{
+	util::CBuffer Packed;
+	util::CBuffer Plain;
+};
+
+void BindStruct(const CStructBinder &a_binder, Blob &a_val)
+{
+	a_binder("Packed", a_val.Packed, SerializationFlags::Compress)
+			("Plain", a_val.Plain);
+}
+
+util::CBuffer MakeBuffer(const string &a_data)
+{
+	util::CBuffer l_ret(a_data.size());
+
+	if (!a_data.empty())
+		memcpy(l_ret.Data(), a_data.data(), a_data.size());
+
+	return l_ret;
+}
+
+bool SameData(const util::CBuffer &a_buff, const string &a_data)
+{
+	return a_buff.Size() == a_data.size() &&
+		(a_data.empty() || 0 == memcmp(a_buff.Data(), a_data.data(), a_data.size()));
+}
+
+string Repeat(const string &a_text, size_t a_size)
+{
+	string l_ret;
+
+	while (l_ret.size() < a_size)
+		l_ret += a_text;
+
+	l_ret.resize(a_size);
+	return l_ret;
+}
+
+string MakeRandom(size_t a_size)
+{
+	mt19937 l_rand(static_cast<uint32_t>(a_size));
+
+	string l_ret;
+
+	for (size_t i = 0; i < a_size; ++i)
+		l_ret.push_back(char(l_rand()));
+
+	return l_ret;
+}
+
+// Buffers flagged for compression are compressed when they are large
+// enough, and readers refuse them without the compressor, or when they
+// would decompress to more than the reader allows
+void CheckCompressedBuffersWith(ASerializer &a_ser, ASerializer &a_plain, const ICompressor::Ptr &a_compressor)
+{
+	const string l_name = a_ser.FormatName() + " with " + a_compressor->Name();
+
+	a_ser.SetBufferCompressor(a_compressor);
+
+	const string l_text = Repeat("The quick brown fox jumps over the lazy dog. ", 8192);
+
+	Blob l_blob;
+	l_blob.Packed = MakeBuffer(l_text);
+	l_blob.Plain = MakeBuffer("plain");
+
+	const string l_buff = a_ser.Serialize(l_blob);
+	const Blob l_read = a_ser.Deserialize<Blob>(l_buff);
+
+	Check(SameData(l_read.Packed, l_text) && SameData(l_read.Plain, "plain"),
+			l_name + ": a compressed buffer round trips");
+	Check(l_buff.size() < a_plain.Serialize(l_blob).size(), l_name + ": the buffer is compressed");
+
+	CheckThrows(l_name + ": a compressed buffer without the compressor",
+			[&] () { a_plain.Deserialize<Blob>(l_buff); });
+
+	a_ser.SetMaxDecompressedSize(l_text.size() - 1);
+
+	CheckThrows(l_name + ": a buffer larger than the decompression limit",
+			[&] () { a_ser.Deserialize<Blob>(l_buff); });
+
+	a_ser.SetMaxDecompressedSize(ASerializer::DEFAULT_MAX_DECOMPRESSED_SIZE);
+
+	// Below the threshold, and not worth compressing
+	const string l_short = Repeat("abc", a_ser.CompressThreshold() - 1);
+	const string l_random = MakeRandom(4096);
+
+	for (const string &l_data : { l_short, l_random, string() })
+	{
+		l_blob.Packed = MakeBuffer(l_data);
+
+		const string l_uncompressed = a_ser.Serialize(l_blob);
+
+		Check(SameData(a_ser.Deserialize<Blob>(l_uncompressed).Packed, l_data),
+				l_name + ": an uncompressed buffer round trips");
+		Check(l_uncompressed.size() == a_plain.Serialize(l_blob).size(),
+				l_name + ": a buffer that doesn't shrink is written as it is");
+	}
+
+	l_blob.Packed = MakeBuffer(Repeat("0123456789", 2000));
+
+	const string l_small = a_ser.Serialize(l_blob);
+
+	CheckTruncations(a_ser, l_small, l_name + ": a compressed buffer");
+	CheckCorruptions(a_ser, l_small);
+}
+
+void CheckCompressedBuffers()
+{
+	Section("Compressed buffers");
+
+	const ICompressor::Ptr l_compressors[] = {
+		ICompressor::Ptr(new CSnappyCompressor()),
+		ICompressor::Ptr(new CLZ4Compressor()),
+		ICompressor::Ptr(new CZstdCompressor())
+	};
+
+	for (const ICompressor::Ptr &l_compressor : l_compressors)
+	{
+		CAxonSerializer l_axon, l_axonPlain;
+		CheckCompressedBuffersWith(l_axon, l_axonPlain, l_compressor);
+
+		CMsgPackSerializer l_msgpack, l_msgpackPlain;
+		CheckCompressedBuffersWith(l_msgpack, l_msgpackPlain, l_compressor);
+	}
+}
+
+string ReadFileBytes(const string &a_fileName)
+{
+	ifstream l_file(a_fileName, ios_base::binary);
+
+	return string(istreambuf_iterator<char>(l_file), istreambuf_iterator<char>());
+}
+
+void WriteFileBytes(const string &a_fileName, const string &a_data)
+{
+	ofstream l_file(a_fileName, ios_base::binary | ios_base::trunc);
+
+	l_file.write(a_data.data(), a_data.size());
+}
+
+const uint64_t NUM_LOG_RECORDS = 1000;
+
+void WriteLog(const string &a_fileName, const ICompressor::Ptr &a_compressor)
+{
+	CRecordLogWriter l_writer(a_fileName, ASerializer::Ptr(new CAxonSerializer));
+	l_writer.SetCompressor(a_compressor);
+	l_writer.SetBlockSize(1024);
+
+	for (uint64_t i = 0; i < NUM_LOG_RECORDS; ++i)
+		l_writer.Append(MakePoint(int(i)));
+
+	l_writer.Close();
+}
+
+// Reads every record in order, and returns how many matched
+uint64_t ScanLog(CRecordLogReader &a_reader, uint64_t a_from)
+{
+	a_reader.Seek(a_from);
+
+	uint64_t l_numMatched = 0;
+	Point l_point;
+
+	for (uint64_t i = a_from; a_reader.Next(l_point); ++i)
+	{
+		if (l_point == MakePoint(int(i)))
+			++l_numMatched;
+	}
+
+	return l_numMatched;
+}
+
+// Records span many blocks, and have to be found by number from anywhere,
+// with or without the index that Close writes. Compressed logs record
+// which compressor wrote them, and can only be read with that one
+void CheckRecordLogs()
+{
+	Section("Record logs");
+
+	const string l_fileName = "format_check_record.log";
+	const string l_copyName = "format_check_record_copy.log";
+
+	WriteLog(l_fileName, ICompressor::Ptr());
+
+	{
+		CRecordLogReader l_reader(l_fileName, ASerializer::Ptr(new CAxonSerializer));
+
+		Check(l_reader.Size() == NUM_LOG_RECORDS, "the log has every record");
+		Check(l_reader.Blocks().size() > 10, "the records are split into blocks");
+		Check(l_reader.CompressorName().empty(), "an uncompressed log has no compressor");
+		Check(ScanLog(l_reader, 0) == NUM_LOG_RECORDS, "the records are read in order");
+		Check(l_reader.Tell() == NUM_LOG_RECORDS, "the scan ends after the last record");
+
+		// Around each block boundary, walking backwards so that every read
+		// loads another block
+		size_t l_numWrong = 0;
+
+		for (size_t b = l_reader.Blocks().size(); b-- > 1; )
+		{
+			const uint64_t l_first = l_reader.Blocks()[b].FirstRecord;
+
+			for (uint64_t l_record : { l_first, l_first - 1 })
+			{
+				if (!(l_reader.Read<Point>(l_record) == MakePoint(int(l_record))))
+					++l_numWrong;
+			}
+		}
+
+		Check(l_numWrong == 0, "records are read by number across block boundaries");
+
+		const uint64_t l_middle = l_reader.Blocks()[l_reader.Blocks().size() / 2].FirstRecord + 1;
+
+		Check(ScanLog(l_reader, l_middle) == NUM_LOG_RECORDS - l_middle, "a scan continues from a seek");
+
+		l_reader.ReadData(3);
+
+		Point l_point;
+		Check(l_reader.Next(l_point) && l_point == MakePoint(4), "a scan continues after a read");
+
+		l_reader.Seek(NUM_LOG_RECORDS);
+		Check(!l_reader.Next(), "a scan from the end reads nothing");
+
+		CheckThrows("a seek past the end", [&] () { l_reader.Seek(NUM_LOG_RECORDS + 1); });
+		CheckThrows("a read past the end", [&] () { l_reader.ReadData(NUM_LOG_RECORDS); });
+	}
+
+	const string l_plain = ReadFileBytes(l_fileName);
+
+	const ICompressor::Ptr l_compressors[] = {
+		ICompressor::Ptr(new CLZ4Compressor()),
+		ICompressor::Ptr(new CZstdCompressor())
+	};
+
+	for (const ICompressor::Ptr &l_compressor : l_compressors)
+	{
+		const string l_name = l_compressor->Name();
+
+		WriteLog(l_fileName, l_compressor);
+
+		Check(ReadFileBytes(l_fileName).size() < l_plain.size(), l_name + ": the log is compressed");
+
+		CRecordLogReader l_reader(l_fileName, ASerializer::Ptr(new CAxonSerializer));
+		l_reader.SetCompressor(l_compressor);
+
+		Check(l_reader.CompressorName() == l_name, l_name + ": the log records its compressor");
+		Check(ScanLog(l_reader, 0) == NUM_LOG_RECORDS, l_name + ": the records are read in order");
+		Check(l_reader.Read<Point>(NUM_LOG_RECORDS / 3) == MakePoint(int(NUM_LOG_RECORDS / 3)),
+				l_name + ": a record is read by number");
+
+		CRecordLogReader l_default(l_fileName, ASerializer::Ptr(new CAxonSerializer));
+
+		CheckThrows(l_name + ": a log read with the default compressor",
+				[&] () { l_default.ReadData(0); });
+
+		l_default.SetCompressor(ICompressor::Ptr());
+
+		CheckThrows(l_name + ": a log read without a compressor",
+				[&] () { l_default.ReadData(0); });
+	}
+
+	{
+		CRecordLogWriter l_writer(l_fileName, ASerializer::Ptr(new CAxonSerializer));
+		l_writer.Append(MakePoint(0));
+		l_writer.Flush();
+
+		CheckThrows("a compressor set after a block was written",
+				[&] () { l_writer.SetCompressor(l_compressors[0]); });
+	}
+
+	// A log that wasn't closed has no index, and may end in a partial block
+	{
+		CRecordLogWriter l_writer(l_fileName, ASerializer::Ptr(new CAxonSerializer));
+		l_writer.SetCompressor(l_compressors[0]);
+		l_writer.SetBlockSize(1024);
+
+		for (uint64_t i = 0; i < NUM_LOG_RECORDS / 2; ++i)
+			l_writer.Append(MakePoint(int(i)));
+
+		l_writer.Flush();
+
+		const string l_flushed = ReadFileBytes(l_fileName);
+
+		for (uint64_t i = NUM_LOG_RECORDS / 2; i < NUM_LOG_RECORDS; ++i)
+			l_writer.Append(MakePoint(int(i)));
+
+		l_writer.Flush();
+
+		const string l_more = ReadFileBytes(l_fileName);
+
+		WriteFileBytes(l_copyName, l_more.substr(0, (l_flushed.size() + l_more.size()) / 2));
+
+		CRecordLogReader l_reader(l_copyName, ASerializer::Ptr(new CAxonSerializer));
+		l_reader.SetCompressor(l_compressors[0]);
+
+		Check(l_reader.Size() >= NUM_LOG_RECORDS / 2 && l_reader.Size() < NUM_LOG_RECORDS,
+				"an unclosed log has the records of its complete blocks");
+		Check(ScanLog(l_reader, 0) == l_reader.Size(), "an unclosed log is read in order");
+		Check(l_reader.Read<Point>(l_reader.Size() - 1) == MakePoint(int(l_reader.Size() - 1)),
+				"the last complete record of an unclosed log is read by number");
+	}
+
+	// Without its last byte, the index of a closed log is lost too
+	{
+		const string l_closed = ReadFileBytes(l_fileName);
+
+		WriteFileBytes(l_copyName, l_closed.substr(0, l_closed.size() - 1));
+
+		CRecordLogReader l_reader(l_copyName, ASerializer::Ptr(new CAxonSerializer));
+		l_reader.SetCompressor(l_compressors[0]);
+
+		Check(l_reader.Size() == NUM_LOG_RECORDS, "a log with a damaged index has every record");
+		Check(ScanLog(l_reader, 0) == NUM_LOG_RECORDS, "a log with a damaged index is read in order");
+	}
+
+	WriteFileBytes(l_copyName, "not a record log");
+
+	CheckThrows("a file that isn't a record log",
+			[&] () { CRecordLogReader(l_copyName, ASerializer::Ptr(new CAxonSerializer)); });
+
+	remove(l_fileName.c_str());
+	remove(l_copyName.c_str());
+}
+
+// Brackets and quotes in the names keep a scanner that only counts
+// brackets honest
+Shape MakeShape(int a_numPoints)
+{
+	Shape l_ret;
+	l_ret.Origin = MakePoint(a_numPoints);
+	l_ret.Origin.Name = "}]\"\\{[ " + to_string(a_numPoints);
+
+	for (int i = 0; i < a_numPoints; ++i)
+		l_ret.Points.push_back(MakePoint(i));
+
+	l_ret.Offset.X = a_numPoints;
+	l_ret.Offset.Z = a_numPoints / 3.0;
+	return l_ret;
+}
+
+// Feeds the stream in chunks of 1 to a_maxChunk bytes, and collects the
+// values as they complete
+vector<AData::Ptr> ParseInChunks(CIncrementalParser &a_parser, const string &a_stream, size_t a_maxChunk)
+{
+	mt19937 l_rand(static_cast<uint32_t>(a_maxChunk));
+
+	vector<AData::Ptr> l_ret;
+
+	for (size_t l_pos = 0; l_pos < a_stream.size(); )
+	{
+		const size_t l_chunk = min<size_t>(1 + l_rand() % a_maxChunk, a_stream.size() - l_pos);
+
+		a_parser.Feed(a_stream.data() + l_pos, l_chunk);
+		l_pos += l_chunk;
+
+		while (AData::Ptr l_data = a_parser.Next())
+			l_ret.push_back(move(l_data));
+	}
+
+	return l_ret;
+}
+
+// A stream of values has to come out of the parser the same way as each
+// value does from DeserializeData, however the stream is split up
+void CheckIncrementalParsingWith(const ASerializer::Ptr &a_ser, const string &a_separator)
+{
+	const string l_name = a_ser->FormatName();
+
+	vector<string> l_expected;
+	string l_stream;
+
+	for (int l_numPoints : { 0, 1, 2, 7, 30, 3, 1000, 0, 12 })
+	{
+		const string l_buff = a_ser->Serialize(MakeShape(l_numPoints));
+
+		l_expected.push_back(a_ser->DeserializeData(l_buff.data(), l_buff.data() + l_buff.size())->ToJsonString());
+		l_stream += l_buff + a_separator;
+	}
+
+	for (size_t l_maxChunk : { size_t(1), size_t(7), size_t(100), size_t(5000), l_stream.size() })
+	{
+		const string l_what = l_name + " in chunks of up to " + to_string(l_maxChunk) + " bytes";
+
+		CIncrementalParser l_parser(a_ser);
+
+		const vector<AData::Ptr> l_values = ParseInChunks(l_parser, l_stream, l_maxChunk);
+
+		bool l_same = l_values.size() == l_expected.size();
+
+		for (size_t i = 0; l_same && i < l_values.size(); ++i)
+			l_same = l_values[i]->ToJsonString() == l_expected[i];
+
+		Check(l_same, l_what + ": every value matches DeserializeData");
+		Check(!l_parser.Next() && l_parser.Buffered() == a_separator.size(),
+				l_what + ": nothing is left over");
+	}
+
+	CIncrementalParser l_parser(a_ser);
+
+	const size_t l_numValues = ParseInChunks(l_parser, l_stream.substr(0, l_stream.size() - a_separator.size() - 1), 1).size();
+
+	Check(l_numValues == l_expected.size() - 1 && l_parser.Buffered() > 0,
+			l_name + ": a value missing its last byte is held back");
+}
+
+void CheckIncrementalParsing()
+{
+	Section("Incremental parsing");
+
+	CheckIncrementalParsingWith(ASerializer::Ptr(new CAxonSerializer), "");
+	CheckIncrementalParsingWith(ASerializer::Ptr(new CMsgPackSerializer), "");
+	CheckIncrementalParsingWith(ASerializer::Ptr(new CJsonSerializer), "\n");
+}
+
+struct Numbers
+{
+	vector<int8_t> SBytes;
+	vector<uint8_t> UBytes;
+	vector<int16_t> Shorts;
+	vector<uint16_t> UShorts;
+	vector<int32_t> Ints;
+	vector<uint32_t> UInts;
+	vector<int64_t> Longs;
+	vector<uint64_t> ULongs;
+	vector<float> Floats;
+	vector<double> Doubles;
+	vector<bool> Bools;
+	vector<string> Strings;
+	int64_t Long = 0;
+	uint64_t ULong = 0;
+	double Double = 0;
+
+	bool operator==(const Numbers &a_other) const
+	{
+		return SBytes == a_other.SBytes && UBytes == a_other.UBytes &&
+			Shorts == a_other.Shorts && UShorts == a_other.UShorts &&
+			Ints == a_other.Ints && UInts == a_other.UInts &&
+			Longs == a_other.Longs && ULongs == a_other.ULongs &&
+			SameBits(Floats, a_other.Floats) && SameBits(Doubles, a_other.Doubles) &&
+			Bools == a_other.Bools && Strings == a_other.Strings &&
+			Long == a_other.Long && ULong == a_other.ULong &&
+			SameBits(vector<double>(1, Double), vector<double>(1, a_other.Double));
+	}
+};
+
+void BindStruct(const CStructBinder &a_binder, Numbers &a_val)
+{
+	a_binder("SBytes", a_val.SBytes)
+			("UBytes", a_val.UBytes)
+			("Shorts", a_val.Shorts)
+			("UShorts", a_val.UShorts)
+			("Ints", a_val.Ints)
+			("UInts", a_val.UInts)
+			("Longs", a_val.Longs)
+			("ULongs", a_val.ULongs)
+			("Floats", a_val.Floats)
+			("Doubles", a_val.Doubles)
+			("Bools", a_val.Bools)
+			("Strings", a_val.Strings)
+			("Long", a_val.Long)
+			("ULong", a_val.ULong)
+			("Double", a_val.Double);
+}
+
+// The limits of the type, and the values around 0
+template<typename T>
+vector<T> MakeBoundaries()
+{
+	typedef numeric_limits<T> lim;
+
+	return { lim::lowest(), T(lim::lowest() + 1), T(-1), T(0), T(1), T(lim::max() - 1), lim::max() };
+}
+
+template<typename T>
+vector<T> MakeFloatBoundaries()
+{
+	typedef numeric_limits<T> lim;
+
+	return { lim::lowest(), -lim::max() / 3, T(-1) / 3, -lim::denorm_min(), -T(0), T(0), lim::denorm_min(),
+			 lim::min(), lim::epsilon(), T(0.1), T(1) / 3, T(2) / 3, T(1e15), T(123456789.123456789), lim::max() };
+}
+
+Numbers MakeNumbers()
+{
+	Numbers l_ret;
+	l_ret.SBytes = MakeBoundaries<int8_t>();
+	l_ret.UBytes = MakeBoundaries<uint8_t>();
+	l_ret.Shorts = MakeBoundaries<int16_t>();
+	l_ret.UShorts = MakeBoundaries<uint16_t>();
+	l_ret.Ints = MakeBoundaries<int32_t>();
+	l_ret.UInts = MakeBoundaries<uint32_t>();
+	l_ret.Longs = MakeBoundaries<int64_t>();
+	l_ret.ULongs = MakeBoundaries<uint64_t>();
+	l_ret.Floats = MakeFloatBoundaries<float>();
+	l_ret.Doubles = MakeFloatBoundaries<double>();
+	l_ret.Bools = { true, false, false, true };
+	l_ret.Strings = { "", "plain", "\"quoted\"", "back\\slash", "/", "line\nbreak\ttab\r",
+					  string("\x01\x1f\x7f", 3), "caf\xc3\xa9 \xe2\x82\xac", "{\"_t\":\"_prim\"}" };
+	l_ret.Long = numeric_limits<int64_t>::min();
+	l_ret.ULong = numeric_limits<uint64_t>::max();
+	l_ret.Double = numeric_limits<double>::max();
+	return l_ret;
+}
+
+// A JSON document has to read back as the same values, with or without the
+// whitespace, including the values that a double can't hold and the ones
+// that only round trip with all of their digits
+void CheckJson()
+{
+	Section("JSON");
+
+	CJsonSerializer l_pretty, l_compact;
+	l_compact.SetPretty(false);
+
+	vector<Shape> l_shapes;
+
+	for (int i = 0; i < 20; ++i)
+		l_shapes.push_back(MakeShape(i));
+
+	const Numbers l_numbers = MakeNumbers();
+
+	string l_prettyBuff, l_compactBuff;
+
+	Check(RoundTrip(l_pretty, l_shapes, &l_prettyBuff) == l_shapes, "nested structs round trip");
+	Check(RoundTrip(l_compact, l_shapes, &l_compactBuff) == l_shapes, "compact nested structs round trip");
+
+	Check(l_prettyBuff.find('\n') != string::npos, "pretty output is indented");
+	Check(l_compactBuff.size() < l_prettyBuff.size(), "compact output is smaller");
+
+	vector<Point> l_points;
+
+	for (int i = 0; i < 20; ++i)
+		l_points.push_back(MakePoint(i));
+
+	const string l_compactPoints = l_compact.Serialize(l_points);
+
+	Check(l_compactPoints.find_first_of(" \t\r\n") == string::npos, "compact output has no whitespace");
+	Check(l_pretty.Deserialize<vector<Point>>(l_compactPoints) == l_points, "compact output is read with pretty set");
+	Check(l_compact.Deserialize<vector<Point>>(l_pretty.Serialize(l_points)) == l_points,
+			"pretty output is read with pretty unset");
+
+	Check(RoundTrip(l_pretty, l_numbers, &l_prettyBuff) == l_numbers, "primitive arrays and number limits round trip");
+	Check(RoundTrip(l_compact, l_numbers, &l_compactBuff) == l_numbers,
+			"compact primitive arrays and number limits round trip");
+
+	// Primitive arrays whose values come before their type can't be read
+	// straight into the array, and are converted afterwards
+	const string l_type = to_string(int(DataType::Long));
+	const string l_values = "[-9223372036854775808,0,9223372036854775807]";
+	const vector<int64_t> l_longs = { numeric_limits<int64_t>::min(), 0, numeric_limits<int64_t>::max() };
+
+	Check(l_compact.Deserialize<vector<int64_t>>("{\"_t\":\"_prim\",\"_it\":" + l_type + ",\"_v\":" + l_values + "}") == l_longs,
+			"a primitive array with its type first is read");
+	Check(l_compact.Deserialize<vector<int64_t>>("{\"_t\":\"_prim\",\"_v\":" + l_values + ",\"_it\":" + l_type + "}") == l_longs,
+			"a primitive array with its type last is read");
+
+	const string l_malformed[] = {
+		"", " ", "{", "}", "[", "{\"X\":}", "{\"X\" 1}", "{\"X\":1,}", "[1,]", "[1 2]",
+		"{\"X\":tru}", "{\"X\":nul}", "{\"X\":\"abc}", "{\"X\":\"\\q\"}", "{\"X\":01}", "{\"X\":1e}",
+		"{\"X\":-}", "{\"X\":1}}", "{\"X\":1} 2", "{'X':1}", "{X:1}",
+		"{\"_t\":\"_prim\",\"_it\":" + l_type + ",\"_v\":[1,[2]]}",
+		"{\"_t\":\"_prim\",\"_it\":" + l_type + ",\"_v\":[{}]}",
+		"{\"_t\":\"_prim\",\"_it\":99,\"_v\":[1]}", "{\"_t\":\"_prim\",\"_it\":" + l_type + "}",
+		"{\"_t\":\"_buffer\",\"_enclen\":4,\"_rawlen\":3,\"_compressed\":false,\"_data\":[\"A\"]}"
+	};
+
+	for (const string &l_doc : l_malformed)
+	{
+		CheckThrows("the document '" + l_doc + "'",
+				[&] () { l_compact.DeserializeData(l_doc.data(), l_doc.data() + l_doc.size()); });
+	}
+
+	CheckTruncations(l_compact, l_compact.Serialize(l_shapes[3]), "compact JSON");
+	CheckTruncations(l_pretty, l_pretty.Serialize(l_shapes[3]), "pretty JSON");
+	CheckCorruptions(l_compact, l_compact.Serialize(l_shapes[3]));
+	CheckCorruptions(l_compact, l_compact.Serialize(l_numbers));
+}
+
+// Files are mapped into memory, and buffers read from them can point into
+// the mapping. They have to stay valid after the serializer and the file
+// are gone, and writing to them must not change the file
+void CheckMappedFiles()
+{
+	Section("Mapped files");
+
+	const string l_fileName = "format_check_mapped.bin";
+
+	CAxonSerializer l_axon;
+	CMsgPackSerializer l_msgpack;
+	CJsonSerializer l_json;
+
+	const ASerializer *l_serializers[] = { &l_axon, &l_msgpack, &l_json };
+
+	WriteFileBytes(l_fileName, "");
+
+	for (const ASerializer *l_ser : l_serializers)
+	{
+		CheckThrows(l_ser->FormatName() + ": an empty file",
+				[&] () { l_ser->DeserializeDataFromFile(l_fileName); });
+	}
+
+	remove(l_fileName.c_str());
+
+	for (const ASerializer *l_ser : l_serializers)
+	{
+		CheckThrows(l_ser->FormatName() + ": a missing file",
+				[&] () { l_ser->DeserializeDataFromFile(l_fileName); });
+	}
+
+	const string l_text = MakeRandom(100000);
+
+	Blob l_blob;
+	l_blob.Packed = MakeBuffer("packed");
+	l_blob.Plain = MakeBuffer(l_text);
+
+	l_axon.SerializeToFile(l_fileName, l_blob);
+
+	const string l_file = ReadFileBytes(l_fileName);
+
+	Blob l_read;
+
+	{
+		CAxonSerializer l_ser;
+		l_ser.DeserializeFromFile(l_fileName, l_read);
+	}
+
+	Check(SameData(l_read.Plain, l_text), "a buffer read from a file outlives the serializer");
+
+	for (size_t i = 0; i < l_read.Plain.Size(); i += 4096)
+		l_read.Plain.Data()[i] = ~l_read.Plain.Data()[i];
+
+	Blob l_reread;
+	l_axon.DeserializeFromFile(l_fileName, l_reread);
+
+	Check(ReadFileBytes(l_fileName) == l_file, "writing to a buffer read from a file leaves the file alone");
+	Check(SameData(l_reread.Plain, l_text), "writing to a buffer read from a file leaves later reads alone");
+
+	remove(l_fileName.c_str());
+
+	size_t l_numChanged = 0;
+
+	for (size_t i = 0; i < l_read.Plain.Size(); ++i)
+	{
+		if (l_read.Plain.Data()[i] != l_text[i])
+			++l_numChanged;
+	}
+
+	Check(l_read.Plain.Size() == l_text.size() && l_numChanged == (l_text.size() + 4095) / 4096,
+			"a buffer read from a file outlives the file, and keeps what was written to it");
+	Check(SameData(l_read.Packed, "packed"), "a small buffer read from a file outlives the file");
+}
+
+struct Bulk
+{
+	vector<Shape> Shapes;
+	util::CBuffer Data;
+	vector<bool> Flags;
+	vector<int64_t> Counts;
+	vector<string> Texts;
+};
+
+void BindStruct(const CStructBinder &a_binder, Bulk &a_val)
+{
+	a_binder("Shapes", a_val.Shapes)
+			("Data", a_val.Data, SerializationFlags::Compress)
+			("Flags", a_val.Flags)
+			("Counts", a_val.Counts)
+			("Texts", a_val.Texts);
+}
+
+// Several times the size of the buffer that streams are written through,
+// with single values that are larger than it, and many small ones that
+// cross its end
+Bulk MakeBulk()
+{
+	Bulk l_ret;
+
+	for (int i = 0; i < 300; ++i)
+		l_ret.Shapes.push_back(MakeShape(i % 50));
+
+	l_ret.Data = MakeBuffer(MakeRandom(200000) + Repeat("compressible ", 100000));
+
+	for (size_t i = 0; i < 100000; ++i)
+		l_ret.Flags.push_back(i % 7 == 0);
+
+	l_ret.Counts = MakeIntegers<int64_t>(50000);
+	l_ret.Texts = { Repeat("text ", 70000), "", "short" };
+	return l_ret;
+}
+
+// Streams and files have to hold exactly what SerializeData returns
+void CheckStreamedOutput(const ASerializer &a_ser, const string &a_name, const Bulk &a_bulk)
+{
+	const string l_fileName = "format_check_stream.bin";
+
+	auto l_data = Serialize(a_bulk);
+
+	const string l_expected = a_ser.SerializeData(*l_data);
+
+	ostringstream l_stream;
+	a_ser.SerializeDataToStream(l_stream, *l_data);
+
+	Check(l_stream.str() == l_expected, a_name + ": the stream holds the same bytes as SerializeData");
+
+	a_ser.SerializeDataToFile(l_fileName, *l_data);
+
+	Check(ReadFileBytes(l_fileName) == l_expected, a_name + ": the file holds the same bytes as SerializeData");
+	Check(a_ser.SerializeData(*a_ser.DeserializeDataFromFile(l_fileName)) == l_expected,
+			a_name + ": the file reads back as the same data");
+
+	remove(l_fileName.c_str());
+}
+
+void CheckStreamedOutputs()
+{
+	Section("Streamed output");
+
+	const Bulk l_bulk = MakeBulk();
+
+	CAxonSerializer l_axon;
+	CMsgPackSerializer l_msgpack;
+	CJsonSerializer l_json;
+
+	CheckStreamedOutput(l_axon, "axon", l_bulk);
+	CheckStreamedOutput(l_msgpack, "msgpack", l_bulk);
+	CheckStreamedOutput(l_json, "json", l_bulk);
+
+	CAxonSerializer l_packedAxon;
+	l_packedAxon.SetPackIntegerArrays(true);
+	l_packedAxon.SetPackBoolArrays(true);
+	l_packedAxon.SetColumnarArrays(true);
+	l_packedAxon.SetBufferCompressor(ICompressor::Ptr(new CZstdCompressor()));
+
+	CheckStreamedOutput(l_packedAxon, "packed and compressed axon", l_bulk);
+
+	CMsgPackSerializer l_packedMsgpack;
+	l_packedMsgpack.SetPackBoolArrays(true);
+	l_packedMsgpack.SetBufferCompressor(ICompressor::Ptr(new CLZ4Compressor()));
+
+	CheckStreamedOutput(l_packedMsgpack, "packed and compressed msgpack", l_bulk);
+
+	CJsonSerializer l_compactJson;
+	l_compactJson.SetPretty(false);
+
+	CheckStreamedOutput(l_compactJson, "compact json", l_bulk);
+}
+
+int main(int argc, char *argv[])
+{
+	CheckNameTables();
+	CheckNameDictionary();
+	CheckDecodeLimits();
+	CheckPackedIntegers();
+	CheckPackedBools();
+	CheckColumnarArrays();
+	CheckDeltaCoding();
+	CheckCompressedBuffers();
+	CheckRecordLogs();
+	CheckIncrementalParsing();
+	CheckJson();
+	CheckMappedFiles();
+	CheckStreamedOutputs();
+
+	if (s_numFailed)
+	{
+		cout << s_numFailed << " of " << s_numChecks << " checks failed." << endl;
+		return 1;
+	}
+
+	cout << "All " << s_numChecks << " checks passed." << endl;
+	return 0;
+}
@@ -0,0 +1,148 @@
+/*
+ * File description: latency_demo.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <numeric>
+#include <string>
+#include <vector>
+
+#include "serialization/master.h"
+
+#include "communication/messaging/axon_client.h"
+#include "communication/messaging/axon_server.h"
+#include "communication/tcp/socket_options.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace axon::util;
+using namespace axon::serialization;
+using namespace axon::communication;
+using namespace axon::communication::tcp;
+
+// Round trips small calls over loopback with each set of socket options, and
+// prints the latency percentiles. Both ends use the same options. With more
+// than one call in flight, each sample is the time until the whole burst has
+// come back, which is where Nagle's algorithm and delayed acks show up.
+//
+// Usage: latency_demo [protocol] [samples] [calls in flight] [options...]
+// e.g.   latency_demo uring 50000 1 "nodelay=1&busypoll=50"
+int main(int argc, char *argv[])
+{
+	CContract<int (int, int)> l_add("Add");
+
+	string l_protocol = "tcp";
+	size_t l_numCalls = 20000;
+	size_t l_inFlight = 1;
+
+	if (argc > 1)
+		l_protocol = argv[1];
+	if (argc > 2)
+		l_numCalls = StringTo<size_t>(argv[2]);
+	if (argc > 3)
+		l_inFlight = max<size_t>(1, StringTo<size_t>(argv[3]));
+
+	vector<string> l_profiles;
+
+	for (int i = 4; i < argc; ++i)
+		l_profiles.push_back(argv[i]);
+
+	if (l_profiles.empty())
+	{
+		l_profiles = {
+			"nodelay=0",
+			"nodelay=1",
+			"nodelay=1&quickack=1",
+			"nodelay=1&quickack=1&busypoll=50",
+			"nodelay=1&sndbuf=1048576&rcvbuf=1048576",
+		};
+	}
+
+	const size_t l_numWarmup = min<size_t>(1000, l_numCalls);
+
+	int l_port = 12346;
+
+	// Kept until the end, so that nothing is torn down while the last reply
+	// is still being processed
+	vector<CAxonClient::Ptr> l_clients;
+	vector<CAxonServer::Ptr> l_servers;
+
+	cout << left << setw(45) << "Options"
+		 << right << setw(10) << "Mean(us)"
+		 << setw(10) << "p50(us)"
+		 << setw(10) << "p99(us)"
+		 << setw(10) << "p99.9(us)"
+		 << setw(10) << "Max(us)" << endl;
+
+	for (const string &l_profile : l_profiles)
+	{
+		// Catches typos before anything is started
+		CSocketOptions::Parse(l_profile);
+
+		// A new port each time, since the last one can linger
+		const string l_hostString = ToString(l_port) + "?" + l_profile;
+		const string l_connString = "127.0.0.1:" + ToString(l_port) + "?" + l_profile;
+		++l_port;
+
+		auto l_server = CAxonServer::Create(l_protocol + "://" + l_hostString);
+		l_server->HostContract(l_add, [] (int a, int b) { return a + b; });
+
+		auto l_client = CAxonClient::Create(l_protocol + "://" + l_connString);
+
+		for (size_t i = 0; i < l_numWarmup; ++i)
+			l_client->Send(l_add, 1000, int(i), 1);
+
+		vector<double> l_times;
+		l_times.reserve(l_numCalls);
+
+		vector<IContractWaitHandle<int>::Ptr> l_handles;
+
+		for (size_t i = 0; i < l_numCalls; ++i)
+		{
+			auto l_start = steady_clock::now();
+
+			if (l_inFlight == 1)
+			{
+				l_client->Send(l_add, 1000, int(i), 1);
+			}
+			else
+			{
+				for (size_t j = 0; j < l_inFlight; ++j)
+					l_handles.push_back(l_client->SendAsync(l_add, 1000, int(i), int(j)));
+
+				for (auto &l_handle : l_handles)
+					l_handle->Get();
+
+				l_handles.clear();
+			}
+
+			auto l_end = steady_clock::now();
+
+			l_times.push_back(duration_cast<nanoseconds>(l_end - l_start).count() / 1000.0);
+		}
+
+		l_clients.push_back(move(l_client));
+		l_servers.push_back(move(l_server));
+
+		sort(l_times.begin(), l_times.end());
+
+		auto l_percentile = [&l_times] (double a_pct)
+			{
+				return l_times[min(l_times.size() - 1, size_t(a_pct * l_times.size()))];
+			};
+
+		const double l_mean = accumulate(l_times.begin(), l_times.end(), 0.0) / l_times.size();
+
+		cout << left << setw(45) << l_profile << right << fixed << setprecision(1)
+			 << setw(10) << l_mean
+			 << setw(10) << l_percentile(0.5)
+			 << setw(10) << l_percentile(0.99)
+			 << setw(10) << l_percentile(0.999)
+			 << setw(10) << l_times.back() << endl;
+	}
+}
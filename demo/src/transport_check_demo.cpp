@@ -0,0 +1,1314 @@
+/*
+ * File description: transport_check_demo.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "serialization/master.h"
+#include "serialization/format/lz4_compressor.h"
+#include "serialization/format/zstd_compressor.h"
+
+#include "communication/messaging/axon_client.h"
+#include "communication/messaging/axon_server.h"
+#include "communication/messaging/axon_protocol.h"
+#include "communication/messaging/axon_protocol_compressed.h"
+#include "communication/tcp/tcp_data_connection.h"
+#include "communication/tcp/tcp_data_server.h"
+#include "util/string_convert.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace axon::util;
+using namespace axon::serialization;
+using namespace axon::communication;
+using namespace axon::communication::tcp;
+
+// Starts a server on each transport, connects clients to it, and checks
+// that calls go through: a small call, a payload that is larger than the
+// buffers of the transport, and many calls in flight at once. Then checks
+// fragmented messages, over TCP and by feeding the frames to a protocol
+// directly, and checks the send limits of TCP connections against a peer
+// that stops reading, and broadcasts to such a peer. Then checks the frames
+// of compressed messages by feeding them to a protocol directly. Prints every
+// check that fails, and returns non-zero if any did.
+//
+// Usage: transport_check_demo [transport...|fragments|limits|broadcasts|compression]
+// e.g.   transport_check_demo tcp unix shm inproc uring fragments limits broadcasts compression
+size_t s_numChecks = 0;
+size_t s_numFailed = 0;
+string s_section;
+
+CContract<int (int, int)> s_add("Add");
+CContract<string (string)> s_echo("Echo");
+CContract<void (string)> s_notify("Notify");
+
+// Kept until the end, so that nothing is torn down while the last reply
+// is still being processed
+vector<CAxonClient::Ptr> s_clients;
+vector<CAxonServer::Ptr> s_servers;
+
+const uint32_t TIMEOUT = 10000;
+
+void Section(const string &a_name)
+{
+	s_section = a_name;
+
+	cout << a_name << endl;
+}
+
+void Check(bool a_ok, const string &a_what)
+{
+	++s_numChecks;
+
+	if (!a_ok)
+	{
+		++s_numFailed;
+
+		cout << "FAILED: " << s_section << ": " << a_what << endl;
+	}
+}
+
+string MakeText(size_t a_size)
+{
+	string l_ret;
+
+	for (size_t i = 0; i < a_size; ++i)
+		l_ret.push_back(char('a' + i % 26));
+
+	return l_ret;
+}
+
+// Polls until a_done is true, for up to 10 seconds
+bool WaitFor(const function<bool ()> &a_done)
+{
+	for (int i = 0; i < 1000 && !a_done(); ++i)
+		this_thread::sleep_for(milliseconds(10));
+
+	return a_done();
+}
+
+CAxonServer::Ptr StartServer(const string &a_hostString,
+							 IProtocolFactory::Ptr a_factory = GetDefaultProtocolFactory())
+{
+	CAxonServer::Ptr l_server = CAxonServer::Create(a_hostString, a_factory);
+
+	l_server->HostContract(s_add, [] (int a, int b) { return a + b; });
+	l_server->HostContract(s_echo, [] (string a_val) { return a_val; });
+
+	s_servers.push_back(l_server);
+
+	return l_server;
+}
+
+CAxonClient::Ptr ConnectClient(const string &a_connectionString,
+							   IProtocol::Ptr a_protocol = IProtocol::Ptr(new CAxonProtocol))
+{
+	CAxonClient::Ptr l_client = CAxonClient::Create(a_connectionString, move(a_protocol));
+
+	s_clients.push_back(l_client);
+
+	return l_client;
+}
+
+void CheckCalls(IAxonClient &a_client, const string &a_what)
+{
+	Check(a_client.Send(s_add, TIMEOUT, 2, 3) == 5, a_what + " makes a call");
+
+	const string l_large = MakeText(3 * 1024 * 1024 + 17);
+
+	Check(a_client.Send(s_echo, TIMEOUT, l_large) == l_large, a_what + " sends a large payload");
+
+	vector<IContractWaitHandle<int>::Ptr> l_handles;
+
+	for (int i = 0; i < 100; ++i)
+		l_handles.push_back(a_client.SendAsync(s_add, TIMEOUT, i, 1));
+
+	bool l_ok = true;
+
+	for (int i = 0; i < 100; ++i)
+		l_ok = l_handles[i]->Get() == i + 1 && l_ok;
+
+	Check(l_ok, a_what + " makes calls in flight at once");
+}
+
+// Two clients on the same server, so that replies have to go back to the
+// client that made the call. The clients use a_clientName when it is given,
+// for servers that also accept the clients of another transport
+void CheckTransport(const string &a_name, const string &a_hostString, const string &a_connectionString,
+					const string &a_clientName = string())
+{
+	const string l_clientName = a_clientName.empty() ? a_name : a_clientName;
+
+	Section(l_clientName == a_name ? a_name : l_clientName + " to " + a_name);
+
+	try
+	{
+		StartServer(a_name + "://" + a_hostString);
+
+		CAxonClient::Ptr l_first = ConnectClient(l_clientName + "://" + a_connectionString);
+		CAxonClient::Ptr l_second = ConnectClient(l_clientName + "://" + a_connectionString);
+
+		CheckCalls(*l_first, "the first client");
+		CheckCalls(*l_second, "the second client");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+}
+
+const size_t FRAGMENT_SIZE = 64 * 1024;
+
+IProtocol::Ptr MakeFragmentingProtocol(size_t a_fragmentSize = FRAGMENT_SIZE)
+{
+	CAxonProtocol *l_protocol = new CAxonProtocol;
+	l_protocol->SetFragmentSize(a_fragmentSize);
+
+	return IProtocol::Ptr(l_protocol);
+}
+
+class CFragmentingProtocolFactory
+	: public IProtocolFactory
+{
+public:
+	virtual IProtocol::Ptr Create() const override
+	{
+		return MakeFragmentingProtocol();
+	}
+};
+
+CMessage MakeMessage(size_t a_size, char a_fill)
+{
+	CMessage l_msg;
+	l_msg.SetAction("Fill");
+	l_msg.Add("Payload", Serialize(string(a_size, a_fill)));
+
+	return l_msg;
+}
+
+// Feeds a frame to the protocol in pieces of a_chunk bytes, the way that a
+// transport would hand over whatever has arrived
+void Feed(IProtocol &a_protocol, const CBuffer &a_frame, size_t a_chunk)
+{
+	for (size_t i = 0; i < a_frame.Size(); i += a_chunk)
+	{
+		a_protocol.Process(CDataBuffer::Copy(a_frame.Data() + i, min(a_chunk, a_frame.Size() - i)));
+	}
+}
+
+// The fill character of every message that was received whole, or '?' for
+// one that came out different from what was sent
+struct CReceived
+{
+	string Fills;
+	vector<size_t> Sizes;
+
+	IProtocol::HandlerFn Handler()
+	{
+		return [this] (CMessage::Ptr a_msg)
+			{
+				const string l_payload = a_msg->GetField<string>("Payload");
+
+				const bool l_whole = !l_payload.empty() &&
+						l_payload.find_first_not_of(l_payload[0]) == string::npos;
+
+				Fills.push_back(l_whole ? l_payload[0] : '?');
+				Sizes.push_back(l_payload.size());
+			};
+	}
+};
+
+void CheckFragmentFrames()
+{
+	Section("fragment frames");
+
+	CAxonProtocol l_sender;
+	l_sender.SetFragmentSize(100000);
+
+	const vector<CBuffer> l_large = l_sender.SerializeFragments(MakeMessage(1000000, 'a'));
+	const vector<CBuffer> l_medium = l_sender.SerializeFragments(MakeMessage(350000, 'b'));
+	const vector<CBuffer> l_small = l_sender.SerializeFragments(MakeMessage(50, 'c'));
+
+	Check(l_large.size() > 1 && l_medium.size() > 1, "a message over the fragment size is split");
+	Check(l_small.size() == 1, "a message under the fragment size is not split");
+
+	{
+		CAxonProtocol l_recv;
+		CReceived l_got;
+		l_recv.SetHandler(l_got.Handler());
+
+		// Interleaved with each other, and cut at different places
+		for (size_t i = 0; i < max(l_large.size(), l_medium.size()); ++i)
+		{
+			if (i < l_large.size())
+				Feed(l_recv, l_large[i], 7777);
+			if (i < l_medium.size())
+				Feed(l_recv, l_medium[i], 100000);
+			Feed(l_recv, l_small[0], 3);
+		}
+
+		Check(count(l_got.Fills.begin(), l_got.Fills.end(), 'c') == ptrdiff_t(max(l_large.size(), l_medium.size())),
+			  "whole messages go through between fragments");
+		Check(l_got.Fills.find('a') != string::npos && l_got.Fills.find('b') != string::npos,
+			  "interleaved fragments are put back together");
+		Check(l_got.Fills.find('?') == string::npos, "no message is mixed up with another");
+	}
+
+	{
+		auto l_budget = make_shared<CReceiveBudget>(10000000);
+
+		CAxonProtocol l_recv;
+		CReceived l_got;
+		l_recv.SetHandler(l_got.Handler());
+		l_recv.SetReceiveBudget(l_budget);
+
+		for (size_t i = 0; i < 5; ++i)
+			Feed(l_recv, l_large[i], 65536);
+
+		Check(l_budget->InUse() > 0, "a partial message holds on to its budget");
+
+		Feed(l_recv, l_sender.SerializeFragmentAbort(l_large[0]), 3);
+		Feed(l_recv, l_small[0], 7);
+
+		Check(l_budget->InUse() == 0, "an abort releases the partial message");
+		Check(l_got.Fills == "c", "an aborted message is not received");
+
+		// The rest of the aborted message has nothing to go with
+		for (size_t i = 5; i < l_large.size(); ++i)
+			Feed(l_recv, l_large[i], 65536);
+		Feed(l_recv, l_small[0], 7);
+
+		Check(l_got.Fills == "cc", "fragments without a start are dropped");
+		Check(l_budget->InUse() == 0, "dropped fragments don't hold on to the budget");
+
+		for (const CBuffer &l_frag : l_large)
+			Feed(l_recv, l_frag, 1 << 20);
+
+		Check(l_got.Fills == "cca", "a message goes through after an abort");
+	}
+
+	{
+		// Over the frame limit once put together, even though every
+		// fragment is under it
+		auto l_budget = make_shared<CReceiveBudget>(0, 0, 500000);
+
+		CAxonProtocol l_recv;
+		CReceived l_got;
+		l_recv.SetHandler(l_got.Handler());
+		l_recv.SetReceiveBudget(l_budget);
+
+		for (const CBuffer &l_frag : l_large)
+			Feed(l_recv, l_frag, 65536);
+		for (const CBuffer &l_frag : l_medium)
+			Feed(l_recv, l_frag, 65536);
+
+		Check(l_recv.NumRejectedFrames() > 0, "a message over the frame limit is rejected");
+		Check(l_got.Fills == "b", "a message under the frame limit goes through");
+		Check(l_budget->InUse() == 0, "a rejected message doesn't hold on to the budget");
+	}
+
+	{
+		CAxonProtocol l_recv;
+		CReceived l_got;
+		l_recv.SetHandler(l_got.Handler());
+
+		// A fragment from the middle with its payload corrupted
+		CBuffer l_corrupt(l_large[1].Size());
+		memcpy(l_corrupt.Data(), l_large[1].Data(), l_corrupt.Size());
+		l_corrupt.Data()[l_corrupt.Size() / 2] ^= 0x5A;
+
+		bool l_threw = false;
+
+		try
+		{
+			Feed(l_recv, l_large[0], 65536);
+			Feed(l_recv, l_corrupt, 65536);
+			for (size_t i = 2; i < l_large.size(); ++i)
+				Feed(l_recv, l_large[i], 65536);
+		}
+		catch (const exception &)
+		{
+			l_threw = true;
+		}
+
+		Check(l_got.Fills.find('a') == string::npos && l_got.Fills.find('?') == string::npos,
+			  "a message with a corrupted fragment is not received");
+
+		if (l_threw)
+			l_recv.Reset();
+
+		Feed(l_recv, l_small[0], 3);
+
+		Check(l_got.Fills == "c", "a message goes through after a corrupted fragment");
+	}
+}
+
+// Both ends fragment, so the large payload goes out in pieces each way, and
+// the calls in flight get their frames sent in between the pieces
+void CheckFragmentedCalls()
+{
+	Section("fragmented tcp");
+
+	try
+	{
+		StartServer("tcp://12464", make_shared<CFragmentingProtocolFactory>());
+
+		CAxonClient::Ptr l_client = ConnectClient("tcp://127.0.0.1:12464", MakeFragmentingProtocol());
+
+		CheckCalls(*l_client, "a fragmenting client");
+
+		// A client that doesn't fragment still talks to the server
+		CAxonClient::Ptr l_plain = ConnectClient("tcp://127.0.0.1:12464");
+
+		CheckCalls(*l_plain, "a client that doesn't fragment");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+}
+
+// A TCP peer that doesn't read from its connection until asked to. Its
+// receive buffer is small, so that a connection to it fills up quickly. It
+// either accepts a single connection, or connects to a server
+class CStalledPeer
+{
+private:
+	int m_listener;
+	int m_socket;
+
+public:
+	typedef unique_ptr<CStalledPeer> Ptr;
+
+	static Ptr Listen(int a_port)
+	{
+		Ptr l_ret(new CStalledPeer);
+		l_ret->m_listener = l_ret->p_Socket();
+
+		const int l_one = 1;
+		setsockopt(l_ret->m_listener, SOL_SOCKET, SO_REUSEADDR, &l_one, sizeof(l_one));
+
+		const sockaddr_in l_addr = s_Address(a_port);
+
+		if (bind(l_ret->m_listener, reinterpret_cast<const sockaddr*>(&l_addr), sizeof(l_addr)) != 0 ||
+			listen(l_ret->m_listener, 1) != 0)
+			throw runtime_error("Unable to listen on port " + ToString(a_port) + ".");
+
+		return l_ret;
+	}
+
+	static Ptr Connect(int a_port)
+	{
+		Ptr l_ret(new CStalledPeer);
+		l_ret->m_socket = l_ret->p_Socket();
+
+		const sockaddr_in l_addr = s_Address(a_port);
+
+		if (connect(l_ret->m_socket, reinterpret_cast<const sockaddr*>(&l_addr), sizeof(l_addr)) != 0)
+			throw runtime_error("Unable to connect to port " + ToString(a_port) + ".");
+
+		return l_ret;
+	}
+
+	~CStalledPeer()
+	{
+		if (m_socket >= 0)
+			close(m_socket);
+		if (m_listener >= 0)
+			close(m_listener);
+	}
+
+	// Once the client has connected
+	void Accept()
+	{
+		m_socket = accept(m_listener, nullptr, nullptr);
+
+		if (m_socket < 0)
+			throw runtime_error("Unable to accept the connection.");
+	}
+
+	// Hands everything that arrives to the protocol, until a_done is true,
+	// or nothing has arrived for a second. Returns the bytes that were read
+	size_t ReadUntil(IProtocol &a_protocol, const function<bool ()> &a_done)
+	{
+		vector<char> l_buff(64 * 1024);
+		size_t l_total = 0;
+
+		while (!a_done())
+		{
+			pollfd l_poll = { m_socket, POLLIN, 0 };
+
+			if (poll(&l_poll, 1, 1000) <= 0)
+				break;
+
+			const ssize_t l_numRead = read(m_socket, l_buff.data(), l_buff.size());
+
+			if (l_numRead <= 0)
+				break;
+
+			l_total += size_t(l_numRead);
+
+			a_protocol.Process(CDataBuffer::Copy(l_buff.data(), size_t(l_numRead)));
+		}
+
+		return l_total;
+	}
+
+	void Write(const CDataBuffer &a_buff)
+	{
+		for (size_t l_sent = 0; l_sent < a_buff.Size(); )
+		{
+			const ssize_t l_numSent = write(m_socket, a_buff.Data() + l_sent, a_buff.Size() - l_sent);
+
+			if (l_numSent <= 0)
+				throw runtime_error("Unable to write to the socket.");
+
+			l_sent += size_t(l_numSent);
+		}
+	}
+
+private:
+	CStalledPeer()
+		: m_listener(-1), m_socket(-1)
+	{
+	}
+
+	int p_Socket()
+	{
+		const int l_socket = socket(AF_INET, SOCK_STREAM, 0);
+		const int l_bufSize = 4096;
+
+		if (l_socket < 0)
+			throw runtime_error("Unable to create a socket.");
+
+		// Before the connection is made, so that it applies to the window
+		setsockopt(l_socket, SOL_SOCKET, SO_RCVBUF, &l_bufSize, sizeof(l_bufSize));
+
+		return l_socket;
+	}
+
+	static sockaddr_in s_Address(int a_port)
+	{
+		sockaddr_in l_addr;
+		memset(&l_addr, 0, sizeof(l_addr));
+		l_addr.sin_family = AF_INET;
+		l_addr.sin_port = htons(uint16_t(a_port));
+		l_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+		return l_addr;
+	}
+};
+
+// A 4K message, whose fill follows the order that it was sent in
+CBuffer MakeFrame(size_t a_index)
+{
+	return CAxonProtocol().SerializeMessage(MakeMessage(4096, char('a' + a_index % 26))).ToShared();
+}
+
+string MakeFills(size_t a_count)
+{
+	string l_ret;
+
+	for (size_t i = 0; i < a_count; ++i)
+		l_ret.push_back(char('a' + i % 26));
+
+	return l_ret;
+}
+
+// A connection to a peer that doesn't read, under each of the policies.
+// Once the peer catches up, the writable handler runs, and everything that
+// wasn't refused or dropped arrives in order
+void CheckSendLimits()
+{
+	Section("send limits");
+
+	const CSendLimits l_limits(64 * 1024, 16 * 1024);
+
+	try
+	{
+		CStalledPeer::Ptr l_peer = CStalledPeer::Listen(12469);
+
+		auto l_conn = make_shared<CTcpDataConnection>("127.0.0.1:12469?sndbuf=4096");
+		l_conn->SetSendLimits(CSendLimits(l_limits.HighWaterMark, l_limits.LowWaterMark, BackpressurePolicy::Fail));
+
+		atomic<size_t> l_numWritable(0);
+		l_conn->SetWritableHandler([&l_numWritable] () { ++l_numWritable; });
+
+		l_peer->Accept();
+
+		size_t l_numSent = 0;
+		bool l_refused = false;
+
+		while (!l_refused && l_numSent < 10000)
+		{
+			try
+			{
+				l_conn->Send(MakeFrame(l_numSent), nullptr);
+				++l_numSent;
+			}
+			catch (const exception &)
+			{
+				l_refused = true;
+			}
+		}
+
+		Check(l_refused, "a full connection throws with the fail policy");
+		Check(l_numWritable == 0, "the writable handler doesn't run while the peer is stalled");
+
+		CReceived l_got;
+		CAxonProtocol l_recv;
+		l_recv.SetHandler(l_got.Handler());
+
+		l_peer->ReadUntil(l_recv, [&] () { return l_got.Fills.size() == l_numSent; });
+
+		Check(l_got.Fills == MakeFills(l_numSent), "the sends before the refused one arrive in order");
+		Check(WaitFor([&] () { return l_numWritable > 0; }),
+			  "the writable handler runs once the peer has caught up");
+
+		l_conn->Send(MakeFrame(l_numSent++), nullptr);
+
+		l_peer->ReadUntil(l_recv, [&] () { return l_got.Fills.size() == l_numSent; });
+
+		Check(l_got.Fills == MakeFills(l_numSent), "a send goes through once the peer has caught up");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+
+	try
+	{
+		CStalledPeer::Ptr l_peer = CStalledPeer::Listen(12470);
+
+		auto l_conn = make_shared<CTcpDataConnection>("127.0.0.1:12470?sndbuf=4096");
+		l_conn->SetSendLimits(CSendLimits(l_limits.HighWaterMark, l_limits.LowWaterMark, BackpressurePolicy::Drop));
+
+		l_peer->Accept();
+
+		string l_fills;
+		size_t l_numDropped = 0;
+
+		for (size_t i = 0; i < 1000; ++i)
+		{
+			if (l_conn->SendDroppable(MakeFrame(i)))
+				l_fills.push_back(char('a' + i % 26));
+			else
+				++l_numDropped;
+		}
+
+		Check(l_numDropped > 0, "a full connection drops one-way sends with the drop policy");
+		Check(l_conn->NumDropped() == l_numDropped, "the connection counts the sends that it dropped");
+
+		CReceived l_got;
+		CAxonProtocol l_recv;
+		l_recv.SetHandler(l_got.Handler());
+
+		l_peer->ReadUntil(l_recv, [&] () { return l_got.Fills.size() == l_fills.size(); });
+
+		Check(l_got.Fills == l_fills, "the sends that weren't dropped arrive in order");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+
+	try
+	{
+		CStalledPeer::Ptr l_peer = CStalledPeer::Listen(12471);
+
+		auto l_conn = make_shared<CTcpDataConnection>("127.0.0.1:12471?sndbuf=4096");
+		l_conn->SetSendLimits(CSendLimits(l_limits.HighWaterMark, l_limits.LowWaterMark, BackpressurePolicy::Block));
+
+		atomic<size_t> l_numWritable(0);
+		l_conn->SetWritableHandler([&l_numWritable] () { ++l_numWritable; });
+
+		l_peer->Accept();
+
+		const size_t NUM_SENDS = 200;
+
+		atomic<size_t> l_numSent(0);
+		atomic<bool> l_failed(false);
+
+		thread l_sender(
+			[&] ()
+			{
+				try
+				{
+					for (size_t i = 0; i < NUM_SENDS; ++i, ++l_numSent)
+						l_conn->Send(MakeFrame(i), nullptr);
+				}
+				catch (const exception &)
+				{
+					l_failed = true;
+				}
+			});
+
+		// Gives the sender the time to run into the high water mark
+		this_thread::sleep_for(milliseconds(500));
+
+		const size_t l_numBlocked = l_numSent;
+
+		Check(l_numBlocked < NUM_SENDS, "a full connection blocks the sender with the block policy");
+
+		CReceived l_got;
+		CAxonProtocol l_recv;
+		l_recv.SetHandler(l_got.Handler());
+
+		l_peer->ReadUntil(l_recv, [&] () { return l_got.Fills.size() == NUM_SENDS; });
+
+		// Unblocks the sender if it never resumed
+		if (l_numSent < NUM_SENDS)
+			l_conn->Close();
+
+		l_sender.join();
+
+		Check(!l_failed && l_numSent == NUM_SENDS, "the sender resumes once the peer drains the connection");
+		Check(l_got.Fills == MakeFills(NUM_SENDS), "every blocked send arrives in order");
+		Check(l_numWritable > 0, "the writable handler runs once the connection drains");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+}
+
+// Each message has a field name that none of the ones before it have, so
+// that a name dictionary learns something from every one of them
+CMessage::Ptr MakeNamedMessage(size_t a_index)
+{
+	CMessage::Ptr l_msg = make_shared<CMessage>();
+	l_msg->SetAction("Fill");
+	l_msg->Add("Field" + ToString(a_index), Serialize(string(4096, 'x')));
+
+	return l_msg;
+}
+
+// The client serializes with a name dictionary, which learns the names of a
+// message as it is serialized. A message that the full connection refuses
+// must not be learned, or the peer can't read the ones after it
+void CheckStatefulSendLimits()
+{
+	Section("stateful send limits");
+
+	try
+	{
+		CStalledPeer::Ptr l_peer = CStalledPeer::Listen(12465);
+
+		auto l_conn = make_shared<CTcpDataConnection>("127.0.0.1:12465?sndbuf=4096");
+		l_conn->SetSendLimits(CSendLimits(64 * 1024, 16 * 1024, BackpressurePolicy::Fail));
+
+		l_peer->Accept();
+
+		CAxonClient::Ptr l_client = CAxonClient::Create(l_conn,
+				IProtocol::Ptr(new CAxonProtocol(make_shared<CAxonSerializer>(), true)));
+		s_clients.push_back(l_client);
+
+		size_t l_numSent = 0;
+		bool l_refused = false;
+
+		while (!l_refused && l_numSent < 10000)
+		{
+			try
+			{
+				l_client->SendNonBlocking(MakeNamedMessage(l_numSent));
+				++l_numSent;
+			}
+			catch (const exception &)
+			{
+				l_refused = true;
+			}
+		}
+
+		Check(l_refused, "a full connection refuses a message");
+
+		// The peer catches up, and has to be able to read everything that
+		// went out, and whatever is sent after it
+		CAxonProtocol l_recv(make_shared<CAxonSerializer>(), true);
+
+		size_t l_numReceived = 0;
+		bool l_inOrder = true;
+
+		l_recv.SetHandler(
+			[&] (CMessage::Ptr a_msg)
+			{
+				l_inOrder = l_inOrder &&
+						a_msg->GetField<string>("Field" + ToString(l_numReceived)) == string(4096, 'x');
+				++l_numReceived;
+			});
+
+		bool l_faulted = false;
+
+		try
+		{
+			l_peer->ReadUntil(l_recv, [&] () { return l_numReceived == l_numSent; });
+
+			Check(l_numReceived == l_numSent, "the messages before the refused one arrive");
+
+			l_client->SendNonBlocking(MakeNamedMessage(l_numSent++));
+
+			l_peer->ReadUntil(l_recv, [&] () { return l_numReceived == l_numSent; });
+		}
+		catch (const exception &)
+		{
+			l_faulted = true;
+		}
+
+		Check(!l_faulted && l_inOrder && l_numReceived == l_numSent,
+			  "the peer reads the messages after the refused one");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+}
+
+IProtocol::Ptr MakeDictionaryProtocol()
+{
+	return IProtocol::Ptr(new CAxonProtocol(make_shared<CAxonSerializer>(), true));
+}
+
+class CDictionaryProtocolFactory
+	: public IProtocolFactory
+{
+public:
+	virtual IProtocol::Ptr Create() const override
+	{
+		return MakeDictionaryProtocol();
+	}
+};
+
+// A server with a name dictionary serializes a broadcast for each client.
+// Two clients read everything, and a third doesn't read at all
+struct CBroadcastSetup
+{
+	CAxonServer::Ptr Server;
+	CStalledPeer::Ptr Stalled;
+	atomic<size_t> NumReceived;
+	atomic<size_t> NumLateReceived;
+	string Payload;
+
+	CBroadcastSetup(int a_port, BackpressurePolicy a_policy)
+		: NumReceived(0), NumLateReceived(0), Payload(MakeText(64 * 1024))
+	{
+		auto l_dataServer = make_shared<CTcpDataServer>();
+		l_dataServer->SetSendLimits(CSendLimits(64 * 1024, 16 * 1024, a_policy));
+		l_dataServer->Startup(ToString(a_port) + "?sndbuf=4096");
+
+		Server = CAxonServer::Create(l_dataServer, make_shared<CDictionaryProtocolFactory>());
+		Server->HostContract(s_add, [] (int a, int b) { return a + b; });
+		s_servers.push_back(Server);
+
+		for (int i = 0; i < 2; ++i)
+			Listen(ConnectClient("tcp://127.0.0.1:" + ToString(a_port), MakeDictionaryProtocol()), NumReceived);
+
+		Stalled = CStalledPeer::Connect(a_port);
+
+		if (!WaitFor([this] () { return Server->NumClients() == 3; }))
+			throw runtime_error("The clients didn't connect.");
+	}
+
+	void Listen(const CAxonClient::Ptr &a_client, atomic<size_t> &a_numReceived)
+	{
+		const string &l_payload = Payload;
+
+		a_client->HostContract(s_notify,
+				[&a_numReceived, &l_payload] (string a_val)
+				{
+					if (a_val == l_payload)
+						++a_numReceived;
+				});
+	}
+
+	CMessage::Ptr Message() const
+	{
+		CMessage::Ptr l_msg = s_notify.Serialize(Payload);
+		l_msg->SetOneWay(true);
+
+		return l_msg;
+	}
+};
+
+void CheckBroadcasts()
+{
+	Section("stateful broadcasts");
+
+	try
+	{
+		// The client that doesn't read refuses a broadcast once it is full,
+		// but the clients that read still get every one of them
+		CBroadcastSetup l_setup(12466, BackpressurePolicy::Fail);
+
+		size_t l_numBroadcasts = 0;
+		string l_error;
+
+		while (l_error.empty() && l_numBroadcasts < 1000)
+		{
+			try
+			{
+				l_setup.Server->Broadcast(*l_setup.Message());
+			}
+			catch (const exception &l_ex)
+			{
+				l_error = l_ex.what();
+			}
+
+			++l_numBroadcasts;
+
+			// So that only the client that doesn't read falls behind
+			WaitFor([&] () { return l_setup.NumReceived == 2 * l_numBroadcasts; });
+		}
+
+		Check(l_error.find("1 of 3") != string::npos, "a full client refuses a broadcast");
+		Check(l_setup.NumReceived == 2 * l_numBroadcasts, "the other clients get every broadcast");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+
+	try
+	{
+		// A broadcast that waits on the client that doesn't read holds up
+		// neither the clients that connect in the meantime nor the others
+		CBroadcastSetup l_setup(12467, BackpressurePolicy::Block);
+
+		const size_t l_numBroadcasts = 20;
+		atomic<bool> l_done(false);
+
+		thread l_broadcaster(
+			[&] ()
+			{
+				try
+				{
+					for (size_t i = 0; i < l_numBroadcasts; ++i)
+						l_setup.Server->Broadcast(*l_setup.Message());
+				}
+				catch (const exception &l_ex)
+				{
+					cout << "The broadcast failed. " << l_ex.what() << endl;
+				}
+
+				l_done = true;
+			});
+
+		const bool l_waiting = !WaitFor([&] () { return l_done.load(); }) ||
+							   l_setup.NumReceived < 2 * l_numBroadcasts;
+
+		Check(l_waiting, "a broadcast waits on a full client");
+
+		bool l_connected = false;
+
+		try
+		{
+			CAxonClient::Ptr l_late = ConnectClient("tcp://127.0.0.1:12467", MakeDictionaryProtocol());
+			l_setup.Listen(l_late, l_setup.NumLateReceived);
+
+			l_connected = l_late->Send(s_add, 5000, 2, 3) == 5;
+		}
+		catch (const exception &)
+		{
+		}
+
+		// The client that doesn't read catches up, and the broadcasts carry
+		// on. If they don't, closing it ends them
+		CAxonProtocol l_recv(make_shared<CAxonSerializer>(), true);
+
+		l_setup.Stalled->ReadUntil(l_recv, [&] () { return l_done.load(); });
+
+		if (!l_done)
+			l_setup.Stalled.reset();
+
+		l_broadcaster.join();
+
+		Check(l_connected, "a client connects while a broadcast waits");
+		Check(WaitFor([&] () { return l_setup.NumReceived == 2 * l_numBroadcasts; }),
+			  "the broadcasts carry on once the client catches up");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+}
+
+vector<ICompressor::Ptr> MakeCompressors(const vector<string> &a_names)
+{
+	vector<ICompressor::Ptr> l_ret;
+
+	for (const string &l_name : a_names)
+	{
+		if (l_name == "lz4")
+			l_ret.push_back(make_shared<CLZ4Compressor>());
+		else
+			l_ret.push_back(make_shared<CZstdCompressor>());
+	}
+
+	return l_ret;
+}
+
+class CCompressedProtocolFactory
+	: public IProtocolFactory
+{
+public:
+	virtual IProtocol::Ptr Create() const override
+	{
+		return IProtocol::Ptr(new CAxonProtocolCompressed(make_shared<CAxonSerializer>(),
+				MakeCompressors({ "zstd", "lz4" })));
+	}
+};
+
+// The codec in a frame is the position of the compressor in the list that
+// the peer advertised. The two peers list zstd at different positions, so
+// a broadcast has to be compressed for each of them
+void CheckCompressedBroadcasts()
+{
+	Section("compressed broadcasts");
+
+	try
+	{
+		CAxonServer::Ptr l_server = StartServer("tcp://12468", make_shared<CCompressedProtocolFactory>());
+
+		const string l_payload = MakeText(64 * 1024);
+
+		// Doesn't have a compressor in common with the server, so it gets
+		// the broadcast uncompressed
+		atomic<size_t> l_numPlain(0);
+
+		CAxonClient::Ptr l_plain = ConnectClient("tcp://127.0.0.1:12468",
+				IProtocol::Ptr(new CAxonProtocolCompressed));
+
+		l_plain->HostContract(s_notify,
+				[&l_numPlain, &l_payload] (string a_val)
+				{
+					if (a_val == l_payload)
+						++l_numPlain;
+				});
+
+		struct CPeer
+		{
+			CStalledPeer::Ptr Socket;
+			unique_ptr<CAxonProtocol> Protocol;
+			vector<CMessage::Ptr> Received;
+		};
+
+		CPeer l_peers[2];
+		const vector<string> l_lists[2] = { { "lz4", "zstd" }, { "zstd" } };
+
+		for (int i = 0; i < 2; ++i)
+		{
+			CPeer &l_peer = l_peers[i];
+
+			l_peer.Socket = CStalledPeer::Connect(12468);
+			l_peer.Protocol.reset(new CAxonProtocolCompressed(make_shared<CAxonSerializer>(),
+					MakeCompressors(l_lists[i])));
+			l_peer.Protocol->SetHandler([&l_peer] (CMessage::Ptr a_msg) { l_peer.Received.push_back(a_msg); });
+
+			// The server has read the hello once the call after it comes back
+			l_peer.Socket->Write(l_peer.Protocol->SerializeHello());
+			l_peer.Socket->Write(l_peer.Protocol->SerializeMessage(*s_add.Serialize(2, 3)));
+			l_peer.Socket->ReadUntil(*l_peer.Protocol, [&l_peer] () { return l_peer.Received.size() == 1; });
+		}
+
+		if (!WaitFor([&] () { return l_server->NumClients() == 3; }))
+			throw runtime_error("The clients didn't connect.");
+
+		CMessage::Ptr l_msg = s_notify.Serialize(l_payload);
+		l_msg->SetOneWay(true);
+
+		l_server->Broadcast(*l_msg);
+
+		for (int i = 0; i < 2; ++i)
+		{
+			CPeer &l_peer = l_peers[i];
+
+			const size_t l_numRead = l_peer.Socket->ReadUntil(*l_peer.Protocol,
+					[&l_peer] () { return l_peer.Received.size() == 2; });
+
+			const string l_what = "a peer with zstd at position " + ToString(l_lists[i].size());
+
+			Check(l_peer.Received.size() == 2 && l_peer.Received[1]->GetField<string>("0") == l_payload,
+				  l_what + " reads the broadcast");
+			Check(l_numRead < l_payload.size() / 4, l_what + " gets the broadcast compressed");
+		}
+
+		Check(WaitFor([&] () { return l_numPlain == 1; }),
+			  "a client without a compressor in common gets the broadcast");
+	}
+	catch (const exception &l_ex)
+	{
+		Check(false, string("unexpected exception: ") + l_ex.what());
+	}
+}
+
+// The codec and the flags of a frame, from the header after its token
+uint8_t FrameCodec(const CBuffer &a_frame)
+{
+	return uint8_t(a_frame.Data()[1 + 4]);
+}
+
+uint8_t FrameFlags(const CBuffer &a_frame)
+{
+	return uint8_t(a_frame.Data()[1 + 5]);
+}
+
+const uint8_t FRAME_STREAM = 0x2;
+const uint8_t FRAME_STREAM_START = 0x4;
+
+CAxonProtocol::Ptr MakeCompressedProtocol(const vector<string> &a_names, CReceived &a_received)
+{
+	CAxonProtocol::Ptr l_ret(new CAxonProtocol);
+	l_ret->SetCompressors(MakeCompressors(a_names));
+	l_ret->SetHandler(a_received.Handler());
+
+	return l_ret;
+}
+
+// Sends the hello of each end to the other
+void ExchangeHellos(CAxonProtocol &a_left, CAxonProtocol &a_right)
+{
+	Feed(a_right, a_left.SerializeHello().ToShared(), 1 << 20);
+	Feed(a_left, a_right.SerializeHello().ToShared(), 1 << 20);
+}
+
+string CompressorName(const CAxonProtocol &a_protocol)
+{
+	ICompressor::Ptr l_comp = a_protocol.SendCompressor();
+
+	return l_comp ? l_comp->Name() : string();
+}
+
+// Feeds compressed frames to the protocol directly: the compressor that the
+// hellos pick, the frames that stay uncompressed, and a compression stream
+// that spans many messages and has to be received in order
+void CheckCompressionFrames()
+{
+	Section("compression frames");
+
+	const CMessage l_large = MakeMessage(20000, 'a');
+	const CMessage l_small = MakeMessage(500, 'b');
+
+	{
+		CReceived l_leftGot, l_rightGot;
+		CAxonProtocol::Ptr l_left = MakeCompressedProtocol({ "lz4", "zstd" }, l_leftGot);
+		CAxonProtocol::Ptr l_right = MakeCompressedProtocol({ "zstd", "lz4" }, l_rightGot);
+
+		const CBuffer l_before = l_left->SerializeMessage(l_large).ToShared();
+
+		Check(CompressorName(*l_left).empty() && FrameCodec(l_before) == 0,
+			  "messages are sent uncompressed before the hello");
+
+		ExchangeHellos(*l_left, *l_right);
+
+		Check(CompressorName(*l_left) == "lz4" && CompressorName(*l_right) == "zstd",
+			  "each end sends with the first of its compressors that the other end has");
+
+		const CBuffer l_toRight = l_left->SerializeMessage(l_large).ToShared();
+		const CBuffer l_toLeft = l_right->SerializeMessage(l_large).ToShared();
+
+		Check(FrameCodec(l_toRight) == 2 && FrameCodec(l_toLeft) == 2,
+			  "the codec is the position of the compressor in the list of the receiver");
+		Check(l_toRight.Size() < 20000 / 4 && l_toLeft.Size() < 20000 / 4, "large messages are compressed");
+
+		Feed(*l_right, l_before, 1000);
+		Feed(*l_right, l_toRight, 7);
+		Feed(*l_left, l_toLeft, 3);
+
+		Check(l_rightGot.Fills == "aa" && l_leftGot.Fills == "a", "compressed messages are received");
+	}
+
+	{
+		CReceived l_leftGot, l_rightGot, l_plainGot;
+		CAxonProtocol::Ptr l_left = MakeCompressedProtocol({ "lz4" }, l_leftGot);
+		CAxonProtocol::Ptr l_right = MakeCompressedProtocol({ "zstd" }, l_rightGot);
+		CAxonProtocol::Ptr l_plain = MakeCompressedProtocol({ }, l_plainGot);
+
+		ExchangeHellos(*l_left, *l_right);
+
+		Check(CompressorName(*l_left).empty() && CompressorName(*l_right).empty(),
+			  "no compressor is picked without one in common");
+
+		const CBuffer l_frame = l_left->SerializeMessage(l_large).ToShared();
+
+		Check(FrameCodec(l_frame) == 0 && l_frame.Size() > 20000,
+			  "messages are sent uncompressed without a compressor in common");
+
+		Feed(*l_right, l_frame, 1000);
+
+		ExchangeHellos(*l_left, *l_plain);
+
+		Check(CompressorName(*l_left).empty(), "no compressor is picked for a peer without compressors");
+
+		Feed(*l_plain, l_left->SerializeMessage(l_large).ToShared(), 1000);
+
+		Check(l_rightGot.Fills == "a" && l_plainGot.Fills == "a",
+			  "uncompressed messages are received without a compressor in common");
+	}
+
+	{
+		CReceived l_leftGot, l_rightGot;
+		CAxonProtocol::Ptr l_left = MakeCompressedProtocol({ "lz4" }, l_leftGot);
+		CAxonProtocol::Ptr l_right = MakeCompressedProtocol({ "lz4" }, l_rightGot);
+
+		l_left->SetCompressThreshold(1000);
+
+		ExchangeHellos(*l_left, *l_right);
+
+		const CBuffer l_under = l_left->SerializeMessage(l_small).ToShared();
+		const CBuffer l_over = l_left->SerializeMessage(l_large).ToShared();
+
+		Check(FrameCodec(l_under) == 0, "a message under the threshold is sent uncompressed");
+		Check(FrameCodec(l_over) == 1, "a message over the threshold is compressed");
+
+		l_left->SetCompressThreshold(0);
+
+		const CBuffer l_noThreshold = l_left->SerializeMessage(l_small).ToShared();
+
+		Check(FrameCodec(l_noThreshold) == 1, "every message is compressed without a threshold");
+
+		Feed(*l_right, l_under, 100);
+		Feed(*l_right, l_over, 100);
+		Feed(*l_right, l_noThreshold, 100);
+
+		Check(l_rightGot.Fills == "bab", "messages on either side of the threshold are received");
+	}
+
+	{
+		CReceived l_senderGot, l_recvGot;
+		CAxonProtocol::Ptr l_sender = MakeCompressedProtocol({ "zstd" }, l_senderGot);
+		CAxonProtocol::Ptr l_recv = MakeCompressedProtocol({ "zstd" }, l_recvGot);
+
+		l_sender->SetStreamCompression(true);
+		l_sender->SetCompressThreshold(0);
+		l_recv->SetStreamCompression(true);
+
+		ExchangeHellos(*l_sender, *l_recv);
+
+		CAxonProtocol l_plain;
+
+		vector<CBuffer> l_frames;
+		string l_fills;
+		size_t l_plainSize = 0;
+		size_t l_streamSize = 0;
+		bool l_flagsOk = true;
+
+		for (size_t i = 0; i < 200; ++i)
+		{
+			const CMessage l_msg = MakeMessage(100 + i % 10, char('a' + i % 26));
+
+			l_frames.push_back(l_sender->SerializeMessage(l_msg).ToShared());
+			l_fills.push_back(char('a' + i % 26));
+
+			const uint8_t l_flags = FrameFlags(l_frames.back());
+
+			l_flagsOk = l_flagsOk && FrameCodec(l_frames.back()) == 1 &&
+					l_flags == (i == 0 ? FRAME_STREAM | FRAME_STREAM_START : FRAME_STREAM);
+
+			l_plainSize += l_plain.SerializeMessage(l_msg).Size();
+			l_streamSize += l_frames.back().Size();
+		}
+
+		Check(l_flagsOk, "only the first frame of a stream starts it");
+		Check(l_streamSize < l_plainSize / 2, "a stream compresses small messages against the ones before them");
+
+		for (const CBuffer &l_frame : l_frames)
+			Feed(*l_recv, l_frame, 5);
+
+		Check(l_recvGot.Fills == l_fills, "the messages of a stream are received in order");
+
+		for (size_t l_first : { size_t(1), size_t(2) })
+		{
+			CReceived l_got;
+			CAxonProtocol::Ptr l_late = MakeCompressedProtocol({ "zstd" }, l_got);
+
+			bool l_faulted = false;
+
+			try
+			{
+				for (size_t i = l_first; i < l_frames.size(); ++i)
+					Feed(*l_late, l_frames[i], 1 << 20);
+			}
+			catch (const CFaultException &)
+			{
+				l_faulted = true;
+			}
+
+			Check(l_faulted && l_got.Fills.empty(), "a stream frame received before the start of its stream faults");
+		}
+	}
+}
+
+bool IsSelected(const vector<string> &a_selected, const string &a_name)
+{
+	if (a_selected.empty())
+		return true;
+
+	for (const string &l_name : a_selected)
+	{
+		if (l_name == a_name)
+			return true;
+	}
+
+	return false;
+}
+
+int main(int argc, char *argv[])
+{
+	const vector<string> l_selected(argv + 1, argv + argc);
+
+	if (IsSelected(l_selected, "tcp"))
+		CheckTransport("tcp", "12461", "127.0.0.1:12461");
+	if (IsSelected(l_selected, "unix"))
+		CheckTransport("unix", "/tmp/axon_transport_check.sock", "/tmp/axon_transport_check.sock");
+	if (IsSelected(l_selected, "shm"))
+		CheckTransport("shm", "axon_transport_check", "axon_transport_check");
+	if (IsSelected(l_selected, "inproc"))
+		CheckTransport("inproc", "transport_check", "transport_check");
+	if (IsSelected(l_selected, "uring"))
+	{
+		CheckTransport("uring", "12462", "127.0.0.1:12462");
+		CheckTransport("uring", "12463", "127.0.0.1:12463", "tcp");
+	}
+	if (IsSelected(l_selected, "fragments"))
+	{
+		CheckFragmentFrames();
+		CheckFragmentedCalls();
+	}
+	if (IsSelected(l_selected, "limits"))
+	{
+		CheckSendLimits();
+		CheckStatefulSendLimits();
+	}
+	if (IsSelected(l_selected, "broadcasts"))
+	{
+		CheckBroadcasts();
+		CheckCompressedBroadcasts();
+	}
+	if (IsSelected(l_selected, "compression"))
+		CheckCompressionFrames();
+
+	if (s_numFailed)
+	{
+		cout << s_numFailed << " of " << s_numChecks << " checks failed." << endl;
+		return 1;
+	}
+
+	cout << "All " << s_numChecks << " checks passed." << endl;
+	return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * File description: varint_demo.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "serialization/master.h"
+#include "util/string_convert.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace axon::util;
+using namespace axon::serialization;
+
+// Times writing and reading integer arrays with the Axon serializer, with
+// and without packed integers, for values that take a different number of
+// bytes each as varints. Prints the size of the output, and the values per
+// second in each direction, from the best of the runs.
+//
+// Usage: varint_demo [values] [runs]
+struct Values
+{
+	vector<int64_t> Longs;
+	vector<int32_t> Ints;
+};
+
+void BindStruct(const CStructBinder &a_binder, Values &a_vals)
+{
+	a_binder("Longs", a_vals.Longs)
+			("Ints", a_vals.Ints);
+}
+
+template<typename Fn>
+double BestOf(size_t a_runs, Fn a_fn)
+{
+	double l_best = 0;
+
+	for (size_t i = 0; i < a_runs; ++i)
+	{
+		auto l_start = high_resolution_clock::now();
+
+		a_fn();
+
+		const double l_secs = duration<double>(high_resolution_clock::now() - l_start).count();
+
+		if (i == 0 || l_secs < l_best)
+			l_best = l_secs;
+	}
+
+	return l_best;
+}
+
+// Values with varints of up to a_maxBytes bytes, after zig-zag encoding.
+// Half of them are negative
+Values MakeValues(size_t a_count, int a_minBytes, int a_maxBytes)
+{
+	mt19937_64 l_rand(a_count * 31 + a_maxBytes);
+
+	uniform_int_distribution<int> l_numBytes(a_minBytes, a_maxBytes);
+
+	Values l_ret;
+
+	for (size_t i = 0; i < a_count; ++i)
+	{
+		const int l_bits = 7 * l_numBytes(l_rand) - 1;
+
+		const int64_t l_max = (int64_t(1) << l_bits) - 1;
+		const int64_t l_val = int64_t(l_rand() & uint64_t(l_max));
+
+		l_ret.Longs.push_back(i & 1 ? -l_val : l_val);
+		l_ret.Ints.push_back(int32_t(l_bits > 31 ? l_val >> (l_bits - 31) : l_val) * (i & 1 ? -1 : 1));
+	}
+
+	return l_ret;
+}
+
+int main(int argc, char *argv[])
+{
+	size_t l_numValues = 1 << 20;
+	size_t l_numRuns = 10;
+
+	if (argc > 1)
+		l_numValues = StringTo<size_t>(argv[1]);
+	if (argc > 2)
+		l_numRuns = max<size_t>(1, StringTo<size_t>(argv[2]));
+
+	struct Dist
+	{
+		const char *Name;
+		int MinBytes;
+		int MaxBytes;
+	};
+
+	const Dist l_dists[] = {
+		{ "1 byte", 1, 1 },
+		{ "2 bytes", 2, 2 },
+		{ "1-2 bytes", 1, 2 },
+		{ "1-3 bytes", 1, 3 },
+		{ "3-5 bytes", 3, 5 },
+		{ "9 bytes", 9, 9 },
+	};
+
+	cout << left << setw(12) << "Values"
+		 << setw(8) << "Mode"
+		 << right << setw(12) << "Size(KB)"
+		 << setw(14) << "Write(M/s)"
+		 << setw(14) << "Read(M/s)" << endl;
+
+	for (const Dist &l_dist : l_dists)
+	{
+		const Values l_vals = MakeValues(l_numValues, l_dist.MinBytes, l_dist.MaxBytes);
+
+		const double l_count = 2.0 * l_numValues;
+
+		for (bool l_pack : { false, true })
+		{
+			CAxonSerializer l_ser;
+			l_ser.SetPackIntegerArrays(l_pack);
+
+			string l_buff;
+
+			const double l_write = BestOf(l_numRuns, [&] () { l_buff = l_ser.Serialize(l_vals); });
+
+			Values l_read;
+
+			const double l_readTime = BestOf(l_numRuns,
+					[&] () { l_ser.Deserialize(l_buff.data(), l_buff.data() + l_buff.size(), l_read); });
+
+			if (l_read.Longs != l_vals.Longs || l_read.Ints != l_vals.Ints)
+			{
+				cout << "The values didn't round trip." << endl;
+				return 1;
+			}
+
+			cout << left << setw(12) << l_dist.Name
+				 << setw(8) << (l_pack ? "packed" : "raw")
+				 << right << fixed << setprecision(1)
+				 << setw(12) << l_buff.size() / 1024.0
+				 << setw(14) << l_count / l_write / 1e6
+				 << setw(14) << l_count / l_readTime / 1e6 << endl;
+		}
+	}
+
+	return 0;
+}
@@ -80,6 +80,53 @@ public:
 
 	virtual void Send(const util::CBuffer &buff, std::condition_variable *finishEvt) = 0;
 
+	/*
+	 * Sends data that the connection may discard when the peer isn't keeping
+	 * up, instead of holding on to it, like one-way messages. Returns false
+	 * if the data was discarded. Connections without send limits always send it.
+	 */
+	virtual bool SendDroppable(const util::CBuffer &a_buff)
+	{
+		Send(a_buff, nullptr);
+		return true;
+	}
+
+	/*
+	 * For data that has to go out once it has been produced, like the frames
+	 * of a stateful protocol, whose state moves on as they are serialized.
+	 * CheckSend throws if the connection would refuse a send right now, and
+	 * is called before the data is produced. SendChecked then never refuses
+	 * the data, even if the connection filled up in between. Connections
+	 * that don't refuse sends always send it.
+	 */
+	virtual void CheckSend()
+	{
+	}
+	virtual void SendChecked(const util::CBuffer &a_buff)
+	{
+		Send(a_buff, nullptr);
+	}
+
+	/*
+	 * Blocks until the connection holds at most a_size bytes for the peer,
+	 * so that a bulk transfer can be sent a piece at a time without much of
+	 * it queued in front of other messages. Returns false if the connection
+	 * closed. Connections that don't queue data return right away.
+	 */
+	virtual bool WaitForSendQueue(size_t a_size)
+	{
+		return IsOpen();
+	}
+
+	/*
+	 * False when called from a thread that drains the connection, since it
+	 * would be waiting on itself in WaitForSendQueue.
+	 */
+	virtual bool CanWaitForSendQueue() const
+	{
+		return true;
+	}
+
 	virtual void SetReceiveHandler(DataReceivedHandler handler) = 0;
 };
 
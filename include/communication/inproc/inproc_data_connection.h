@@ -0,0 +1,71 @@
+/*
+ * File description: inproc_data_connection.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef INPROC_DATA_CONNECTION_H_
+#define INPROC_DATA_CONNECTION_H_
+
+#include <memory>
+
+#include "../i_data_connection.h"
+#include "../messaging/i_message_connection.h"
+
+
+namespace axon { namespace communication { namespace inproc {
+
+/*
+ * Connection to a server in the same process. Data is queued for the other
+ * side, and messages sent through a CAxonClient are passed across as
+ * objects, so they are never serialized.
+ *
+ * The connection string is the name that the server was started with:
+ * inproc://my_service
+ */
+class AXON_COMMUNICATE_API CInprocDataConnection
+	: public virtual IDataConnection,
+	  public IMessageConnection
+{
+public:
+	class Impl;
+
+private:
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	typedef std::shared_ptr<CInprocDataConnection> Ptr;
+
+	CInprocDataConnection();
+	CInprocDataConnection(const std::string &a_name);
+	CInprocDataConnection(std::unique_ptr<Impl> a_impl);
+
+	~CInprocDataConnection();
+
+	virtual std::string ConnectionString() const;
+
+	virtual bool Connect(const std::string &a_name);
+
+	virtual void Close();
+
+	virtual bool IsOpen() const;
+	virtual bool IsServerClient() const;
+
+	virtual void Send(const util::CBuffer &buff, std::condition_variable *finishEvt);
+
+	virtual void SetReceiveHandler(DataReceivedHandler handler);
+
+	virtual void SendMessage(CMessage::Ptr a_message) override;
+
+	virtual void SetMessageHandler(MessageReceivedHandler a_handler) override;
+
+	Impl *GetImpl() const { return m_impl.get(); }
+};
+
+}
+}
+}
+
+
+
+#endif /* INPROC_DATA_CONNECTION_H_ */
@@ -0,0 +1,51 @@
+/*
+ * File description: inproc_data_server.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef INPROC_DATA_SERVER_H_
+#define INPROC_DATA_SERVER_H_
+
+#include "../i_data_server.h"
+
+namespace axon { namespace communication { namespace inproc {
+
+/*
+ * Server for CInprocDataConnection clients. The host string is a name that
+ * is unique within the process.
+ */
+class AXON_COMMUNICATE_API CInprocDataServer
+	: public virtual IDataServer
+{
+public:
+	class Impl;
+
+private:
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	typedef std::shared_ptr<CInprocDataServer> Ptr;
+
+	CInprocDataServer();
+	CInprocDataServer(const std::string &a_name);
+
+	~CInprocDataServer();
+
+	virtual void Startup(const std::string &a_name) override;
+
+	virtual std::string HostString() const override;
+
+	virtual void Shutdown() override;
+
+	virtual size_t NumClients() const override;
+
+	virtual void Broadcast(const util::CBuffer &buff) override;
+
+	virtual void SetConnectedHandler(ConnectedHandler a_handler) override;
+	virtual void SetDisconnectedHandler(DisconnectedHandler a_handler) override;
+};
+
+} } }
+
+#endif
@@ -7,6 +7,8 @@
 #ifndef A_PROTOCOL_H_
 #define A_PROTOCOL_H_
 
+#include <stdexcept>
+
 #include "i_protocol.h"
 
 namespace axon { namespace communication {
@@ -23,6 +25,27 @@ public:
 		m_handler = std::move(a_fn);
 	}
 
+	virtual CDataBuffer SerializeHello() const override
+	{
+		return CDataBuffer();
+	}
+
+	virtual std::vector<util::CBuffer> SerializeFragments(const CMessage &a_msg) const override
+	{
+		return std::vector<util::CBuffer>(1, SerializeMessage(a_msg).ToShared());
+	}
+
+	virtual util::CBuffer SerializeFragmentAbort(const util::CBuffer &a_fragment) const override
+	{
+		throw std::runtime_error("This protocol doesn't send fragments.");
+	}
+
+	virtual bool IsStateful() const override { return false; }
+
+	virtual void SetReceiveBudget(CReceiveBudget::Ptr a_budget) override { }
+
+	virtual void Reset() override { }
+
 protected:
 	void MessageProcessed(const CMessage::Ptr &a_msg)
 	{
@@ -25,6 +25,8 @@ private:
 public:
 	virtual void Process(CDataBuffer a_buffer);
 
+	virtual void Reset() override;
+
 protected:
 	virtual void ProcessInternal(CDataBuffer a_buffer) = 0;
 
@@ -7,10 +7,14 @@
 #ifndef AXON_CLIENT_H_
 #define AXON_CLIENT_H_
 
+#include <atomic>
+#include <deque>
 #include <mutex>
+#include <vector>
 
 #include "a_contract_host.h"
 #include "i_protocol.h"
+#include "i_message_connection.h"
 #include "../i_data_connection.h"
 #include "i_axon_client.h"
 
@@ -28,6 +32,24 @@ private:
 	IDataConnection::Ptr m_connection;
 	IProtocol::Ptr m_protocol;
 
+	// Set when the connection can take messages as they are, in which
+	// case the protocol is only used for data that was already serialized
+	std::shared_ptr<IMessageConnection> m_msgConnection;
+	std::mutex m_sendLock;
+
+	// Messages that the protocol split into fragments. Each sender sends
+	// the fragments of its own message, taking turns with the others one
+	// fragment at a time. See p_SendFragments
+	struct COutgoingFragments;
+	std::mutex m_fragLock;
+	std::condition_variable m_fragTurn;
+	std::deque<COutgoingFragments *> m_fragQueue;
+
+	// Aborts for messages that were given up on part way through, which
+	// couldn't be sent at the time. They go out ahead of the next message
+	std::vector<util::CBuffer> m_pendingAborts;
+	std::atomic<bool> m_abortsPending;
+
 	std::condition_variable m_newMessageEvent;
 	std::mutex m_pendingLock;
 	std::vector<CMessageSocket*> m_pendingList;
@@ -64,8 +86,15 @@ protected:
 	virtual bool TryHandleWithServer(const CMessage &a_msg, CMessage::Ptr &a_out) const;
 	virtual void HandleProtocolError(std::exception &ex);
 
-private:
 	void p_Send(const CMessage &a_message);
+	void p_Send(const CMessage::Ptr &a_message);
+
+private:
+	void p_SendHello();
+	void p_SendFragments(std::vector<util::CBuffer> a_frames, bool a_droppable);
+	bool p_SendFragment(COutgoingFragments &a_msg);
+	void p_AbortFragments(COutgoingFragments &a_msg);
+	void p_SendPendingAborts();
 
 	void p_OnDataReceived(CDataBuffer a_buffer);
 	void p_OnMessageReceived(const CMessage::Ptr &a_message);
@@ -7,8 +7,13 @@
 #ifndef AXON_PROTOCOL_H_
 #define AXON_PROTOCOL_H_
 
+#include <atomic>
+#include <unordered_map>
+#include <vector>
+
 #include "a_state_protocol.h"
-#include "serialization/format/a_serializer.h"
+#include "serialization/format/axon_serializer.h"
+#include "serialization/format/i_compressor.h"
 
 namespace axon { namespace communication {
 
@@ -25,17 +30,149 @@ private:
 	CDataBuffer m_dataBuff;
 	size_t m_stateCurr;
 
+	// Receive limits. The payload buffer grows as the data arrives, rather
+	// than up front to the size that the header claims
+	size_t m_frameSize;
+	bool m_skipFrame;
+	size_t m_maxFrameSize;
+	size_t m_connectionBudget;
+	CReceiveBudget::Ptr m_recvBudget;
+	size_t m_reserved;
+	size_t m_frameReserved;
+	std::atomic<size_t> m_numRejected;
+
+	// Fragmentation. The fragments of a message are appended to its partial
+	// frame, which is moved into m_dataBuff while a fragment arrives, with
+	// the fragment going after the first m_frameBase bytes
+	struct CPartialFrame
+	{
+		CDataBuffer Buff;
+		size_t Size;
+		size_t Reserved;
+		uint8_t Codec;
+		uint8_t Flags;
+
+		CPartialFrame() : Size(0), Reserved(0), Codec(0), Flags(0) { }
+		CPartialFrame(CPartialFrame &&a_other)
+			: Buff(std::move(a_other.Buff)), Size(a_other.Size), Reserved(a_other.Reserved),
+			  Codec(a_other.Codec), Flags(a_other.Flags) { }
+	};
+	std::unordered_map<uint16_t, CPartialFrame> m_partials;
+	uint16_t m_fragmentId;
+	size_t m_frameBase;
+
+	size_t m_fragmentSize;
+	mutable std::atomic<uint16_t> m_nextFragmentId;
+
 	serialization::ASerializer::Ptr m_serializer;
 
+	// Name dictionary mode. Only available with the Axon serializer
+	std::shared_ptr<serialization::CAxonSerializer> m_axonSerializer;
+	bool m_nameDictionary;
+	mutable std::mutex m_dictLock;
+	mutable serialization::CAxonNameDictionary m_sendDict;
+	serialization::CAxonNameDictionary m_recvDict;
+
+	// Compression. The codec of a frame is the position of its compressor
+	// in the list that the receiver advertised
+	std::vector<serialization::ICompressor::Ptr> m_compressors;
+	size_t m_compressThreshold;
+	mutable std::mutex m_compressLock;
+	serialization::ICompressor::Ptr m_sendCompressor;
+	uint8_t m_sendCodec;
+	bool m_streamCompression;
+	mutable serialization::ICompressionStream::Ptr m_sendStream;
+	serialization::ICompressionStream::Ptr m_recvStream;
+	uint8_t m_frameCodec;
+	uint8_t m_frameFlags;
+
 public:
 	typedef std::unique_ptr<CAxonProtocol> Ptr;
 
+	static const size_t DEFAULT_COMPRESS_THRESHOLD = 256;
+	static const size_t DEFAULT_FRAGMENT_SIZE = 256 * 1024;
+
 	CAxonProtocol();
 	CAxonProtocol(serialization::ASerializer::Ptr a_serializer);
+	CAxonProtocol(serialization::ASerializer::Ptr a_serializer, bool a_nameDictionary);
+	~CAxonProtocol();
 
 	void SetSerializer(serialization::ASerializer::Ptr a_serializer);
 
+	// When enabled, each field name is only sent over the connection once.
+	// Both ends of the connection must enable it
+	void SetNameDictionary(bool a_enabled);
+
+	/*
+	 * The compressors that messages can be compressed with, in order of
+	 * preference. Each end of the connection advertises its compressors
+	 * by name when the connection opens, and compresses with the first of
+	 * its own that the other end also supports. Messages are sent
+	 * uncompressed until the other end has advertised, when the two ends
+	 * don't have a compressor in common, and when they are smaller than
+	 * the threshold. None by default, which keeps the frames compatible
+	 * with protocols that don't support compression.
+	 */
+	void SetCompressors(std::vector<serialization::ICompressor::Ptr> a_compressors);
+	void SetCompressor(serialization::ICompressor::Ptr a_compressor);
+
+	size_t CompressThreshold() const { return m_compressThreshold; }
+	void SetCompressThreshold(size_t a_size) { m_compressThreshold = a_size; }
+
+	// The compressor that messages are currently sent with, if any
+	serialization::ICompressor::Ptr SendCompressor() const;
+
+	// When enabled, and the compressor supports it, the messages of a
+	// connection are compressed as one stream, so that repetitive messages
+	// compress well even when they are small. Makes the protocol stateful
+	void SetStreamCompression(bool a_enabled);
+
+	/*
+	 * The largest message that is received, both as it arrives and once it
+	 * has been decompressed. The connection budget bounds all of the memory
+	 * that a message holds while it is received, which includes the
+	 * compressed and the decompressed copy. Frames that are over either one
+	 * are rejected before their payload is buffered. In bytes, and 0
+	 * doesn't limit anything, which is the default. Only change them before
+	 * the connection receives data.
+	 */
+	size_t MaxFrameSize() const { return m_maxFrameSize; }
+	void SetMaxFrameSize(size_t a_size) { m_maxFrameSize = a_size; }
+
+	size_t ConnectionBudget() const { return m_connectionBudget; }
+	void SetConnectionBudget(size_t a_size) { m_connectionBudget = a_size; }
+
+	CReceiveBudget::Ptr ReceiveBudget() const { return m_recvBudget; }
+	virtual void SetReceiveBudget(CReceiveBudget::Ptr a_budget) override;
+
+	// The frames that were discarded for being over one of the limits
+	size_t NumRejectedFrames() const { return m_numRejected; }
+
+	/*
+	 * Messages with a payload over the fragment size are split into
+	 * fragments of that size by SerializeFragments, so that the frames of
+	 * other messages can be sent in between them instead of waiting behind
+	 * the whole message. The receiver puts them back together. Fragments
+	 * are always received, but 0 doesn't send any, which is the default
+	 * and keeps the frames compatible with protocols that don't support
+	 * them. Stateful protocols don't fragment either, since the pieces of
+	 * different messages would be received out of order.
+	 */
+	size_t FragmentSize() const { return m_fragmentSize; }
+	void SetFragmentSize(size_t a_size) { m_fragmentSize = a_size; }
+
 	virtual CDataBuffer SerializeMessage(const CMessage &a_msg) const override;
+	virtual CDataBuffer SerializeHello() const override;
+	virtual std::vector<util::CBuffer> SerializeFragments(const CMessage &a_msg) const override;
+	virtual util::CBuffer SerializeFragmentAbort(const util::CBuffer &a_fragment) const override;
+
+	virtual bool IsStateful() const override { return m_nameDictionary || m_streamCompression; }
+
+	// The codec of a frame is the position of the compressor in the list of
+	// the peer, so frames are per connection once there are compressors
+	virtual bool IsPerConnection() const override;
+
+	virtual void Reset() override;
 
 protected:
 	virtual void ProcessInternal(CDataBuffer a_buffer) override;
@@ -51,13 +188,30 @@ private:
 	bool p_ReadIntoBuffer(char *a_target, uint64_t a_targetSize,
 						  char *&a_curr, char *a_end);
 
-	void p_ValidateHeader(uint64_t a_headerSize);
+	size_t p_MaxFrameSize() const;
+	size_t p_ConnectionBudget() const;
+	bool p_GrowBuffer(size_t a_size);
+	bool p_Reserve(size_t a_size);
+	void p_Release(size_t a_size);
+	void p_ReleaseBuffer();
+	void p_ReleasePartials();
+	void p_RejectFrame(const char *a_reason);
+
+	void p_BeginFragment();
+	void p_FinishFragment();
+	void p_DropFragment();
+
+	CDataBuffer p_Decompress(CDataBuffer a_buffer);
+	void p_ProcHello(const CDataBuffer &a_buffer);
+
+	void p_ValidateHeader(uint64_t a_header);
 	void p_ValidateData();
 	void p_Finalize();
 	void p_MoveTo(APState a_state);
 
 	void OnFinished(const CMessage::Ptr &a_msg);
 	void ResetState();
+	void ResetCompression();
 };
 
 } }
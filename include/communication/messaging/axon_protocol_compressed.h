@@ -2,23 +2,23 @@
 #define _AXON_PROTOCOL_CHAIN_H_
 
 #include "axon_protocol.h"
-#include "serialization/format/i_compressor.h"
 
 namespace axon { namespace communication {
 
+/*
+ * The Axon protocol with compression enabled. Uses ICompressor::DEFAULT_INSTANCE
+ * unless other compressors are specified. See CAxonProtocol::SetCompressors.
+ */
 class AXON_COMMUNICATE_API CAxonProtocolCompressed
-    : public IProtocol
+    : public CAxonProtocol
 {
-private:
-    CAxonProtocol m_inner;
-    CAxonProtocol m_outer;
-    serialization::ICompressor::Ptr m_compressor;
-
 public:
     typedef std::unique_ptr<CAxonProtocolCompressed> Ptr;
 
     CAxonProtocolCompressed();
     CAxonProtocolCompressed(serialization::ASerializer::Ptr a_serializer);
+    CAxonProtocolCompressed(serialization::ASerializer::Ptr a_serializer,
+                            std::vector<serialization::ICompressor::Ptr> a_compressors);
             
     static Ptr Create()
     {
@@ -28,20 +28,13 @@ public:
     {
         return Ptr(new CAxonProtocolCompressed(std::move(a_serializer)));
     }
-
-    virtual void SetHandler(HandlerFn a_fn) override;
-
-    void SetCompressor(serialization::ICompressor::Ptr a_compressor);
-
-    virtual CDataBuffer SerializeMessage(const CMessage &a_msg) const override;
-
-    virtual void Process(CDataBuffer a_buffer) override;
-
-private:
-    void OnOuterProcessed(const CMessage::Ptr &a_msg);
+    static Ptr Create(serialization::ASerializer::Ptr a_serializer,
+                      std::vector<serialization::ICompressor::Ptr> a_compressors)
+    {
+        return Ptr(new CAxonProtocolCompressed(std::move(a_serializer), std::move(a_compressors)));
+    }
 };
 
 } }
 
 #endif
-
@@ -32,6 +32,7 @@ private:
 	IDataServer::Ptr m_server;
 	IProtocolFactory::Ptr m_proto;
 	IProtocol::Ptr m_broadProto;
+	CReceiveBudget::Ptr m_recvBudget;
 
 public:
 	typedef std::shared_ptr<CAxonServer> Ptr;
@@ -50,6 +51,11 @@ public:
 
 	size_t NumClients() const;
 
+	// Shared by the protocols of the clients that connect afterwards. See
+	// CReceiveBudget
+	CReceiveBudget::Ptr ReceiveBudget() const;
+	void SetReceiveBudget(CReceiveBudget::Ptr a_budget);
+
 	void Broadcast(const CMessage &a_message);
 
 private:
@@ -60,6 +66,7 @@ private:
 	CAxonServer(const std::string &a_hostString, IProtocolFactory::Ptr a_protoFactory);
 	CAxonServer(IDataServer::Ptr a_server, IProtocolFactory::Ptr a_protoFactory);
 
+	void p_BroadcastEach(const CMessage &a_message);
 	void p_OnClientConnected(IDataConnection::Ptr a_client);
 	void p_OnClientDisconnected(IDataConnection::Ptr a_client);
 };
@@ -0,0 +1,39 @@
+/*
+ * File description: i_message_connection.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef I_MESSAGE_CONNECTION_H_
+#define I_MESSAGE_CONNECTION_H_
+
+#include <functional>
+
+#include "message.h"
+
+namespace axon { namespace communication {
+
+/*
+ * Implemented by data connections that can also carry messages without
+ * serializing them, which is only possible when both ends are in the same
+ * process. CAxonClient hands its messages to the connection directly
+ * whenever it supports this, instead of going through its protocol.
+ *
+ * The receiver gets the same object that was sent, so a message must not
+ * be changed after it has been sent.
+ */
+class AXON_COMMUNICATE_API IMessageConnection
+{
+public:
+	typedef std::function<void (CMessage::Ptr)> MessageReceivedHandler;
+
+	virtual ~IMessageConnection() { }
+
+	virtual void SendMessage(CMessage::Ptr a_message) = 0;
+
+	virtual void SetMessageHandler(MessageReceivedHandler a_handler) = 0;
+};
+
+} }
+
+#endif /* I_MESSAGE_CONNECTION_H_ */
@@ -8,9 +8,11 @@
 #define I_PROTOCOL_H_
 
 #include <functional>
+#include <vector>
 
 #include "message.h"
 #include "data_buffer.h"
+#include "receive_budget.h"
 
 namespace axon { namespace communication {
 
@@ -25,9 +27,38 @@ public:
 
 	virtual CDataBuffer SerializeMessage(const CMessage &a_msg) const = 0;
 
+	// A frame that is sent on its own when the connection opens, ahead of
+	// any message, and is never dropped. Empty when there is none
+	virtual CDataBuffer SerializeHello() const = 0;
+
+	// Serializes a message as frames that can be sent with the frames of
+	// other messages in between, and that the peer puts back together.
+	// Messages that aren't split up come back as a single buffer
+	virtual std::vector<util::CBuffer> SerializeFragments(const CMessage &a_msg) const = 0;
+
+	// A frame that tells the peer to discard the fragments that it has of a
+	// message that won't be sent in full. a_fragment is any one of them
+	virtual util::CBuffer SerializeFragmentAbort(const util::CBuffer &a_fragment) const = 0;
+
 	virtual void Process(CDataBuffer a_buffer) = 0;
 
 	virtual void SetHandler(HandlerFn a_fn) = 0;
+
+	// A stateful protocol carries state from one message to the next, so
+	// messages must reach the connection in the order they were serialized
+	virtual bool IsStateful() const = 0;
+
+	// A frame that depends on the connection it was serialized for, like
+	// one compressed with what the peer negotiated, can't be sent to other
+	// connections as it is. Stateful protocols always depend on it
+	virtual bool IsPerConnection() const { return IsStateful(); }
+
+	// Shares the memory that incoming messages may hold on to with the other
+	// connections of the budget. Null removes the budget
+	virtual void SetReceiveBudget(CReceiveBudget::Ptr a_budget) = 0;
+
+	// Discards all state. Invoked whenever the underlying connection changes
+	virtual void Reset() = 0;
 };
 
 AXON_COMMUNICATE_API IProtocol::Ptr GetDefaultProtocol();
@@ -0,0 +1,64 @@
+/*
+ * File description: receive_budget.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef RECEIVE_BUDGET_H_
+#define RECEIVE_BUDGET_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+#include "../dll_export.h"
+
+namespace axon { namespace communication {
+
+/*
+ * Bounds the memory that a group of connections may hold on to for
+ * messages that are still arriving. A server hands its budget to the
+ * protocol of every connection that it accepts, so that a handful of
+ * clients can't tie up all of its memory by announcing large messages.
+ *
+ * Frames that don't fit are rejected. Their data is discarded as it
+ * arrives, and the connection carries on with the next frame, unless the
+ * protocol is stateful, in which case the connection is faulted.
+ */
+class AXON_COMMUNICATE_API CReceiveBudget
+{
+private:
+	size_t m_limit;
+	size_t m_connectionLimit;
+	size_t m_maxFrameSize;
+
+	std::atomic<size_t> m_inUse;
+	std::atomic<size_t> m_numRejected;
+
+public:
+	typedef std::shared_ptr<CReceiveBudget> Ptr;
+
+	// All of the limits are in bytes, and 0 doesn't limit anything. The
+	// connection limit and the maximum frame size apply to each connection
+	// on their own, in addition to the limits of its protocol
+	CReceiveBudget(size_t a_limit, size_t a_connectionLimit = 0, size_t a_maxFrameSize = 0);
+
+	size_t Limit() const { return m_limit; }
+	size_t ConnectionLimit() const { return m_connectionLimit; }
+	size_t MaxFrameSize() const { return m_maxFrameSize; }
+
+	// The memory currently held by the connections
+	size_t InUse() const { return m_inUse; }
+
+	// The frames that any of the connections have rejected
+	size_t NumRejectedFrames() const { return m_numRejected; }
+
+	bool TryReserve(size_t a_size);
+	void Release(size_t a_size);
+
+	void FrameRejected() { ++m_numRejected; }
+};
+
+} }
+
+#endif /* RECEIVE_BUDGET_H_ */
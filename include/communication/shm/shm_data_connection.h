@@ -0,0 +1,66 @@
+/*
+ * File description: shm_data_connection.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef SHM_DATA_CONNECTION_H_
+#define SHM_DATA_CONNECTION_H_
+
+#include <memory>
+
+#include "../i_data_connection.h"
+
+
+namespace axon { namespace communication { namespace shm {
+
+/*
+ * Connection to a server in another process on the same host, through a
+ * pair of ring buffers in shared memory. Data doesn't go through the
+ * kernel, and the receiving side spins for a while before it goes to sleep,
+ * so there usually isn't a system call per message either. Linux only.
+ *
+ * The connection string is the name that the server was started with:
+ * shm://my_service
+ */
+class AXON_COMMUNICATE_API CShmDataConnection
+	: public virtual IDataConnection
+{
+public:
+	class Impl;
+
+private:
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	typedef std::shared_ptr<CShmDataConnection> Ptr;
+
+	CShmDataConnection();
+	CShmDataConnection(const std::string &a_name);
+	CShmDataConnection(std::unique_ptr<Impl> a_impl);
+
+	~CShmDataConnection();
+
+	virtual std::string ConnectionString() const;
+
+	virtual bool Connect(const std::string &a_name);
+
+	virtual void Close();
+
+	virtual bool IsOpen() const;
+	virtual bool IsServerClient() const;
+
+	virtual void Send(const util::CBuffer &buff, std::condition_variable *finishEvt);
+
+	virtual void SetReceiveHandler(DataReceivedHandler handler);
+
+	Impl *GetImpl() const { return m_impl.get(); }
+};
+
+}
+}
+}
+
+
+
+#endif /* SHM_DATA_CONNECTION_H_ */
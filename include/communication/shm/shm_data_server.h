@@ -0,0 +1,59 @@
+/*
+ * File description: shm_data_server.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef SHM_DATA_SERVER_H_
+#define SHM_DATA_SERVER_H_
+
+#include "../i_data_server.h"
+
+namespace axon { namespace communication { namespace shm {
+
+/*
+ * Server for CShmDataConnection clients. The host string is a name that is
+ * unique on the host, and every client that connects gets its own shared
+ * memory segment.
+ */
+class AXON_COMMUNICATE_API CShmDataServer
+	: public virtual IDataServer
+{
+public:
+	class Impl;
+
+private:
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	typedef std::shared_ptr<CShmDataServer> Ptr;
+
+	static const size_t DEFAULT_RING_SIZE = 1024 * 1024;
+
+	CShmDataServer();
+	CShmDataServer(const std::string &a_name);
+
+	~CShmDataServer();
+
+	virtual void Startup(const std::string &a_name) override;
+
+	virtual std::string HostString() const override;
+
+	virtual void Shutdown() override;
+
+	virtual size_t NumClients() const override;
+
+	virtual void Broadcast(const util::CBuffer &buff) override;
+
+	virtual void SetConnectedHandler(ConnectedHandler a_handler) override;
+	virtual void SetDisconnectedHandler(DisconnectedHandler a_handler) override;
+
+	// The size of the buffer in each direction, for clients that connect
+	// afterwards. Must be a power of 2, and at least 4KB
+	size_t RingSize() const;
+	void SetRingSize(size_t a_size);
+};
+
+} } }
+
+#endif
@@ -0,0 +1,55 @@
+/*
+ * File description: send_limits.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef SEND_LIMITS_H_
+#define SEND_LIMITS_H_
+
+#include <cstddef>
+
+namespace axon { namespace communication { namespace tcp {
+
+// What a send does when the connection already has too much data waiting
+enum class BackpressurePolicy
+{
+	// Waits until the peer has caught up. Sends from an event thread are
+	// queued instead, since the thread would be waiting on itself
+	Block,
+	// Throws instead of queueing the data. Never waits, not even between
+	// the fragments of a large message
+	Fail,
+	// Discards droppable sends, like one-way messages, and blocks the rest
+	Drop,
+};
+
+/*
+ * Bounds the outgoing data that a connection holds on to for a peer that
+ * isn't keeping up. Once a send would take the waiting data past the high
+ * water mark, the policy applies until the peer has drained it down to the
+ * low water mark. A single send that is larger than the high water mark
+ * still goes out once nothing else is waiting.
+ */
+struct CSendLimits
+{
+	// In bytes. 0 doesn't limit the connection, which is the default
+	size_t HighWaterMark;
+	size_t LowWaterMark;
+
+	BackpressurePolicy Policy;
+
+	CSendLimits()
+		: HighWaterMark(0), LowWaterMark(0), Policy(BackpressurePolicy::Block)
+	{
+	}
+	CSendLimits(size_t a_highWaterMark, size_t a_lowWaterMark,
+				BackpressurePolicy a_policy = BackpressurePolicy::Block)
+		: HighWaterMark(a_highWaterMark), LowWaterMark(a_lowWaterMark), Policy(a_policy)
+	{
+	}
+};
+
+} } }
+
+#endif /* SEND_LIMITS_H_ */
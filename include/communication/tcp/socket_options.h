@@ -0,0 +1,84 @@
+/*
+ * File description: socket_options.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef SOCKET_OPTIONS_H_
+#define SOCKET_OPTIONS_H_
+
+#include <string>
+
+#include "../dll_export.h"
+
+namespace axon { namespace communication { namespace tcp {
+
+/*
+ * Kernel options for the sockets of a TCP connection. Servers apply them to
+ * each client that they accept, and clients apply them once they are
+ * connected. The defaults are tuned for small request/response messages.
+ *
+ * The options can also be given after a '?' in a connection string or a
+ * server host string, with the names that Parse lists:
+ * tcp://localhost:12345?nodelay=1&quickack=1&rcvbuf=262144
+ */
+struct AXON_COMMUNICATE_API CSocketOptions
+{
+	// Sends small messages right away instead of holding them back to be
+	// combined with the next one (TCP_NODELAY)
+	bool NoDelay;
+
+	// Kernel buffer sizes in bytes (SO_SNDBUF, SO_RCVBUF). 0 keeps the system
+	// default, which also keeps the kernel's automatic tuning
+	int SendBufferSize;
+	int ReceiveBufferSize;
+
+	// Acknowledges data right away instead of waiting to piggyback on a
+	// reply (TCP_QUICKACK). Linux only. The kernel clears it again on its
+	// own, so it is set after every read
+	bool QuickAck;
+
+	// Microseconds to spin on the device queue for data before sleeping
+	// (SO_BUSY_POLL). 0 disables it. Linux only, and raising it usually
+	// needs CAP_NET_ADMIN
+	int BusyPoll;
+
+	// Probes idle connections so that dead peers are noticed. The times are
+	// in seconds, and 0 keeps the system default (SO_KEEPALIVE, TCP_KEEPIDLE,
+	// TCP_KEEPINTVL, TCP_KEEPCNT)
+	bool KeepAlive;
+	int KeepAliveIdle;
+	int KeepAliveInterval;
+	int KeepAliveCount;
+
+	CSocketOptions();
+
+	// Parses options of the form "name=value&name=value" on top of the
+	// defaults. The names are nodelay, sndbuf, rcvbuf, quickack, busypoll,
+	// keepalive, keepidle, keepintvl and keepcnt
+	static CSocketOptions Parse(const std::string &a_options);
+
+	// Splits the options off of a connection or host string, and parses them
+	// into a_options on top of what is already there. Returns the rest of
+	// the string
+	static std::string Split(const std::string &a_string, CSocketOptions &a_options);
+
+	// Applies the options to a connected socket. Options that don't apply to
+	// the socket, like TCP options on a UNIX socket, are skipped, and the
+	// ones that the system refuses are reported without failing
+	void Apply(int a_socket) const;
+
+	// The options that accepted sockets inherit from the listening socket.
+	// The buffer sizes have to be set before the connection is established
+	// to affect the TCP window
+	void ApplyToListener(int a_socket) const;
+
+	// Sets TCP_QUICKACK again, if it is enabled
+	void RearmQuickAck(int a_socket) const;
+
+	std::string ToString() const;
+};
+
+} } }
+
+#endif /* SOCKET_OPTIONS_H_ */
@@ -10,6 +10,8 @@
 #include <memory>
 
 #include "../i_data_connection.h"
+#include "socket_options.h"
+#include "send_limits.h"
 
 
 namespace axon { namespace communication { namespace tcp {
@@ -26,6 +28,10 @@ private:
 public:
 	typedef std::shared_ptr<CTcpDataConnection> Ptr;
 
+	// Called on the event thread once a connection that ran into its high
+	// water mark has drained to its low water mark
+	typedef std::function<void ()> WritableHandler;
+
 	CTcpDataConnection();
 	CTcpDataConnection(const std::string &a_connectionString);
 	CTcpDataConnection(std::string a_hostName, int a_port);
@@ -44,9 +50,28 @@ public:
 	virtual bool IsServerClient() const;
 
 	virtual void Send(const util::CBuffer &buff, std::condition_variable *finishEvt);
+	virtual bool SendDroppable(const util::CBuffer &a_buff) override;
+	virtual void CheckSend() override;
+	virtual void SendChecked(const util::CBuffer &a_buff) override;
+	virtual bool WaitForSendQueue(size_t a_size) override;
+	virtual bool CanWaitForSendQueue() const override;
 
 	virtual void SetReceiveHandler(DataReceivedHandler handler);
 
+	// The options can only be changed while the connection is closed. They
+	// can also be given in the connection string
+	const CSocketOptions &SocketOptions() const;
+	void SetSocketOptions(const CSocketOptions &a_options);
+
+	// Bounds the data that is held on to for a slow peer. Unlimited by default
+	CSendLimits SendLimits() const;
+	void SetSendLimits(const CSendLimits &a_limits);
+
+	void SetWritableHandler(WritableHandler a_handler);
+
+	// The number of droppable sends that were discarded
+	size_t NumDropped() const;
+
 	Impl *GetImpl() const { return m_impl.get(); }
 };
 
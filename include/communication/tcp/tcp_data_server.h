@@ -8,6 +8,8 @@
 #define TCP_DATA_SERVER_H_
 
 #include "../i_data_server.h"
+#include "socket_options.h"
+#include "send_limits.h"
 
 namespace axon { namespace communication { namespace tcp {
 
@@ -42,6 +44,16 @@ public:
 
 	virtual void SetConnectedHandler(ConnectedHandler a_handler) override;
 	virtual void SetDisconnectedHandler(DisconnectedHandler a_handler) override;
+
+	// Applied to every client that is accepted. The options can only be
+	// changed before the server is started, or given after the port in the
+	// host string, e.g. "12345?nodelay=1&quickack=1"
+	const CSocketOptions &SocketOptions() const;
+	void SetSocketOptions(const CSocketOptions &a_options);
+
+	// Applied to every client that is accepted after they are set
+	CSendLimits SendLimits() const;
+	void SetSendLimits(const CSendLimits &a_limits);
 };
 
 } } }
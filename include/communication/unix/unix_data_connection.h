@@ -0,0 +1,61 @@
+/*
+ * File description: unix_data_connection.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef UNIX_DATA_CONNECTION_H_
+#define UNIX_DATA_CONNECTION_H_
+
+#include <memory>
+
+#include "../i_data_connection.h"
+
+
+namespace axon { namespace communication { namespace unix_socket {
+
+/*
+ * Connection to a server on the same host, through a UNIX domain socket.
+ * Skips the TCP stack, but otherwise behaves the same as a TCP connection.
+ *
+ * The connection string is the path of the socket:
+ * unix:///tmp/my_service.sock
+ */
+class AXON_COMMUNICATE_API CUnixDataConnection
+	: public virtual IDataConnection
+{
+public:
+	class Impl;
+
+private:
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	typedef std::shared_ptr<CUnixDataConnection> Ptr;
+
+	CUnixDataConnection();
+	CUnixDataConnection(const std::string &a_path);
+
+	~CUnixDataConnection();
+
+	virtual std::string ConnectionString() const;
+
+	virtual bool Connect(const std::string &a_path);
+
+	virtual void Close();
+
+	virtual bool IsOpen() const;
+	virtual bool IsServerClient() const;
+
+	virtual void Send(const util::CBuffer &buff, std::condition_variable *finishEvt);
+
+	virtual void SetReceiveHandler(DataReceivedHandler handler);
+};
+
+}
+}
+}
+
+
+
+#endif /* UNIX_DATA_CONNECTION_H_ */
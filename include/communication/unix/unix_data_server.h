@@ -0,0 +1,52 @@
+/*
+ * File description: unix_data_server.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef UNIX_DATA_SERVER_H_
+#define UNIX_DATA_SERVER_H_
+
+#include "../i_data_server.h"
+
+namespace axon { namespace communication { namespace unix_socket {
+
+/*
+ * Listens on a UNIX domain socket. The host string is the path of the
+ * socket, which is replaced if a socket was left there by a previous run,
+ * and removed when the server is destroyed.
+ */
+class AXON_COMMUNICATE_API CUnixDataServer
+	: public virtual IDataServer
+{
+public:
+	class Impl;
+
+private:
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	typedef std::shared_ptr<CUnixDataServer> Ptr;
+
+	CUnixDataServer();
+	CUnixDataServer(const std::string &a_path);
+
+	~CUnixDataServer();
+
+	virtual void Startup(const std::string &a_path) override;
+
+	virtual std::string HostString() const override;
+
+	virtual void Shutdown() override;
+
+	virtual size_t NumClients() const override;
+
+	virtual void Broadcast(const util::CBuffer &buff) override;
+
+	virtual void SetConnectedHandler(ConnectedHandler a_handler) override;
+	virtual void SetDisconnectedHandler(DisconnectedHandler a_handler) override;
+};
+
+} } }
+
+#endif
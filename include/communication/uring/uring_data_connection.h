@@ -0,0 +1,77 @@
+/*
+ * File description: uring_data_connection.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef URING_DATA_CONNECTION_H_
+#define URING_DATA_CONNECTION_H_
+
+#include <memory>
+
+#include "../i_data_connection.h"
+#include "../tcp/socket_options.h"
+
+
+namespace axon { namespace communication { namespace uring {
+
+/*
+ * TCP connection that does its I/O through io_uring instead of libevent.
+ * Receives are multishot into buffers registered with the kernel, and the
+ * sends that pile up while the loop is busy go out as one request, so a
+ * busy connection makes far fewer system calls. Talks to the same servers
+ * and clients as CTcpDataConnection. Linux only, and needs a 6.0 or later
+ * kernel for multishot receives.
+ *
+ * The connection string is the same as for TCP, including the socket
+ * options:
+ * uring://localhost:12345?nodelay=1
+ */
+class AXON_COMMUNICATE_API CUringDataConnection
+	: public virtual IDataConnection
+{
+public:
+	class Impl;
+
+private:
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	typedef std::shared_ptr<CUringDataConnection> Ptr;
+
+	CUringDataConnection();
+	CUringDataConnection(const std::string &a_connectionString);
+	CUringDataConnection(std::string a_hostName, int a_port);
+	CUringDataConnection(std::unique_ptr<Impl> a_impl);
+
+	~CUringDataConnection();
+
+	virtual std::string ConnectionString() const;
+
+	virtual bool Connect(const std::string &a_connectionString);
+	bool Connect(std::string a_hostName, int a_port);
+
+	virtual void Close();
+
+	virtual bool IsOpen() const;
+	virtual bool IsServerClient() const;
+
+	virtual void Send(const util::CBuffer &buff, std::condition_variable *finishEvt);
+
+	virtual void SetReceiveHandler(DataReceivedHandler handler);
+
+	// The options can only be changed while the connection is closed. They
+	// can also be given in the connection string
+	const tcp::CSocketOptions &SocketOptions() const;
+	void SetSocketOptions(const tcp::CSocketOptions &a_options);
+
+	Impl *GetImpl() const { return m_impl.get(); }
+};
+
+}
+}
+}
+
+
+
+#endif /* URING_DATA_CONNECTION_H_ */
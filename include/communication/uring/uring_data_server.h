@@ -0,0 +1,62 @@
+/*
+ * File description: uring_data_server.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef URING_DATA_SERVER_H_
+#define URING_DATA_SERVER_H_
+
+#include "../i_data_server.h"
+#include "../tcp/socket_options.h"
+
+namespace axon { namespace communication { namespace uring {
+
+/*
+ * Server for CUringDataConnection and CTcpDataConnection clients. The host
+ * string is the port. Clients are accepted with a single multishot
+ * accept, and spread over the io_uring loops the same way that the TCP
+ * server spreads them over its event loops.
+ */
+class AXON_COMMUNICATE_API CUringDataServer
+	: public virtual IDataServer
+{
+public:
+	class Impl;
+
+private:
+	std::unique_ptr<Impl> m_impl;
+
+public:
+	typedef std::shared_ptr<CUringDataServer> Ptr;
+
+	CUringDataServer();
+	CUringDataServer(const std::string &a_hostString);
+	CUringDataServer(int a_port);
+
+	~CUringDataServer();
+
+	virtual void Startup(const std::string &a_hostString) override;
+	void Startup(int a_port);
+
+	virtual std::string HostString() const override;
+
+	virtual void Shutdown() override;
+
+	virtual size_t NumClients() const override;
+
+	virtual void Broadcast(const util::CBuffer &buff) override;
+
+	virtual void SetConnectedHandler(ConnectedHandler a_handler) override;
+	virtual void SetDisconnectedHandler(DisconnectedHandler a_handler) override;
+
+	// Applied to every client that is accepted. The options can only be
+	// changed before the server is started, or given after the port in the
+	// host string, e.g. "12345?nodelay=1&quickack=1"
+	const tcp::CSocketOptions &SocketOptions() const;
+	void SetSocketOptions(const tcp::CSocketOptions &a_options);
+};
+
+} } }
+
+#endif
@@ -72,8 +72,8 @@ void ReadCollection(const AData &a_data, CollType &a_coll)
 		READ_PRIM(UShort, unsigned short);
 		READ_PRIM(Int, int);
 		READ_PRIM(UInt, unsigned int);
-		READ_PRIM(Long, long long);
-		READ_PRIM(ULong, unsigned long);
+		READ_PRIM(Long, int64_t);
+		READ_PRIM(ULong, uint64_t);
 		READ_PRIM(Float, float);
 		READ_PRIM(Double, double);
 		READ_PRIM(Bool, bool);
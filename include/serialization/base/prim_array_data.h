@@ -20,17 +20,23 @@ class AXON_SERIALIZE_API APrimArrayDataBase
 {
 protected:
 	DataType m_innerType;
+	bool m_delta;
 
 public:
 	typedef std::unique_ptr<APrimArrayDataBase> Ptr;
 
 	APrimArrayDataBase(DataType a_innerType)
-		: AData(DataType::PrimArray), m_innerType(a_innerType) { }
+		: AData(DataType::PrimArray), m_innerType(a_innerType), m_delta(false) { }
 	APrimArrayDataBase(DataType a_innerType, CSerializationContext a_context)
-		: AData(DataType::PrimArray, std::move(a_context)), m_innerType(a_innerType) { }
+		: AData(DataType::PrimArray, std::move(a_context)), m_innerType(a_innerType), m_delta(false) { }
 
 	DataType InnerType() const { return m_innerType; }
 
+	// Hint for the formats that support it (currently Axon) to delta code
+	// the values. Set from SerializationFlags::Delta
+	bool Delta() const { return m_delta; }
+	void SetDelta(bool a_val) { m_delta = a_val; }
+
 	virtual size_t Size() const = 0;
 	virtual AData::Ptr GetChild(size_t idx) const = 0;
 	virtual CArrayData::Ptr ToRegArray() const = 0;
@@ -83,6 +89,11 @@ public:
 		Import(std::begin(a_coll), std::end(a_coll));
 	}
 
+	void Resize(size_t a_size)
+	{
+		m_children.resize(a_size);
+	}
+
 	T &operator[](size_t idx) { return m_children[idx]; }
 	const T &operator[](size_t idx) const { return m_children[idx]; }
 
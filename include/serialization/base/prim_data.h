@@ -73,8 +73,12 @@ struct AXON_SERIALIZE_API CPrimCaster<std::string, std::string>
 
 template<>
 struct AXON_SERIALIZE_API CPrimCaster<const char *, std::string>
-	: CPrimCaster<std::string, std::string>
 {
+	// Has to return by value, since the string is constructed here
+	static std::string Get(const char *a_val)
+	{
+		return a_val;
+	}
 };
 
 template<typename B, typename A>
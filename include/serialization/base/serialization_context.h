@@ -18,7 +18,10 @@ enum class SerializationFlags : uint32_t
 {
 	None = 0,
 	Shareable = 0x1,
-	Compress = 0x2
+	Compress = 0x2,
+	// Numeric primitive arrays are delta coded: integers by their difference
+	// from the previous value, floats by XOR with it
+	Delta = 0x4
 };
 
 class AXON_SERIALIZE_API CSerializationContext
@@ -84,6 +87,10 @@ public:
 	{
 		return (m_flags & (uint32_t)SerializationFlags::Compress);
 	}
+	bool IsDeltaSet() const
+	{
+		return (m_flags & (uint32_t)SerializationFlags::Delta);
+	}
 
     std::string *GetVariable(const std::string &a_name) const
     {
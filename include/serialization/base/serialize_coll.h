@@ -52,6 +52,7 @@ AData::Ptr SerializeCollImpl(const CollType &a_coll,
 	typedef typename data_type::Ptr data_ptr;
 
 	data_ptr l_ret(new data_type(a_context));
+	l_ret->SetDelta(a_context.IsDeltaSet());
 	l_ret->Import(a_coll);
 	return std::move(l_ret);
 }
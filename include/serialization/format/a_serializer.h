@@ -7,23 +7,54 @@
 #ifndef A_SERIALIZER_H_
 #define A_SERIALIZER_H_
 
+#include <iosfwd>
 #include <memory>
 #include <string>
 
 #include "serialization/base/serialize.h"
 #include "serialization/base/deserialize.h"
 
+#include "i_compressor.h"
+#include "i_value_scanner.h"
+
 namespace axon { namespace serialization {
 
 class AXON_SERIALIZE_API ASerializer
 {
+protected:
+	ICompressor::Ptr m_bufferCompressor;
+	size_t m_compressThreshold;
+	size_t m_maxDecompressedSize;
+
 public:
 	typedef std::shared_ptr<ASerializer> Ptr;
 
+	static const size_t DEFAULT_COMPRESS_THRESHOLD = 1024;
+	static const size_t DEFAULT_MAX_DECOMPRESSED_SIZE = 64 * 1024 * 1024;
+
+	ASerializer();
 	virtual ~ASerializer();
 
 	virtual std::string FormatName() const = 0;
 
+	/*
+	 * Buffer data that was serialized with SerializationFlags::Compress is
+	 * compressed with this compressor, as long as it is at least the threshold
+	 * size and compressing it makes it smaller. Reading compressed buffers
+	 * requires the same compressor. Defaults to null, which disables
+	 * compression, since older readers can't read compressed buffers.
+	 */
+	const ICompressor::Ptr &BufferCompressor() const { return m_bufferCompressor; }
+	void SetBufferCompressor(ICompressor::Ptr a_compressor) { m_bufferCompressor = std::move(a_compressor); }
+
+	size_t CompressThreshold() const { return m_compressThreshold; }
+	void SetCompressThreshold(size_t a_size) { m_compressThreshold = a_size; }
+
+	// The size of a compressed buffer once it is decompressed comes from the
+	// input, so readers refuse to allocate more than this for one buffer
+	size_t MaxDecompressedSize() const { return m_maxDecompressedSize; }
+	void SetMaxDecompressedSize(size_t a_size) { m_maxDecompressedSize = a_size; }
+
 	template<typename T>
 	std::string Serialize(const T &a_val) const
 	{
@@ -40,6 +71,14 @@ public:
 		SerializeDataToFile(a_fileName, *l_data);
 	}
 
+	template<typename T>
+	void SerializeToStream(std::ostream &a_stream, const T &a_val) const
+	{
+		auto l_data = axon::serialization::Serialize(a_val);
+
+		SerializeDataToStream(a_stream, *l_data);
+	}
+
 	template<typename T>
 	void Serialize(char *a_buff, size_t a_buffSize, const T &a_val) const
 	{
@@ -106,15 +145,42 @@ public:
 
 	virtual AData::Ptr DeserializeData(const char *a_buf, const char *a_endBuf) const = 0;
 
+	/*
+	 * Deserializes data from a buffer that the result is allowed to keep a
+	 * reference to. Formats that support it return buffer data that points
+	 * into a_buf instead of copying it. The default copies, the same as
+	 * DeserializeData.
+	 */
+	virtual AData::Ptr DeserializeSharedData(const util::CBuffer &a_buf) const;
+
 	/*
 	 * Abstract function that serializes the data into the format controlled by
 	 * derived classes.
 	 */
 	virtual std::string SerializeData(const AData &a_data) const = 0;
 
+	/*
+	 * Writes the serialized data to the stream. Formats that can, write the
+	 * output in chunks as it is produced, so the whole output never has to
+	 * be held in memory. The default writes the result of SerializeData.
+	 */
+	virtual void SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const;
+
 	virtual void SerializeDataToFile(const std::string &a_fileName, const AData &a_data) const;
 
+	/*
+	 * Maps the file into memory where the platform allows it, and passes
+	 * the mapping to DeserializeSharedData, so the file is never copied
+	 * as a whole.
+	 */
 	virtual AData::Ptr DeserializeDataFromFile(const std::string &a_fileName) const;
+
+	/*
+	 * Creates a scanner that finds the end of each top level value in a
+	 * stream of this format. Used by CIncrementalParser. Formats that don't
+	 * support incremental parsing throw.
+	 */
+	virtual IValueScanner::Ptr CreateScanner() const;
 };
 
 } }
@@ -7,14 +7,109 @@
 #ifndef AXON_SERIALIZER_H_
 #define AXON_SERIALIZER_H_
 
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
 #include "a_serializer.h"
 
 namespace axon { namespace serialization {
 
+/*
+ * The set of names that have already been exchanged with a peer. In
+ * dictionary mode, the Axon format only transmits a name the first time
+ * it is used, and references it by index from then on. Each side of a
+ * connection keeps one dictionary for sending and one for receiving.
+ */
+class AXON_SERIALIZE_API CAxonNameDictionary
+{
+private:
+	std::vector<std::string> m_names;
+	std::unordered_map<std::string, size_t> m_index;
+	size_t m_maxNames;
+
+public:
+	static const size_t DEFAULT_MAX_NAMES = 4096;
+
+	CAxonNameDictionary(size_t a_maxNames = DEFAULT_MAX_NAMES)
+		: m_maxNames(a_maxNames) { }
+
+	size_t Size() const { return m_names.size(); }
+	size_t MaxNames() const { return m_maxNames; }
+
+	bool Find(const std::string &a_name, size_t &a_ref) const
+	{
+		auto l_iter = m_index.find(a_name);
+
+		if (l_iter == m_index.end())
+			return false;
+
+		a_ref = l_iter->second;
+		return true;
+	}
+
+	const std::string &Get(size_t a_ref) const { return m_names[a_ref]; }
+
+	void Add(std::string a_name)
+	{
+		m_index.emplace(a_name, m_names.size());
+		m_names.push_back(std::move(a_name));
+	}
+
+	void Clear()
+	{
+		m_names.clear();
+		m_index.clear();
+	}
+};
+
 class AXON_SERIALIZE_API CAxonSerializer
 	: public ASerializer
 {
+private:
+	class CNameCache;
+
+	// Name tables are cached per message shape, and shared between copies
+	// of this serializer
+	std::shared_ptr<CNameCache> m_nameCache;
+
+	size_t m_maxDepth;
+	size_t m_maxElements;
+	bool m_packIntegers;
+	bool m_packBools;
+	bool m_columnar;
+
 public:
+	static const size_t DEFAULT_MAX_DEPTH = 256;
+
+	CAxonSerializer();
+
+	// Limits enforced by DeserializeData. The depth counts nested structs and
+	// arrays, and the elements are counted over the whole message (struct
+	// properties, array elements and primitive array values)
+	size_t MaxDepth() const { return m_maxDepth; }
+	void SetMaxDepth(size_t a_maxDepth) { m_maxDepth = a_maxDepth; }
+
+	size_t MaxElements() const { return m_maxElements; }
+	void SetMaxElements(size_t a_maxElements) { m_maxElements = a_maxElements; }
+
+	// When set, integer primitive arrays are written as variable length
+	// integers whenever that is smaller than the plain encoding. Readers
+	// always accept both
+	bool PackIntegerArrays() const { return m_packIntegers; }
+	void SetPackIntegerArrays(bool a_pack) { m_packIntegers = a_pack; }
+
+	// When set, bool primitive arrays are written with 1 bit per value
+	// instead of 1 byte. Readers always accept both
+	bool PackBoolArrays() const { return m_packBools; }
+	void SetPackBoolArrays(bool a_pack) { m_packBools = a_pack; }
+
+	// When set, arrays of structs that all have the same fields (with the
+	// same types) are written as a single schema followed by one column per
+	// field. Older readers can't decode these, so it is off by default
+	bool ColumnarArrays() const { return m_columnar; }
+	void SetColumnarArrays(bool a_columnar) { m_columnar = a_columnar; }
+
 	virtual std::string FormatName() const override { return "axon"; }
 
 	virtual size_t CalcSize(const AData &a_data) const override;
@@ -23,10 +118,36 @@ public:
 
 	virtual std::string SerializeData(const AData &a_data) const override;
 
+	virtual void SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const override;
+
 	virtual AData::Ptr DeserializeData(const char *a_buf, const char *a_endBuf) const override;
 
+	/*
+	 * Buffer data in the result references a_buf instead of holding a copy.
+	 */
+	virtual AData::Ptr DeserializeSharedData(const util::CBuffer &a_buf) const override;
+
+	virtual IValueScanner::Ptr CreateScanner() const override;
+
+	/*
+	 * Dictionary mode. Names that are already in the dictionary are referenced
+	 * by index instead of being written to the header, and new names are added
+	 * to the dictionary once the message has been written (or read). The peer
+	 * must read the messages in the same order that they were written.
+	 */
+	size_t CalcSize(const AData &a_data, const CAxonNameDictionary &a_dict) const;
+
+	size_t SerializeInto(const AData &a_data, char *a_buffer, size_t a_bufferSize,
+	                     CAxonNameDictionary &a_dict) const;
+
+	AData::Ptr DeserializeData(const char *a_buf, const char *a_endBuf,
+	                           CAxonNameDictionary &a_dict) const;
+
 private:
 	size_t p_EstablishSize(const AData &a_data) const;
+
+	AData::Ptr p_DeserializeData(const char *a_buf, const char *a_endBuf,
+	                             const util::CBuffer *a_backing) const;
 };
 
 } }
@@ -24,6 +24,16 @@ public:
     }
 };
 
+class CNameDictionaryException
+    : public std::exception
+{
+public:
+    virtual const char *what() const noexcept override
+    {
+        return "The name dictionary does not match the one used to write the data.";
+    }
+};
+
 } }
 
 
@@ -2,11 +2,29 @@
 #define I_COMPRESSOR_H_
 
 #include <memory>
+#include <string>
 
 #include "../dll_export.h"
 
 namespace axon { namespace serialization {
 
+// Compresses a sequence of messages with a shared history, so that each
+// message can refer back to the ones before it. Each message is flushed
+// completely, but can only be decompressed by a stream that has already
+// decompressed all of the messages before it, in the same order
+class AXON_SERIALIZE_API ICompressionStream
+{
+public:
+    typedef std::unique_ptr<ICompressionStream> Ptr;
+
+    virtual ~ICompressionStream() { }
+
+    virtual void Compress(const char *a_input, size_t a_inputSize,
+                          std::unique_ptr<char[]> &a_output, size_t &a_outputSize) = 0;
+    virtual std::unique_ptr<char[]> Decompress(const char *a_compressed, size_t a_compressedSize,
+                             size_t a_decompressedSize) = 0;
+};
+
 class AXON_SERIALIZE_API ICompressor
 {
 public:
@@ -16,10 +34,20 @@ public:
 
     static const Ptr DEFAULT_INSTANCE;
 
+    // Identifies the compression format, so that both ends of a connection
+    // can agree on one. Compressors that can only read each other's output
+    // when configured the same way (e.g. with a dictionary) must include
+    // that in the name
+    virtual std::string Name() const = 0;
+
     virtual void Compress(const char *a_input, size_t a_inputSIze, 
                           std::unique_ptr<char[]> &a_output, size_t &a_outputSize) const = 0;
     virtual std::unique_ptr<char[]> Decompress(const char *a_compressed, size_t a_compressedSize, 
                              size_t a_decompressedSize) const = 0;
+
+    // A new stream with the same format, or null when the compressor can't
+    // keep its state from one message to the next
+    virtual ICompressionStream::Ptr CreateStream() const { return ICompressionStream::Ptr(); }
 };
 
 } }
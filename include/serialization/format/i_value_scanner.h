@@ -0,0 +1,42 @@
+/*
+ * File description: i_value_scanner.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef I_VALUE_SCANNER_H_
+#define I_VALUE_SCANNER_H_
+
+#include <memory>
+
+#include "../dll_export.h"
+
+namespace axon { namespace serialization {
+
+/*
+ * Finds where a serialized value ends, without decoding it. The buffer
+ * passed to Scan always starts at the beginning of the value, and only
+ * grows between calls, so scanners are free to remember how far they got.
+ */
+class AXON_SERIALIZE_API IValueScanner
+{
+public:
+	typedef std::unique_ptr<IValueScanner> Ptr;
+
+	virtual ~IValueScanner() { }
+
+	/*
+	 * Returns the size of the value in bytes once all of it is in the buffer,
+	 * or 0 if more input is needed.
+	 */
+	virtual size_t Scan(const char *a_buf, const char *a_endBuf) = 0;
+
+	/*
+	 * Prepares the scanner for the next value.
+	 */
+	virtual void Reset() = 0;
+};
+
+} }
+
+#endif /* I_VALUE_SCANNER_H_ */
@@ -0,0 +1,49 @@
+/*
+ * File description: incremental_parser.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef INCREMENTAL_PARSER_H_
+#define INCREMENTAL_PARSER_H_
+
+#include <vector>
+
+#include "a_serializer.h"
+
+namespace axon { namespace serialization {
+
+/*
+ * Push parser for a stream of top level values. The input can be fed in
+ * chunks of any size, and each value is decoded as soon as all of its bytes
+ * have arrived. Only the value that is currently being received is buffered.
+ */
+class AXON_SERIALIZE_API CIncrementalParser
+{
+private:
+	ASerializer::Ptr m_serializer;
+	IValueScanner::Ptr m_scanner;
+
+	std::vector<char> m_buffer;
+	size_t m_start;
+
+public:
+	CIncrementalParser(ASerializer::Ptr a_serializer);
+
+	void Feed(const char *a_buf, size_t a_size);
+
+	/*
+	 * Returns the next complete value, or null if more input is needed.
+	 */
+	AData::Ptr Next();
+
+	/*
+	 * The number of bytes that have been fed, but are not part of a
+	 * returned value yet.
+	 */
+	size_t Buffered() const { return m_buffer.size() - m_start; }
+};
+
+} }
+
+#endif /* INCREMENTAL_PARSER_H_ */
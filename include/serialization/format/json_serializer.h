@@ -15,12 +15,26 @@ namespace axon { namespace serialization {
 class AXON_SERIALIZE_API CJsonSerializer
 	: public ASerializer
 {
+private:
+	bool m_pretty;
+
 public:
+	CJsonSerializer();
+
 	virtual std::string FormatName() const override { return "json"; }
 
+	// Output is indented by default. Compact output has no whitespace at all,
+	// which makes it smaller and faster to write
+	bool Pretty() const { return m_pretty; }
+	void SetPretty(bool a_pretty) { m_pretty = a_pretty; }
+
 	virtual std::string SerializeData(const AData &a_data) const override;
 
+	virtual void SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const override;
+
 	virtual AData::Ptr DeserializeData(const char *a_buf, const char *a_endBuf) const override;
+
+	virtual IValueScanner::Ptr CreateScanner() const override;
 };
 
 } }
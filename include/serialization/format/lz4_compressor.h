@@ -0,0 +1,29 @@
+#ifndef LZ4_COMPRESSOR_H_
+#define LZ4_COMPRESSOR_H_
+
+#include "i_compressor.h"
+
+namespace axon { namespace serialization {
+
+// Favors speed over ratio. Higher acceleration values compress faster,
+// at the cost of a worse ratio
+class AXON_SERIALIZE_API CLZ4Compressor
+    : public ICompressor
+{
+private:
+    int m_acceleration;
+
+public:
+    CLZ4Compressor(int a_acceleration = 1);
+
+    virtual std::string Name() const override { return "lz4"; }
+
+    virtual void Compress(const char *a_input, size_t a_inputSize, 
+                          std::unique_ptr<char[]> &a_output, size_t &a_outputSize) const override;
+    virtual std::unique_ptr<char[]> Decompress(const char *a_compressed, size_t a_compressedSize, 
+                             size_t a_decompressedSize) const override;
+};
+
+} }
+
+#endif
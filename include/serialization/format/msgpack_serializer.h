@@ -15,7 +15,18 @@ namespace axon { namespace serialization {
 class AXON_SERIALIZE_API CMsgPackSerializer
     : public ASerializer
 {
+private:
+    bool m_packBools;
+
 public:
+    CMsgPackSerializer();
+
+    // When set, bool primitive arrays are written as an extension type with
+    // 1 bit per value, whenever that is smaller than an array of bools. Only
+    // readers that know the extension can read these, so it is off by default
+    bool PackBoolArrays() const { return m_packBools; }
+    void SetPackBoolArrays(bool a_pack) { m_packBools = a_pack; }
+
     virtual std::string FormatName() const override { return "msgpack"; }
 
     virtual size_t CalcSize(const AData &a_data) const override;
@@ -24,8 +35,12 @@ public:
 
     virtual std::string SerializeData(const AData &a_data) const override;
 
+    virtual void SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const override;
+
     virtual AData::Ptr DeserializeData(const char *a_buf, const char *a_endBuf) const override;
 
+    virtual IValueScanner::Ptr CreateScanner() const override;
+
 private:
     size_t p_EstablishSize(const AData &a_data) const;
 };
@@ -0,0 +1,190 @@
+/*
+ * File description: record_log.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef RECORD_LOG_H_
+#define RECORD_LOG_H_
+
+#include <fstream>
+#include <vector>
+
+#include "a_serializer.h"
+#include "i_compressor.h"
+
+namespace axon { namespace serialization {
+
+// Location of a block in the file, and the number of its first record
+struct CRecordLogBlock
+{
+	uint64_t FirstRecord;
+	uint64_t Offset;
+};
+
+/*
+ * A file of records, each one serialized with an ASerializer. Records are
+ * grouped into blocks, which are framed with their size and CRCs the same
+ * way as CAxonProtocol frames messages, and can optionally be compressed.
+ * When the log is closed, an index with the position of every block is
+ * written at the end, so that records can be found without reading the
+ * whole file. Logs that weren't closed are still readable up to the last
+ * complete block.
+ */
+class AXON_SERIALIZE_API CRecordLogWriter
+{
+private:
+	std::ofstream m_file;
+	std::string m_fileName;
+
+	ASerializer::Ptr m_serializer;
+	ICompressor::Ptr m_compressor;
+	size_t m_blockSize;
+
+	std::string m_block;
+	uint32_t m_blockRecords;
+
+	std::vector<CRecordLogBlock> m_index;
+	uint64_t m_numRecords;
+	uint64_t m_offset;
+
+public:
+	static const size_t DEFAULT_BLOCK_SIZE = 64 * 1024;
+
+	/*
+	 * Creates the log, replacing the file if it already exists.
+	 */
+	CRecordLogWriter(const std::string &a_fileName, ASerializer::Ptr a_serializer);
+	~CRecordLogWriter();
+
+	// Blocks are compressed with this compressor when it is set, and when
+	// that makes them smaller. Null (the default) disables compression.
+	// Its name is stored in the file, so it has to be set before the first
+	// block is written
+	void SetCompressor(ICompressor::Ptr a_compressor);
+
+	// The amount of record data that is collected before a block is written.
+	// Larger blocks compress better, but random access has to read more
+	size_t BlockSize() const { return m_blockSize; }
+	void SetBlockSize(size_t a_size);
+
+	template<typename T>
+	void Append(const T &a_val)
+	{
+		auto l_data = axon::serialization::Serialize(a_val);
+
+		AppendData(*l_data);
+	}
+
+	void AppendData(const AData &a_data);
+
+	uint64_t Size() const { return m_numRecords; }
+
+	/*
+	 * Writes the records that have been appended so far to the file.
+	 */
+	void Flush();
+
+	/*
+	 * Writes the index and closes the file. Called by the destructor.
+	 */
+	void Close();
+
+private:
+	void p_WriteHeader();
+	void p_WriteBlock();
+	void p_Write(const void *a_data, size_t a_size);
+};
+
+class AXON_SERIALIZE_API CRecordLogReader
+{
+private:
+	std::ifstream m_file;
+	std::string m_fileName;
+
+	ASerializer::Ptr m_serializer;
+	ICompressor::Ptr m_compressor;
+	size_t m_maxBlockSize;
+
+	std::string m_compressorName;
+	bool m_hasCompressorName;
+	uint64_t m_dataStart;
+
+	std::vector<CRecordLogBlock> m_index;
+	uint64_t m_numRecords;
+	uint64_t m_dataEnd;
+
+	// The block that was read last. Sequential reads stay in it until
+	// all of its records have been read
+	size_t m_currBlock;
+	std::vector<char> m_blockData;
+	std::vector<size_t> m_recordOffsets;
+
+	uint64_t m_next;
+
+public:
+	static const size_t DEFAULT_MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+	CRecordLogReader(const std::string &a_fileName, ASerializer::Ptr a_serializer);
+
+	// Needed to read compressed blocks, and has to have the name of the
+	// compressor that wrote them. Defaults to ICompressor::DEFAULT_INSTANCE
+	void SetCompressor(ICompressor::Ptr a_compressor) { m_compressor = std::move(a_compressor); }
+
+	// The name of the compressor that the log was written with, empty if
+	// there wasn't one or the log is from before it was recorded
+	const std::string &CompressorName() const { return m_compressorName; }
+
+	// The size of a block once it is decompressed comes from the file, so
+	// blocks that claim to be larger than this aren't read. Only logs with
+	// records larger than it need to raise it
+	size_t MaxBlockSize() const { return m_maxBlockSize; }
+	void SetMaxBlockSize(size_t a_size) { m_maxBlockSize = a_size; }
+
+	uint64_t Size() const { return m_numRecords; }
+
+	const std::vector<CRecordLogBlock> &Blocks() const { return m_index; }
+
+	/*
+	 * Random access by record number. Sequential reads continue from the
+	 * record after it.
+	 */
+	AData::Ptr ReadData(uint64_t a_record);
+
+	template<typename T>
+	T Read(uint64_t a_record)
+	{
+		T l_ret;
+		axon::serialization::Deserialize(*ReadData(a_record), l_ret);
+		return std::move(l_ret);
+	}
+
+	/*
+	 * Sequential access. Next returns null once every record has been read.
+	 */
+	void Seek(uint64_t a_record);
+	uint64_t Tell() const { return m_next; }
+
+	AData::Ptr Next();
+
+	template<typename T>
+	bool Next(T &a_val)
+	{
+		auto l_data = Next();
+
+		if (!l_data)
+			return false;
+
+		axon::serialization::Deserialize(*l_data, a_val);
+		return true;
+	}
+
+private:
+	bool p_ReadIndex(uint64_t a_fileSize);
+	void p_ScanBlocks(uint64_t a_fileSize);
+	void p_LoadBlock(size_t a_block);
+};
+
+} }
+
+#endif /* RECORD_LOG_H_ */
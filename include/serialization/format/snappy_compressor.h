@@ -9,6 +9,8 @@ class AXON_SERIALIZE_API CSnappyCompressor
     : public ICompressor
 {
 public:
+    virtual std::string Name() const override { return "snappy"; }
+
     virtual void Compress(const char *a_input, size_t a_inputSize, 
                           std::unique_ptr<char[]> &a_output, size_t &a_outputSize) const override;
     virtual std::unique_ptr<char[]> Decompress(const char *a_compressed, size_t a_compressedSize, 
@@ -19,6 +19,8 @@ public:
 
 	virtual std::string SerializeData(const AData &a_data) const override;
 
+	virtual void SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const override;
+
 	virtual AData::Ptr DeserializeData(const char *a_buf, const char *a_endBuf) const override;
 };
 
@@ -0,0 +1,53 @@
+#ifndef ZSTD_COMPRESSOR_H_
+#define ZSTD_COMPRESSOR_H_
+
+#include <string>
+#include <vector>
+
+#include "i_compressor.h"
+
+struct ZSTD_CDict_s;
+struct ZSTD_DDict_s;
+
+namespace axon { namespace serialization {
+
+// Favors ratio over speed. Small messages compress much better with a
+// dictionary that was trained on samples of them. Both ends must use
+// the same dictionary, which is why it is part of the name
+class AXON_SERIALIZE_API CZstdCompressor
+    : public ICompressor
+{
+private:
+    int m_level;
+    std::string m_name;
+    std::shared_ptr<ZSTD_CDict_s> m_cdict;
+    std::shared_ptr<ZSTD_DDict_s> m_ddict;
+
+public:
+    static const int DEFAULT_LEVEL = 3;
+
+    CZstdCompressor(int a_level = DEFAULT_LEVEL);
+    CZstdCompressor(int a_level, const std::string &a_dictionary);
+
+    int Level() const { return m_level; }
+
+    virtual std::string Name() const override { return m_name; }
+
+    virtual void Compress(const char *a_input, size_t a_inputSize, 
+                          std::unique_ptr<char[]> &a_output, size_t &a_outputSize) const override;
+    virtual std::unique_ptr<char[]> Decompress(const char *a_compressed, size_t a_compressedSize, 
+                             size_t a_decompressedSize) const override;
+
+    virtual ICompressionStream::Ptr CreateStream() const override;
+
+    /*
+     * Builds a dictionary of at most a_maxSize bytes from samples of the
+     * data that will be compressed, e.g. serialized messages.
+     */
+    static std::string TrainDictionary(const std::vector<std::string> &a_samples,
+                                       size_t a_maxSize = 110 * 1024);
+};
+
+} }
+
+#endif
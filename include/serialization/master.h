@@ -15,5 +15,7 @@
 #include "format/json_serializer.h"
 #include "format/xml_serializer.h"
 #include "format/msgpack_serializer.h"
+#include "format/incremental_parser.h"
+#include "format/record_log.h"
 
 #endif /* MASTER_H_ */
@@ -7,6 +7,7 @@
 #ifndef BUFFER_H_
 #define BUFFER_H_
 
+#include <cstring>
 #include <memory>
 #include <stdexcept>
 
@@ -139,6 +140,19 @@ public:
             if (!m_buff.unique())
                 throw std::runtime_error("Unable to release this buffer because it is shared across multiple objects.");
 
+            // Copies reference the memory of the buffer they were made from,
+            // which still frees it, so the data has to be copied out
+            if (*m_ownership == Unowned)
+            {
+                std::unique_ptr<char[]> l_ret(new char[m_buffSize]);
+                memcpy(l_ret.get(), m_buff.get(), m_buffSize);
+
+                a_bufSize = m_buffSize;
+                m_buffSize = 0;
+                m_buff.reset();
+                return std::move(l_ret);
+            }
+
             *m_ownership = Unowned;
             a_bufSize = m_buffSize;
             m_buffSize = 0;
@@ -20,6 +20,11 @@ void AStateProtocol::Process(CDataBuffer a_buffer)
 	TryProcess(true);
 }
 
+void AStateProtocol::Reset()
+{
+	m_buffQueue = queue<CDataBuffer>();
+}
+
 void AStateProtocol::TryProcess(bool a_tryOnExit)
 {
 	{
@@ -7,6 +7,7 @@
 #include "communication/messaging/axon_client.h"
 #include "communication/timeout_exception.h"
 
+#include <algorithm>
 #include <functional>
 #include <assert.h>
 
@@ -25,6 +26,22 @@ struct CMessageSocket
 	CMessage::Ptr IncomingMessage;
 };
 
+struct CAxonClient::COutgoingFragments
+{
+	COutgoingFragments(IDataConnection::Ptr a_connection, vector<util::CBuffer> a_frames,
+					   bool a_droppable)
+		: Connection(move(a_connection)), Frames(move(a_frames)), Next(0),
+		  Droppable(a_droppable)
+	{
+	}
+
+	// The rest of the message can't go to a connection that replaced it
+	IDataConnection::Ptr Connection;
+	vector<util::CBuffer> Frames;
+	size_t Next;
+	bool Droppable;
+};
+
 class CAxonClient::WaitHandle
     : public IMessageWaitHandle
 {
@@ -55,11 +72,13 @@ private:
 };
 
 CAxonClient::CAxonClient()
+	: m_abortsPending(false)
 {
 	SetDefaultProtocol();
 }
 
 CAxonClient::CAxonClient(const std::string& a_connectionString)
+	: m_abortsPending(false)
 {
 	SetDefaultProtocol();
 
@@ -67,6 +86,7 @@ CAxonClient::CAxonClient(const std::string& a_connectionString)
 }
 
 CAxonClient::CAxonClient(IDataConnection::Ptr a_connection)
+	: m_abortsPending(false)
 {
 	SetDefaultProtocol();
 
@@ -74,6 +94,7 @@ CAxonClient::CAxonClient(IDataConnection::Ptr a_connection)
 }
 
 CAxonClient::CAxonClient(const std::string& a_connectionString, IProtocol::Ptr a_protocol)
+	: m_abortsPending(false)
 {
 	SetProtocol(move(a_protocol));
 
@@ -81,6 +102,7 @@ CAxonClient::CAxonClient(const std::string& a_connectionString, IProtocol::Ptr a
 }
 
 CAxonClient::CAxonClient(IDataConnection::Ptr a_connection, IProtocol::Ptr a_protocol)
+	: m_abortsPending(false)
 {
 	SetProtocol(move(a_protocol));
 
@@ -127,6 +149,21 @@ void CAxonClient::Connect(IDataConnection::Ptr a_connection)
 {
 	m_connection = move(a_connection);
 
+	// Any protocol state belongs to the previous connection
+	m_protocol->Reset();
+
+	{
+		lock_guard<mutex> l_lock(m_fragLock);
+		m_pendingAborts.clear();
+		m_abortsPending = false;
+	}
+
+	m_msgConnection = dynamic_pointer_cast<IMessageConnection>(m_connection);
+
+	// Set before the receive handler, so that no message arrives without it
+	if (m_msgConnection)
+		m_msgConnection->SetMessageHandler(bind(&CAxonClient::p_OnMessageReceived, this, placeholders::_1));
+
 	if (m_connection)
 	{
 #ifdef IS_WINDOWS
@@ -140,6 +177,8 @@ void CAxonClient::Connect(IDataConnection::Ptr a_connection)
 		m_connection->SetReceiveHandler(bind(&CAxonClient::p_OnDataReceived, this, placeholders::_1));
 #endif
 	}
+
+	p_SendHello();
 }
 
 void CAxonClient::Close()
@@ -161,6 +200,23 @@ void CAxonClient::SetProtocol(IProtocol::Ptr a_protocol)
 	m_protocol = move(a_protocol);
 
 	m_protocol->SetHandler(bind(&CAxonClient::p_OnMessageReceived, this, placeholders::_1));
+
+	// The peer hasn't heard from this protocol yet
+	p_SendHello();
+}
+
+void CAxonClient::p_SendHello()
+{
+	// Connections within the process don't serialize anything
+	if (!m_connection || !m_connection->IsOpen() || m_msgConnection)
+		return;
+
+	CDataBuffer l_hello = m_protocol->SerializeHello();
+
+	// On its own, and never dropped or refused, so that the peer gets it
+	// whether or not any message follows
+	if (l_hello.Size())
+		m_connection->SendChecked(l_hello.ToShared());
 }
 
 string CAxonClient::ConnectionString() const
@@ -205,7 +261,7 @@ IMessageWaitHandle::Ptr CAxonClient::SendAsync(const CMessage::Ptr& a_message, u
         m_pendingList.push_back(&l_waitHandle->m_socket);
     }
 
-    p_Send(*a_message);
+    p_Send(a_message);
 
     return move(l_waitHandle);
 }
@@ -295,14 +351,191 @@ void CAxonClient::SendNonBlocking(const CMessage::Ptr &a_message)
 {
 	a_message->SetOneWay(true);
 
-	p_Send(*a_message);
+	p_Send(a_message);
+}
+
+void CAxonClient::p_Send(const CMessage::Ptr &a_message)
+{
+	// Connections within the process take the message as it is
+	if (m_msgConnection)
+		m_msgConnection->SendMessage(a_message);
+	else
+		p_Send(*a_message);
 }
 
 void CAxonClient::p_Send(const CMessage& a_message)
 {
-	CDataBuffer l_buffer = m_protocol->SerializeMessage(a_message);
+	if (m_abortsPending)
+		p_SendPendingAborts();
+
+	// The peer of a stateful protocol has to receive the messages in the
+	// same order that they were serialized, and every one of them, since
+	// the state has moved on once a message is serialized. So a connection
+	// that refuses sends has to do it before then
+	const bool l_stateful = m_protocol->IsStateful();
+
+	unique_lock<mutex> l_lock(m_sendLock, defer_lock);
+
+	if (l_stateful)
+	{
+		l_lock.lock();
+
+		m_connection->CheckSend();
+	}
+
+	// Large messages come back in fragments, if the protocol splits them.
+	// Stateful protocols don't. Sending fragments means waiting for the
+	// connection to drain, so the threads that drain it send them whole
+	vector<util::CBuffer> l_frames = m_connection->CanWaitForSendQueue() ?
+			m_protocol->SerializeFragments(a_message)
+		  : vector<util::CBuffer>(1, m_protocol->SerializeMessage(a_message).ToShared());
+
+	// Nobody waits on one-way messages, so they can be dropped for a peer
+	// that isn't keeping up. Responses are sent as one-way messages too, but
+	// the caller is waiting on those. Neither with a stateful protocol, since
+	// the peer needs everything that was serialized
+	const bool l_droppable = a_message.IsOneWay() && a_message.RequestId().empty() &&
+							 !l_stateful;
+
+	if (l_frames.size() > 1)
+		p_SendFragments(move(l_frames), l_droppable);
+	else if (l_stateful)
+		m_connection->SendChecked(l_frames[0]);
+	else if (l_droppable)
+		m_connection->SendDroppable(l_frames[0]);
+	else
+		m_connection->Send(l_frames[0]);
+}
+
+void CAxonClient::p_SendFragments(vector<util::CBuffer> a_frames, bool a_droppable)
+{
+	COutgoingFragments l_msg(m_connection, move(a_frames), a_droppable);
+
+	unique_lock<mutex> l_lock(m_fragLock);
+
+	m_fragQueue.push_back(&l_msg);
+
+	// Each message gets a fragment in turn, so the transfers share the
+	// connection evenly. Other messages are sent right away, and only wait
+	// behind a fragment
+	while (l_msg.Next < l_msg.Frames.size())
+	{
+		m_fragTurn.wait(l_lock,
+				[this, &l_msg] () -> bool
+				{
+					return m_fragQueue.front() == &l_msg;
+				});
+
+		l_lock.unlock();
+
+		bool l_sent;
+
+		try
+		{
+			l_sent = p_SendFragment(l_msg);
+		}
+		catch (...)
+		{
+			p_AbortFragments(l_msg);
+			throw;
+		}
+
+		l_lock.lock();
+
+		m_fragQueue.pop_front();
+
+		// The message was dropped, or the connection closed
+		if (!l_sent)
+			break;
+
+		if (l_msg.Next < l_msg.Frames.size())
+			m_fragQueue.push_back(&l_msg);
+
+		m_fragTurn.notify_all();
+	}
+
+	m_fragTurn.notify_all();
+}
+
+bool CAxonClient::p_SendFragment(COutgoingFragments &a_msg)
+{
+	const util::CBuffer &l_frame = a_msg.Frames[a_msg.Next];
+
+	// Keeps a couple of fragments queued on the connection, so that it
+	// doesn't run dry between them, but other messages can still get in
+	if (!a_msg.Connection->WaitForSendQueue(2 * l_frame.Size()))
+		return false;
+
+	// So that a dropped message is dropped as a whole
+	if (a_msg.Next == 0 && a_msg.Droppable)
+	{
+		if (!a_msg.Connection->SendDroppable(l_frame))
+			return false;
+	}
+	else
+		a_msg.Connection->Send(l_frame);
+
+	++a_msg.Next;
+
+	return true;
+}
+
+void CAxonClient::p_AbortFragments(COutgoingFragments &a_msg)
+{
+	{
+		lock_guard<mutex> l_lock(m_fragLock);
+
+		m_fragQueue.erase(find(m_fragQueue.begin(), m_fragQueue.end(), &a_msg));
+	}
+	m_fragTurn.notify_all();
 
-	m_connection->Send(l_buffer.ToShared());
+	// Otherwise the peer holds on to the fragments that it already has
+	if (a_msg.Next == 0 || a_msg.Connection != m_connection)
+		return;
+
+	util::CBuffer l_abort = m_protocol->SerializeFragmentAbort(a_msg.Frames.back());
+
+	try
+	{
+		a_msg.Connection->Send(l_abort);
+	}
+	catch (exception &)
+	{
+		// The connection is over its send limits, like it was for the
+		// fragment that failed, so it goes out with the next message
+		lock_guard<mutex> l_lock(m_fragLock);
+
+		m_pendingAborts.push_back(move(l_abort));
+		m_abortsPending = true;
+	}
+}
+
+void CAxonClient::p_SendPendingAborts()
+{
+	vector<util::CBuffer> l_aborts;
+
+	{
+		lock_guard<mutex> l_lock(m_fragLock);
+
+		l_aborts.swap(m_pendingAborts);
+		m_abortsPending = false;
+	}
+
+	for (size_t i = 0; i < l_aborts.size(); ++i)
+	{
+		try
+		{
+			m_connection->Send(l_aborts[i]);
+		}
+		catch (exception &)
+		{
+			lock_guard<mutex> l_lock(m_fragLock);
+
+			m_pendingAborts.insert(m_pendingAborts.end(), l_aborts.begin() + i, l_aborts.end());
+			m_abortsPending = true;
+			return;
+		}
+	}
 }
 
 void CAxonClient::p_OnMessageReceived(const CMessage::Ptr& a_message)
@@ -8,9 +8,11 @@
 
 #include "util/crc_calc.h"
 #include "serialization/format/axon_serializer.h"
+#include "serialization/format/binary_format_common.h"
 #include "fault_exception.h"
 
 #include <algorithm>
+#include <limits>
 
 using namespace std;
 
@@ -21,6 +23,47 @@ namespace axon { namespace communication {
 
 const char s_specialToken = 172;
 
+// A frame is the token, an 8 byte header, the CRCs of the header and the
+// payload, and then the payload. The header holds the payload size in the
+// low 32 bits, followed by the codec of a compressed payload (0 when it
+// isn't compressed), the frame flags, and the message id of a fragment
+const size_t s_frameHeaderSize = 1 + 8 + 4 + 4;
+const int s_codecShift = 32;
+const int s_flagsShift = 40;
+const int s_fragmentIdShift = 48;
+const uint64_t s_sizeMask = 0xFFFFFFFF;
+const uint64_t s_reservedMask = ~((uint64_t(1) << 48) - 1);
+
+// The payload of a hello frame is the names of the compressors of the
+// sender, each one followed by a null character
+const uint8_t s_frameHello = 0x1;
+
+// The payload was compressed by the compression stream of the connection.
+// The first frame of a stream also has the start flag
+const uint8_t s_frameStream = 0x2;
+const uint8_t s_frameStreamStart = 0x4;
+
+// The payload is a piece of a larger message, which the receiver appends
+// to the pieces before it. The pieces of a message arrive in order, from
+// the one with the start flag to the one with the end flag, and all of
+// them have the codec and the flags of the message. A fragment with the
+// abort flag and no payload ends a message that won't be sent in full
+const uint8_t s_frameFragment = 0x8;
+const uint8_t s_frameFragmentStart = 0x10;
+const uint8_t s_frameFragmentEnd = 0x20;
+const uint8_t s_frameFragmentAbort = 0x40;
+const uint8_t s_fragmentFlags = s_frameFragment | s_frameFragmentStart | s_frameFragmentEnd |
+                                s_frameFragmentAbort;
+
+const uint8_t s_frameFlags = s_frameHello | s_frameStream | s_frameStreamStart | s_fragmentFlags;
+
+// Compressed payloads start with their uncompressed size
+const size_t s_rawSizeSize = sizeof(uint32_t);
+
+// The payload buffer starts out at this size, or the size of the frame if
+// that is smaller, and doubles from there as the data arrives
+const size_t s_minPayloadBuffer = 64 * 1024;
+
 enum class APState
 {
 	Anchor,
@@ -30,64 +73,392 @@ enum class APState
 	Message
 };
 
+namespace {
+
+void FinishFrame(char *a_frame, uint64_t a_header)
+{
+	a_frame[0] = s_specialToken;
+	memcpy(a_frame + 1, &a_header, 8);
+
+	// Compute a CRC for the header. This is simply to add redundancy on the receiving
+	// end to prevent the system from allocating erroneous memory. This is not a security
+	// enhancement because it doesn't detect tampering, only accidental transmission error
+	const uint32_t l_crcHeader = CalcCRC32(&a_header, 8);
+	memcpy(a_frame + 1 + 8, &l_crcHeader, 4);
+
+	// Calculate the CRC for the data buffer
+	const uint32_t l_crcData = CalcCRC32(a_frame + s_frameHeaderSize, a_header & s_sizeMask);
+	memcpy(a_frame + 1 + 8 + 4, &l_crcData, 4);
+}
+
+// Streams have to be sent everything they compress, but a message that
+// was compressed on its own is sent uncompressed when that is smaller
+template<typename Compressor>
+CDataBuffer CompressFrame(Compressor &a_compressor, uint8_t a_codec, uint8_t a_flags,
+                          const char *a_data, uint64_t a_size)
+{
+	unique_ptr<char[]> l_compData;
+	size_t l_compSize;
+	a_compressor.Compress(a_data, a_size, l_compData, l_compSize);
+
+	const uint64_t l_payloadSize = s_rawSizeSize + l_compSize;
+
+	if (l_payloadSize >= a_size && !(a_flags & s_frameStream))
+		return CDataBuffer();
+
+	if (l_payloadSize > s_sizeMask)
+		throw runtime_error("The message size cannot exceed 4 GiB.");
+
+	CDataBuffer l_ret(s_frameHeaderSize + l_payloadSize);
+
+	char *l_payload = l_ret.Data() + s_frameHeaderSize;
+
+	const uint32_t l_rawSize = uint32_t(a_size);
+	memcpy(l_payload, &l_rawSize, s_rawSizeSize);
+	memcpy(l_payload + s_rawSizeSize, l_compData.get(), l_compSize);
+
+	FinishFrame(l_ret.Data(), l_payloadSize | (uint64_t(a_codec) << s_codecShift)
+	                                        | (uint64_t(a_flags) << s_flagsShift));
+
+	return move(l_ret);
+}
+
+}
+
 CAxonProtocol::CAxonProtocol()
+	: m_frameSize(0), m_skipFrame(false), m_maxFrameSize(0), m_connectionBudget(0), m_reserved(0),
+	  m_frameReserved(0), m_numRejected(0), m_fragmentId(0), m_frameBase(0), m_fragmentSize(0),
+	  m_nextFragmentId(0), m_nameDictionary(false), m_compressThreshold(DEFAULT_COMPRESS_THRESHOLD),
+	  m_streamCompression(false), m_frameCodec(0), m_frameFlags(0)
 {
 	ResetState();
+	ResetCompression();
 
 	SetSerializer(make_shared<CAxonSerializer>());
 }
 
 CAxonProtocol::CAxonProtocol(ASerializer::Ptr a_serializer)
+	: m_frameSize(0), m_skipFrame(false), m_maxFrameSize(0), m_connectionBudget(0), m_reserved(0),
+	  m_frameReserved(0), m_numRejected(0), m_fragmentId(0), m_frameBase(0), m_fragmentSize(0),
+	  m_nextFragmentId(0), m_nameDictionary(false), m_compressThreshold(DEFAULT_COMPRESS_THRESHOLD),
+	  m_streamCompression(false), m_frameCodec(0), m_frameFlags(0)
 {
 	ResetState();
+	ResetCompression();
 
 	SetSerializer(move(a_serializer));
 }
 
+CAxonProtocol::CAxonProtocol(ASerializer::Ptr a_serializer, bool a_nameDictionary)
+	: m_frameSize(0), m_skipFrame(false), m_maxFrameSize(0), m_connectionBudget(0), m_reserved(0),
+	  m_frameReserved(0), m_numRejected(0), m_fragmentId(0), m_frameBase(0), m_fragmentSize(0),
+	  m_nextFragmentId(0), m_nameDictionary(false), m_compressThreshold(DEFAULT_COMPRESS_THRESHOLD),
+	  m_streamCompression(false), m_frameCodec(0), m_frameFlags(0)
+{
+	ResetState();
+	ResetCompression();
+
+	SetSerializer(move(a_serializer));
+	SetNameDictionary(a_nameDictionary);
+}
+
+CAxonProtocol::~CAxonProtocol()
+{
+	p_ReleaseBuffer();
+	p_ReleasePartials();
+}
+
 void CAxonProtocol::SetSerializer(ASerializer::Ptr a_serializer)
 {
 	if (!a_serializer)
 		throw runtime_error("Cannot set the serializer to null.");
 
+	auto l_axon = dynamic_pointer_cast<CAxonSerializer>(a_serializer);
+
+	if (m_nameDictionary && !l_axon)
+		throw runtime_error("The name dictionary requires the Axon serializer.");
+
 	m_serializer = move(a_serializer);
+	m_axonSerializer = move(l_axon);
+}
+
+void CAxonProtocol::SetNameDictionary(bool a_enabled)
+{
+	if (a_enabled && !m_axonSerializer)
+		throw runtime_error("The name dictionary requires the Axon serializer.");
+
+	lock_guard<mutex> l_lock(m_dictLock);
+
+	m_nameDictionary = a_enabled;
+	m_sendDict.Clear();
+	m_recvDict.Clear();
+}
+
+void CAxonProtocol::SetCompressors(vector<ICompressor::Ptr> a_compressors)
+{
+	if (any_of(a_compressors.begin(), a_compressors.end(),
+			[] (const ICompressor::Ptr &a_comp) { return !a_comp; }))
+		throw runtime_error("The compressors cannot be null.");
+
+	if (a_compressors.size() > numeric_limits<uint8_t>::max())
+		throw runtime_error("Too many compressors.");
+
+	lock_guard<mutex> l_lock(m_compressLock);
+
+	m_compressors = move(a_compressors);
+
+	ResetCompression();
+}
+
+void CAxonProtocol::SetCompressor(ICompressor::Ptr a_compressor)
+{
+	vector<ICompressor::Ptr> l_compressors;
+
+	if (a_compressor)
+		l_compressors.push_back(move(a_compressor));
+
+	SetCompressors(move(l_compressors));
+}
+
+ICompressor::Ptr CAxonProtocol::SendCompressor() const
+{
+	lock_guard<mutex> l_lock(m_compressLock);
+
+	return m_sendCompressor;
+}
+
+void CAxonProtocol::SetStreamCompression(bool a_enabled)
+{
+	lock_guard<mutex> l_lock(m_compressLock);
+
+	m_streamCompression = a_enabled;
+	m_sendStream.reset();
+}
+
+bool CAxonProtocol::IsPerConnection() const
+{
+	if (IsStateful())
+		return true;
+
+	lock_guard<mutex> l_lock(m_compressLock);
+
+	return !m_compressors.empty();
+}
+
+void CAxonProtocol::SetReceiveBudget(CReceiveBudget::Ptr a_budget)
+{
+	// The reservations belong to the old budget
+	p_ReleaseBuffer();
+	p_ReleasePartials();
+	ResetState();
+
+	m_recvBudget = move(a_budget);
+}
+
+void CAxonProtocol::Reset()
+{
+	AStateProtocol::Reset();
+
+	{
+		lock_guard<mutex> l_lock(m_dictLock);
+		m_sendDict.Clear();
+		m_recvDict.Clear();
+	}
+
+	{
+		lock_guard<mutex> l_lock(m_compressLock);
+		ResetCompression();
+	}
+
+	p_ReleaseBuffer();
+	p_ReleasePartials();
+	ResetState();
 }
 
 CDataBuffer CAxonProtocol::SerializeMessage(const CMessage& a_msg) const
 {
-	const uint64_t l_msgSize = m_serializer->CalcSize(*a_msg.Msg());
+	// The send dictionary changes with each message, so it has to stay
+	// locked from the size calculation until the message has been written
+	unique_lock<mutex> l_dictLock(m_dictLock, defer_lock);
+
+	if (m_nameDictionary)
+		l_dictLock.lock();
+
+	const uint64_t l_msgSize = m_nameDictionary ?
+			m_axonSerializer->CalcSize(*a_msg.Msg(), m_sendDict)
+		  : m_serializer->CalcSize(*a_msg.Msg());
 
 	if (l_msgSize > numeric_limits<uint32_t>::max())
 		throw runtime_error("The message size cannot exceed 4 GiB.");
 
-	const size_t l_bufferSize = 1 + sizeof(m_lenHeader) +
-					  sizeof(m_crcHeader) + sizeof(m_crcData) +
-					  l_msgSize;
+	CDataBuffer l_ret(s_frameHeaderSize + l_msgSize);
+
+	char *l_opDataBuff = l_ret.Data() + s_frameHeaderSize;
+	if (m_nameDictionary)
+	{
+		m_axonSerializer->SerializeInto(*a_msg.Msg(),
+				l_opDataBuff,
+				l_msgSize,
+				m_sendDict);
+
+		l_dictLock.unlock();
+	}
+	else
+	{
+		m_serializer->SerializeInto(*a_msg.Msg(),
+				l_opDataBuff,
+				l_msgSize);
+	}
 
-	CDataBuffer l_ret(l_bufferSize);
+	ICompressor::Ptr l_compressor;
+	uint8_t l_codec = 0;
+	CDataBuffer l_comp;
 
-	char *l_opBuff = l_ret.Data();
-	l_opBuff[0] = s_specialToken;
-	memcpy(l_opBuff + 1, &l_msgSize, sizeof(m_lenHeader));
+	{
+		lock_guard<mutex> l_lock(m_compressLock);
 
-	// Compute a CRC for the header size. This is simply to add redundancy on the receiving
-	// end to prevent the system from allocating erroneous memory. This is not a security
-	// enhancement because it doesn't detect tampering, only accidental transmission error
-	const uint32_t l_crcHeader = CalcCRC32(&l_msgSize, sizeof(m_lenHeader));
-	memcpy(l_opBuff + 1 + sizeof(m_lenHeader), &l_crcHeader, sizeof(m_crcHeader));
+		if (l_msgSize >= m_compressThreshold && m_sendCompressor)
+		{
+			uint8_t l_flags = s_frameStream;
+
+			if (m_streamCompression && !m_sendStream)
+			{
+				m_sendStream = m_sendCompressor->CreateStream();
+				l_flags |= s_frameStreamStart;
+			}
+
+			// The stream has to compress the messages in the order that
+			// they are sent, so this can't happen outside of the lock
+			if (m_sendStream)
+				l_comp = CompressFrame(*m_sendStream, m_sendCodec, l_flags, l_opDataBuff, l_msgSize);
+			else
+			{
+				l_compressor = m_sendCompressor;
+				l_codec = m_sendCodec;
+			}
+		}
+	}
 
-	char *l_opDataBuff = l_opBuff + 1 + sizeof(m_lenHeader) + sizeof(m_crcHeader) + sizeof(m_crcData);
-	m_serializer->SerializeInto(*a_msg.Msg(),
-			l_opDataBuff,
-			l_msgSize);
+	if (l_compressor)
+		l_comp = CompressFrame(*l_compressor, l_codec, 0, l_opDataBuff, l_msgSize);
 
-	// Calculate the CRC for the data buffer
-	const uint32_t l_crcData = CalcCRC32(l_opDataBuff, l_msgSize);
-	memcpy(l_opBuff + 1 + sizeof(m_lenHeader) + sizeof(m_crcHeader),
-			&l_crcData, sizeof(m_crcData));
+	if (l_comp.Size())
+		l_ret = move(l_comp);
+	else
+		FinishFrame(l_ret.Data(), l_msgSize);
 
 	return move(l_ret);
 }
 
+CDataBuffer CAxonProtocol::SerializeHello() const
+{
+	string l_hello;
+
+	{
+		lock_guard<mutex> l_lock(m_compressLock);
+
+		for (const ICompressor::Ptr &l_comp : m_compressors)
+		{
+			l_hello += l_comp->Name();
+			l_hello += '\0';
+		}
+	}
+
+	// Without compressors there is nothing to advertise, and the frames stay
+	// compatible with protocols that don't support compression
+	if (l_hello.empty())
+		return CDataBuffer();
+
+	CDataBuffer l_ret(s_frameHeaderSize + l_hello.size());
+
+	memcpy(l_ret.Data() + s_frameHeaderSize, l_hello.data(), l_hello.size());
+	FinishFrame(l_ret.Data(), l_hello.size() | (uint64_t(s_frameHello) << s_flagsShift));
+
+	return move(l_ret);
+}
+
+vector<CBuffer> CAxonProtocol::SerializeFragments(const CMessage &a_msg) const
+{
+	CDataBuffer l_frames = SerializeMessage(a_msg);
+
+	// The name dictionary and the compression streams need the messages in
+	// the order that they were serialized
+	if (!m_fragmentSize || IsStateful())
+		return vector<CBuffer>(1, l_frames.ToShared());
+
+	uint64_t l_header = 0;
+	memcpy(&l_header, l_frames.Data() + 1, 8);
+
+	const size_t l_payloadSize = l_header & s_sizeMask;
+
+	if (l_payloadSize <= m_fragmentSize)
+		return vector<CBuffer>(1, l_frames.ToShared());
+
+	const size_t l_numFragments = (l_payloadSize + m_fragmentSize - 1) / m_fragmentSize;
+	const uint64_t l_msgHeader = (l_header & ~s_sizeMask) |
+			(uint64_t(m_nextFragmentId++) << s_fragmentIdShift);
+
+	// All of the fragments share one buffer, and each one is sent from a
+	// slice of it
+	CBuffer l_buff(l_numFragments * s_frameHeaderSize + l_payloadSize);
+
+	const char *l_payload = l_frames.Data() + s_frameHeaderSize;
+	char *l_out = l_buff.Data();
+
+	vector<CBuffer> l_ret;
+	l_ret.reserve(l_numFragments);
+
+	size_t l_sliceStart = 0;
+
+	for (size_t i = 0; i < l_numFragments; ++i)
+	{
+		const size_t l_offset = i * m_fragmentSize;
+		const size_t l_size = min(m_fragmentSize, l_payloadSize - l_offset);
+
+		uint8_t l_flags = s_frameFragment;
+
+		if (i == 0)
+			l_flags |= s_frameFragmentStart;
+		if (i == l_numFragments - 1)
+			l_flags |= s_frameFragmentEnd;
+
+		memcpy(l_out + s_frameHeaderSize, l_payload + l_offset, l_size);
+		FinishFrame(l_out, l_msgHeader | l_size | (uint64_t(l_flags) << s_flagsShift));
+
+		l_out += s_frameHeaderSize + l_size;
+
+		const size_t l_sliceEnd = l_out - l_buff.Data();
+
+		l_ret.push_back(CBuffer(l_sliceEnd - l_sliceStart, l_buff.SP_At(l_sliceStart).SPData()));
+
+		l_sliceStart = l_sliceEnd;
+	}
+
+	return l_ret;
+}
+
+CBuffer CAxonProtocol::SerializeFragmentAbort(const CBuffer &a_fragment) const
+{
+	uint64_t l_header = 0;
+
+	if (a_fragment.Size() < s_frameHeaderSize)
+		throw runtime_error("The buffer isn't a fragment.");
+
+	memcpy(&l_header, a_fragment.Data() + 1, 8);
+
+	if (!(uint8_t(l_header >> s_flagsShift) & s_frameFragment))
+		throw runtime_error("The buffer isn't a fragment.");
+
+	const uint64_t l_fragmentId = l_header & s_reservedMask;
+
+	CBuffer l_ret(s_frameHeaderSize);
+
+	FinishFrame(l_ret.Data(), l_fragmentId |
+			(uint64_t(s_frameFragment | s_frameFragmentAbort) << s_flagsShift));
+
+	return l_ret;
+}
+
 void CAxonProtocol::ProcessInternal(CDataBuffer a_buffer)
 {
 	if (a_buffer.Size() == 0)
@@ -144,12 +515,42 @@ void CAxonProtocol::p_ProcCRCMsgHeader(char*& a_curr, char* a_end)
 {
 	if (p_ReadIntoBuffer(m_crcHeader, sizeof(m_crcHeader), a_curr, a_end))
 	{
-		uint64_t l_headerSize = 0;
-		memcpy(&l_headerSize, m_lenHeader, sizeof(m_lenHeader));
+		uint64_t l_header = 0;
+		memcpy(&l_header, m_lenHeader, sizeof(m_lenHeader));
+
+		p_ValidateHeader(l_header);
 
-		p_ValidateHeader(l_headerSize);
+		m_frameCodec = uint8_t(l_header >> s_codecShift);
+		m_frameFlags = uint8_t(l_header >> s_flagsShift);
 
-		m_dataBuff.Reset(l_headerSize);
+		m_frameSize = l_header & s_sizeMask;
+		m_frameBase = 0;
+		m_skipFrame = false;
+
+		if (m_frameFlags & s_frameFragment)
+		{
+			m_fragmentId = uint16_t(l_header >> s_fragmentIdShift);
+
+			if (m_frameFlags & s_frameFragmentAbort)
+			{
+				p_DropFragment();
+				m_skipFrame = true;
+			}
+			else
+				p_BeginFragment();
+		}
+
+		// Nothing is allocated yet, since the header could be claiming
+		// anything. The buffer grows in p_ProcMessage as the payload arrives
+		const size_t l_maxFrameSize = p_MaxFrameSize();
+		const size_t l_connBudget = p_ConnectionBudget();
+		const size_t l_msgSize = m_frameBase + m_frameSize;
+
+		if (!m_skipFrame && ((l_maxFrameSize && l_msgSize > l_maxFrameSize) ||
+							 (l_connBudget && l_msgSize > l_connBudget)))
+		{
+			p_RejectFrame("Received a message that is larger than the receive limits allow");
+		}
 
 		p_MoveTo(APState::CRCDataHeader);
 	}
@@ -165,28 +566,63 @@ void CAxonProtocol::p_ProcCRCDataHeader(char*& a_curr, char* a_end)
 
 void CAxonProtocol::p_ProcMessage(char*& a_curr, char* a_end)
 {
-	if (p_ReadIntoBuffer(m_dataBuff.Data(), m_dataBuff.Size(),
-			a_curr, a_end))
+	const uint64_t l_numRead = min<uint64_t>(m_frameSize - m_stateCurr, a_end - a_curr);
+
+	if (!m_skipFrame && !p_GrowBuffer(m_frameBase + m_stateCurr + l_numRead))
+		p_RejectFrame("Received a message that doesn't fit in the receive budget");
+
+	// The payload of a rejected frame is dropped as it arrives
+	if (!m_skipFrame && l_numRead)
+		memcpy(m_dataBuff.Data() + m_frameBase + m_stateCurr, a_curr, l_numRead);
+
+	a_curr += l_numRead;
+	m_stateCurr += l_numRead;
+
+	if (m_stateCurr < m_frameSize)
+		return;
+
+	if (!m_skipFrame)
 	{
-		p_ValidateData();
+		try
+		{
+			p_ValidateData();
 
-		p_Finalize();
+			if (m_frameFlags & s_frameFragment)
+				p_FinishFragment();
+			else
+				p_Finalize();
+		}
+		catch (...)
+		{
+			p_ReleaseBuffer();
+			p_DropFragment();
+			throw;
+		}
 
-		p_MoveTo(APState::Anchor);
+		p_ReleaseBuffer();
 	}
+
+	p_MoveTo(APState::Anchor);
 }
 
 void CAxonProtocol::FinishProcessing(CDataBuffer a_buffer)
 {
  	try
 	{
-		AData::Ptr l_data = m_serializer->DeserializeData(
-				a_buffer.begin(), a_buffer.end());
+		AData::Ptr l_data = m_nameDictionary ?
+				m_axonSerializer->DeserializeData(a_buffer.begin(), a_buffer.end(), m_recvDict)
+			  : m_serializer->DeserializeData(a_buffer.begin(), a_buffer.end());
 
 		auto l_msg = make_shared<CMessage>(move(l_data));
 
 		OnFinished(l_msg);
 	}
+	catch (CNameDictionaryException &ex)
+	{
+		// The dictionaries are out of sync, so none of the following
+		// messages can be read either. Let the connection be torn down
+		throw CFaultException(ex.what());
+	}
 	catch (...)
 	{
 		// TODO: Log this?
@@ -195,7 +631,109 @@ void CAxonProtocol::FinishProcessing(CDataBuffer a_buffer)
 
 void CAxonProtocol::p_Finalize()
 {
-    FinishProcessing(move(m_dataBuff));
+	if (m_frameFlags & s_frameHello)
+		p_ProcHello(m_dataBuff);
+	else if (m_frameCodec)
+	{
+		CDataBuffer l_raw = p_Decompress(move(m_dataBuff));
+
+		// Unless it turned out to be over the limits once decompressed
+		if (!m_skipFrame)
+			FinishProcessing(move(l_raw));
+	}
+	else
+		FinishProcessing(move(m_dataBuff));
+}
+
+CDataBuffer CAxonProtocol::p_Decompress(CDataBuffer a_buffer)
+{
+	ICompressor::Ptr l_compressor;
+
+	{
+		lock_guard<mutex> l_lock(m_compressLock);
+
+		if (m_frameCodec <= m_compressors.size())
+			l_compressor = m_compressors[m_frameCodec - 1];
+	}
+
+	if (!l_compressor)
+		throw CFaultException("Received a message that was compressed with an unknown codec");
+
+	if (a_buffer.Size() < s_rawSizeSize)
+		throw CFaultException("Received a compressed message without its size");
+
+	uint32_t l_rawSize = 0;
+	memcpy(&l_rawSize, a_buffer.Data(), s_rawSizeSize);
+
+	// The decompressed size is only known once the frame has arrived, and
+	// the decompressor allocates all of it up front
+	const size_t l_maxFrameSize = p_MaxFrameSize();
+
+	if ((l_maxFrameSize && l_rawSize > l_maxFrameSize) || !p_Reserve(l_rawSize))
+	{
+		p_RejectFrame("Received a compressed message that is larger than the receive limits allow");
+		return CDataBuffer();
+	}
+
+	// Only this thread uses the receive stream
+	if (m_frameFlags & s_frameStreamStart)
+	{
+		m_recvStream = l_compressor->CreateStream();
+
+		if (!m_recvStream)
+			throw CFaultException("Received a compression stream that isn't supported");
+	}
+	else if ((m_frameFlags & s_frameStream) && !m_recvStream)
+		throw CFaultException("Received a message from a compression stream that wasn't started");
+
+	try
+	{
+		auto l_raw = (m_frameFlags & s_frameStream) ?
+				m_recvStream->Decompress(a_buffer.Data() + s_rawSizeSize,
+					a_buffer.Size() - s_rawSizeSize, l_rawSize)
+			  : l_compressor->Decompress(a_buffer.Data() + s_rawSizeSize,
+					a_buffer.Size() - s_rawSizeSize, l_rawSize);
+
+		return CDataBuffer(move(l_raw), l_rawSize);
+	}
+	catch (exception &ex)
+	{
+		// The CRC was valid, so the two ends disagree on the codec
+		throw CFaultException(ex.what());
+	}
+}
+
+void CAxonProtocol::p_ProcHello(const CDataBuffer &a_buffer)
+{
+	vector<string> l_names;
+
+	for (const char *l_curr = a_buffer.begin(); l_curr < a_buffer.end(); )
+	{
+		const char *l_nameEnd = find(l_curr, a_buffer.end(), '\0');
+
+		l_names.emplace_back(l_curr, l_nameEnd);
+
+		l_curr = l_nameEnd + 1;
+	}
+
+	lock_guard<mutex> l_lock(m_compressLock);
+
+	// The peer starts over, so the send stream has to start over too
+	m_sendCompressor.reset();
+	m_sendCodec = 0;
+	m_sendStream.reset();
+
+	for (const ICompressor::Ptr &l_comp : m_compressors)
+	{
+		auto l_iter = find(l_names.begin(), l_names.end(), l_comp->Name());
+
+		if (l_iter != l_names.end() && l_iter - l_names.begin() < numeric_limits<uint8_t>::max())
+		{
+			m_sendCompressor = l_comp;
+			m_sendCodec = uint8_t(l_iter - l_names.begin() + 1);
+			break;
+		}
+	}
 }
 
 bool CAxonProtocol::p_ReadIntoBuffer(char* a_target, uint64_t a_targetSize,
@@ -210,15 +748,213 @@ bool CAxonProtocol::p_ReadIntoBuffer(char* a_target, uint64_t a_targetSize,
 	return m_stateCurr == a_targetSize;
 }
 
+size_t CAxonProtocol::p_MaxFrameSize() const
+{
+	const size_t l_shared = m_recvBudget ? m_recvBudget->MaxFrameSize() : 0;
+
+	if (!m_maxFrameSize || !l_shared)
+		return max(m_maxFrameSize, l_shared);
+
+	return min(m_maxFrameSize, l_shared);
+}
+
+size_t CAxonProtocol::p_ConnectionBudget() const
+{
+	const size_t l_shared = m_recvBudget ? m_recvBudget->ConnectionLimit() : 0;
+
+	if (!m_connectionBudget || !l_shared)
+		return max(m_connectionBudget, l_shared);
+
+	return min(m_connectionBudget, l_shared);
+}
+
+bool CAxonProtocol::p_GrowBuffer(size_t a_size)
+{
+	const size_t l_capacity = m_dataBuff.Size();
+
+	if (a_size <= l_capacity)
+		return true;
+
+	// Doubling keeps a frame that trickles in from being copied over and
+	// over. The buffer never grows past the size of a frame, but the size
+	// of a fragmented message is only known once its last fragment arrives
+	size_t l_newCapacity = max(l_capacity * 2, s_minPayloadBuffer);
+
+	if (!(m_frameFlags & s_frameFragment))
+		l_newCapacity = min<size_t>(l_newCapacity, m_frameSize);
+	else if (const size_t l_maxFrameSize = p_MaxFrameSize())
+		l_newCapacity = min(l_newCapacity, l_maxFrameSize);
+
+	// A message that still fits shouldn't be rejected for the doubling
+	const size_t l_connBudget = p_ConnectionBudget();
+
+	if (l_connBudget && m_reserved < l_connBudget)
+		l_newCapacity = min(l_newCapacity, l_capacity + (l_connBudget - m_reserved));
+
+	l_newCapacity = max(l_newCapacity, a_size);
+
+	if (!p_Reserve(l_newCapacity - l_capacity))
+		return false;
+
+	CDataBuffer l_buff(l_newCapacity);
+
+	const size_t l_used = m_frameBase + m_stateCurr;
+
+	if (l_used)
+		memcpy(l_buff.Data(), m_dataBuff.Data(), l_used);
+
+	m_dataBuff = move(l_buff);
+
+	return true;
+}
+
+bool CAxonProtocol::p_Reserve(size_t a_size)
+{
+	const size_t l_connBudget = p_ConnectionBudget();
+
+	if (l_connBudget && (a_size > l_connBudget || m_reserved > l_connBudget - a_size))
+		return false;
+
+	if (m_recvBudget && !m_recvBudget->TryReserve(a_size))
+		return false;
+
+	// Everything that is reserved belongs to the current frame, until it
+	// is either finished or moved to a partial frame
+	m_reserved += a_size;
+	m_frameReserved += a_size;
+
+	return true;
+}
+
+void CAxonProtocol::p_Release(size_t a_size)
+{
+	if (m_recvBudget)
+		m_recvBudget->Release(a_size);
+
+	m_reserved -= a_size;
+}
+
+void CAxonProtocol::p_ReleaseBuffer()
+{
+	m_dataBuff.Reset();
+
+	p_Release(m_frameReserved);
+	m_frameReserved = 0;
+}
+
+void CAxonProtocol::p_ReleasePartials()
+{
+	for (auto &l_partial : m_partials)
+		p_Release(l_partial.second.Reserved);
+
+	m_partials.clear();
+}
+
+void CAxonProtocol::p_RejectFrame(const char *a_reason)
+{
+	++m_numRejected;
+
+	if (m_recvBudget)
+		m_recvBudget->FrameRejected();
+
+	p_ReleaseBuffer();
+
+	// The rest of the message is skipped, since it has a piece missing
+	p_DropFragment();
+
+	// Skipping a frame that carries state would leave the two ends out of
+	// sync, so the connection can't carry on
+	if (m_nameDictionary || (m_frameFlags & s_frameStream))
+		throw CFaultException(a_reason);
+
+	m_skipFrame = true;
+}
+
+void CAxonProtocol::p_BeginFragment()
+{
+	auto l_iter = m_partials.find(m_fragmentId);
+
+	if (m_frameFlags & s_frameFragmentStart)
+	{
+		// The id was reused, so whatever was left of the last message with
+		// it isn't coming anymore
+		if (l_iter != m_partials.end())
+		{
+			p_Release(l_iter->second.Reserved);
+			m_partials.erase(l_iter);
+		}
+
+		l_iter = m_partials.emplace(m_fragmentId, CPartialFrame()).first;
+
+		l_iter->second.Codec = m_frameCodec;
+		l_iter->second.Flags = m_frameFlags & ~s_fragmentFlags;
+	}
+	else if (l_iter == m_partials.end())
+	{
+		// The rest of a message that was rejected
+		m_skipFrame = true;
+		return;
+	}
+
+	// The fragment is read in after the ones before it
+	CPartialFrame &l_partial = l_iter->second;
+
+	m_dataBuff = move(l_partial.Buff);
+	m_frameBase = l_partial.Size;
+	m_frameReserved = l_partial.Reserved;
+	l_partial.Reserved = 0;
+}
+
+void CAxonProtocol::p_FinishFragment()
+{
+	auto l_iter = m_partials.find(m_fragmentId);
+
+	CPartialFrame &l_partial = l_iter->second;
+
+	if (m_frameFlags & s_frameFragmentEnd)
+	{
+		// The message is complete, and is finished like any other frame
+		m_frameCodec = l_partial.Codec;
+		m_frameFlags = l_partial.Flags;
+
+		m_partials.erase(l_iter);
+
+		m_dataBuff.UpdateSize(m_frameBase + m_frameSize);
+
+		p_Finalize();
+	}
+	else
+	{
+		l_partial.Buff = move(m_dataBuff);
+		l_partial.Size = m_frameBase + m_frameSize;
+		l_partial.Reserved = m_frameReserved;
+		m_frameReserved = 0;
+	}
+}
+
+void CAxonProtocol::p_DropFragment()
+{
+	if (!(m_frameFlags & s_frameFragment))
+		return;
+
+	auto l_iter = m_partials.find(m_fragmentId);
+
+	if (l_iter != m_partials.end())
+	{
+		p_Release(l_iter->second.Reserved);
+		m_partials.erase(l_iter);
+	}
+}
+
 void CAxonProtocol::p_MoveTo(APState a_state)
 {
 	m_stateCurr = 0;
 	m_currState = a_state;
 }
 
-void CAxonProtocol::p_ValidateHeader(uint64_t a_headerSize)
+void CAxonProtocol::p_ValidateHeader(uint64_t a_header)
 {
-	const uint32_t l_calcCrcHeader = CalcCRC32(&a_headerSize, sizeof(m_lenHeader));
+	const uint32_t l_calcCrcHeader = CalcCRC32(&a_header, sizeof(m_lenHeader));
 
 	// Read the CRC buffer for the header
 	uint32_t l_actualCrcHeader = 0;
@@ -226,6 +962,16 @@ void CAxonProtocol::p_ValidateHeader(uint64_t a_headerSize)
 
 	if (l_calcCrcHeader != l_actualCrcHeader)
 		throw CFaultException("Received a message with an invalid CRC in the header");
+
+	const uint8_t l_flags = uint8_t(a_header >> s_flagsShift);
+
+	// Only fragments have an id in the reserved bits, or the other fragment flags
+	if (((a_header & s_reservedMask) && !(l_flags & s_frameFragment)) ||
+		((l_flags & s_fragmentFlags) && !(l_flags & s_frameFragment)) || (l_flags & ~s_frameFlags))
+		throw CFaultException("Received a message with unsupported frame flags");
+
+	if ((l_flags & s_frameStream) && uint8_t(a_header >> s_codecShift) == 0)
+		throw CFaultException("Received a compression stream message without a codec");
 }
 
 void CAxonProtocol::p_ValidateData()
@@ -233,7 +979,7 @@ void CAxonProtocol::p_ValidateData()
 	uint32_t l_actualCrcData = 0;
 	memcpy(&l_actualCrcData, m_crcData, sizeof(m_crcData));
 
-	uint32_t l_calcCrcData = CalcCRC32(m_dataBuff.data(), m_dataBuff.size());
+	uint32_t l_calcCrcData = CalcCRC32(m_dataBuff.data() + m_frameBase, m_frameSize);
 
 	if (l_calcCrcData != l_actualCrcData)
 		throw CFaultException("Received a message with an invalid CRC in the data buffer");
@@ -251,4 +997,12 @@ void CAxonProtocol::ResetState()
 	p_MoveTo(APState::Anchor);
 }
 
+void CAxonProtocol::ResetCompression()
+{
+	m_sendCompressor.reset();
+	m_sendCodec = 0;
+	m_sendStream.reset();
+	m_recvStream.reset();
+}
+
 } }
@@ -1,7 +1,7 @@
+
 #include "communication/messaging/axon_protocol_compressed.h"
 
 using namespace std;
-using namespace axon::util;
 using namespace axon::serialization;
 
 namespace axon { namespace communication {
@@ -9,54 +9,19 @@ namespace axon { namespace communication {
 CAxonProtocolCompressed::CAxonProtocolCompressed()
 {
     SetCompressor(ICompressor::DEFAULT_INSTANCE);
-
-    m_outer.SetHandler(bind(&CAxonProtocolCompressed::OnOuterProcessed, this, placeholders::_1));
 }
 
 CAxonProtocolCompressed::CAxonProtocolCompressed(ASerializer::Ptr a_serializer)
-    : CAxonProtocolCompressed() 
-{
-    m_inner.SetSerializer(move(a_serializer));
-}
-
-void CAxonProtocolCompressed::SetCompressor(ICompressor::Ptr a_compressor)
-{
-    m_compressor = move(a_compressor);
-}
-
-void CAxonProtocolCompressed::SetHandler(HandlerFn a_fn)
-{
-	m_inner.SetHandler(move(a_fn));
-}
-
-CDataBuffer CAxonProtocolCompressed::SerializeMessage(const CMessage &a_msg) const
+    : CAxonProtocol(move(a_serializer))
 {
-    CDataBuffer l_inner = m_inner.SerializeMessage(a_msg);
-   
-    std::unique_ptr<char[]> l_compData;
-    size_t l_compSize;
-    m_compressor->Compress(l_inner.data(), l_inner.size(), l_compData, l_compSize); 
-
-    CBuffer l_sb(l_compSize, l_compData.release(), CBuffer::TakeOwnership);
-
-    CMessage l_msgOuter(a_msg);
-    l_msgOuter.Add("Compressed", Serialize(l_sb));
-
-    return m_outer.SerializeMessage(l_msgOuter);
-}
-
-void CAxonProtocolCompressed::Process(CDataBuffer a_buffer)
-{
-    m_outer.Process(move(a_buffer));
+    SetCompressor(ICompressor::DEFAULT_INSTANCE);
 }
 
-
-
-void CAxonProtocolCompressed::OnOuterProcessed(const CMessage::Ptr &a_outerMsg)
+CAxonProtocolCompressed::CAxonProtocolCompressed(ASerializer::Ptr a_serializer,
+                                                 vector<ICompressor::Ptr> a_compressors)
+    : CAxonProtocol(move(a_serializer))
 {
-    auto l_buff = a_outerMsg->GetField<CDataBuffer>("Compressed"); 
-
-    m_inner.Process(move(l_buff));
+    SetCompressors(move(a_compressors));
 }
 
 } }
@@ -6,6 +6,7 @@
 
 #include "communication/messaging/axon_server.h"
 #include "communication/messaging/axon_client.h"
+#include "util/string_convert.h"
 
 using namespace std;
 
@@ -34,6 +35,11 @@ public:
 		throw runtime_error("Cannot change the connection of a server managed client.");
 	}
 
+	void SendBroadcast(const CMessage &a_message)
+	{
+		p_Send(a_message);
+	}
+
 protected:
 	virtual bool TryHandleWithServer(const CMessage &a_msg, CMessage::Ptr &a_out) const override
 	{
@@ -82,6 +88,18 @@ size_t CAxonServer::NumClients() const
 	return m_clients.size();
 }
 
+CReceiveBudget::Ptr CAxonServer::ReceiveBudget() const
+{
+	lock_guard<mutex> l_lock(m_clientLock);
+	return m_recvBudget;
+}
+
+void CAxonServer::SetReceiveBudget(CReceiveBudget::Ptr a_budget)
+{
+	lock_guard<mutex> l_lock(m_clientLock);
+	m_recvBudget = move(a_budget);
+}
+
 void CAxonServer::Broadcast(const CMessage& a_message)
 {
 	if (!m_server)
@@ -90,16 +108,70 @@ void CAxonServer::Broadcast(const CMessage& a_message)
 	if (!m_broadProto)
 		m_broadProto = m_proto->Create();
 
+	if (m_broadProto->IsPerConnection())
+	{
+		// The protocol state, or the compressor that the client
+		// negotiated, is per connection, so the message has to be
+		// serialized separately for each client
+		p_BroadcastEach(a_message);
+		return;
+	}
+
 	util::CBuffer l_buff = m_broadProto->SerializeMessage(a_message).ToShared();
 
 	m_server->Broadcast(l_buff);
 }
 
+void CAxonServer::p_BroadcastEach(const CMessage &a_message)
+{
+	// A send can wait on a slow client, which mustn't hold up the clients
+	// that connect or disconnect in the meantime
+	vector<CAxonServerConnectionPtr> l_clients;
+
+	{
+		lock_guard<mutex> l_lock(m_clientLock);
+
+		l_clients.reserve(m_clients.size());
+
+		for (const auto &l_client : m_clients)
+			l_clients.push_back(l_client.second);
+	}
+
+	// Every client gets the message, even when it can't be sent to some of
+	// them. Those are reported once the rest have been sent to
+	size_t l_numFailed = 0;
+	string l_error;
+
+	for (const CAxonServerConnectionPtr &l_client : l_clients)
+	{
+		try
+		{
+			l_client->SendBroadcast(a_message);
+		}
+		catch (exception &ex)
+		{
+			if (!l_numFailed++)
+				l_error = ex.what();
+		}
+	}
+
+	if (l_numFailed)
+		throw runtime_error("Unable to broadcast to " + util::ToString(l_numFailed) + " of " +
+				util::ToString(l_clients.size()) + " clients. " + l_error);
+}
+
 void CAxonServer::p_OnClientConnected(IDataConnection::Ptr a_client)
 {
 	auto lp = a_client.get();
+
+	IProtocol::Ptr l_proto = m_proto->Create();
+
+	// Before the connection can hand the protocol any data
+	if (auto l_budget = ReceiveBudget())
+		l_proto->SetReceiveBudget(move(l_budget));
+
 	auto l_conn = make_shared<CAxonServerConnection>(shared_from_this(),
-			move(a_client), m_proto->Create());
+			move(a_client), move(l_proto));
 
 	lock_guard<mutex> l_lock(m_clientLock);
 	m_clients.emplace(lp, move(l_conn));
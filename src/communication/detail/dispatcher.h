@@ -151,14 +151,33 @@ public:
 		return Base(m_lastEvt);
 	}
 
+	// Whether the calling thread runs an event loop of any dispatcher. Waiting
+	// on a connection from one could keep it from ever doing the work
+	static bool InEventThread()
+	{
+		return s_EventThread();
+	}
+
 	event_base *Base() const { return m_bases[0].get(); }
 	event_base *Base(size_t a_idx) const { return m_bases[a_idx].get(); }
 	evdns_base *Dns() const { return m_dnss[0].get(); }
 	evdns_base *Dns(size_t a_idx) const { return m_dnss[a_idx].get(); }
 
 private:
+	static bool &s_EventThread()
+	{
+#ifdef IS_WINDOWS
+		static __declspec(thread) bool s_eventThread = false;
+#else
+		static __thread bool s_eventThread = false;
+#endif
+		return s_eventThread;
+	}
+
 	void p_Run(size_t a_idx)
 	{
+		s_EventThread() = true;
+
 		{
 			lock_guard<mutex> l_lock(m_lock);
 			cout << "Entering event dispatch loop " << a_idx << "." << endl;
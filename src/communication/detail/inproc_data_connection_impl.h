@@ -0,0 +1,363 @@
+/*
+ * File description: inproc_data_connection_impl.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef INPROC_DATA_CONNECTION_IMPL_H_
+#define INPROC_DATA_CONNECTION_IMPL_H_
+
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+#include "communication/inproc/inproc_data_connection.h"
+
+using namespace std;
+using namespace axon::util;
+
+namespace axon { namespace communication { namespace inproc {
+
+// What one side sends to the other. Either data or a message
+struct CInprocItem
+{
+	CDataBuffer Data;
+	CMessage::Ptr Message;
+};
+
+/*
+ * The queues between a client and the server, one for each side. Closing
+ * it closes both ends, but anything that was already queued is still
+ * delivered.
+ */
+class CInprocPipe
+{
+public:
+	typedef shared_ptr<CInprocPipe> Ptr;
+	typedef deque<CInprocItem> TQueue;
+
+	static const size_t CLIENT_SIDE = 0;
+	static const size_t SERVER_SIDE = 1;
+
+private:
+	mutable mutex m_lock;
+	condition_variable m_cvs[2];
+	TQueue m_queues[2];
+	bool m_closed;
+
+public:
+	CInprocPipe() : m_closed(false) { }
+
+	bool Push(size_t a_to, CInprocItem a_item)
+	{
+		{
+			lock_guard<mutex> l_lock(m_lock);
+
+			if (m_closed)
+				return false;
+
+			m_queues[a_to].push_back(move(a_item));
+		}
+
+		m_cvs[a_to].notify_one();
+		return true;
+	}
+
+	// Waits for items for the side, and takes all of them at once. Returns
+	// false once the pipe is closed and there is nothing left
+	bool PopAll(size_t a_side, TQueue &a_items)
+	{
+		unique_lock<mutex> l_lock(m_lock);
+
+		m_cvs[a_side].wait(l_lock,
+				[this, a_side] ()
+				{
+					return m_closed || !m_queues[a_side].empty();
+				});
+
+		if (m_queues[a_side].empty())
+			return false;
+
+		a_items.swap(m_queues[a_side]);
+		return true;
+	}
+
+	void Close()
+	{
+		{
+			lock_guard<mutex> l_lock(m_lock);
+			m_closed = true;
+		}
+
+		for (auto &l_cv : m_cvs)
+			l_cv.notify_all();
+	}
+
+	bool IsClosed() const
+	{
+		lock_guard<mutex> l_lock(m_lock);
+		return m_closed;
+	}
+};
+
+// How a server can be reached. The server clears the accept function when
+// it stops, so a client that already found it won't call into a dead server
+struct CInprocListener
+{
+	typedef shared_ptr<CInprocListener> Ptr;
+
+	mutex Lock;
+	function<CInprocPipe::Ptr ()> Accept;
+};
+
+// The servers of the process, by name
+class CInprocRegistry
+{
+private:
+	mutex m_lock;
+	unordered_map<string, CInprocListener::Ptr> m_listeners;
+
+public:
+	static CInprocRegistry &Instance()
+	{
+		static CInprocRegistry s_registry;
+		return s_registry;
+	}
+
+	bool Add(const string &a_name, CInprocListener::Ptr a_listener)
+	{
+		lock_guard<mutex> l_lock(m_lock);
+		return m_listeners.emplace(a_name, move(a_listener)).second;
+	}
+
+	void Remove(const string &a_name, const CInprocListener *a_listener)
+	{
+		lock_guard<mutex> l_lock(m_lock);
+
+		auto iter = m_listeners.find(a_name);
+
+		if (iter != m_listeners.end() && iter->second.get() == a_listener)
+			m_listeners.erase(iter);
+	}
+
+	CInprocPipe::Ptr Connect(const string &a_name)
+	{
+		CInprocListener::Ptr l_listener;
+
+		{
+			lock_guard<mutex> l_lock(m_lock);
+
+			auto iter = m_listeners.find(a_name);
+
+			if (iter == m_listeners.end())
+				return nullptr;
+
+			l_listener = iter->second;
+		}
+
+		lock_guard<mutex> l_lock(l_listener->Lock);
+
+		if (!l_listener->Accept)
+			return nullptr;
+
+		return l_listener->Accept();
+	}
+};
+
+/*
+ * Each connection has a thread that delivers what the other side sent. It
+ * is started once the connection is open and a receive handler has been
+ * set. Messages are delivered to the message handler, which has to be set
+ * before the receive handler to be sure to get all of them.
+ */
+class CInprocDataConnection::Impl
+{
+private:
+	string m_name;
+
+	CInprocPipe::Ptr m_pipe;
+	size_t m_side;
+
+	DataReceivedHandler m_rcvHandler;
+	MessageReceivedHandler m_msgHandler;
+
+	mutex m_startLock;
+	thread m_reader;
+
+public:
+	Impl();
+	Impl(const string &a_name);
+	virtual ~Impl();
+
+	string ConnectionString() const { return m_name; }
+	virtual bool Connect(const string &a_name);
+	virtual void Close();
+	bool IsOpen() const { return m_pipe && !m_pipe->IsClosed(); }
+	virtual bool IsServerClient() const { return false; }
+
+	void Send(const CBuffer &a_buff, condition_variable *a_finishEvt);
+	void SendMessage(CMessage::Ptr a_message);
+
+	void SetReceiveHandler(DataReceivedHandler a_handler);
+	void SetMessageHandler(MessageReceivedHandler a_handler);
+
+protected:
+	// Used by the server for the clients that connect to it
+	Impl(string a_name, CInprocPipe::Ptr a_pipe);
+
+	void p_Start();
+	void p_Stop();
+
+private:
+	void p_Push(CInprocItem a_item);
+	void p_ReadLoop();
+};
+
+inline CInprocDataConnection::Impl::Impl()
+	: m_side(CInprocPipe::CLIENT_SIDE)
+{
+}
+
+inline CInprocDataConnection::Impl::Impl(const string &a_name)
+	: Impl()
+{
+	if (!Connect(a_name))
+		throw runtime_error("Unable to connect to the specified endpoint.");
+}
+
+inline CInprocDataConnection::Impl::Impl(string a_name, CInprocPipe::Ptr a_pipe)
+	: m_name(move(a_name)), m_pipe(move(a_pipe)), m_side(CInprocPipe::SERVER_SIDE)
+{
+}
+
+inline CInprocDataConnection::Impl::~Impl()
+{
+	p_Stop();
+}
+
+inline bool CInprocDataConnection::Impl::Connect(const string &a_name)
+{
+	p_Stop();
+
+	auto l_pipe = CInprocRegistry::Instance().Connect(a_name);
+
+	if (!l_pipe)
+		return false;
+
+	m_name = a_name;
+	m_pipe = move(l_pipe);
+
+	p_Start();
+
+	return true;
+}
+
+inline void CInprocDataConnection::Impl::Close()
+{
+	if (m_pipe)
+		m_pipe->Close();
+}
+
+inline void CInprocDataConnection::Impl::p_Start()
+{
+	lock_guard<mutex> l_lock(m_startLock);
+
+	if (m_pipe && m_rcvHandler && !m_reader.joinable())
+		m_reader = thread(&Impl::p_ReadLoop, this);
+}
+
+inline void CInprocDataConnection::Impl::p_Stop()
+{
+	Impl::Close();
+
+	lock_guard<mutex> l_lock(m_startLock);
+
+	if (m_reader.joinable())
+	{
+		// The connection can be released by one of the handlers
+		if (m_reader.get_id() == this_thread::get_id())
+			m_reader.detach();
+		else
+			m_reader.join();
+	}
+}
+
+inline void CInprocDataConnection::Impl::Send(const CBuffer &a_buff, condition_variable *a_finishEvt)
+{
+	if (a_finishEvt)
+		throw runtime_error("Signaling the end of the send is not currently supported.");
+
+	// The sender is free to reuse its buffer, so the data is copied
+	CInprocItem l_item;
+	l_item.Data.Reset(a_buff.size());
+	memcpy(l_item.Data.Data(), a_buff.data(), a_buff.size());
+
+	p_Push(move(l_item));
+}
+
+inline void CInprocDataConnection::Impl::SendMessage(CMessage::Ptr a_message)
+{
+	CInprocItem l_item;
+	l_item.Message = move(a_message);
+
+	p_Push(move(l_item));
+}
+
+inline void CInprocDataConnection::Impl::p_Push(CInprocItem a_item)
+{
+	if (!m_pipe || !m_pipe->Push(1 - m_side, move(a_item)))
+		cout << "Failed to send in-process data." << endl;
+}
+
+inline void CInprocDataConnection::Impl::SetReceiveHandler(DataReceivedHandler a_handler)
+{
+	m_rcvHandler = move(a_handler);
+
+	p_Start();
+}
+
+inline void CInprocDataConnection::Impl::SetMessageHandler(MessageReceivedHandler a_handler)
+{
+	m_msgHandler = move(a_handler);
+}
+
+inline void CInprocDataConnection::Impl::p_ReadLoop()
+{
+	CInprocPipe::TQueue l_items;
+
+	while (m_pipe->PopAll(m_side, l_items))
+	{
+		for (CInprocItem &l_item : l_items)
+		{
+			if (l_item.Message)
+			{
+				if (m_msgHandler)
+					m_msgHandler(move(l_item.Message));
+				else
+					cout << "Dropped an in-process message, since there is no handler for it." << endl;
+			}
+			else
+			{
+				m_rcvHandler(move(l_item.Data));
+			}
+		}
+
+		l_items.clear();
+	}
+
+	// The other side closed the connection. This has to be the last thing
+	// the thread does, because closing can release the connection
+	Close();
+}
+
+}
+}
+}
+
+
+
+#endif /* INPROC_DATA_CONNECTION_IMPL_H_ */
@@ -0,0 +1,232 @@
+/*
+ * File description: inproc_data_server_impl.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef INPROC_DATA_SERVER_IMPL_H_
+#define INPROC_DATA_SERVER_IMPL_H_
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include "communication/inproc/inproc_data_server.h"
+
+#include "inproc_data_connection_impl.h"
+
+using namespace std;
+using namespace axon::util;
+
+namespace axon { namespace communication { namespace inproc {
+
+class CInprocServerConnImpl;
+
+class CInprocDataServer::Impl
+{
+private:
+	friend class CInprocServerConnImpl;
+
+	string m_name;
+	CInprocListener::Ptr m_listener;
+
+	ConnectedHandler m_connectedHandler;
+	DisconnectedHandler m_disconnectedHandler;
+
+	mutable mutex m_connLock;
+	unordered_map<CInprocDataConnection*, CInprocDataConnection::Ptr> m_conns;
+
+public:
+	Impl() { }
+	Impl(const string &a_name);
+	~Impl();
+
+	void Startup(const string &a_name);
+
+	string HostString() const { return m_name; }
+
+	void Shutdown();
+
+	size_t NumClients() const;
+
+	void Broadcast(const util::CBuffer &a_buff);
+
+	void SetConnectedHandler(ConnectedHandler a_handler) { m_connectedHandler = move(a_handler); }
+	void SetDisconnectedHandler(DisconnectedHandler a_handler) { m_disconnectedHandler = move(a_handler); }
+
+private:
+	CInprocPipe::Ptr p_Accept();
+	void p_StopListening();
+};
+
+class CInprocServerConnImpl
+	: public CInprocDataConnection::Impl
+{
+private:
+	// Cleared when the server shuts down, since the connection can outlive it
+	mutex m_serverLock;
+	CInprocDataServer::Impl *m_server;
+
+public:
+	CInprocServerConnImpl(CInprocDataServer::Impl *a_server, string a_name, CInprocPipe::Ptr a_pipe)
+		: CInprocDataConnection::Impl(move(a_name), move(a_pipe)),
+		  m_server(a_server)
+	{
+	}
+	~CInprocServerConnImpl()
+	{
+		// The reader thread has to be gone before this part of the object is
+		p_Stop();
+	}
+
+	CInprocDataConnection *Conn = nullptr;
+
+	virtual bool Connect(const string &a_name) override
+	{
+		throw runtime_error("The specified operation is not permitted on server managed connections.");
+	}
+	virtual void Close() override
+	{
+		CInprocDataConnection::Impl::Close();
+
+		IDataConnection::Ptr l_conn;
+		IDataServer::DisconnectedHandler l_handler;
+
+		{
+			lock_guard<mutex> l_serverLock(m_serverLock);
+
+			if (!m_server)
+				return;
+
+			lock_guard<mutex> l_lock(m_server->m_connLock);
+
+			auto iter = m_server->m_conns.find(Conn);
+
+			if (iter == m_server->m_conns.end())
+				return;
+
+			l_conn = iter->second;
+			m_server->m_conns.erase(iter);
+
+			l_handler = m_server->m_disconnectedHandler;
+		}
+
+		if (l_handler)
+			l_handler(l_conn);
+	}
+	virtual bool IsServerClient() const override { return true; }
+
+	void Start()
+	{
+		p_Start();
+	}
+
+	void Detach()
+	{
+		lock_guard<mutex> l_lock(m_serverLock);
+		m_server = nullptr;
+	}
+};
+
+inline CInprocDataServer::Impl::Impl(const string &a_name)
+{
+	Startup(a_name);
+}
+
+inline CInprocDataServer::Impl::~Impl()
+{
+	p_StopListening();
+
+	Shutdown();
+}
+
+inline void CInprocDataServer::Impl::Startup(const string &a_name)
+{
+	if (a_name.empty())
+		throw runtime_error("Invalid in-process server name. It cannot be empty.");
+
+	p_StopListening();
+
+	auto l_listener = make_shared<CInprocListener>();
+	l_listener->Accept = bind(&Impl::p_Accept, this);
+
+	if (!CInprocRegistry::Instance().Add(a_name, l_listener))
+		throw runtime_error("Failed to start the in-process server. Verify that the name is not already in use.");
+
+	m_name = a_name;
+	m_listener = move(l_listener);
+}
+
+inline void CInprocDataServer::Impl::p_StopListening()
+{
+	if (!m_listener)
+		return;
+
+	CInprocRegistry::Instance().Remove(m_name, m_listener.get());
+
+	// Waits for clients that are connecting right now
+	lock_guard<mutex> l_lock(m_listener->Lock);
+	m_listener->Accept = nullptr;
+}
+
+inline void CInprocDataServer::Impl::Shutdown()
+{
+	unordered_map<CInprocDataConnection*, CInprocDataConnection::Ptr> l_conns;
+
+	{
+		lock_guard<mutex> l_lock(m_connLock);
+		l_conns.swap(m_conns);
+	}
+
+	for (const auto &l_pair : l_conns)
+	{
+		((CInprocServerConnImpl*)l_pair.first->GetImpl())->Detach();
+	}
+}
+
+inline size_t CInprocDataServer::Impl::NumClients() const
+{
+	lock_guard<mutex> l_lock(m_connLock);
+	return m_conns.size();
+}
+
+inline void CInprocDataServer::Impl::Broadcast(const util::CBuffer &a_buff)
+{
+	lock_guard<mutex> l_lock(m_connLock);
+	for (const auto &iter : m_conns)
+	{
+		iter.first->Send(a_buff, nullptr);
+	}
+}
+
+inline CInprocPipe::Ptr CInprocDataServer::Impl::p_Accept()
+{
+	auto l_pipe = make_shared<CInprocPipe>();
+
+	unique_ptr<CInprocServerConnImpl> l_impl(new CInprocServerConnImpl(this, m_name, l_pipe));
+
+	auto l_ptr = l_impl.get();
+
+	auto l_conn = make_shared<CInprocDataConnection>(move(l_impl));
+	l_ptr->Conn = l_conn.get();
+
+	{
+		lock_guard<mutex> l_lock(m_connLock);
+		m_conns.insert(make_pair(l_conn.get(), l_conn));
+	}
+
+	if (m_connectedHandler)
+		m_connectedHandler(l_conn);
+
+	l_ptr->Start();
+
+	return l_pipe;
+}
+
+}
+}
+}
+
+
+
+#endif /* INPROC_DATA_SERVER_IMPL_H_ */
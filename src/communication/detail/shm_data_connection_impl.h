@@ -0,0 +1,333 @@
+/*
+ * File description: shm_data_connection_impl.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef SHM_DATA_CONNECTION_IMPL_H_
+#define SHM_DATA_CONNECTION_IMPL_H_
+
+#include <atomic>
+#include <cerrno>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#include <poll.h>
+
+#include "communication/shm/shm_data_connection.h"
+
+#include "shm_ring.h"
+
+using namespace std;
+using namespace axon::util;
+
+namespace axon { namespace communication { namespace shm {
+
+/*
+ * Each connection has a thread that reads from its ring and calls the
+ * receive handler. The thread is started once the connection is open and
+ * a handler has been set, so that nothing is received before there is
+ * somewhere to put it.
+ */
+class CShmDataConnection::Impl
+{
+private:
+	string m_name;
+
+	int m_sock;
+	unique_ptr<CShmSegment> m_segment;
+
+	CShmRing m_rx;
+	CShmRing m_tx;
+
+	DataReceivedHandler m_rcvHandler;
+
+	atomic<bool> m_open;
+
+	mutex m_startLock;
+	thread m_reader;
+
+	mutex m_sendLock;
+
+	// Number of times the reader checks for more data before it goes to
+	// sleep. It doubles whenever data shows up while spinning, and halves
+	// whenever it doesn't
+	size_t m_spin;
+
+public:
+	static const size_t MIN_SPIN = 64;
+	static const size_t MAX_SPIN = 16 * 1024;
+
+	// Largest buffer handed to the receive handler at once
+	static const size_t MAX_READ = 1024 * 1024;
+
+	Impl();
+	Impl(const string &a_name);
+	virtual ~Impl();
+
+	string ConnectionString() const { return m_name; }
+	virtual bool Connect(const string &a_name);
+	virtual void Close();
+	bool IsOpen() const { return m_open; }
+	virtual bool IsServerClient() const { return false; }
+
+	void Send(const CBuffer &a_buff, condition_variable *a_finishEvt);
+
+	void SetReceiveHandler(DataReceivedHandler a_handler);
+
+protected:
+	// Used by the server for the clients it accepts
+	Impl(string a_name, int a_sock, unique_ptr<CShmSegment> a_segment);
+
+	void p_Start();
+	void p_Stop();
+
+private:
+	void p_Attach(int a_sock, unique_ptr<CShmSegment> a_segment, size_t a_rxRing, size_t a_txRing);
+	void p_ReadLoop();
+	bool p_WaitForData();
+	bool p_WaitForSpace();
+	bool p_Poll(int a_evt);
+};
+
+inline CShmDataConnection::Impl::Impl()
+	: m_sock(-1), m_open(false), m_spin(MIN_SPIN)
+{
+}
+
+inline CShmDataConnection::Impl::Impl(const string &a_name)
+	: Impl()
+{
+	if (!Connect(a_name))
+		throw runtime_error("Unable to connect to the specified endpoint.");
+}
+
+inline CShmDataConnection::Impl::Impl(string a_name, int a_sock, unique_ptr<CShmSegment> a_segment)
+	: Impl()
+{
+	m_name = move(a_name);
+
+	p_Attach(a_sock, move(a_segment), CShmSegment::CLIENT_RING, CShmSegment::SERVER_RING);
+}
+
+inline CShmDataConnection::Impl::~Impl()
+{
+	p_Stop();
+}
+
+inline bool CShmDataConnection::Impl::Connect(const string &a_name)
+{
+	sockaddr_un l_address;
+	const int l_addressLen = MakeShmAddress(a_name, l_address);
+
+	p_Stop();
+
+	int l_sock = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (l_sock < 0)
+		return false;
+
+	// Wait for up to 10 seconds for the server to hand over the segment
+	timeval l_timeout{ 10, 0 };
+	setsockopt(l_sock, SOL_SOCKET, SO_RCVTIMEO, &l_timeout, sizeof(l_timeout));
+
+	unique_ptr<CShmSegment> l_segment(new CShmSegment);
+
+	if (connect(l_sock, (const sockaddr*)&l_address, l_addressLen) != 0 ||
+		!ReceiveHandshake(l_sock, *l_segment))
+	{
+		close(l_sock);
+		return false;
+	}
+
+	m_name = a_name;
+
+	p_Attach(l_sock, move(l_segment), CShmSegment::SERVER_RING, CShmSegment::CLIENT_RING);
+
+	p_Start();
+
+	return true;
+}
+
+inline void CShmDataConnection::Impl::p_Attach(int a_sock, unique_ptr<CShmSegment> a_segment,
+		size_t a_rxRing, size_t a_txRing)
+{
+	m_sock = a_sock;
+	m_segment = move(a_segment);
+
+	m_rx = m_segment->Ring(a_rxRing);
+	m_tx = m_segment->Ring(a_txRing);
+
+	m_open = true;
+}
+
+inline void CShmDataConnection::Impl::Close()
+{
+	// Shutting the socket down wakes up both sides
+	if (m_open.exchange(false))
+		shutdown(m_sock, SHUT_RDWR);
+}
+
+inline void CShmDataConnection::Impl::p_Start()
+{
+	lock_guard<mutex> l_lock(m_startLock);
+
+	if (m_open && m_rcvHandler && !m_reader.joinable())
+		m_reader = thread(&Impl::p_ReadLoop, this);
+}
+
+inline void CShmDataConnection::Impl::p_Stop()
+{
+	Impl::Close();
+
+	{
+		lock_guard<mutex> l_lock(m_startLock);
+
+		if (m_reader.joinable())
+		{
+			// The connection can be released by the receive handler
+			if (m_reader.get_id() == this_thread::get_id())
+				m_reader.detach();
+			else
+				m_reader.join();
+		}
+	}
+
+	if (m_sock >= 0)
+	{
+		close(m_sock);
+		m_sock = -1;
+	}
+}
+
+inline void CShmDataConnection::Impl::Send(const CBuffer &a_buff, condition_variable *a_finishEvt)
+{
+	if (a_finishEvt)
+		throw runtime_error("Signaling the end of the send is not currently supported.");
+
+	lock_guard<mutex> l_lock(m_sendLock);
+
+	const char *l_data = a_buff.data();
+	size_t l_left = a_buff.size();
+
+	while (l_left > 0)
+	{
+		const size_t l_written = m_open ? m_tx.Write(l_data, l_left) : 0;
+
+		l_data += l_written;
+		l_left -= l_written;
+
+		// Large buffers go through the ring in pieces, as the other side reads them
+		if (l_left > 0 && l_written == 0 && (!m_open || !p_WaitForSpace()))
+		{
+			cout << "Failed to write shared memory data." << endl;
+			return;
+		}
+	}
+}
+
+inline void CShmDataConnection::Impl::SetReceiveHandler(DataReceivedHandler a_handler)
+{
+	m_rcvHandler = move(a_handler);
+
+	p_Start();
+}
+
+inline void CShmDataConnection::Impl::p_ReadLoop()
+{
+	while (m_open)
+	{
+		const size_t l_avail = m_rx.Available();
+
+		if (l_avail == 0)
+		{
+			if (!p_WaitForData())
+				break;
+
+			continue;
+		}
+
+		CDataBuffer l_buff(min(l_avail, size_t(MAX_READ)));
+
+		m_rx.Read(l_buff.Data(), l_buff.Size());
+
+		m_rcvHandler(move(l_buff));
+	}
+
+	// Also covers the other side going away. This has to be the last thing
+	// the thread does, because closing can release the connection
+	Close();
+}
+
+inline bool CShmDataConnection::Impl::p_WaitForData()
+{
+	for (size_t i = 0; i < m_spin; ++i)
+	{
+		CpuRelax();
+
+		if (m_rx.Available())
+		{
+			m_spin = min(m_spin * 2, size_t(MAX_SPIN));
+			return true;
+		}
+	}
+
+	m_spin = max(m_spin / 2, size_t(MIN_SPIN));
+
+	if (!m_rx.PrepareReaderWait())
+		return true;
+
+	const bool l_peerOpen = p_Poll(m_rx.DataEvent());
+
+	m_rx.EndReaderWait();
+
+	// Whatever was written before the other side closed is still delivered
+	return m_open && (l_peerOpen || m_rx.Available() != 0);
+}
+
+inline bool CShmDataConnection::Impl::p_WaitForSpace()
+{
+	for (size_t i = 0; i < MIN_SPIN; ++i)
+	{
+		CpuRelax();
+
+		if (m_tx.Free())
+			return true;
+	}
+
+	if (!m_tx.PrepareWriterWait())
+		return true;
+
+	const bool l_peerOpen = p_Poll(m_tx.SpaceEvent());
+
+	m_tx.EndWriterWait();
+
+	return m_open && l_peerOpen;
+}
+
+inline bool CShmDataConnection::Impl::p_Poll(int a_evt)
+{
+	pollfd l_fds[2] = {
+		{ a_evt, POLLIN, 0 },
+		{ m_sock, POLLIN, 0 }
+	};
+
+	while (poll(l_fds, 2, -1) < 0)
+	{
+		if (errno != EINTR)
+			return false;
+	}
+
+	// Nothing is sent over the socket after the segment has been handed
+	// over, so it only becomes readable once one of the sides closes it
+	return l_fds[1].revents == 0;
+}
+
+}
+}
+}
+
+
+
+#endif /* SHM_DATA_CONNECTION_IMPL_H_ */
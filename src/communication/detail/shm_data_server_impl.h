@@ -0,0 +1,281 @@
+/*
+ * File description: shm_data_server_impl.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef SHM_DATA_SERVER_IMPL_H_
+#define SHM_DATA_SERVER_IMPL_H_
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <event2/listener.h>
+
+#include "communication/shm/shm_data_server.h"
+
+#include "dispatcher.h"
+#include "shm_data_connection_impl.h"
+
+using namespace std;
+using namespace axon::util;
+
+namespace axon { namespace communication { namespace shm {
+
+class CShmServerConnImpl;
+
+class CShmDataServer::Impl
+{
+private:
+	friend class CShmServerConnImpl;
+
+	typedef unique_ptr<evconnlistener, void(*)(evconnlistener*)> evconnlistener_ptr;
+
+	// Only used to accept clients. Data never goes through the event loop
+	tcp::CDispatcher::Ptr m_dispatcher;
+	evconnlistener_ptr m_listener;
+
+	string m_name;
+	size_t m_ringSize;
+
+	ConnectedHandler m_connectedHandler;
+	DisconnectedHandler m_disconnectedHandler;
+
+	mutable mutex m_connLock;
+	unordered_map<CShmDataConnection*, CShmDataConnection::Ptr> m_conns;
+
+public:
+	Impl();
+	Impl(const string &a_name);
+	~Impl();
+
+	void Startup(const string &a_name);
+
+	string HostString() const { return m_name; }
+
+	void Shutdown();
+
+	size_t NumClients() const;
+
+	void Broadcast(const util::CBuffer &a_buff);
+
+	void SetConnectedHandler(ConnectedHandler a_handler) { m_connectedHandler = move(a_handler); }
+	void SetDisconnectedHandler(DisconnectedHandler a_handler) { m_disconnectedHandler = move(a_handler); }
+
+	size_t RingSize() const { return m_ringSize; }
+	void SetRingSize(size_t a_size);
+
+private:
+	void p_AcceptCallback(evutil_socket_t a_sock);
+
+	static void s_AcceptCallback(evconnlistener *a_listener, evutil_socket_t a_sock,
+			sockaddr *a_address, int a_sockLen, void *a_ptr);
+	static void s_FreeListener(evconnlistener *a_listener);
+};
+
+class CShmServerConnImpl
+	: public CShmDataConnection::Impl
+{
+private:
+	// Cleared when the server shuts down, since the connection can outlive it
+	mutex m_serverLock;
+	CShmDataServer::Impl *m_server;
+
+public:
+	CShmServerConnImpl(CShmDataServer::Impl *a_server, string a_name, int a_sock, unique_ptr<CShmSegment> a_segment)
+		: CShmDataConnection::Impl(move(a_name), a_sock, move(a_segment)),
+		  m_server(a_server)
+	{
+	}
+	~CShmServerConnImpl()
+	{
+		// The reader thread has to be gone before this part of the object is
+		p_Stop();
+	}
+
+	CShmDataConnection *Conn = nullptr;
+
+	virtual bool Connect(const string &a_name) override
+	{
+		throw runtime_error("The specified operation is not permitted on server managed connections.");
+	}
+	virtual void Close() override
+	{
+		CShmDataConnection::Impl::Close();
+
+		IDataConnection::Ptr l_conn;
+		IDataServer::DisconnectedHandler l_handler;
+
+		{
+			lock_guard<mutex> l_serverLock(m_serverLock);
+
+			if (!m_server)
+				return;
+
+			lock_guard<mutex> l_lock(m_server->m_connLock);
+
+			auto iter = m_server->m_conns.find(Conn);
+
+			if (iter == m_server->m_conns.end())
+				return;
+
+			l_conn = iter->second;
+			m_server->m_conns.erase(iter);
+
+			l_handler = m_server->m_disconnectedHandler;
+		}
+
+		cout << "Client Disconnected." << endl;
+
+		if (l_handler)
+			l_handler(l_conn);
+	}
+	virtual bool IsServerClient() const override { return true; }
+
+	void Start()
+	{
+		p_Start();
+	}
+
+	void Detach()
+	{
+		lock_guard<mutex> l_lock(m_serverLock);
+		m_server = nullptr;
+	}
+};
+
+inline CShmDataServer::Impl::Impl()
+	: m_listener(nullptr, s_FreeListener), m_ringSize(DEFAULT_RING_SIZE)
+{
+	m_dispatcher = tcp::CDispatcher::Get(1);
+}
+
+inline CShmDataServer::Impl::Impl(const string &a_name)
+	: Impl()
+{
+	Startup(a_name);
+}
+
+inline CShmDataServer::Impl::~Impl()
+{
+	m_listener.reset();
+
+	Shutdown();
+}
+
+inline void CShmDataServer::Impl::Startup(const string &a_name)
+{
+	sockaddr_un l_address;
+	const int l_addressLen = MakeShmAddress(a_name, l_address);
+
+	m_listener.reset(
+			evconnlistener_new_bind(m_dispatcher->Base(0), s_AcceptCallback, this,
+					LEV_OPT_CLOSE_ON_FREE | LEV_OPT_CLOSE_ON_EXEC, -1,
+					(const sockaddr*)&l_address, l_addressLen)
+	);
+
+	if (!m_listener)
+		throw runtime_error("Failed to start the shared memory server. Verify that the name is not already in use.");
+
+	m_name = a_name;
+}
+
+inline void CShmDataServer::Impl::Shutdown()
+{
+	unordered_map<CShmDataConnection*, CShmDataConnection::Ptr> l_conns;
+
+	{
+		lock_guard<mutex> l_lock(m_connLock);
+		l_conns.swap(m_conns);
+	}
+
+	for (const auto &l_pair : l_conns)
+	{
+		((CShmServerConnImpl*)l_pair.first->GetImpl())->Detach();
+	}
+}
+
+inline size_t CShmDataServer::Impl::NumClients() const
+{
+	lock_guard<mutex> l_lock(m_connLock);
+	return m_conns.size();
+}
+
+inline void CShmDataServer::Impl::Broadcast(const util::CBuffer &a_buff)
+{
+	lock_guard<mutex> l_lock(m_connLock);
+	for (const auto &iter : m_conns)
+	{
+		iter.first->Send(a_buff, nullptr);
+	}
+}
+
+inline void CShmDataServer::Impl::SetRingSize(size_t a_size)
+{
+	if (!CShmSegment::IsValidRingSize(a_size))
+		throw runtime_error("The shared memory ring size must be a power of 2, and at least 4KB.");
+
+	m_ringSize = a_size;
+}
+
+inline void CShmDataServer::Impl::p_AcceptCallback(evutil_socket_t a_sock)
+{
+	unique_ptr<CShmSegment> l_segment(new CShmSegment);
+
+	try
+	{
+		int l_memFd = l_segment->Create(m_ringSize);
+
+		const bool l_sent = SendHandshake(a_sock, l_memFd, *l_segment);
+
+		close(l_memFd);
+
+		if (!l_sent)
+			throw runtime_error("Failed to send the shared memory segment to the client.");
+	}
+	catch (exception &ex)
+	{
+		cout << ex.what() << endl;
+		close(a_sock);
+		return;
+	}
+
+	unique_ptr<CShmServerConnImpl> l_impl(new CShmServerConnImpl(this, m_name, a_sock, move(l_segment)));
+
+	auto l_ptr = l_impl.get();
+
+	auto l_conn = make_shared<CShmDataConnection>(move(l_impl));
+	l_ptr->Conn = l_conn.get();
+
+	{
+		lock_guard<mutex> l_lock(m_connLock);
+		m_conns.insert(make_pair(l_conn.get(), l_conn));
+	}
+
+	cout << "Client Connected." << endl;
+
+	if (m_connectedHandler)
+		m_connectedHandler(l_conn);
+
+	l_ptr->Start();
+}
+
+inline void CShmDataServer::Impl::s_AcceptCallback(evconnlistener *a_listener,
+		evutil_socket_t a_sock, sockaddr *a_address, int a_sockLen, void *a_ptr)
+{
+	((Impl*)a_ptr)->p_AcceptCallback(a_sock);
+}
+
+inline void CShmDataServer::Impl::s_FreeListener(evconnlistener *a_listener)
+{
+	evconnlistener_free(a_listener);
+}
+
+}
+}
+}
+
+
+
+#endif /* SHM_DATA_SERVER_IMPL_H_ */
@@ -0,0 +1,474 @@
+/*
+ * File description: shm_ring.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef SHM_RING_H_
+#define SHM_RING_H_
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+#include <thread>
+
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace axon { namespace communication { namespace shm {
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+		"The shared memory transport needs atomics that work across processes.");
+
+inline void CpuRelax()
+{
+#ifdef __SSE2__
+	_mm_pause();
+#else
+	std::this_thread::yield();
+#endif
+}
+
+// Control block at the start of each ring. The positions only ever grow,
+// so the amount of data in the ring is Head - Tail. The writer and the
+// reader each get their own cache line
+struct CShmRingHeader
+{
+	alignas(64) std::atomic<uint64_t> Head;
+	std::atomic<uint32_t> WriterWaiting;
+
+	alignas(64) std::atomic<uint64_t> Tail;
+	std::atomic<uint32_t> ReaderWaiting;
+};
+
+/*
+ * Single producer, single consumer byte ring in shared memory. Reads and
+ * writes never block, and only signal the event of the other side when it
+ * said it was going to sleep, so that a busy ring doesn't make a system
+ * call per message.
+ *
+ * To sleep, a side calls Prepare*Wait, and only blocks on its event if that
+ * returns true. Once it wakes up (or doesn't need to), it calls End*Wait.
+ */
+class CShmRing
+{
+private:
+	CShmRingHeader *m_header;
+	char *m_data;
+	uint64_t m_mask;
+
+	// Signaled by the writer when there is data, and by the reader when
+	// there is space
+	int m_dataEvt;
+	int m_spaceEvt;
+
+public:
+	CShmRing()
+		: m_header(nullptr), m_data(nullptr), m_mask(0), m_dataEvt(-1), m_spaceEvt(-1) { }
+	CShmRing(CShmRingHeader *a_header, char *a_data, uint64_t a_capacity, int a_dataEvt, int a_spaceEvt)
+		: m_header(a_header), m_data(a_data), m_mask(a_capacity - 1),
+		  m_dataEvt(a_dataEvt), m_spaceEvt(a_spaceEvt) { }
+
+	uint64_t Capacity() const { return m_mask + 1; }
+
+	int DataEvent() const { return m_dataEvt; }
+	int SpaceEvent() const { return m_spaceEvt; }
+
+	size_t Available() const
+	{
+		return size_t(m_header->Head.load(std::memory_order_acquire) -
+				m_header->Tail.load(std::memory_order_relaxed));
+	}
+
+	size_t Free() const
+	{
+		return size_t(Capacity() - (m_header->Head.load(std::memory_order_relaxed) -
+				m_header->Tail.load(std::memory_order_acquire)));
+	}
+
+	// Writes as much of the data as fits, and returns how much that was
+	size_t Write(const char *a_data, size_t a_size)
+	{
+		const uint64_t l_head = m_header->Head.load(std::memory_order_relaxed);
+		const uint64_t l_tail = m_header->Tail.load(std::memory_order_acquire);
+
+		const size_t l_size = std::min<uint64_t>(a_size, Capacity() - (l_head - l_tail));
+
+		if (l_size == 0)
+			return 0;
+
+		p_Copy(m_data, l_head, a_data, l_size);
+
+		m_header->Head.store(l_head + l_size, std::memory_order_release);
+
+		p_Signal(m_header->ReaderWaiting, m_dataEvt);
+
+		return l_size;
+	}
+
+	// Reads up to a_size bytes, and returns how many there were
+	size_t Read(char *a_data, size_t a_size)
+	{
+		const uint64_t l_tail = m_header->Tail.load(std::memory_order_relaxed);
+		const uint64_t l_head = m_header->Head.load(std::memory_order_acquire);
+
+		const size_t l_size = std::min<uint64_t>(a_size, l_head - l_tail);
+
+		if (l_size == 0)
+			return 0;
+
+		const uint64_t l_offset = l_tail & m_mask;
+		const size_t l_first = std::min<uint64_t>(l_size, Capacity() - l_offset);
+
+		memcpy(a_data, m_data + l_offset, l_first);
+		memcpy(a_data + l_first, m_data, l_size - l_first);
+
+		m_header->Tail.store(l_tail + l_size, std::memory_order_release);
+
+		p_Signal(m_header->WriterWaiting, m_spaceEvt);
+
+		return l_size;
+	}
+
+	bool PrepareReaderWait() { return p_PrepareWait(m_header->ReaderWaiting, [this] { return Available() == 0; }); }
+	void EndReaderWait() { p_EndWait(m_header->ReaderWaiting, m_dataEvt); }
+
+	bool PrepareWriterWait() { return p_PrepareWait(m_header->WriterWaiting, [this] { return Free() == 0; }); }
+	void EndWriterWait() { p_EndWait(m_header->WriterWaiting, m_spaceEvt); }
+
+private:
+	void p_Copy(char *a_ring, uint64_t a_pos, const char *a_data, size_t a_size)
+	{
+		const uint64_t l_offset = a_pos & m_mask;
+		const size_t l_first = std::min<uint64_t>(a_size, Capacity() - l_offset);
+
+		memcpy(a_ring + l_offset, a_data, l_first);
+		memcpy(a_ring, a_data + l_first, a_size - l_first);
+	}
+
+	// The fences pair with the ones in p_PrepareWait, so that either the
+	// waiting side sees the new position, or this side sees the flag
+	static void p_Signal(std::atomic<uint32_t> &a_waiting, int a_evt)
+	{
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (a_waiting.load(std::memory_order_relaxed) &&
+			a_waiting.exchange(0, std::memory_order_acq_rel))
+		{
+			eventfd_write(a_evt, 1);
+		}
+	}
+
+	template<typename Pred>
+	static bool p_PrepareWait(std::atomic<uint32_t> &a_waiting, Pred a_stillBlocked)
+	{
+		a_waiting.store(1, std::memory_order_relaxed);
+
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		if (a_stillBlocked())
+			return true;
+
+		a_waiting.store(0, std::memory_order_relaxed);
+		return false;
+	}
+
+	static void p_EndWait(std::atomic<uint32_t> &a_waiting, int a_evt)
+	{
+		a_waiting.store(0, std::memory_order_relaxed);
+
+		// The event is non-blocking, so this only clears a pending signal
+		eventfd_t l_val;
+		eventfd_read(a_evt, &l_val);
+	}
+};
+
+/*
+ * The memory and events that a client and the server share. The segment
+ * holds two rings, one for each direction, and is created by the server
+ * for every client that connects.
+ */
+class CShmSegment
+{
+public:
+	static const size_t NUM_EVENTS = 4;
+
+	// The ring the client writes to. The other one is written by the server
+	static const size_t CLIENT_RING = 0;
+	static const size_t SERVER_RING = 1;
+
+private:
+	void *m_base;
+	size_t m_size;
+	uint64_t m_ringSize;
+	int m_evts[NUM_EVENTS];
+
+public:
+	CShmSegment()
+		: m_base(MAP_FAILED), m_size(0), m_ringSize(0)
+	{
+		for (int &l_evt : m_evts)
+			l_evt = -1;
+	}
+	~CShmSegment()
+	{
+		if (m_base != MAP_FAILED)
+			munmap(m_base, m_size);
+
+		for (int l_evt : m_evts)
+		{
+			if (l_evt >= 0)
+				close(l_evt);
+		}
+	}
+
+	CShmSegment(const CShmSegment &) = delete;
+	CShmSegment &operator=(const CShmSegment &) = delete;
+
+	uint64_t RingSize() const { return m_ringSize; }
+	const int *Events() const { return m_evts; }
+
+	/*
+	 * Creates a new segment with rings of the given size. Returns the file
+	 * descriptor of the memory, which the caller has to close once it has
+	 * been passed on to the client.
+	 */
+	int Create(uint64_t a_ringSize)
+	{
+		if (!IsValidRingSize(a_ringSize))
+			throw std::runtime_error("The shared memory ring size must be a power of 2, and at least 4KB.");
+
+		int l_fd = memfd_create("axon-shm", MFD_CLOEXEC);
+
+		if (l_fd < 0)
+			throw std::runtime_error("Failed to create the shared memory segment.");
+
+		try
+		{
+			if (ftruncate(l_fd, off_t(CalcSize(a_ringSize))) != 0)
+				throw std::runtime_error("Failed to size the shared memory segment.");
+
+			p_Map(l_fd, a_ringSize);
+
+			for (size_t i = 0; i < 2; ++i)
+			{
+				new (p_Header(i)) CShmRingHeader();
+			}
+
+			for (int &l_evt : m_evts)
+			{
+				l_evt = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+				if (l_evt < 0)
+					throw std::runtime_error("Failed to create the shared memory events.");
+			}
+		}
+		catch (...)
+		{
+			close(l_fd);
+			throw;
+		}
+
+		return l_fd;
+	}
+
+	/*
+	 * Maps a segment that was created by the server. Takes ownership of
+	 * the events, and closes the memory descriptor.
+	 */
+	void Attach(int a_fd, uint64_t a_ringSize, const int *a_evts)
+	{
+		for (size_t i = 0; i < NUM_EVENTS; ++i)
+			m_evts[i] = a_evts[i];
+
+		try
+		{
+			if (!IsValidRingSize(a_ringSize))
+				throw std::runtime_error("Invalid shared memory ring size.");
+
+			// Otherwise touching the rings past the end of the memory
+			// faults, instead of failing here
+			struct stat l_stat;
+
+			if (fstat(a_fd, &l_stat) != 0 || l_stat.st_size < 0 ||
+				a_ringSize > uint64_t(l_stat.st_size) / 2 ||
+				CalcSize(a_ringSize) > uint64_t(l_stat.st_size))
+				throw std::runtime_error("The shared memory segment is smaller than its rings.");
+
+			p_Map(a_fd, a_ringSize);
+		}
+		catch (...)
+		{
+			close(a_fd);
+			throw;
+		}
+
+		close(a_fd);
+	}
+
+	// Each ring has a data and a space event
+	CShmRing Ring(size_t a_idx) const
+	{
+		return CShmRing(p_Header(a_idx), (char*)p_Header(a_idx) + sizeof(CShmRingHeader),
+				m_ringSize, m_evts[a_idx * 2], m_evts[a_idx * 2 + 1]);
+	}
+
+	static bool IsValidRingSize(uint64_t a_ringSize)
+	{
+		return a_ringSize >= 4096 && (a_ringSize & (a_ringSize - 1)) == 0;
+	}
+
+	static size_t CalcSize(uint64_t a_ringSize)
+	{
+		return 2 * (sizeof(CShmRingHeader) + a_ringSize);
+	}
+
+private:
+	void p_Map(int a_fd, uint64_t a_ringSize)
+	{
+		const size_t l_size = CalcSize(a_ringSize);
+
+		m_base = mmap(nullptr, l_size, PROT_READ | PROT_WRITE, MAP_SHARED, a_fd, 0);
+
+		if (m_base == MAP_FAILED)
+			throw std::runtime_error("Failed to map the shared memory segment.");
+
+		m_size = l_size;
+		m_ringSize = a_ringSize;
+	}
+
+	CShmRingHeader *p_Header(size_t a_idx) const
+	{
+		return (CShmRingHeader*)((char*)m_base + a_idx * (sizeof(CShmRingHeader) + m_ringSize));
+	}
+};
+
+// Clients find the server through a socket in the abstract namespace,
+// which is also used to notice when the other side goes away
+inline int MakeShmAddress(const std::string &a_name, sockaddr_un &a_address)
+{
+	static const char s_prefix[] = "axon-shm/";
+
+	memset(&a_address, 0, sizeof(a_address));
+	a_address.sun_family = AF_UNIX;
+
+	// The leading null character is what makes the socket abstract
+	const size_t l_len = 1 + sizeof(s_prefix) - 1 + a_name.size();
+
+	if (a_name.empty() || l_len > sizeof(a_address.sun_path))
+		throw std::runtime_error("Invalid shared memory name. It must have between 1 and " +
+				std::to_string(sizeof(a_address.sun_path) - sizeof(s_prefix)) + " characters.");
+
+	memcpy(a_address.sun_path + 1, s_prefix, sizeof(s_prefix) - 1);
+	memcpy(a_address.sun_path + sizeof(s_prefix), a_name.data(), a_name.size());
+
+	return int(offsetof(sockaddr_un, sun_path) + l_len);
+}
+
+// Sent by the server along with the descriptors of the segment
+struct CShmHandshake
+{
+	static const uint32_t MAGIC = 0x6D687341; // "Ashm"
+	static const uint32_t VERSION = 1;
+
+	uint32_t Magic;
+	uint32_t Version;
+	uint64_t RingSize;
+};
+
+inline bool SendHandshake(int a_sock, int a_memFd, const CShmSegment &a_segment)
+{
+	CShmHandshake l_hs{ CShmHandshake::MAGIC, CShmHandshake::VERSION, a_segment.RingSize() };
+
+	int l_fds[1 + CShmSegment::NUM_EVENTS];
+	l_fds[0] = a_memFd;
+	memcpy(l_fds + 1, a_segment.Events(), sizeof(int) * CShmSegment::NUM_EVENTS);
+
+	char l_ctrl[CMSG_SPACE(sizeof(l_fds))];
+	memset(l_ctrl, 0, sizeof(l_ctrl));
+
+	iovec l_iov{ &l_hs, sizeof(l_hs) };
+
+	msghdr l_msg;
+	memset(&l_msg, 0, sizeof(l_msg));
+	l_msg.msg_iov = &l_iov;
+	l_msg.msg_iovlen = 1;
+	l_msg.msg_control = l_ctrl;
+	l_msg.msg_controllen = sizeof(l_ctrl);
+
+	cmsghdr *l_cmsg = CMSG_FIRSTHDR(&l_msg);
+	l_cmsg->cmsg_level = SOL_SOCKET;
+	l_cmsg->cmsg_type = SCM_RIGHTS;
+	l_cmsg->cmsg_len = CMSG_LEN(sizeof(l_fds));
+	memcpy(CMSG_DATA(l_cmsg), l_fds, sizeof(l_fds));
+
+	return sendmsg(a_sock, &l_msg, MSG_NOSIGNAL) == ssize_t(sizeof(l_hs));
+}
+
+inline bool ReceiveHandshake(int a_sock, CShmSegment &a_segment)
+{
+	CShmHandshake l_hs;
+
+	int l_fds[1 + CShmSegment::NUM_EVENTS];
+
+	char l_ctrl[CMSG_SPACE(sizeof(l_fds))];
+
+	iovec l_iov{ &l_hs, sizeof(l_hs) };
+
+	msghdr l_msg;
+	memset(&l_msg, 0, sizeof(l_msg));
+	l_msg.msg_iov = &l_iov;
+	l_msg.msg_iovlen = 1;
+	l_msg.msg_control = l_ctrl;
+	l_msg.msg_controllen = sizeof(l_ctrl);
+
+	const ssize_t l_read = recvmsg(a_sock, &l_msg, MSG_CMSG_CLOEXEC | MSG_WAITALL);
+
+	cmsghdr *l_cmsg = l_read > 0 ? CMSG_FIRSTHDR(&l_msg) : nullptr;
+
+	if (!l_cmsg || l_cmsg->cmsg_level != SOL_SOCKET || l_cmsg->cmsg_type != SCM_RIGHTS)
+		return false;
+
+	const size_t l_numFds = (l_cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+
+	memcpy(l_fds, CMSG_DATA(l_cmsg), std::min(l_numFds, sizeof(l_fds) / sizeof(int)) * sizeof(int));
+
+	if (l_numFds != sizeof(l_fds) / sizeof(int) || l_read != ssize_t(sizeof(l_hs)) ||
+		l_hs.Magic != CShmHandshake::MAGIC || l_hs.Version != CShmHandshake::VERSION)
+	{
+		for (size_t i = 0; i < std::min(l_numFds, sizeof(l_fds) / sizeof(int)); ++i)
+			close(l_fds[i]);
+
+		return false;
+	}
+
+	// The segment owns the descriptors from here on, even when the peer
+	// sent a ring size that it can't map
+	try
+	{
+		a_segment.Attach(l_fds[0], l_hs.RingSize, l_fds + 1);
+	}
+	catch (std::exception &)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+} } }
+
+#endif /* SHM_RING_H_ */
@@ -10,6 +10,8 @@
 #include <chrono>
 
 #include "communication/tcp/tcp_data_connection.h"
+#include "communication/tcp/socket_options.h"
+#include "communication/tcp/send_limits.h"
 
 #include "dispatcher.h"
 
@@ -45,13 +47,26 @@ private:
 
 	DataReceivedHandler m_rcvHandler;
 
+	CSocketOptions m_options;
+
 	//condition_variable *m_var;
 
 	atomic<bool> m_open;
 	mutex m_openLock;
 	condition_variable m_openCV;
 
-	mutex m_sendLock;
+	// Guarded by the bufferevent lock, which the sends also go through
+	CSendLimits m_sendLimits;
+
+	// Set when a send runs into the high water mark, and cleared by the
+	// event thread once the peer has drained the data to the low water mark.
+	// Both happen under the bufferevent lock
+	atomic<bool> m_backedUp;
+	mutex m_writableLock;
+	condition_variable m_writableCV;
+	WritableHandler m_writableHandler;
+
+	atomic<size_t> m_numDropped;
 
 protected:
 	atomic<size_t> m_procTime;
@@ -72,9 +87,22 @@ public:
 	virtual bool IsServerClient() const { return false; }
 
 	void Send(const CBuffer &a_buff, condition_variable *a_finishEvt);
+	bool SendDroppable(const CBuffer &a_buff);
+	void CheckSend();
+	void SendChecked(const CBuffer &a_buff);
+	bool WaitForSendQueue(size_t a_size);
+	bool CanWaitForSendQueue() const;
 
 	void SetReceiveHandler(DataReceivedHandler a_handler);
 
+	const CSocketOptions &SocketOptions() const { return m_options; }
+	void SetSocketOptions(const CSocketOptions &a_options);
+
+	CSendLimits SendLimits() const;
+	void SetSendLimits(const CSendLimits &a_limits);
+	void SetWritableHandler(WritableHandler a_handler);
+	size_t NumDropped() const { return m_numDropped; }
+
 	bufferevent *GetBufferEvent() const { return m_evt.get(); }
 
 	size_t GetProcTime() const { return m_procTime; }
@@ -82,20 +110,42 @@ public:
 	void ResetProcTime() { m_procTime = size_t(0); }
 
 protected:
-	Impl(string a_hostName, int a_port, CDispatcher::Ptr a_dispatcher);
+	Impl(string a_hostName, int a_port, CDispatcher::Ptr a_dispatcher, const CSocketOptions &a_options);
 
 	void p_SetBufferEvent(bufferevent_ptr a_evt);
 
+	// Data can be sent as soon as the bufferevent is attached, but nothing
+	// is received until it is hooked up
+	void p_AttachBufferEvent(bufferevent_ptr a_evt);
+	void p_HookupEvt();
+
+	// Connects to an address that doesn't need to be resolved
+	bool p_Connect(const sockaddr *a_address, int a_addressLen);
+
 	virtual void UpdateProcTime(const dirus &a_dur);
 
 
 
 private:
+	// What a send does once the connection is full, on top of the policy.
+	// Droppable sends can be discarded, and checked sends are never refused
+	enum class SendMode
+	{
+		Normal,
+		Droppable,
+		Checked,
+	};
+
 	void p_WriteCallback(bufferevent *a_evt);
 	void p_ReadCallback(bufferevent *a_evt);
 	void p_EventCallback(bufferevent *a_evt, short a_flags);
-	void p_HookupEvt();
 	void p_UnhookEvt();
+	bool p_WaitForOpen(unique_lock<mutex> &a_lock);
+	bool p_Send(const CBuffer &a_buff, SendMode a_mode);
+	bool p_WaitWritable();
+	void p_ApplyWaterMark();
+	void p_LockEvt() const;
+	void p_UnlockEvt() const;
 
 	static void s_WriteCallback(bufferevent *a_evt, void *a_ptr);
 	static void s_ReadCallback(bufferevent *a_evt, void *a_ptr);
@@ -105,11 +155,13 @@ private:
 
 
 inline CTcpDataConnection::Impl::Impl()
-	: m_port(-1), m_open(false), m_evt(nullptr, s_FreeBuffEvt), m_procTime(0)
+	: m_port(-1), m_open(false), m_evt(nullptr, s_FreeBuffEvt), m_backedUp(false), m_numDropped(0),
+	  m_procTime(0)
 {
 	m_disp = CDispatcher::Get(1);
 
-	auto l_evt = bufferevent_socket_new(m_disp->Base(), -1, BEV_OPT_CLOSE_ON_FREE);
+	// Sends check the output and write to it under the bufferevent lock
+	auto l_evt = bufferevent_socket_new(m_disp->Base(), -1, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE);
 	m_evt.reset(l_evt);
 
 	p_HookupEvt();
@@ -129,9 +181,11 @@ inline CTcpDataConnection::Impl::Impl(string a_hostName, int a_port)
 		throw runtime_error("Unable to connect to the specified endpoint.");
 }
 
-inline CTcpDataConnection::Impl::Impl(string a_hostName, int a_port, CDispatcher::Ptr a_dispatcher)
+inline CTcpDataConnection::Impl::Impl(string a_hostName, int a_port, CDispatcher::Ptr a_dispatcher,
+		const CSocketOptions &a_options)
 	: m_port(a_port), m_open(true), m_hostName(move(a_hostName)), m_evt(nullptr, s_FreeBuffEvt),
-	  m_disp(move(a_dispatcher)), m_procTime(0)
+	  m_disp(move(a_dispatcher)), m_options(a_options), m_backedUp(false), m_numDropped(0),
+	  m_procTime(0)
 {
 }
 
@@ -142,15 +196,22 @@ inline CTcpDataConnection::Impl::~Impl()
 
 inline void CTcpDataConnection::Impl::p_SetBufferEvent(bufferevent_ptr a_evt)
 {
-	m_evt = move(a_evt);
+	p_AttachBufferEvent(move(a_evt));
 
 	p_HookupEvt();
 }
 
+inline void CTcpDataConnection::Impl::p_AttachBufferEvent(bufferevent_ptr a_evt)
+{
+	m_evt = move(a_evt);
+}
+
 inline void CTcpDataConnection::Impl::p_HookupEvt()
 {
 	bufferevent_setcb(m_evt.get(), s_ReadCallback, s_WriteCallback, s_EventCallback, this);
 	bufferevent_enable(m_evt.get(), EV_READ|EV_WRITE);
+
+	p_ApplyWaterMark();
 }
 
 inline void CTcpDataConnection::Impl::p_UnhookEvt()
@@ -161,19 +222,25 @@ inline void CTcpDataConnection::Impl::p_UnhookEvt()
 
 inline string CTcpDataConnection::Impl::ConnectionString() const
 {
+	// Local connections don't have a port
+	if (m_port < 0)
+		return m_hostName;
+
 	return m_hostName + ":" + ToString(m_port);
 }
 
 inline bool CTcpDataConnection::Impl::Connect(const string& a_connectionString)
 {
-	size_t l_colIdx = a_connectionString.find(':');
+	const string l_address = CSocketOptions::Split(a_connectionString, m_options);
+
+	size_t l_colIdx = l_address.find(':');
 
 	if (l_colIdx == string::npos)
-		throw runtime_error("Invalid TCP connection string. Must be of format [host name]:[port]");
+		throw runtime_error("Invalid TCP connection string. Must be of format [host name]:[port][?options]");
 
-	string l_hostName = a_connectionString.substr(0, l_colIdx);
+	string l_hostName = l_address.substr(0, l_colIdx);
 
-	int l_port = StringTo<int>(a_connectionString.substr(l_colIdx + 1));
+	int l_port = StringTo<int>(l_address.substr(l_colIdx + 1));
 
 	return Connect(move(l_hostName), l_port);
 }
@@ -188,15 +255,7 @@ inline bool CTcpDataConnection::Impl::Connect(string a_hostName, int a_port)
 	if (l_err)
 		return false;
 
-	// Wait for up to 10 seconds for the connection to open
-	bool l_conn =
-			m_openCV.wait_for(l_lock, chrono::seconds(10),
-					[this] () -> bool
-					{
-						return m_open;
-					});
-
-	if (!l_conn)
+	if (!p_WaitForOpen(l_lock))
 		return false;
 
 	m_hostName = move(a_hostName);
@@ -205,9 +264,37 @@ inline bool CTcpDataConnection::Impl::Connect(string a_hostName, int a_port)
 	return true;
 }
 
+inline bool CTcpDataConnection::Impl::p_Connect(const sockaddr *a_address, int a_addressLen)
+{
+	unique_lock<mutex> l_lock(m_openLock);
+
+	int l_err = bufferevent_socket_connect(m_evt.get(), const_cast<sockaddr*>(a_address), a_addressLen);
+
+	if (l_err)
+		return false;
+
+	return p_WaitForOpen(l_lock);
+}
+
+inline bool CTcpDataConnection::Impl::p_WaitForOpen(unique_lock<mutex> &a_lock)
+{
+	// Wait for up to 10 seconds for the connection to open
+	return m_openCV.wait_for(a_lock, chrono::seconds(10),
+					[this] () -> bool
+					{
+						return m_open;
+					});
+}
+
 inline void CTcpDataConnection::Impl::Close()
 {
 	m_open = false;
+
+	// Senders that are waiting on the peer give up
+	{
+		lock_guard<mutex> l_lock(m_writableLock);
+	}
+	m_writableCV.notify_all();
 }
 
 inline bool CTcpDataConnection::Impl::IsOpen() const
@@ -220,14 +307,163 @@ inline void CTcpDataConnection::Impl::Send(const CBuffer& a_buff, condition_vari
 	if (a_finishEvt)
 	    throw runtime_error("Signaling the end of the send is not currently supported.");
 
-	int l_ret;
+	p_Send(a_buff, SendMode::Normal);
+}
+
+inline bool CTcpDataConnection::Impl::SendDroppable(const CBuffer& a_buff)
+{
+	return p_Send(a_buff, SendMode::Droppable);
+}
+
+inline void CTcpDataConnection::Impl::CheckSend()
+{
+	bufferevent *l_evt = m_evt.get();
+
+	bufferevent_lock(l_evt);
+
+	// Any data at all would take it past the mark
+	const size_t l_waiting = evbuffer_get_length(bufferevent_get_output(l_evt));
+
+	const bool l_full = m_sendLimits.HighWaterMark != 0 && l_waiting > 0 &&
+						l_waiting >= m_sendLimits.HighWaterMark;
+
+	const bool l_refuse = l_full && m_sendLimits.Policy == BackpressurePolicy::Fail;
+
+	// Like a send that was refused, so the writable handler runs once the
+	// peer has caught up
+	if (l_refuse)
+		m_backedUp = true;
+
+	bufferevent_unlock(l_evt);
+
+	if (l_refuse)
+		throw runtime_error("Unable to send. The connection has more data waiting for the peer than its high water mark allows.");
+}
+
+inline void CTcpDataConnection::Impl::SendChecked(const CBuffer& a_buff)
+{
+	p_Send(a_buff, SendMode::Checked);
+}
+
+inline bool CTcpDataConnection::Impl::p_Send(const CBuffer& a_buff, SendMode a_mode)
+{
+	bufferevent *l_evt = m_evt.get();
+
+	while (true)
+	{
+		// The event thread drains the output and clears the flag under the
+		// same lock, so neither can be missed in between
+		bufferevent_lock(l_evt);
+
+		const size_t l_waiting = evbuffer_get_length(bufferevent_get_output(l_evt));
+
+		const bool l_full = m_sendLimits.HighWaterMark != 0 && l_waiting > 0 &&
+							l_waiting + a_buff.size() > m_sendLimits.HighWaterMark;
+
+		BackpressurePolicy l_policy = m_sendLimits.Policy;
+
+		int l_ret = 0;
+
+		if (l_full)
+			m_backedUp = true;
+		else
+			l_ret = bufferevent_write(l_evt, a_buff.data(), a_buff.size());
+
+		bufferevent_unlock(l_evt);
+
+		if (!l_full)
+		{
+			if (l_ret != 0)
+				cout << "Failed to write socket data." << endl;
+
+			return l_ret == 0;
+		}
+
+		if (l_policy == BackpressurePolicy::Drop)
+		{
+			if (a_mode == SendMode::Droppable)
+			{
+				++m_numDropped;
+				return false;
+			}
+
+			l_policy = BackpressurePolicy::Block;
+		}
+
+		if (l_policy == BackpressurePolicy::Fail && a_mode != SendMode::Checked)
+			throw runtime_error("Unable to send. The connection has more data waiting for the peer than its high water mark allows.");
+
+		// The event thread can't wait for itself, or for a thread that might be
+		// waiting on it, so the data is queued past the mark. So is data that
+		// CheckSend let through, rather than failing it after all
+		if (l_policy == BackpressurePolicy::Fail || CDispatcher::InEventThread())
+		{
+			if (bufferevent_write(l_evt, a_buff.data(), a_buff.size()) != 0)
+			{
+				cout << "Failed to write socket data." << endl;
+				return false;
+			}
+			return true;
+		}
+
+		if (!p_WaitWritable())
+		{
+			cout << "Failed to write socket data." << endl;
+			return false;
+		}
+	}
+}
+
+inline bool CTcpDataConnection::Impl::WaitForSendQueue(size_t a_size)
+{
+	// The event thread is the one that drains the queue
+	if (CDispatcher::InEventThread())
+		return m_open;
+
+	bufferevent *l_evt = m_evt.get();
+
+	while (m_open)
 	{
-	    lock_guard<mutex> l_lock(m_sendLock);
-	    l_ret = bufferevent_write(m_evt.get(), a_buff.data(), a_buff.size());
+		bufferevent_lock(l_evt);
+
+		// Connections that fail sends instead of blocking them don't wait
+		// here either. Their fragments go out until the high water mark
+		const bool l_noWait = m_sendLimits.HighWaterMark != 0 &&
+							  m_sendLimits.Policy == BackpressurePolicy::Fail;
+
+		const bool l_full = !l_noWait && evbuffer_get_length(bufferevent_get_output(l_evt)) > a_size;
+
+		if (l_full)
+			m_backedUp = true;
+
+		bufferevent_unlock(l_evt);
+
+		if (!l_full)
+			return true;
+
+		p_WaitWritable();
 	}
 
-	if (l_ret != 0)
-		cout << "Failed to write socket data." << endl;
+	return false;
+}
+
+inline bool CTcpDataConnection::Impl::CanWaitForSendQueue() const
+{
+	return !CDispatcher::InEventThread();
+}
+
+inline bool CTcpDataConnection::Impl::p_WaitWritable()
+{
+	// Until the write callback has seen the output drain to the low water
+	// mark, or the connection closes
+	unique_lock<mutex> l_lock(m_writableLock);
+	m_writableCV.wait(l_lock,
+				[this] () -> bool
+				{
+					return !m_backedUp || !m_open;
+				});
+
+	return m_open;
 }
 
 inline void CTcpDataConnection::Impl::SetReceiveHandler(DataReceivedHandler a_handler)
@@ -235,9 +471,79 @@ inline void CTcpDataConnection::Impl::SetReceiveHandler(DataReceivedHandler a_ha
 	m_rcvHandler = move(a_handler);
 }
 
+inline void CTcpDataConnection::Impl::SetSocketOptions(const CSocketOptions &a_options)
+{
+	// The event thread reads them while the connection is open
+	if (m_open)
+		throw runtime_error("The socket options can only be changed before the connection is opened.");
+
+	m_options = a_options;
+}
+
+inline CSendLimits CTcpDataConnection::Impl::SendLimits() const
+{
+	p_LockEvt();
+	CSendLimits l_ret = m_sendLimits;
+	p_UnlockEvt();
+
+	return l_ret;
+}
+
+inline void CTcpDataConnection::Impl::SetSendLimits(const CSendLimits& a_limits)
+{
+	if (a_limits.HighWaterMark != 0 && a_limits.LowWaterMark >= a_limits.HighWaterMark)
+		throw runtime_error("The low water mark has to be below the high water mark.");
+
+	p_LockEvt();
+	m_sendLimits = a_limits;
+	p_ApplyWaterMark();
+	p_UnlockEvt();
+}
+
+inline void CTcpDataConnection::Impl::SetWritableHandler(WritableHandler a_handler)
+{
+	p_LockEvt();
+	m_writableHandler = move(a_handler);
+	p_UnlockEvt();
+}
+
+inline void CTcpDataConnection::Impl::p_ApplyWaterMark()
+{
+	// Server connections don't have their bufferevent right away, and pick
+	// the limits up once they do
+	if (!m_evt)
+		return;
+
+	// The write callback runs once the output has drained to the low mark
+	bufferevent_setwatermark(m_evt.get(), EV_WRITE, m_sendLimits.LowWaterMark, 0);
+}
+
+inline void CTcpDataConnection::Impl::p_LockEvt() const
+{
+	if (m_evt)
+		bufferevent_lock(m_evt.get());
+}
+
+inline void CTcpDataConnection::Impl::p_UnlockEvt() const
+{
+	if (m_evt)
+		bufferevent_unlock(m_evt.get());
+}
+
 inline void CTcpDataConnection::Impl::p_WriteCallback(bufferevent* a_evt)
 {
-	// TODO: Determine if the write finished
+	// Runs whenever the output drains to the low water mark. Only matters
+	// when a send ran into the high water mark since the last time
+	if (!m_backedUp.exchange(false))
+		return;
+
+	{
+		lock_guard<mutex> l_lock(m_writableLock);
+	}
+	m_writableCV.notify_all();
+
+	if (m_writableHandler)
+		m_writableHandler();
 }
 
 inline void CTcpDataConnection::Impl::p_ReadCallback(bufferevent* a_evt)
@@ -246,6 +552,8 @@ inline void CTcpDataConnection::Impl::p_ReadCallback(bufferevent* a_evt)
 
 	evbuffer *l_input = bufferevent_get_input(a_evt);
 
+	m_options.RearmQuickAck(bufferevent_getfd(a_evt));
+
 	const size_t l_size = 1024 * 1024;
 	CDataBuffer l_buff(l_size);
 
@@ -282,6 +590,8 @@ inline void CTcpDataConnection::Impl::p_EventCallback(bufferevent* a_evt, short
 
 	if (a_flags & BEV_EVENT_CONNECTED)
 	{
+		m_options.Apply(bufferevent_getfd(a_evt));
+
 	    {
 	        lock_guard<mutex> l_lock(m_openLock);
 	        m_open = true;
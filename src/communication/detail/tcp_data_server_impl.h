@@ -69,6 +69,11 @@ private:
 
 	int m_port;
 
+	CSocketOptions m_options;
+
+	mutable mutex m_limitsLock;
+	CSendLimits m_sendLimits;
+
 public:
 	Impl();
 	Impl(const string &a_hostString);
@@ -77,7 +82,7 @@ public:
 	void Startup(const string &a_hostString);
 	void Startup(int a_port);
 
-	string HostString() const;
+	virtual string HostString() const;
 
 	void Shutdown();
 
@@ -88,8 +93,17 @@ public:
 	void SetConnectedHandler(ConnectedHandler a_handler);
 	void SetDisconnectedHandler(DisconnectedHandler a_handler);
 
+	const CSocketOptions &SocketOptions() const { return m_options; }
+	void SetSocketOptions(const CSocketOptions &a_options);
+
+	CSendLimits SendLimits() const;
+	void SetSendLimits(const CSendLimits &a_limits);
+
 	void UpdateClientProcTime(CServerConnImpl *a_client, const dirus &a_dur);
 
+protected:
+	void p_Listen(const sockaddr *a_address, int a_addressLen);
+
 private:
 	void p_AcceptCallback(evconnlistener *a_listener, evutil_socket_t a_sock,
 			sockaddr *a_address, int a_sockLen);
@@ -110,8 +124,9 @@ private:
 	CTcpDataServer::Impl *m_server;
 
 public:
-	CServerConnImpl(CTcpDataServer::Impl *a_server, string a_hostName, int a_port, CDispatcher::Ptr a_dispatcher)
-		: CTcpDataConnection::Impl(move(a_hostName), a_port, a_dispatcher),
+	CServerConnImpl(CTcpDataServer::Impl *a_server, string a_hostName, int a_port, CDispatcher::Ptr a_dispatcher,
+					const CSocketOptions &a_options)
+		: CTcpDataConnection::Impl(move(a_hostName), a_port, a_dispatcher, a_options),
 		  m_server(a_server)
 	{
 
@@ -145,9 +160,14 @@ public:
 	}
 	virtual bool IsServerClient() const override { return true; }
 
-	void EstablishEvt(bufferevent_ptr a_evt)
+	void AttachEvt(bufferevent_ptr a_evt)
+	{
+		p_AttachBufferEvent(move(a_evt));
+	}
+
+	void EstablishEvt()
 	{
-		p_SetBufferEvent(move(a_evt));
+		p_HookupEvt();
 	}
 
 	size_t GetProcTime() const
@@ -201,7 +221,10 @@ inline CTcpDataServer::Impl::Impl(int a_port)
 
 inline void CTcpDataServer::Impl::Startup(const string& a_hostString)
 {
-	Startup(StringTo<int>(a_hostString));
+	// The accept thread reads the options
+	m_listener.reset();
+
+	Startup(StringTo<int>(CSocketOptions::Split(a_hostString, m_options)));
 }
 
 inline void CTcpDataServer::Impl::Startup(int a_port)
@@ -212,15 +235,24 @@ inline void CTcpDataServer::Impl::Startup(int a_port)
 	l_in.sin_addr.s_addr = htonl(INADDR_ANY);
 	l_in.sin_port = htons(a_port);
 
+	p_Listen((sockaddr*)&l_in, sizeof(l_in));
+
+	m_port = a_port;
+}
+
+inline void CTcpDataServer::Impl::p_Listen(const sockaddr *a_address, int a_addressLen)
+{
 	m_listener.reset(
 			evconnlistener_new_bind(m_dispatcher->Base(0), s_AcceptCallback, this, LEV_OPT_CLOSE_ON_FREE | LEV_OPT_REUSEABLE, -1,
-					(sockaddr*)&l_in, sizeof(l_in))
+					a_address, a_addressLen)
 	);
 
 	if (!m_listener)
-		throw runtime_error("Failed to bind server to the specified port. Verify that the port is not already in use.");
+		throw runtime_error("Failed to bind server to the specified address. Verify that the address is not already in use.");
 
 	evconnlistener_set_error_cb(m_listener.get(), s_AcceptErrorCallback);
+
+	m_options.ApplyToListener(evconnlistener_get_fd(m_listener.get()));
 }
 
 inline string CTcpDataServer::Impl::HostString() const
@@ -228,6 +260,21 @@ inline string CTcpDataServer::Impl::HostString() const
 	return ToString(m_port);
 }
 
+inline CSendLimits CTcpDataServer::Impl::SendLimits() const
+{
+	lock_guard<mutex> l_lock(m_limitsLock);
+	return m_sendLimits;
+}
+
+inline void CTcpDataServer::Impl::SetSendLimits(const CSendLimits &a_limits)
+{
+	if (a_limits.HighWaterMark != 0 && a_limits.LowWaterMark >= a_limits.HighWaterMark)
+		throw runtime_error("The low water mark has to be below the high water mark.");
+
+	lock_guard<mutex> l_lock(m_limitsLock);
+	m_sendLimits = a_limits;
+}
+
 inline void CTcpDataServer::Impl::Shutdown()
 {
 	lock_guard<mutex> l_lock(m_connLock);
@@ -259,25 +306,52 @@ inline void CTcpDataServer::Impl::SetDisconnectedHandler(DisconnectedHandler a_h
 	m_disconnectedHandler = move(a_handler);
 }
 
+inline void CTcpDataServer::Impl::SetSocketOptions(const CSocketOptions &a_options)
+{
+	if (m_listener)
+		throw runtime_error("The socket options can only be changed before the server is started.");
+
+	m_options = a_options;
+}
+
 
 
 
 inline void CTcpDataServer::Impl::p_AcceptCallback(evconnlistener* a_listener,
 		evutil_socket_t a_sock, sockaddr* a_address, int a_sockLen)
 {
-	char l_scratch[INET6_ADDRSTRLEN];
-	inet_ntop(a_address->sa_family, a_address->sa_data, l_scratch, sizeof(l_scratch));
+	string l_hostName;
+	int l_port = -1;
 
-	int l_port;
-	if (a_address->sa_family == AF_INET)
-		l_port = ((sockaddr_in*)a_address)->sin_port;
+#ifndef IS_WINDOWS
+	// Local clients don't have an address of their own
+	if (a_address->sa_family == AF_UNIX)
+	{
+		l_hostName = HostString();
+	}
 	else
-		l_port = ((sockaddr_in6*)a_address)->sin6_port;
+#endif
+	{
+		char l_scratch[INET6_ADDRSTRLEN];
+		inet_ntop(a_address->sa_family, a_address->sa_data, l_scratch, sizeof(l_scratch));
 
-	std::unique_ptr<CServerConnImpl> l_impl(new CServerConnImpl(this, l_scratch, l_port, m_dispatcher));
+		l_hostName = l_scratch;
+
+		if (a_address->sa_family == AF_INET)
+			l_port = ((sockaddr_in*)a_address)->sin_port;
+		else
+			l_port = ((sockaddr_in6*)a_address)->sin6_port;
+	}
+
+	m_options.Apply(a_sock);
+
+	std::unique_ptr<CServerConnImpl> l_impl(new CServerConnImpl(this, move(l_hostName), l_port, m_dispatcher, m_options));
 
 	auto l_ptr = l_impl.get();
 
+	// Before there is a bufferevent, so it starts out with the water mark
+	l_ptr->SetSendLimits(SendLimits());
+
 	auto l_conn = make_shared<CTcpDataConnection>(move(l_impl));
 	l_ptr->Conn = l_conn.get();
 
@@ -286,19 +360,23 @@ inline void CTcpDataServer::Impl::p_AcceptCallback(evconnlistener* a_listener,
 		m_conns.insert(make_pair(l_conn.get(), l_conn));
 	}
 
-	cout << "Client Connected." << endl;
-
-	if (m_connectedHandler)
-		m_connectedHandler(l_conn);
-
 	event_base *l_baseHandler = m_dispatcher->GetNextBase();
 
 	bufferevent_ptr l_evt(
-			bufferevent_socket_new(l_baseHandler, a_sock, BEV_OPT_CLOSE_ON_FREE),
+			bufferevent_socket_new(l_baseHandler, a_sock, BEV_OPT_CLOSE_ON_FREE | BEV_OPT_THREADSAFE),
 			s_FreeBuffEvt
 	);
 
-	l_ptr->EstablishEvt(move(l_evt));
+	// So that the connected handler can already send, but doesn't receive
+	// anything before it has set up the connection
+	l_ptr->AttachEvt(move(l_evt));
+
+	cout << "Client Connected." << endl;
+
+	if (m_connectedHandler)
+		m_connectedHandler(l_conn);
+
+	l_ptr->EstablishEvt();
 }
 
 struct RBPair
@@ -0,0 +1,75 @@
+/*
+ * File description: unix_data_connection_impl.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef UNIX_DATA_CONNECTION_IMPL_H_
+#define UNIX_DATA_CONNECTION_IMPL_H_
+
+#include <cstddef>
+
+#include <sys/un.h>
+
+#include "communication/unix/unix_data_connection.h"
+
+#include "tcp_data_connection_impl.h"
+
+namespace axon { namespace communication { namespace unix_socket {
+
+inline int MakeUnixAddress(const string &a_path, sockaddr_un &a_address)
+{
+	if (a_path.empty() || a_path.size() >= sizeof(a_address.sun_path))
+		throw runtime_error("Invalid UNIX socket path. It must have between 1 and " +
+				ToString(sizeof(a_address.sun_path) - 1) + " characters.");
+
+	memset(&a_address, 0, sizeof(a_address));
+	a_address.sun_family = AF_UNIX;
+	memcpy(a_address.sun_path, a_path.data(), a_path.size());
+
+	return int(offsetof(sockaddr_un, sun_path) + a_path.size() + 1);
+}
+
+// The buffer events and dispatcher of the TCP connection work the same
+// way for UNIX sockets, only connecting is different
+class CUnixDataConnection::Impl
+	: public tcp::CTcpDataConnection::Impl
+{
+private:
+	string m_path;
+
+public:
+	Impl() { }
+	Impl(const string &a_path)
+	{
+		if (!Connect(a_path))
+			throw runtime_error("Unable to connect to the specified endpoint.");
+	}
+
+	string ConnectionString() const { return m_path; }
+
+	virtual bool Connect(const string &a_path) override
+	{
+		sockaddr_un l_address;
+		const int l_addressLen = MakeUnixAddress(a_path, l_address);
+
+		if (!p_Connect((sockaddr*)&l_address, l_addressLen))
+			return false;
+
+		m_path = a_path;
+		return true;
+	}
+
+	virtual bool Connect(string a_hostName, int a_port) override
+	{
+		throw runtime_error("UNIX socket connections are made to a path, not a host and port.");
+	}
+};
+
+}
+}
+}
+
+
+
+#endif /* UNIX_DATA_CONNECTION_IMPL_H_ */
@@ -0,0 +1,85 @@
+/*
+ * File description: unix_data_server_impl.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef UNIX_DATA_SERVER_IMPL_H_
+#define UNIX_DATA_SERVER_IMPL_H_
+
+#include <cerrno>
+
+#include <sys/stat.h>
+
+#include "communication/unix/unix_data_server.h"
+
+#include "tcp_data_server_impl.h"
+#include "unix_data_connection_impl.h"
+
+namespace axon { namespace communication { namespace unix_socket {
+
+// Accepted connections are handled exactly like TCP ones
+class CUnixDataServer::Impl
+	: public tcp::CTcpDataServer::Impl
+{
+private:
+	string m_path;
+
+public:
+	Impl() { }
+	Impl(const string &a_path)
+	{
+		Startup(a_path);
+	}
+	~Impl()
+	{
+		if (!m_path.empty())
+			unlink(m_path.c_str());
+	}
+
+	void Startup(const string &a_path)
+	{
+		sockaddr_un l_address;
+		const int l_addressLen = MakeUnixAddress(a_path, l_address);
+
+		if (p_IsStale(l_address, l_addressLen))
+			unlink(a_path.c_str());
+
+		p_Listen((sockaddr*)&l_address, l_addressLen);
+
+		m_path = a_path;
+	}
+
+	virtual string HostString() const override { return m_path; }
+
+private:
+	// A socket file that nothing is listening on anymore would make the
+	// bind fail. Sockets that are still in use are left alone
+	static bool p_IsStale(const sockaddr_un &a_address, int a_addressLen)
+	{
+		struct stat l_stat;
+
+		if (stat(a_address.sun_path, &l_stat) != 0 || !S_ISSOCK(l_stat.st_mode))
+			return false;
+
+		int l_sock = socket(AF_UNIX, SOCK_STREAM, 0);
+
+		if (l_sock < 0)
+			return false;
+
+		const bool l_refused = connect(l_sock, (const sockaddr*)&a_address, a_addressLen) != 0 &&
+				errno == ECONNREFUSED;
+
+		close(l_sock);
+
+		return l_refused;
+	}
+};
+
+}
+}
+}
+
+
+
+#endif /* UNIX_DATA_SERVER_IMPL_H_ */
@@ -0,0 +1,336 @@
+/*
+ * File description: uring.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef URING_H_
+#define URING_H_
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace axon { namespace communication { namespace uring {
+
+/*
+ * An io_uring instance, talking to the kernel directly so that there is
+ * no dependency on liburing. Only one thread may use it at a time.
+ * Entries are queued with GetSqe, and nothing reaches the kernel until
+ * Submit is called, so everything queued in between is one system call.
+ */
+class CUring
+{
+private:
+	int m_fd;
+	io_uring_params m_params;
+
+	void *m_sqMap;
+	size_t m_sqMapSize;
+	void *m_cqMap;
+	size_t m_cqMapSize;
+	io_uring_sqe *m_sqes;
+
+	unsigned *m_sqHead;
+	unsigned *m_sqTail;
+	unsigned m_sqMask;
+	unsigned m_sqTailLocal;
+
+	unsigned *m_cqHead;
+	unsigned *m_cqTail;
+	unsigned m_cqMask;
+	io_uring_cqe *m_cqes;
+
+public:
+	explicit CUring(unsigned a_entries)
+		: m_sqMap(MAP_FAILED), m_cqMap(MAP_FAILED), m_sqes((io_uring_sqe*)MAP_FAILED)
+	{
+		memset(&m_params, 0, sizeof(m_params));
+
+		// Only run completion work when the loop asks for events, instead of
+		// interrupting it. Older kernels don't know the flag
+		m_params.flags = IORING_SETUP_COOP_TASKRUN;
+
+		m_fd = syscall(__NR_io_uring_setup, a_entries, &m_params);
+
+		if (m_fd < 0 && errno == EINVAL)
+		{
+			memset(&m_params, 0, sizeof(m_params));
+			m_fd = syscall(__NR_io_uring_setup, a_entries, &m_params);
+		}
+
+		if (m_fd < 0)
+			throw runtime_error("Failed to create the io_uring instance. The kernel may not support it.");
+
+		try
+		{
+			p_Map();
+		}
+		catch (...)
+		{
+			p_Unmap();
+			throw;
+		}
+	}
+	~CUring()
+	{
+		p_Unmap();
+	}
+
+	CUring(const CUring &) = delete;
+	CUring &operator=(const CUring &) = delete;
+
+	int Fd() const { return m_fd; }
+
+	// Returns a cleared entry to fill in. Submits what is queued when the
+	// submission queue is full
+	io_uring_sqe *GetSqe()
+	{
+		if (m_sqTailLocal - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_params.sq_entries)
+		{
+			Submit(false);
+
+			if (m_sqTailLocal - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE) >= m_params.sq_entries)
+				throw runtime_error("The io_uring submission queue is full.");
+		}
+
+		io_uring_sqe *l_sqe = &m_sqes[m_sqTailLocal & m_sqMask];
+		++m_sqTailLocal;
+
+		memset(l_sqe, 0, sizeof(io_uring_sqe));
+		return l_sqe;
+	}
+
+	// Hands the queued entries to the kernel, and optionally sleeps until
+	// there is at least one completion
+	int Submit(bool a_wait)
+	{
+		__atomic_store_n(m_sqTail, m_sqTailLocal, __ATOMIC_RELEASE);
+
+		const unsigned l_toSubmit = m_sqTailLocal - __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+
+		if (l_toSubmit == 0 && !a_wait)
+			return 0;
+
+		int l_ret;
+
+		do
+		{
+			l_ret = syscall(__NR_io_uring_enter, m_fd, l_toSubmit, a_wait ? 1 : 0,
+							a_wait ? IORING_ENTER_GETEVENTS : 0, nullptr, 0);
+		} while (l_ret < 0 && errno == EINTR);
+
+		return l_ret;
+	}
+
+	bool HasCompletions() const
+	{
+		return *m_cqHead != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+	}
+
+	// Calls the function with each completion that is ready. Every entry is
+	// copied and released before the call, so the function can queue more work
+	template<typename Fn>
+	size_t ProcessCompletions(Fn &&a_fn)
+	{
+		unsigned l_head = *m_cqHead;
+		const unsigned l_tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+		size_t l_count = 0;
+
+		while (l_head != l_tail)
+		{
+			const io_uring_cqe l_cqe = m_cqes[l_head & m_cqMask];
+
+			++l_head;
+			__atomic_store_n(m_cqHead, l_head, __ATOMIC_RELEASE);
+
+			a_fn(l_cqe);
+			++l_count;
+		}
+
+		return l_count;
+	}
+
+	int Register(unsigned a_opCode, void *a_arg, unsigned a_numArgs)
+	{
+		return syscall(__NR_io_uring_register, m_fd, a_opCode, a_arg, a_numArgs);
+	}
+
+private:
+	void p_Map()
+	{
+		m_sqMapSize = m_params.sq_off.array + m_params.sq_entries * sizeof(unsigned);
+		m_cqMapSize = m_params.cq_off.cqes + m_params.cq_entries * sizeof(io_uring_cqe);
+
+		const bool l_single = m_params.features & IORING_FEAT_SINGLE_MMAP;
+
+		if (l_single)
+			m_sqMapSize = m_cqMapSize = max(m_sqMapSize, m_cqMapSize);
+
+		m_sqMap = mmap(nullptr, m_sqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+					   m_fd, IORING_OFF_SQ_RING);
+
+		if (m_sqMap == MAP_FAILED)
+			throw runtime_error("Failed to map the io_uring submission queue.");
+
+		if (l_single)
+		{
+			m_cqMap = m_sqMap;
+		}
+		else
+		{
+			m_cqMap = mmap(nullptr, m_cqMapSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+						   m_fd, IORING_OFF_CQ_RING);
+
+			if (m_cqMap == MAP_FAILED)
+				throw runtime_error("Failed to map the io_uring completion queue.");
+		}
+
+		m_sqes = (io_uring_sqe*)mmap(nullptr, m_params.sq_entries * sizeof(io_uring_sqe),
+									 PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+									 m_fd, IORING_OFF_SQES);
+
+		if (m_sqes == MAP_FAILED)
+			throw runtime_error("Failed to map the io_uring submission entries.");
+
+		char *l_sq = (char*)m_sqMap;
+		m_sqHead = (unsigned*)(l_sq + m_params.sq_off.head);
+		m_sqTail = (unsigned*)(l_sq + m_params.sq_off.tail);
+		m_sqMask = *(unsigned*)(l_sq + m_params.sq_off.ring_mask);
+		m_sqTailLocal = *m_sqTail;
+
+		// Entries are always used in order, so the indirection array is fixed
+		unsigned *l_array = (unsigned*)(l_sq + m_params.sq_off.array);
+		for (unsigned i = 0; i < m_params.sq_entries; ++i)
+			l_array[i] = i;
+
+		char *l_cq = (char*)m_cqMap;
+		m_cqHead = (unsigned*)(l_cq + m_params.cq_off.head);
+		m_cqTail = (unsigned*)(l_cq + m_params.cq_off.tail);
+		m_cqMask = *(unsigned*)(l_cq + m_params.cq_off.ring_mask);
+		m_cqes = (io_uring_cqe*)(l_cq + m_params.cq_off.cqes);
+	}
+
+	void p_Unmap()
+	{
+		if (m_sqes != MAP_FAILED)
+			munmap(m_sqes, m_params.sq_entries * sizeof(io_uring_sqe));
+		if (m_cqMap != MAP_FAILED && m_cqMap != m_sqMap)
+			munmap(m_cqMap, m_cqMapSize);
+		if (m_sqMap != MAP_FAILED)
+			munmap(m_sqMap, m_sqMapSize);
+
+		close(m_fd);
+	}
+};
+
+/*
+ * Receive buffers that are registered with the kernel as a buffer group.
+ * Multishot receives pick a free one for each completion, so no memory is
+ * tied up by sockets that are idle. A buffer belongs to the application
+ * from its completion until it is recycled.
+ */
+class CUringBufferRing
+{
+private:
+	io_uring_buf_ring *m_ring;
+	size_t m_ringSize;
+	char *m_storage;
+	size_t m_count;
+	size_t m_bufferSize;
+	uint16_t m_tail;
+
+public:
+	CUringBufferRing(CUring &a_uring, uint16_t a_group, size_t a_count, size_t a_bufferSize)
+		: m_count(a_count), m_bufferSize(a_bufferSize), m_tail(0)
+	{
+		if (a_count == 0 || (a_count & (a_count - 1)) != 0 || a_count > 32768)
+			throw runtime_error("The number of io_uring receive buffers must be a power of 2, and at most 32768.");
+
+		m_ringSize = a_count * sizeof(io_uring_buf);
+
+		m_ring = (io_uring_buf_ring*)mmap(nullptr, m_ringSize, PROT_READ | PROT_WRITE,
+										  MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (m_ring == MAP_FAILED)
+			throw runtime_error("Failed to allocate the io_uring buffer ring.");
+
+		m_storage = (char*)mmap(nullptr, a_count * a_bufferSize, PROT_READ | PROT_WRITE,
+								MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+		if (m_storage == MAP_FAILED)
+		{
+			munmap(m_ring, m_ringSize);
+			throw runtime_error("Failed to allocate the io_uring receive buffers.");
+		}
+
+		io_uring_buf_reg l_reg;
+		memset(&l_reg, 0, sizeof(l_reg));
+		l_reg.ring_addr = (uint64_t)m_ring;
+		l_reg.ring_entries = a_count;
+		l_reg.bgid = a_group;
+
+		if (a_uring.Register(IORING_REGISTER_PBUF_RING, &l_reg, 1) != 0)
+		{
+			munmap(m_storage, m_count * m_bufferSize);
+			munmap(m_ring, m_ringSize);
+			throw runtime_error("Failed to register the io_uring receive buffers. Linux 5.19 or later is required.");
+		}
+
+		for (size_t i = 0; i < a_count; ++i)
+			p_Add(i);
+
+		p_Publish();
+	}
+	~CUringBufferRing()
+	{
+		// Only safe once the ring that the buffers are registered with is gone
+		munmap(m_storage, m_count * m_bufferSize);
+		munmap(m_ring, m_ringSize);
+	}
+
+	CUringBufferRing(const CUringBufferRing &) = delete;
+	CUringBufferRing &operator=(const CUringBufferRing &) = delete;
+
+	const char *Buffer(uint16_t a_id) const { return m_storage + a_id * m_bufferSize; }
+
+	size_t BufferSize() const { return m_bufferSize; }
+
+	void Recycle(uint16_t a_id)
+	{
+		p_Add(a_id);
+		p_Publish();
+	}
+
+private:
+	void p_Add(uint16_t a_id)
+	{
+		// Not m_ring->bufs, which the kernel header gets wrong for C++. The
+		// entries start at the beginning of the ring, with the tail overlaid
+		io_uring_buf &l_buf = ((io_uring_buf*)m_ring)[m_tail & (m_count - 1)];
+		l_buf.addr = (uint64_t)(m_storage + a_id * m_bufferSize);
+		l_buf.len = m_bufferSize;
+		l_buf.bid = a_id;
+
+		++m_tail;
+	}
+
+	void p_Publish()
+	{
+		__atomic_store_n(&m_ring->tail, m_tail, __ATOMIC_RELEASE);
+	}
+};
+
+} } }
+
+#endif /* URING_H_ */
@@ -0,0 +1,655 @@
+/*
+ * File description: uring_data_connection_impl.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef URING_DATA_CONNECTION_IMPL_H_
+#define URING_DATA_CONNECTION_IMPL_H_
+
+#include <atomic>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "communication/uring/uring_data_connection.h"
+#include "communication/tcp/socket_options.h"
+
+#include "uring_dispatcher.h"
+
+#include "util/string_convert.h"
+
+using namespace std;
+using namespace axon::util;
+using axon::communication::tcp::CSocketOptions;
+
+namespace axon { namespace communication { namespace uring {
+
+/*
+ * The part of a connection that lives on a loop. The loop keeps it alive
+ * until the socket is closed and nothing is in flight any more, so the
+ * connection can be released at any time. Apart from Send, everything is
+ * done on the loop thread.
+ */
+class CUringSocket
+	: public IUringHandler, public enable_shared_from_this<CUringSocket>
+{
+public:
+	typedef shared_ptr<CUringSocket> Ptr;
+	typedef function<void ()> ClosedHandler;
+
+	static const uint8_t OP_RECEIVE = 1;
+	static const uint8_t OP_SEND = 2;
+	static const uint8_t OP_CANCEL = 3;
+
+private:
+	CUringLoop *m_loop;
+	int m_fd;
+	uint64_t m_id;
+
+	const CSocketOptions m_options;
+
+	mutex m_sendLock;
+	vector<CDataBuffer> m_pending;
+	bool m_flushPosted;
+
+	// Only used on the loop thread
+	IDataConnection::DataReceivedHandler m_receiver;
+	ClosedHandler m_closedHandler;
+
+	deque<CDataBuffer> m_sending;
+	size_t m_sendOffset;
+	vector<iovec> m_iov;
+	msghdr m_msg;
+
+	bool m_receiving;
+	bool m_sendInFlight;
+	bool m_delivering;
+	bool m_detached;
+	bool m_closing;
+
+public:
+	CUringSocket(CUringLoop *a_loop, int a_fd, const CSocketOptions &a_options)
+		: m_loop(a_loop), m_fd(a_fd), m_id(0), m_options(a_options), m_flushPosted(false), m_sendOffset(0),
+		  m_receiving(false), m_sendInFlight(false), m_delivering(false),
+		  m_detached(false), m_closing(false)
+	{
+		memset(&m_msg, 0, sizeof(m_msg));
+	}
+	~CUringSocket()
+	{
+		if (m_fd >= 0)
+			close(m_fd);
+	}
+
+	// Can be called from any thread. The data is copied, and goes out with
+	// everything else that was sent before the loop got to it
+	void Send(const CBuffer &a_buff)
+	{
+		CDataBuffer l_copy(a_buff.size());
+		memcpy(l_copy.Data(), a_buff.data(), a_buff.size());
+
+		bool l_post;
+
+		{
+			lock_guard<mutex> l_lock(m_sendLock);
+
+			m_pending.push_back(move(l_copy));
+
+			l_post = !m_flushPosted;
+			m_flushPosted = true;
+		}
+
+		if (l_post)
+		{
+			Ptr l_self = shared_from_this();
+			m_loop->Post([l_self] () { l_self->p_Flush(); });
+		}
+	}
+
+	void Attach(ClosedHandler a_handler)
+	{
+		m_closedHandler = move(a_handler);
+		m_id = m_loop->Add(shared_from_this());
+	}
+
+	void SetReceiver(IDataConnection::DataReceivedHandler a_handler)
+	{
+		if (m_detached)
+			return;
+
+		m_receiver = move(a_handler);
+
+		if (m_receiver && !m_receiving && !m_closing)
+			p_ArmReceive();
+	}
+
+	void Shutdown()
+	{
+		if (m_closing)
+			return;
+
+		m_closing = true;
+
+		shutdown(m_fd, SHUT_RDWR);
+
+		if (m_receiving)
+		{
+			io_uring_sqe *l_sqe = m_loop->GetSqe(m_id, OP_CANCEL);
+			l_sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			l_sqe->addr = (m_id << 8) | OP_RECEIVE;
+		}
+
+		p_TryFinish();
+	}
+
+	// Stops calling back into the connection, which is going away
+	void Detach()
+	{
+		m_detached = true;
+
+		// The receiver might be the one releasing the connection
+		if (!m_delivering)
+			m_receiver = nullptr;
+
+		m_closedHandler = nullptr;
+
+		Shutdown();
+	}
+
+	virtual void OnComplete(uint8_t a_op, const io_uring_cqe &a_cqe) override
+	{
+		switch (a_op)
+		{
+		case OP_RECEIVE:
+			p_OnReceive(a_cqe);
+			break;
+		case OP_SEND:
+			p_OnSend(a_cqe);
+			break;
+		}
+	}
+
+private:
+	void p_ArmReceive()
+	{
+		io_uring_sqe *l_sqe = m_loop->GetSqe(m_id, OP_RECEIVE);
+		l_sqe->opcode = IORING_OP_RECV;
+		l_sqe->fd = m_fd;
+		l_sqe->ioprio = IORING_RECV_MULTISHOT;
+		l_sqe->flags = IOSQE_BUFFER_SELECT;
+		l_sqe->buf_group = CUringLoop::BUFFER_GROUP;
+
+		m_receiving = true;
+	}
+
+	void p_OnReceive(const io_uring_cqe &a_cqe)
+	{
+		Ptr l_self = shared_from_this();
+
+		if (!(a_cqe.flags & IORING_CQE_F_MORE))
+			m_receiving = false;
+
+		if (a_cqe.flags & IORING_CQE_F_BUFFER)
+		{
+			const uint16_t l_bufferId = a_cqe.flags >> IORING_CQE_BUFFER_SHIFT;
+
+			CDataBuffer l_buff;
+
+			if (a_cqe.res > 0)
+			{
+				l_buff.Reset(a_cqe.res);
+				memcpy(l_buff.Data(), m_loop->Buffers().Buffer(l_bufferId), a_cqe.res);
+			}
+
+			// Given back before the handler runs, so that the loop doesn't
+			// run out while it is busy
+			m_loop->Buffers().Recycle(l_bufferId);
+
+			if (a_cqe.res > 0)
+			{
+				m_options.RearmQuickAck(m_fd);
+
+				p_Deliver(move(l_buff));
+			}
+		}
+
+		if (a_cqe.res == 0 || (a_cqe.res < 0 && a_cqe.res != -ENOBUFS))
+		{
+			if (!m_closing)
+			{
+				if (a_cqe.res == 0)
+					cout << "Client Closed." << endl;
+				else
+					cout << "Error on connection" << endl;
+			}
+
+			Shutdown();
+			p_TryFinish();
+		}
+		else if (!m_receiving && !m_closing && m_receiver)
+		{
+			// Multishot receives end when the loop is out of buffers
+			p_ArmReceive();
+		}
+	}
+
+	void p_Deliver(CDataBuffer a_buff)
+	{
+		if (m_detached || !m_receiver)
+			return;
+
+		m_delivering = true;
+		m_receiver(move(a_buff));
+		m_delivering = false;
+
+		if (m_detached)
+			m_receiver = nullptr;
+	}
+
+	void p_Flush()
+	{
+		{
+			lock_guard<mutex> l_lock(m_sendLock);
+
+			for (CDataBuffer &l_buff : m_pending)
+				m_sending.push_back(move(l_buff));
+
+			m_pending.clear();
+			m_flushPosted = false;
+		}
+
+		if (m_closing)
+		{
+			m_sending.clear();
+			return;
+		}
+
+		if (m_sendInFlight || m_sending.empty())
+			return;
+
+		// Everything waiting goes out as a single request
+		m_iov.clear();
+
+		for (CDataBuffer &l_buff : m_sending)
+		{
+			if (m_iov.size() == IOV_MAX)
+				break;
+
+			const size_t l_offset = m_iov.empty() ? m_sendOffset : 0;
+
+			iovec l_vec;
+			l_vec.iov_base = l_buff.Data() + l_offset;
+			l_vec.iov_len = l_buff.Size() - l_offset;
+			m_iov.push_back(l_vec);
+		}
+
+		m_msg.msg_iov = m_iov.data();
+		m_msg.msg_iovlen = m_iov.size();
+
+		io_uring_sqe *l_sqe = m_loop->GetSqe(m_id, OP_SEND);
+		l_sqe->opcode = IORING_OP_SENDMSG;
+		l_sqe->fd = m_fd;
+		l_sqe->addr = (uint64_t)&m_msg;
+		l_sqe->len = 1;
+		l_sqe->msg_flags = MSG_NOSIGNAL;
+
+		m_sendInFlight = true;
+	}
+
+	void p_OnSend(const io_uring_cqe &a_cqe)
+	{
+		Ptr l_self = shared_from_this();
+
+		m_sendInFlight = false;
+
+		if (a_cqe.res < 0)
+		{
+			if (!m_closing)
+				cout << "Failed to write socket data." << endl;
+
+			m_sending.clear();
+
+			Shutdown();
+			p_TryFinish();
+			return;
+		}
+
+		size_t l_sent = a_cqe.res;
+
+		while (l_sent > 0)
+		{
+			const size_t l_left = m_sending.front().Size() - m_sendOffset;
+
+			if (l_sent < l_left)
+			{
+				m_sendOffset += l_sent;
+				break;
+			}
+
+			l_sent -= l_left;
+			m_sendOffset = 0;
+			m_sending.pop_front();
+		}
+
+		if (m_closing)
+		{
+			p_TryFinish();
+			return;
+		}
+
+		// Also picks up whatever was sent in the meantime
+		p_Flush();
+	}
+
+	void p_TryFinish()
+	{
+		if (!m_closing || m_receiving || m_sendInFlight || m_fd < 0)
+			return;
+
+		Ptr l_self = shared_from_this();
+
+		close(m_fd);
+		m_fd = -1;
+
+		m_sending.clear();
+
+		m_loop->Remove(m_id);
+
+		ClosedHandler l_handler = move(m_closedHandler);
+		m_closedHandler = nullptr;
+
+		if (l_handler)
+			l_handler();
+	}
+};
+
+/*
+ * A connection has a socket on one of the loops of its dispatcher, which
+ * is created when it connects. Clients get a dispatcher with one loop, the
+ * same as TCP clients.
+ */
+class CUringDataConnection::Impl
+{
+private:
+	CUringDispatcher::Ptr m_disp;
+	CUringLoop *m_loop;
+	CUringSocket::Ptr m_socket;
+
+	string m_hostName;
+	int m_port;
+
+	DataReceivedHandler m_rcvHandler;
+
+	CSocketOptions m_options;
+
+	atomic<bool> m_open;
+
+public:
+	Impl();
+	Impl(const string &a_connectionString);
+	Impl(string a_hostName, int a_port);
+	virtual ~Impl();
+
+	string ConnectionString() const;
+	virtual bool Connect(const string &a_connectionString);
+	virtual bool Connect(string a_hostName, int a_port);
+	virtual void Close();
+	bool IsOpen() const { return m_open; }
+	virtual bool IsServerClient() const { return false; }
+
+	void Send(const CBuffer &a_buff, condition_variable *a_finishEvt);
+
+	void SetReceiveHandler(DataReceivedHandler a_handler);
+
+	const CSocketOptions &SocketOptions() const { return m_options; }
+	void SetSocketOptions(const CSocketOptions &a_options);
+
+protected:
+	// Used by the server for the clients it accepts
+	Impl(string a_hostName, int a_port, CUringDispatcher::Ptr a_dispatcher, int a_fd,
+		 const CSocketOptions &a_options);
+
+	void p_Stop();
+
+private:
+	void p_Attach(int a_fd);
+
+	static bool s_Connect(int a_fd, const sockaddr *a_address, socklen_t a_addressLen);
+};
+
+inline CUringDataConnection::Impl::Impl()
+	: m_loop(nullptr), m_port(-1), m_open(false)
+{
+	m_disp = CUringDispatcher::Get(1);
+}
+
+inline CUringDataConnection::Impl::Impl(const string &a_connectionString)
+	: Impl()
+{
+	if (!Connect(a_connectionString))
+		throw runtime_error("Unable to connect to the specified endpoint.");
+}
+
+inline CUringDataConnection::Impl::Impl(string a_hostName, int a_port)
+	: Impl()
+{
+	if (!Connect(move(a_hostName), a_port))
+		throw runtime_error("Unable to connect to the specified endpoint.");
+}
+
+inline CUringDataConnection::Impl::Impl(string a_hostName, int a_port, CUringDispatcher::Ptr a_dispatcher, int a_fd,
+		const CSocketOptions &a_options)
+	: m_disp(move(a_dispatcher)), m_loop(nullptr), m_hostName(move(a_hostName)), m_port(a_port),
+	  m_options(a_options), m_open(false)
+{
+	p_Attach(a_fd);
+}
+
+inline CUringDataConnection::Impl::~Impl()
+{
+	p_Stop();
+}
+
+inline string CUringDataConnection::Impl::ConnectionString() const
+{
+	return m_hostName + ":" + ToString(m_port);
+}
+
+inline bool CUringDataConnection::Impl::Connect(const string &a_connectionString)
+{
+	const string l_address = CSocketOptions::Split(a_connectionString, m_options);
+
+	size_t l_colIdx = l_address.find(':');
+
+	if (l_colIdx == string::npos)
+		throw runtime_error("Invalid TCP connection string. Must be of format [host name]:[port][?options]");
+
+	string l_hostName = l_address.substr(0, l_colIdx);
+
+	int l_port = StringTo<int>(l_address.substr(l_colIdx + 1));
+
+	return Connect(move(l_hostName), l_port);
+}
+
+inline bool CUringDataConnection::Impl::Connect(string a_hostName, int a_port)
+{
+	p_Stop();
+
+	addrinfo l_hints;
+	memset(&l_hints, 0, sizeof(l_hints));
+	l_hints.ai_family = AF_UNSPEC;
+	l_hints.ai_socktype = SOCK_STREAM;
+
+	addrinfo *l_addresses = nullptr;
+
+	if (getaddrinfo(a_hostName.c_str(), ToString(a_port).c_str(), &l_hints, &l_addresses) != 0)
+		return false;
+
+	int l_fd = -1;
+
+	for (addrinfo *l_curr = l_addresses; l_curr; l_curr = l_curr->ai_next)
+	{
+		l_fd = socket(l_curr->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+		if (l_fd < 0)
+			continue;
+
+		// Before connecting, so that the buffer sizes count for the window
+		m_options.Apply(l_fd);
+
+		if (s_Connect(l_fd, l_curr->ai_addr, l_curr->ai_addrlen))
+			break;
+
+		close(l_fd);
+		l_fd = -1;
+	}
+
+	freeaddrinfo(l_addresses);
+
+	if (l_fd < 0)
+		return false;
+
+	m_hostName = move(a_hostName);
+	m_port = a_port;
+
+	p_Attach(l_fd);
+
+	return true;
+}
+
+inline bool CUringDataConnection::Impl::s_Connect(int a_fd, const sockaddr *a_address, socklen_t a_addressLen)
+{
+	if (connect(a_fd, a_address, a_addressLen) == 0)
+		return true;
+
+	if (errno != EINPROGRESS)
+		return false;
+
+	// Wait for up to 10 seconds for the connection to open
+	pollfd l_fd{ a_fd, POLLOUT, 0 };
+
+	int l_ret;
+	while ((l_ret = poll(&l_fd, 1, 10000)) < 0 && errno == EINTR) { }
+
+	if (l_ret <= 0)
+		return false;
+
+	int l_err = 0;
+	socklen_t l_errLen = sizeof(l_err);
+
+	return getsockopt(a_fd, SOL_SOCKET, SO_ERROR, &l_err, &l_errLen) == 0 && l_err == 0;
+}
+
+inline void CUringDataConnection::Impl::p_Attach(int a_fd)
+{
+	m_loop = m_disp->GetNextLoop();
+	m_socket = make_shared<CUringSocket>(m_loop, a_fd, m_options);
+	m_open = true;
+
+	CUringSocket::Ptr l_socket = m_socket;
+	DataReceivedHandler l_handler = m_rcvHandler;
+
+	// Closing on the loop calls back into the connection until it detaches
+	m_loop->Post(
+		[this, l_socket, l_handler] ()
+		{
+			l_socket->Attach(
+				[this] ()
+				{
+					Close();
+				});
+
+			if (l_handler)
+				l_socket->SetReceiver(l_handler);
+		});
+}
+
+inline void CUringDataConnection::Impl::p_Stop()
+{
+	m_open = false;
+
+	if (!m_socket)
+		return;
+
+	CUringSocket::Ptr l_socket = move(m_socket);
+
+	m_loop->Run(
+		[l_socket] ()
+		{
+			l_socket->Detach();
+		});
+}
+
+inline void CUringDataConnection::Impl::Close()
+{
+	m_open = false;
+
+	if (!m_socket)
+		return;
+
+	CUringSocket::Ptr l_socket = m_socket;
+
+	m_loop->Post(
+		[l_socket] ()
+		{
+			l_socket->Shutdown();
+		});
+}
+
+inline void CUringDataConnection::Impl::Send(const CBuffer &a_buff, condition_variable *a_finishEvt)
+{
+	if (a_finishEvt)
+		throw runtime_error("Signaling the end of the send is not currently supported.");
+
+	if (!m_open)
+	{
+		cout << "Failed to write socket data." << endl;
+		return;
+	}
+
+	m_socket->Send(a_buff);
+}
+
+inline void CUringDataConnection::Impl::SetSocketOptions(const CSocketOptions &a_options)
+{
+	if (m_open)
+		throw runtime_error("The socket options can only be changed before the connection is opened.");
+
+	m_options = a_options;
+}
+
+inline void CUringDataConnection::Impl::SetReceiveHandler(DataReceivedHandler a_handler)
+{
+	m_rcvHandler = move(a_handler);
+
+	if (!m_socket)
+		return;
+
+	CUringSocket::Ptr l_socket = m_socket;
+	DataReceivedHandler l_handler = m_rcvHandler;
+
+	m_loop->Post(
+		[l_socket, l_handler] ()
+		{
+			l_socket->SetReceiver(l_handler);
+		});
+}
+
+}
+}
+}
+
+
+
+#endif /* URING_DATA_CONNECTION_IMPL_H_ */
@@ -0,0 +1,434 @@
+/*
+ * File description: uring_data_server_impl.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef URING_DATA_SERVER_IMPL_H_
+#define URING_DATA_SERVER_IMPL_H_
+
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <arpa/inet.h>
+
+#include "communication/uring/uring_data_server.h"
+
+#include "uring_data_connection_impl.h"
+
+using namespace std;
+using namespace axon::util;
+
+namespace axon { namespace communication { namespace uring {
+
+/*
+ * A listening socket with a multishot accept on a loop. It owns the
+ * socket until it is stopped.
+ */
+class CUringListener
+	: public IUringHandler, public enable_shared_from_this<CUringListener>
+{
+public:
+	typedef shared_ptr<CUringListener> Ptr;
+	typedef function<void (int)> AcceptHandler;
+
+	static const uint8_t OP_ACCEPT = 1;
+	static const uint8_t OP_CANCEL = 2;
+
+private:
+	CUringLoop *m_loop;
+	int m_fd;
+	uint64_t m_id;
+
+	// Only used on the loop thread
+	AcceptHandler m_handler;
+	bool m_accepting;
+
+public:
+	CUringListener(CUringLoop *a_loop, int a_fd)
+		: m_loop(a_loop), m_fd(a_fd), m_id(0), m_accepting(false)
+	{
+	}
+	~CUringListener()
+	{
+		if (m_fd >= 0)
+			close(m_fd);
+	}
+
+	void Start(AcceptHandler a_handler)
+	{
+		m_handler = move(a_handler);
+		m_id = m_loop->Add(shared_from_this());
+
+		p_Arm();
+	}
+
+	void Stop()
+	{
+		m_handler = nullptr;
+
+		if (m_accepting)
+		{
+			io_uring_sqe *l_sqe = m_loop->GetSqe(m_id, OP_CANCEL);
+			l_sqe->opcode = IORING_OP_ASYNC_CANCEL;
+			l_sqe->addr = (m_id << 8) | OP_ACCEPT;
+
+			// The accept holds on to the socket, and the port should be free
+			// by the time the server is gone
+			m_loop->Flush();
+		}
+
+		close(m_fd);
+		m_fd = -1;
+
+		if (!m_accepting)
+			m_loop->Remove(m_id);
+	}
+
+	virtual void OnComplete(uint8_t a_op, const io_uring_cqe &a_cqe) override
+	{
+		if (a_op != OP_ACCEPT)
+			return;
+
+		Ptr l_self = shared_from_this();
+
+		if (!(a_cqe.flags & IORING_CQE_F_MORE))
+			m_accepting = false;
+
+		if (a_cqe.res >= 0)
+		{
+			if (m_handler)
+				m_handler(a_cqe.res);
+			else
+				close(a_cqe.res);
+		}
+		else if (m_handler)
+		{
+			cout << "Failed to accept a client. Error: " << -a_cqe.res << endl;
+		}
+
+		if (!m_handler)
+		{
+			if (!m_accepting)
+				m_loop->Remove(m_id);
+		}
+		else if (!m_accepting)
+		{
+			p_Arm();
+		}
+	}
+
+private:
+	void p_Arm()
+	{
+		io_uring_sqe *l_sqe = m_loop->GetSqe(m_id, OP_ACCEPT);
+		l_sqe->opcode = IORING_OP_ACCEPT;
+		l_sqe->fd = m_fd;
+		l_sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+		l_sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+
+		m_accepting = true;
+	}
+};
+
+class CUringServerConnImpl;
+
+class CUringDataServer::Impl
+{
+private:
+	friend class CUringServerConnImpl;
+
+	CUringDispatcher::Ptr m_dispatcher;
+	CUringListener::Ptr m_listener;
+
+	ConnectedHandler m_connectedHandler;
+	DisconnectedHandler m_disconnectedHandler;
+
+	mutable mutex m_connLock;
+	unordered_map<CUringDataConnection*, CUringDataConnection::Ptr> m_conns;
+
+	int m_port;
+
+	CSocketOptions m_options;
+
+public:
+	Impl();
+	Impl(const string &a_hostString);
+	Impl(int a_port);
+	~Impl();
+
+	void Startup(const string &a_hostString);
+	void Startup(int a_port);
+
+	string HostString() const { return ToString(m_port); }
+
+	void Shutdown();
+
+	size_t NumClients() const;
+
+	void Broadcast(const util::CBuffer &a_buff);
+
+	void SetConnectedHandler(ConnectedHandler a_handler) { m_connectedHandler = move(a_handler); }
+	void SetDisconnectedHandler(DisconnectedHandler a_handler) { m_disconnectedHandler = move(a_handler); }
+
+	const CSocketOptions &SocketOptions() const { return m_options; }
+	void SetSocketOptions(const CSocketOptions &a_options);
+
+private:
+	void p_Accept(int a_fd);
+	void p_StopListening();
+};
+
+class CUringServerConnImpl
+	: public CUringDataConnection::Impl
+{
+private:
+	// Cleared when the server shuts down, since the connection can outlive it
+	mutex m_serverLock;
+	CUringDataServer::Impl *m_server;
+
+public:
+	CUringServerConnImpl(CUringDataServer::Impl *a_server, string a_hostName, int a_port,
+						 CUringDispatcher::Ptr a_dispatcher, int a_fd, const CSocketOptions &a_options)
+		: CUringDataConnection::Impl(move(a_hostName), a_port, move(a_dispatcher), a_fd, a_options),
+		  m_server(a_server)
+	{
+	}
+	~CUringServerConnImpl()
+	{
+		// The loop has to stop calling Close before this part of the object
+		// is gone
+		p_Stop();
+	}
+
+	CUringDataConnection *Conn = nullptr;
+
+	virtual bool Connect(const string &a_connectionString) override { p_ThrowInvalid(); return false; }
+	virtual bool Connect(string a_hostName, int a_port) override { p_ThrowInvalid(); return false; }
+	virtual void Close() override
+	{
+		CUringDataConnection::Impl::Close();
+
+		IDataConnection::Ptr l_conn;
+		IDataServer::DisconnectedHandler l_handler;
+
+		{
+			lock_guard<mutex> l_serverLock(m_serverLock);
+
+			if (!m_server)
+				return;
+
+			lock_guard<mutex> l_lock(m_server->m_connLock);
+
+			auto iter = m_server->m_conns.find(Conn);
+
+			if (iter == m_server->m_conns.end())
+				return;
+
+			l_conn = iter->second;
+			m_server->m_conns.erase(iter);
+
+			l_handler = m_server->m_disconnectedHandler;
+		}
+
+		cout << "Client Disconnected." << endl;
+
+		if (l_handler)
+			l_handler(l_conn);
+	}
+	virtual bool IsServerClient() const override { return true; }
+
+	void Detach()
+	{
+		lock_guard<mutex> l_lock(m_serverLock);
+		m_server = nullptr;
+	}
+
+private:
+	void p_ThrowInvalid()
+	{
+		throw runtime_error("The specified operation is not permitted on server managed connections.");
+	}
+};
+
+inline CUringDataServer::Impl::Impl()
+	: m_port(-1)
+{
+	m_dispatcher = CUringDispatcher::Get(CUringDispatcher::OptimalNumThreads() + 1);
+}
+
+inline CUringDataServer::Impl::Impl(const string &a_hostString)
+	: Impl()
+{
+	Startup(a_hostString);
+}
+
+inline CUringDataServer::Impl::Impl(int a_port)
+	: Impl()
+{
+	Startup(a_port);
+}
+
+inline CUringDataServer::Impl::~Impl()
+{
+	p_StopListening();
+
+	Shutdown();
+}
+
+inline void CUringDataServer::Impl::Startup(const string &a_hostString)
+{
+	// The accept loop reads the options
+	p_StopListening();
+
+	Startup(StringTo<int>(CSocketOptions::Split(a_hostString, m_options)));
+}
+
+inline void CUringDataServer::Impl::Startup(int a_port)
+{
+	p_StopListening();
+
+	int l_fd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+
+	if (l_fd < 0)
+		throw runtime_error("Failed to create the server socket.");
+
+	int l_reuse = 1;
+	setsockopt(l_fd, SOL_SOCKET, SO_REUSEADDR, &l_reuse, sizeof(l_reuse));
+
+	m_options.ApplyToListener(l_fd);
+
+	sockaddr_in l_in;
+	memset(&l_in, 0, sizeof(l_in));
+	l_in.sin_family = AF_INET;
+	l_in.sin_addr.s_addr = htonl(INADDR_ANY);
+	l_in.sin_port = htons(a_port);
+
+	if (bind(l_fd, (const sockaddr*)&l_in, sizeof(l_in)) != 0 ||
+		listen(l_fd, SOMAXCONN) != 0)
+	{
+		close(l_fd);
+		throw runtime_error("Failed to bind server to the specified address. Verify that the address is not already in use.");
+	}
+
+	CUringListener::Ptr l_listener = make_shared<CUringListener>(m_dispatcher->Loop(0), l_fd);
+
+	m_dispatcher->Loop(0)->Run(
+		[this, l_listener] ()
+		{
+			l_listener->Start(bind(&Impl::p_Accept, this, placeholders::_1));
+		});
+
+	m_listener = move(l_listener);
+	m_port = a_port;
+}
+
+inline void CUringDataServer::Impl::p_StopListening()
+{
+	if (!m_listener)
+		return;
+
+	CUringListener::Ptr l_listener = move(m_listener);
+
+	m_dispatcher->Loop(0)->Run(
+		[l_listener] ()
+		{
+			l_listener->Stop();
+		});
+}
+
+inline void CUringDataServer::Impl::SetSocketOptions(const CSocketOptions &a_options)
+{
+	if (m_listener)
+		throw runtime_error("The socket options can only be changed before the server is started.");
+
+	m_options = a_options;
+}
+
+inline void CUringDataServer::Impl::Shutdown()
+{
+	unordered_map<CUringDataConnection*, CUringDataConnection::Ptr> l_conns;
+
+	{
+		lock_guard<mutex> l_lock(m_connLock);
+		l_conns.swap(m_conns);
+	}
+
+	for (const auto &l_pair : l_conns)
+	{
+		((CUringServerConnImpl*)l_pair.first->GetImpl())->Detach();
+	}
+}
+
+inline size_t CUringDataServer::Impl::NumClients() const
+{
+	lock_guard<mutex> l_lock(m_connLock);
+	return m_conns.size();
+}
+
+inline void CUringDataServer::Impl::Broadcast(const util::CBuffer &a_buff)
+{
+	lock_guard<mutex> l_lock(m_connLock);
+	for (const auto &iter : m_conns)
+	{
+		iter.first->Send(a_buff, nullptr);
+	}
+}
+
+inline void CUringDataServer::Impl::p_Accept(int a_fd)
+{
+	sockaddr_storage l_address;
+	socklen_t l_addressLen = sizeof(l_address);
+
+	string l_hostName;
+	int l_port = -1;
+
+	if (getpeername(a_fd, (sockaddr*)&l_address, &l_addressLen) == 0)
+	{
+		char l_scratch[INET6_ADDRSTRLEN] = { 0 };
+
+		if (l_address.ss_family == AF_INET)
+		{
+			const sockaddr_in *l_in = (const sockaddr_in*)&l_address;
+			inet_ntop(AF_INET, &l_in->sin_addr, l_scratch, sizeof(l_scratch));
+			l_port = ntohs(l_in->sin_port);
+		}
+		else if (l_address.ss_family == AF_INET6)
+		{
+			const sockaddr_in6 *l_in6 = (const sockaddr_in6*)&l_address;
+			inet_ntop(AF_INET6, &l_in6->sin6_addr, l_scratch, sizeof(l_scratch));
+			l_port = ntohs(l_in6->sin6_port);
+		}
+
+		l_hostName = l_scratch;
+	}
+
+	m_options.Apply(a_fd);
+
+	unique_ptr<CUringServerConnImpl> l_impl(
+			new CUringServerConnImpl(this, move(l_hostName), l_port, m_dispatcher, a_fd, m_options));
+
+	auto l_ptr = l_impl.get();
+
+	auto l_conn = make_shared<CUringDataConnection>(move(l_impl));
+	l_ptr->Conn = l_conn.get();
+
+	{
+		lock_guard<mutex> l_lock(m_connLock);
+		m_conns.insert(make_pair(l_conn.get(), l_conn));
+	}
+
+	cout << "Client Connected." << endl;
+
+	if (m_connectedHandler)
+		m_connectedHandler(l_conn);
+}
+
+}
+}
+}
+
+
+
+#endif /* URING_DATA_SERVER_IMPL_H_ */
@@ -0,0 +1,376 @@
+/*
+ * File description: uring_dispatcher.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef URING_DISPATCHER_H_
+#define URING_DISPATCHER_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <poll.h>
+#include <sys/eventfd.h>
+
+#include "uring.h"
+
+using namespace std;
+
+namespace axon { namespace communication { namespace uring {
+
+// Something that has operations in flight on a loop
+class IUringHandler
+{
+public:
+	typedef shared_ptr<IUringHandler> Ptr;
+
+	virtual ~IUringHandler() { }
+
+	virtual void OnComplete(uint8_t a_op, const io_uring_cqe &a_cqe) = 0;
+};
+
+/*
+ * A thread with its own ring and receive buffers. Handlers are added to
+ * the loop and get the completions for the operations that they queue.
+ * Everything about a handler happens on the loop thread; other threads
+ * hand work over with Post, and whatever is queued while the loop is busy
+ * is submitted together the next time it goes to wait.
+ */
+class CUringLoop
+{
+private:
+	static const uint64_t WAKE_ID = 0;
+
+	unique_ptr<CUring> m_ring;
+	unique_ptr<CUringBufferRing> m_buffers;
+
+	int m_wakeFd;
+	uint64_t m_wakeValue;
+
+	mutex m_postLock;
+	vector<function<void ()>> m_posted;
+
+	atomic<bool> m_terminating;
+	thread::id m_threadId;
+
+	// Only used on the loop thread
+	unordered_map<uint64_t, IUringHandler::Ptr> m_handlers;
+	uint64_t m_nextId;
+
+public:
+	typedef shared_ptr<CUringLoop> Ptr;
+
+	static const unsigned RING_ENTRIES = 256;
+	static const uint16_t BUFFER_GROUP = 0;
+	static const size_t NUM_BUFFERS = 128;
+	static const size_t BUFFER_SIZE = 16 * 1024;
+
+	CUringLoop()
+		: m_wakeValue(0), m_terminating(false), m_nextId(WAKE_ID + 1)
+	{
+		m_ring.reset(new CUring(RING_ENTRIES));
+		m_buffers.reset(new CUringBufferRing(*m_ring, BUFFER_GROUP, NUM_BUFFERS, BUFFER_SIZE));
+
+		m_wakeFd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+		if (m_wakeFd < 0)
+			throw runtime_error("Failed to create the io_uring wake event.");
+	}
+	~CUringLoop()
+	{
+		m_handlers.clear();
+
+		// The buffers are registered with the ring, so they go after it
+		m_ring.reset();
+		m_buffers.reset();
+
+		close(m_wakeFd);
+	}
+
+	bool InLoop() const { return m_threadId == this_thread::get_id(); }
+
+	// Runs the function on the loop thread
+	void Post(function<void ()> a_fn)
+	{
+		bool l_wake;
+
+		{
+			lock_guard<mutex> l_lock(m_postLock);
+
+			l_wake = m_posted.empty();
+			m_posted.push_back(move(a_fn));
+		}
+
+		// The loop takes everything that was posted at once, so it only
+		// needs to be woken up for the first one
+		if (l_wake)
+		{
+			uint64_t l_one = 1;
+			if (write(m_wakeFd, &l_one, sizeof(l_one)) < 0) { }
+		}
+	}
+
+	// Runs the function on the loop thread, and waits for it to finish
+	void Run(function<void ()> a_fn)
+	{
+		if (InLoop())
+		{
+			a_fn();
+			return;
+		}
+
+		mutex l_doneLock;
+		condition_variable l_doneCV;
+		bool l_done = false;
+
+		Post([&] ()
+			{
+				a_fn();
+
+				lock_guard<mutex> l_lock(l_doneLock);
+				l_done = true;
+				l_doneCV.notify_all();
+			});
+
+		unique_lock<mutex> l_lock(l_doneLock);
+		l_doneCV.wait(l_lock, [&l_done] () { return l_done; });
+	}
+
+	// The following are only used on the loop thread
+
+	uint64_t Add(IUringHandler::Ptr a_handler)
+	{
+		const uint64_t l_id = m_nextId++;
+		m_handlers.emplace(l_id, move(a_handler));
+		return l_id;
+	}
+
+	void Remove(uint64_t a_id)
+	{
+		m_handlers.erase(a_id);
+	}
+
+	// The completion for the entry goes to the handler with the id
+	io_uring_sqe *GetSqe(uint64_t a_id, uint8_t a_op)
+	{
+		io_uring_sqe *l_sqe = m_ring->GetSqe();
+		l_sqe->user_data = (a_id << 8) | a_op;
+		return l_sqe;
+	}
+
+	// Sends whatever is queued right away, instead of when the loop waits
+	void Flush()
+	{
+		m_ring->Submit(false);
+	}
+
+	CUringBufferRing &Buffers() { return *m_buffers; }
+
+	void Stop()
+	{
+		m_terminating = true;
+
+		Post([] () { });
+	}
+
+	// Called by the thread that is going to run the loop, before anything
+	// else can use it
+	void Bind()
+	{
+		m_threadId = this_thread::get_id();
+	}
+
+	void Loop(size_t a_idx)
+	{
+		p_ArmWake();
+
+		while (!m_terminating)
+		{
+			// Queued work is submitted in the same call that waits for more
+			if (m_ring->Submit(!m_ring->HasCompletions()) < 0 && errno != EBUSY)
+			{
+				cout << "Failed to enter the io_uring. Error: " << errno << endl;
+				break;
+			}
+
+			m_ring->ProcessCompletions(
+					[this] (const io_uring_cqe &a_cqe)
+					{
+						p_Dispatch(a_cqe);
+					});
+
+			p_RunPosted();
+		}
+
+		// Nothing waits on work that was posted after the loop ended
+		p_RunPosted();
+
+		m_handlers.clear();
+
+		cout << "Exiting io_uring loop " << a_idx << "." << endl;
+	}
+
+private:
+	void p_ArmWake()
+	{
+		io_uring_sqe *l_sqe = GetSqe(WAKE_ID, 0);
+		l_sqe->opcode = IORING_OP_POLL_ADD;
+		l_sqe->fd = m_wakeFd;
+		l_sqe->len = IORING_POLL_ADD_MULTI;
+		l_sqe->poll32_events = POLLIN;
+	}
+
+	void p_Dispatch(const io_uring_cqe &a_cqe)
+	{
+		const uint64_t l_id = a_cqe.user_data >> 8;
+
+		if (l_id == WAKE_ID)
+		{
+			while (read(m_wakeFd, &m_wakeValue, sizeof(m_wakeValue)) > 0) { }
+
+			if (!(a_cqe.flags & IORING_CQE_F_MORE))
+				p_ArmWake();
+			return;
+		}
+
+		auto iter = m_handlers.find(l_id);
+
+		if (iter == m_handlers.end())
+		{
+			// The handler is gone, but the buffer still has to go back
+			if (a_cqe.flags & IORING_CQE_F_BUFFER)
+				m_buffers->Recycle(a_cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+			return;
+		}
+
+		// The handler can remove itself
+		IUringHandler::Ptr l_handler = iter->second;
+
+		l_handler->OnComplete(uint8_t(a_cqe.user_data & 0xFF), a_cqe);
+	}
+
+	void p_RunPosted()
+	{
+		vector<function<void ()>> l_posted;
+
+		{
+			lock_guard<mutex> l_lock(m_postLock);
+			l_posted.swap(m_posted);
+		}
+
+		for (auto &l_fn : l_posted)
+			l_fn();
+	}
+};
+
+/*
+ * The io_uring counterpart of CDispatcher. Each thread runs a loop, and
+ * servers accept on the first one and spread the clients over the rest.
+ */
+class CUringDispatcher
+{
+private:
+	struct make_private {};
+
+	static const size_t NUM_THREADS = 8;
+
+	vector<CUringLoop::Ptr> m_loops;
+	vector<thread> m_threads;
+
+	mutex m_lock;
+	size_t m_lastLoop;
+
+public:
+	typedef shared_ptr<CUringDispatcher> Ptr;
+
+	CUringDispatcher(size_t a_numThreads, make_private)
+		: m_lastLoop(0)
+	{
+		for (size_t i = 0; i < a_numThreads; ++i)
+		{
+			m_loops.push_back(make_shared<CUringLoop>());
+
+			mutex l_startLock;
+			condition_variable l_startCV;
+			bool l_started = false;
+
+			CUringLoop::Ptr l_loop = m_loops.back();
+
+			// The thread keeps its loop alive, since the dispatcher can be
+			// released from one of its own handlers
+			m_threads.emplace_back(
+					[l_loop, i, &l_startLock, &l_startCV, &l_started] ()
+					{
+						l_loop->Bind();
+
+						{
+							// Notified under the lock, since the constructor
+							// owns the condition variable
+							lock_guard<mutex> l_lock(l_startLock);
+							cout << "Entering io_uring loop " << i << "." << endl;
+							l_started = true;
+							l_startCV.notify_all();
+						}
+
+						l_loop->Loop(i);
+					});
+
+			unique_lock<mutex> l_lock(l_startLock);
+			l_startCV.wait(l_lock, [&l_started] () { return l_started; });
+		}
+	}
+	~CUringDispatcher()
+	{
+		for (size_t i = 0; i < m_loops.size(); ++i)
+		{
+			m_loops[i]->Stop();
+
+			if (m_threads[i].get_id() == this_thread::get_id())
+				m_threads[i].detach();
+			else
+				m_threads[i].join();
+		}
+	}
+
+	static Ptr Get(size_t a_numThreads = NUM_THREADS)
+	{
+		return make_shared<CUringDispatcher>(a_numThreads, make_private());
+	}
+
+	static size_t OptimalNumThreads()
+	{
+		return NUM_THREADS;
+	}
+
+	size_t NumThreads() const { return m_loops.size(); }
+
+	CUringLoop *Loop(size_t a_idx) const { return m_loops[a_idx].get(); }
+
+	CUringLoop *GetNextLoop()
+	{
+		lock_guard<mutex> l_lock(m_lock);
+
+		++m_lastLoop;
+		if (m_lastLoop >= m_loops.size())
+		{
+			if (m_loops.size() == 1)
+				m_lastLoop = 0;
+			else
+				m_lastLoop = 1;
+		}
+
+		return Loop(m_lastLoop);
+	}
+};
+
+} } }
+
+#endif /* URING_DISPATCHER_H_ */
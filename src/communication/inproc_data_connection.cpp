@@ -0,0 +1,85 @@
+/*
+ * File description: inproc_data_connection.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include "communication/inproc/inproc_data_connection.h"
+
+#include "detail/inproc_data_connection_impl.h"
+
+namespace axon { namespace communication { namespace inproc {
+
+namespace {
+
+register_protocol<CInprocDataConnection> s_inprocRegister("inproc");
+
+}
+
+CInprocDataConnection::CInprocDataConnection()
+	: m_impl(new Impl)
+{
+}
+
+CInprocDataConnection::CInprocDataConnection(const std::string& a_name)
+	: m_impl(new Impl(a_name))
+{
+}
+
+CInprocDataConnection::CInprocDataConnection(std::unique_ptr<Impl> a_impl)
+	: m_impl(move(a_impl))
+{
+}
+
+CInprocDataConnection::~CInprocDataConnection()
+{
+	// Destructor simply here so that the unique_ptr to an opaque class
+	// will compile
+}
+
+std::string CInprocDataConnection::ConnectionString() const
+{
+	return m_impl->ConnectionString();
+}
+
+bool CInprocDataConnection::Connect(const std::string& a_name)
+{
+	return m_impl->Connect(a_name);
+}
+
+void CInprocDataConnection::Close()
+{
+	m_impl->Close();
+}
+
+bool CInprocDataConnection::IsOpen() const
+{
+	return m_impl->IsOpen();
+}
+
+bool CInprocDataConnection::IsServerClient() const
+{
+	return m_impl->IsServerClient();
+}
+
+void CInprocDataConnection::Send(const util::CBuffer& a_buff, std::condition_variable* a_finishEvt)
+{
+	m_impl->Send(a_buff, a_finishEvt);
+}
+
+void CInprocDataConnection::SetReceiveHandler(DataReceivedHandler a_handler)
+{
+	m_impl->SetReceiveHandler(move(a_handler));
+}
+
+void CInprocDataConnection::SendMessage(CMessage::Ptr a_message)
+{
+	m_impl->SendMessage(move(a_message));
+}
+
+void CInprocDataConnection::SetMessageHandler(MessageReceivedHandler a_handler)
+{
+	m_impl->SetMessageHandler(move(a_handler));
+}
+
+} } }
@@ -0,0 +1,73 @@
+/*
+ * File description: inproc_data_server.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include "communication/inproc/inproc_data_server.h"
+
+#include "detail/inproc_data_server_impl.h"
+
+namespace axon { namespace communication { namespace inproc {
+
+namespace {
+
+register_server<CInprocDataServer> s_inprocRegister("inproc");
+
+}
+
+CInprocDataServer::CInprocDataServer()
+	: m_impl(new Impl)
+{
+}
+
+CInprocDataServer::CInprocDataServer(const string &a_name)
+	: m_impl(new Impl(a_name))
+{
+}
+
+CInprocDataServer::~CInprocDataServer()
+{
+	// Marker destructor that enables the opaque Impl pointer
+	// to be managed by unique_ptr
+}
+
+void CInprocDataServer::Startup(const string& a_name)
+{
+	m_impl->Startup(a_name);
+}
+
+std::string CInprocDataServer::HostString() const
+{
+	return m_impl->HostString();
+}
+
+void CInprocDataServer::Shutdown()
+{
+	m_impl->Shutdown();
+}
+
+size_t CInprocDataServer::NumClients() const
+{
+	return m_impl->NumClients();
+}
+
+void CInprocDataServer::Broadcast(const util::CBuffer& a_buff)
+{
+	m_impl->Broadcast(a_buff);
+}
+
+void CInprocDataServer::SetConnectedHandler(ConnectedHandler a_handler)
+{
+	m_impl->SetConnectedHandler(a_handler);
+}
+
+void CInprocDataServer::SetDisconnectedHandler(DisconnectedHandler a_handler)
+{
+	m_impl->SetDisconnectedHandler(a_handler);
+}
+
+
+}
+}
+}
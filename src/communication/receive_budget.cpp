@@ -0,0 +1,37 @@
+/*
+ * File description: receive_budget.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include "communication/messaging/receive_budget.h"
+
+using namespace std;
+
+namespace axon { namespace communication {
+
+CReceiveBudget::CReceiveBudget(size_t a_limit, size_t a_connectionLimit, size_t a_maxFrameSize)
+	: m_limit(a_limit), m_connectionLimit(a_connectionLimit), m_maxFrameSize(a_maxFrameSize),
+	  m_inUse(0), m_numRejected(0)
+{
+}
+
+bool CReceiveBudget::TryReserve(size_t a_size)
+{
+	size_t l_inUse = m_inUse;
+
+	do
+	{
+		if (m_limit && (a_size > m_limit || l_inUse > m_limit - a_size))
+			return false;
+	} while (!m_inUse.compare_exchange_weak(l_inUse, l_inUse + a_size));
+
+	return true;
+}
+
+void CReceiveBudget::Release(size_t a_size)
+{
+	m_inUse -= a_size;
+}
+
+} }
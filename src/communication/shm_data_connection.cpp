@@ -0,0 +1,80 @@
+/*
+ * File description: shm_data_connection.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+// The rings are woken up with eventfd, which only exists on Linux
+#ifdef __linux__
+
+#include "communication/shm/shm_data_connection.h"
+
+#include "detail/shm_data_connection_impl.h"
+
+namespace axon { namespace communication { namespace shm {
+
+namespace {
+
+register_protocol<CShmDataConnection> s_shmRegister("shm");
+
+}
+
+CShmDataConnection::CShmDataConnection()
+	: m_impl(new Impl)
+{
+}
+
+CShmDataConnection::CShmDataConnection(const std::string& a_name)
+	: m_impl(new Impl(a_name))
+{
+}
+
+CShmDataConnection::CShmDataConnection(std::unique_ptr<Impl> a_impl)
+	: m_impl(move(a_impl))
+{
+}
+
+CShmDataConnection::~CShmDataConnection()
+{
+	// Destructor simply here so that the unique_ptr to an opaque class
+	// will compile
+}
+
+std::string CShmDataConnection::ConnectionString() const
+{
+	return m_impl->ConnectionString();
+}
+
+bool CShmDataConnection::Connect(const std::string& a_name)
+{
+	return m_impl->Connect(a_name);
+}
+
+void CShmDataConnection::Close()
+{
+	m_impl->Close();
+}
+
+bool CShmDataConnection::IsOpen() const
+{
+	return m_impl->IsOpen();
+}
+
+bool CShmDataConnection::IsServerClient() const
+{
+	return m_impl->IsServerClient();
+}
+
+void CShmDataConnection::Send(const util::CBuffer& a_buff, std::condition_variable* a_finishEvt)
+{
+	m_impl->Send(a_buff, a_finishEvt);
+}
+
+void CShmDataConnection::SetReceiveHandler(DataReceivedHandler a_handler)
+{
+	m_impl->SetReceiveHandler(move(a_handler));
+}
+
+} } }
+
+#endif
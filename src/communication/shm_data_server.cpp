@@ -0,0 +1,87 @@
+/*
+ * File description: shm_data_server.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifdef __linux__
+
+#include "communication/shm/shm_data_server.h"
+
+#include "detail/shm_data_server_impl.h"
+
+namespace axon { namespace communication { namespace shm {
+
+namespace {
+
+register_server<CShmDataServer> s_shmRegister("shm");
+
+}
+
+CShmDataServer::CShmDataServer()
+	: m_impl(new Impl)
+{
+}
+
+CShmDataServer::CShmDataServer(const string &a_name)
+	: m_impl(new Impl(a_name))
+{
+}
+
+CShmDataServer::~CShmDataServer()
+{
+	// Marker destructor that enables the opaque Impl pointer
+	// to be managed by unique_ptr
+}
+
+void CShmDataServer::Startup(const string& a_name)
+{
+	m_impl->Startup(a_name);
+}
+
+std::string CShmDataServer::HostString() const
+{
+	return m_impl->HostString();
+}
+
+void CShmDataServer::Shutdown()
+{
+	m_impl->Shutdown();
+}
+
+size_t CShmDataServer::NumClients() const
+{
+	return m_impl->NumClients();
+}
+
+void CShmDataServer::Broadcast(const util::CBuffer& a_buff)
+{
+	m_impl->Broadcast(a_buff);
+}
+
+void CShmDataServer::SetConnectedHandler(ConnectedHandler a_handler)
+{
+	m_impl->SetConnectedHandler(a_handler);
+}
+
+void CShmDataServer::SetDisconnectedHandler(DisconnectedHandler a_handler)
+{
+	m_impl->SetDisconnectedHandler(a_handler);
+}
+
+size_t CShmDataServer::RingSize() const
+{
+	return m_impl->RingSize();
+}
+
+void CShmDataServer::SetRingSize(size_t a_size)
+{
+	m_impl->SetRingSize(a_size);
+}
+
+
+}
+}
+}
+
+#endif
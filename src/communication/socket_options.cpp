@@ -0,0 +1,205 @@
+/*
+ * File description: socket_options.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include "communication/tcp/socket_options.h"
+
+#include <cerrno>
+#include <iostream>
+#include <sstream>
+#include <stdexcept>
+
+#ifdef IS_WINDOWS
+#include <WinSock2.h>
+#include <Ws2tcpip.h>
+#else
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#endif
+
+#include "util/string_convert.h"
+
+using namespace std;
+using namespace axon::util;
+
+namespace axon { namespace communication { namespace tcp {
+
+namespace {
+
+void s_SetOption(int a_socket, int a_level, int a_name, int a_value, const char *a_display)
+{
+	if (setsockopt(a_socket, a_level, a_name, (const char*)&a_value, sizeof(a_value)) != 0)
+	{
+		cout << "Failed to set the " << a_display << " socket option. Error: " << errno << endl;
+	}
+}
+
+bool s_IsTcp(int a_socket)
+{
+	sockaddr_storage l_address;
+	socklen_t l_addressLen = sizeof(l_address);
+
+	if (getsockname(a_socket, (sockaddr*)&l_address, &l_addressLen) != 0)
+		return false;
+
+	return l_address.ss_family == AF_INET || l_address.ss_family == AF_INET6;
+}
+
+}
+
+CSocketOptions::CSocketOptions()
+	: NoDelay(true), SendBufferSize(0), ReceiveBufferSize(0), QuickAck(false), BusyPoll(0),
+	  KeepAlive(false), KeepAliveIdle(0), KeepAliveInterval(0), KeepAliveCount(0)
+{
+}
+
+CSocketOptions CSocketOptions::Parse(const string &a_options)
+{
+	CSocketOptions l_ret;
+
+	size_t l_start = 0;
+
+	while (l_start < a_options.size())
+	{
+		size_t l_end = a_options.find('&', l_start);
+
+		if (l_end == string::npos)
+			l_end = a_options.size();
+
+		const string l_option = a_options.substr(l_start, l_end - l_start);
+
+		l_start = l_end + 1;
+
+		if (l_option.empty())
+			continue;
+
+		const size_t l_eqIdx = l_option.find('=');
+
+		if (l_eqIdx == string::npos)
+			throw runtime_error("Invalid socket option '" + l_option + "'. Must be of format [name]=[value]");
+
+		const string l_name = l_option.substr(0, l_eqIdx);
+		const int l_value = StringTo<int>(l_option.substr(l_eqIdx + 1));
+
+		if (l_name == "nodelay")
+			l_ret.NoDelay = l_value != 0;
+		else if (l_name == "sndbuf")
+			l_ret.SendBufferSize = l_value;
+		else if (l_name == "rcvbuf")
+			l_ret.ReceiveBufferSize = l_value;
+		else if (l_name == "quickack")
+			l_ret.QuickAck = l_value != 0;
+		else if (l_name == "busypoll")
+			l_ret.BusyPoll = l_value;
+		else if (l_name == "keepalive")
+			l_ret.KeepAlive = l_value != 0;
+		else if (l_name == "keepidle")
+			l_ret.KeepAliveIdle = l_value;
+		else if (l_name == "keepintvl")
+			l_ret.KeepAliveInterval = l_value;
+		else if (l_name == "keepcnt")
+			l_ret.KeepAliveCount = l_value;
+		else
+			throw runtime_error("Unknown socket option '" + l_name + "'.");
+	}
+
+	return l_ret;
+}
+
+string CSocketOptions::Split(const string &a_string, CSocketOptions &a_options)
+{
+	const size_t l_qIdx = a_string.find('?');
+
+	if (l_qIdx == string::npos)
+		return a_string;
+
+	// Parsed on top of the current options, rather than the defaults
+	const string l_options = a_options.ToString() + "&" + a_string.substr(l_qIdx + 1);
+
+	a_options = Parse(l_options);
+
+	return a_string.substr(0, l_qIdx);
+}
+
+void CSocketOptions::Apply(int a_socket) const
+{
+	// UNIX sockets share the TCP code, but only have the buffer sizes
+	if (s_IsTcp(a_socket))
+	{
+		s_SetOption(a_socket, IPPROTO_TCP, TCP_NODELAY, NoDelay ? 1 : 0, "TCP_NODELAY");
+
+		if (KeepAlive)
+		{
+			s_SetOption(a_socket, SOL_SOCKET, SO_KEEPALIVE, 1, "SO_KEEPALIVE");
+
+#ifdef TCP_KEEPIDLE
+			if (KeepAliveIdle > 0)
+				s_SetOption(a_socket, IPPROTO_TCP, TCP_KEEPIDLE, KeepAliveIdle, "TCP_KEEPIDLE");
+#endif
+#ifdef TCP_KEEPINTVL
+			if (KeepAliveInterval > 0)
+				s_SetOption(a_socket, IPPROTO_TCP, TCP_KEEPINTVL, KeepAliveInterval, "TCP_KEEPINTVL");
+#endif
+#ifdef TCP_KEEPCNT
+			if (KeepAliveCount > 0)
+				s_SetOption(a_socket, IPPROTO_TCP, TCP_KEEPCNT, KeepAliveCount, "TCP_KEEPCNT");
+#endif
+		}
+
+#ifdef TCP_QUICKACK
+		if (QuickAck)
+			s_SetOption(a_socket, IPPROTO_TCP, TCP_QUICKACK, 1, "TCP_QUICKACK");
+#endif
+
+#ifdef SO_BUSY_POLL
+		if (BusyPoll > 0)
+			s_SetOption(a_socket, SOL_SOCKET, SO_BUSY_POLL, BusyPoll, "SO_BUSY_POLL");
+#endif
+	}
+
+	// Accepted sockets already have these from the listener, but setting
+	// them again is harmless
+	ApplyToListener(a_socket);
+}
+
+void CSocketOptions::ApplyToListener(int a_socket) const
+{
+	if (SendBufferSize > 0)
+		s_SetOption(a_socket, SOL_SOCKET, SO_SNDBUF, SendBufferSize, "SO_SNDBUF");
+	if (ReceiveBufferSize > 0)
+		s_SetOption(a_socket, SOL_SOCKET, SO_RCVBUF, ReceiveBufferSize, "SO_RCVBUF");
+}
+
+void CSocketOptions::RearmQuickAck(int a_socket) const
+{
+#ifdef TCP_QUICKACK
+	// Runs on every read, so failures are left to Apply to report once
+	if (QuickAck)
+	{
+		int l_one = 1;
+		setsockopt(a_socket, IPPROTO_TCP, TCP_QUICKACK, (const char*)&l_one, sizeof(l_one));
+	}
+#endif
+}
+
+string CSocketOptions::ToString() const
+{
+	ostringstream l_ss;
+
+	l_ss << "nodelay=" << (NoDelay ? 1 : 0)
+		 << "&sndbuf=" << SendBufferSize
+		 << "&rcvbuf=" << ReceiveBufferSize
+		 << "&quickack=" << (QuickAck ? 1 : 0)
+		 << "&busypoll=" << BusyPoll
+		 << "&keepalive=" << (KeepAlive ? 1 : 0)
+		 << "&keepidle=" << KeepAliveIdle
+		 << "&keepintvl=" << KeepAliveInterval
+		 << "&keepcnt=" << KeepAliveCount;
+
+	return l_ss.str();
+}
+
+} } }
@@ -79,9 +79,64 @@ void CTcpDataConnection::Send(const util::CBuffer& a_buff, std::condition_variab
 	m_impl->Send(a_buff, a_finishEvt);
 }
 
+bool CTcpDataConnection::SendDroppable(const util::CBuffer& a_buff)
+{
+	return m_impl->SendDroppable(a_buff);
+}
+
+void CTcpDataConnection::CheckSend()
+{
+	m_impl->CheckSend();
+}
+
+void CTcpDataConnection::SendChecked(const util::CBuffer& a_buff)
+{
+	m_impl->SendChecked(a_buff);
+}
+
+bool CTcpDataConnection::WaitForSendQueue(size_t a_size)
+{
+	return m_impl->WaitForSendQueue(a_size);
+}
+
+bool CTcpDataConnection::CanWaitForSendQueue() const
+{
+	return m_impl->CanWaitForSendQueue();
+}
+
 void CTcpDataConnection::SetReceiveHandler(DataReceivedHandler a_handler)
 {
 	m_impl->SetReceiveHandler(move(a_handler));
 }
 
+const CSocketOptions &CTcpDataConnection::SocketOptions() const
+{
+	return m_impl->SocketOptions();
+}
+
+void CTcpDataConnection::SetSocketOptions(const CSocketOptions &a_options)
+{
+	m_impl->SetSocketOptions(a_options);
+}
+
+CSendLimits CTcpDataConnection::SendLimits() const
+{
+	return m_impl->SendLimits();
+}
+
+void CTcpDataConnection::SetSendLimits(const CSendLimits &a_limits)
+{
+	m_impl->SetSendLimits(a_limits);
+}
+
+void CTcpDataConnection::SetWritableHandler(WritableHandler a_handler)
+{
+	m_impl->SetWritableHandler(move(a_handler));
+}
+
+size_t CTcpDataConnection::NumDropped() const
+{
+	return m_impl->NumDropped();
+}
+
 } } }
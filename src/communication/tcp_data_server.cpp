@@ -77,6 +77,26 @@ void CTcpDataServer::SetDisconnectedHandler(DisconnectedHandler a_handler)
 	m_impl->SetDisconnectedHandler(a_handler);
 }
 
+const CSocketOptions &CTcpDataServer::SocketOptions() const
+{
+	return m_impl->SocketOptions();
+}
+
+void CTcpDataServer::SetSocketOptions(const CSocketOptions &a_options)
+{
+	m_impl->SetSocketOptions(a_options);
+}
+
+CSendLimits CTcpDataServer::SendLimits() const
+{
+	return m_impl->SendLimits();
+}
+
+void CTcpDataServer::SetSendLimits(const CSendLimits &a_limits)
+{
+	m_impl->SetSendLimits(a_limits);
+}
+
 
 }
 }
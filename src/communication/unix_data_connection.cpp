@@ -0,0 +1,70 @@
+/*
+ * File description: unix_data_connection.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include "communication/unix/unix_data_connection.h"
+
+#include "detail/unix_data_connection_impl.h"
+
+namespace axon { namespace communication { namespace unix_socket {
+
+namespace {
+
+register_protocol<CUnixDataConnection> s_unixRegister("unix");
+
+}
+
+CUnixDataConnection::CUnixDataConnection()
+	: m_impl(new Impl)
+{
+}
+
+CUnixDataConnection::CUnixDataConnection(const std::string& a_path)
+	: m_impl(new Impl(a_path))
+{
+}
+
+CUnixDataConnection::~CUnixDataConnection()
+{
+	// Destructor simply here so that the unique_ptr to an opaque class
+	// will compile
+}
+
+std::string CUnixDataConnection::ConnectionString() const
+{
+	return m_impl->ConnectionString();
+}
+
+bool CUnixDataConnection::Connect(const std::string& a_path)
+{
+	return m_impl->Connect(a_path);
+}
+
+void CUnixDataConnection::Close()
+{
+	m_impl->Close();
+}
+
+bool CUnixDataConnection::IsOpen() const
+{
+	return m_impl->IsOpen();
+}
+
+bool CUnixDataConnection::IsServerClient() const
+{
+	return m_impl->IsServerClient();
+}
+
+void CUnixDataConnection::Send(const util::CBuffer& a_buff, std::condition_variable* a_finishEvt)
+{
+	m_impl->Send(a_buff, a_finishEvt);
+}
+
+void CUnixDataConnection::SetReceiveHandler(DataReceivedHandler a_handler)
+{
+	m_impl->SetReceiveHandler(move(a_handler));
+}
+
+} } }
@@ -0,0 +1,73 @@
+/*
+ * File description: unix_data_server.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include "communication/unix/unix_data_server.h"
+
+#include "detail/unix_data_server_impl.h"
+
+namespace axon { namespace communication { namespace unix_socket {
+
+namespace {
+
+register_server<CUnixDataServer> s_unixRegister("unix");
+
+}
+
+CUnixDataServer::CUnixDataServer()
+	: m_impl(new Impl)
+{
+}
+
+CUnixDataServer::CUnixDataServer(const string &a_path)
+	: m_impl(new Impl(a_path))
+{
+}
+
+CUnixDataServer::~CUnixDataServer()
+{
+	// Marker destructor that enables the opaque Impl pointer
+	// to be managed by unique_ptr
+}
+
+void CUnixDataServer::Startup(const string& a_path)
+{
+	m_impl->Startup(a_path);
+}
+
+std::string CUnixDataServer::HostString() const
+{
+	return m_impl->HostString();
+}
+
+void CUnixDataServer::Shutdown()
+{
+	m_impl->Shutdown();
+}
+
+size_t CUnixDataServer::NumClients() const
+{
+	return m_impl->NumClients();
+}
+
+void CUnixDataServer::Broadcast(const util::CBuffer& a_buff)
+{
+	m_impl->Broadcast(a_buff);
+}
+
+void CUnixDataServer::SetConnectedHandler(ConnectedHandler a_handler)
+{
+	m_impl->SetConnectedHandler(a_handler);
+}
+
+void CUnixDataServer::SetDisconnectedHandler(DisconnectedHandler a_handler)
+{
+	m_impl->SetDisconnectedHandler(a_handler);
+}
+
+
+}
+}
+}
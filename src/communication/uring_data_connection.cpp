@@ -0,0 +1,100 @@
+/*
+ * File description: uring_data_connection.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+// io_uring only exists on Linux
+#ifdef __linux__
+
+#include "communication/uring/uring_data_connection.h"
+
+#include "detail/uring_data_connection_impl.h"
+
+namespace axon { namespace communication { namespace uring {
+
+namespace {
+
+register_protocol<CUringDataConnection> s_uringRegister("uring");
+
+}
+
+CUringDataConnection::CUringDataConnection()
+	: m_impl(new Impl)
+{
+}
+
+CUringDataConnection::CUringDataConnection(const std::string& a_connectionString)
+	: m_impl(new Impl(a_connectionString))
+{
+}
+
+CUringDataConnection::CUringDataConnection(std::string a_hostName, int a_port)
+	: m_impl(new Impl(move(a_hostName), a_port))
+{
+}
+
+CUringDataConnection::CUringDataConnection(std::unique_ptr<Impl> a_impl)
+	: m_impl(move(a_impl))
+{
+}
+
+CUringDataConnection::~CUringDataConnection()
+{
+	// Destructor simply here so that the unique_ptr to an opaque class
+	// will compile
+}
+
+std::string CUringDataConnection::ConnectionString() const
+{
+	return m_impl->ConnectionString();
+}
+
+bool CUringDataConnection::Connect(std::string a_hostName, int a_port)
+{
+	return m_impl->Connect(move(a_hostName), a_port);
+}
+
+bool CUringDataConnection::Connect(const std::string& a_connectionString)
+{
+	return m_impl->Connect(a_connectionString);
+}
+
+void CUringDataConnection::Close()
+{
+	m_impl->Close();
+}
+
+bool CUringDataConnection::IsOpen() const
+{
+	return m_impl->IsOpen();
+}
+
+bool CUringDataConnection::IsServerClient() const
+{
+	return m_impl->IsServerClient();
+}
+
+void CUringDataConnection::Send(const util::CBuffer& a_buff, std::condition_variable* a_finishEvt)
+{
+	m_impl->Send(a_buff, a_finishEvt);
+}
+
+void CUringDataConnection::SetReceiveHandler(DataReceivedHandler a_handler)
+{
+	m_impl->SetReceiveHandler(move(a_handler));
+}
+
+const tcp::CSocketOptions &CUringDataConnection::SocketOptions() const
+{
+	return m_impl->SocketOptions();
+}
+
+void CUringDataConnection::SetSocketOptions(const tcp::CSocketOptions &a_options)
+{
+	m_impl->SetSocketOptions(a_options);
+}
+
+} } }
+
+#endif
@@ -0,0 +1,97 @@
+/*
+ * File description: uring_data_server.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifdef __linux__
+
+#include "communication/uring/uring_data_server.h"
+
+#include "detail/uring_data_server_impl.h"
+
+namespace axon { namespace communication { namespace uring {
+
+namespace {
+
+register_server<CUringDataServer> s_uringRegister("uring");
+
+}
+
+CUringDataServer::CUringDataServer()
+	: m_impl(new Impl)
+{
+}
+
+CUringDataServer::CUringDataServer(const string &a_hostString)
+	: m_impl(new Impl(a_hostString))
+{
+}
+
+CUringDataServer::CUringDataServer(int a_port)
+	: m_impl(new Impl(a_port))
+{
+}
+
+CUringDataServer::~CUringDataServer()
+{
+	// Marker destructor that enables the opaque Impl pointer
+	// to be managed by unique_ptr
+}
+
+void CUringDataServer::Startup(const string& a_hostString)
+{
+	m_impl->Startup(a_hostString);
+}
+
+void CUringDataServer::Startup(int a_port)
+{
+	m_impl->Startup(a_port);
+}
+
+std::string CUringDataServer::HostString() const
+{
+	return m_impl->HostString();
+}
+
+void CUringDataServer::Shutdown()
+{
+	m_impl->Shutdown();
+}
+
+size_t CUringDataServer::NumClients() const
+{
+	return m_impl->NumClients();
+}
+
+void CUringDataServer::Broadcast(const util::CBuffer& a_buff)
+{
+	m_impl->Broadcast(a_buff);
+}
+
+void CUringDataServer::SetConnectedHandler(ConnectedHandler a_handler)
+{
+	m_impl->SetConnectedHandler(a_handler);
+}
+
+void CUringDataServer::SetDisconnectedHandler(DisconnectedHandler a_handler)
+{
+	m_impl->SetDisconnectedHandler(a_handler);
+}
+
+const tcp::CSocketOptions &CUringDataServer::SocketOptions() const
+{
+	return m_impl->SocketOptions();
+}
+
+void CUringDataServer::SetSocketOptions(const tcp::CSocketOptions &a_options)
+{
+	m_impl->SetSocketOptions(a_options);
+}
+
+
+}
+}
+}
+
+#endif
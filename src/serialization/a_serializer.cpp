@@ -8,8 +8,92 @@
 
 #include <fstream>
 
+#if !defined(WIN32) && !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define AXON_MMAP_FILES
+#endif
+
 namespace axon { namespace serialization {
 
+namespace {
+
+util::CBuffer ReadFile(const std::string &a_fileName)
+{
+#ifdef AXON_MMAP_FILES
+	int l_fd = open(a_fileName.c_str(), O_RDONLY);
+
+	if (l_fd < 0)
+		throw std::runtime_error("Unable to open the file '" + a_fileName + "'.");
+
+	struct stat l_stat;
+	if (fstat(l_fd, &l_stat) != 0)
+	{
+		close(l_fd);
+		throw std::runtime_error("Unable to read the file '" + a_fileName + "'.");
+	}
+
+	const size_t l_size = l_stat.st_size;
+
+	if (l_size == 0)
+	{
+		close(l_fd);
+		return util::CBuffer();
+	}
+
+	// Private and writable, so that the buffer can be modified like any
+	// other. Pages are only copied when they are written to
+	void *l_map = mmap(nullptr, l_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, l_fd, 0);
+
+	// The mapping keeps its own reference to the file
+	close(l_fd);
+
+	if (l_map == MAP_FAILED)
+		throw std::runtime_error("Unable to map the file '" + a_fileName + "'.");
+
+	// The decoders read front to back, so the kernel can read ahead
+	// aggressively
+	madvise(l_map, l_size, MADV_SEQUENTIAL);
+	madvise(l_map, l_size, MADV_WILLNEED);
+
+	util::CBuffer::TPtr l_ptr(static_cast<char *>(l_map),
+		[l_size] (char *a_ptr)
+		{
+			munmap(a_ptr, l_size);
+		});
+
+	return util::CBuffer(l_size, std::move(l_ptr));
+#else
+	std::ifstream fs(a_fileName, std::ios_base::binary);
+
+	if (!fs)
+		throw std::runtime_error("Unable to open the file '" + a_fileName + "'.");
+
+	fs.seekg(0, fs.end);
+
+	size_t len = fs.tellg();
+
+	fs.seekg(0, fs.beg);
+
+	util::CBuffer l_buf;
+	l_buf.Reset(len);
+
+	fs.read(l_buf.Data(), len);
+
+	return l_buf;
+#endif
+}
+
+}
+
+ASerializer::ASerializer()
+	: m_compressThreshold(DEFAULT_COMPRESS_THRESHOLD),
+	  m_maxDecompressedSize(DEFAULT_MAX_DECOMPRESSED_SIZE)
+{
+}
+
 ASerializer::~ASerializer()
 {
 }
@@ -32,30 +116,36 @@ size_t ASerializer::SerializeInto(const AData &a_data, char *a_buffer, size_t a_
 	return l_str.size();
 }
 
-void ASerializer::SerializeDataToFile(const std::string &a_fileName, const AData &a_data) const
+void ASerializer::SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const
 {
 	std::string l_ser = SerializeData(a_data);
 
-	std::ofstream fs(a_fileName, std::ios_base::binary);
-
-	fs.write(l_ser.c_str(), l_ser.size());
+	a_stream.write(l_ser.c_str(), l_ser.size());
 }
 
-AData::Ptr ASerializer::DeserializeDataFromFile(const std::string &a_fileName) const
+void ASerializer::SerializeDataToFile(const std::string &a_fileName, const AData &a_data) const
 {
-	std::ifstream fs(a_fileName, std::ios_base::binary);
+	std::ofstream fs(a_fileName, std::ios_base::binary);
 
-	fs.seekg(0, fs.end);
+	if (!fs)
+		throw std::runtime_error("Unable to open the file '" + a_fileName + "'.");
 
-	size_t len = fs.tellg();
+	SerializeDataToStream(fs, a_data);
 
-	fs.seekg(0, fs.beg);
+	fs.close();
 
-	std::string l_str(len, '\0');
+	if (!fs)
+		throw std::runtime_error("Failed to write the file '" + a_fileName + "'.");
+}
 
-	fs.read(&l_str[0], len);
+AData::Ptr ASerializer::DeserializeDataFromFile(const std::string &a_fileName) const
+{
+	return DeserializeSharedData(ReadFile(a_fileName));
+}
 
-	return DeserializeData(l_str.data(), l_str.data() + len);
+AData::Ptr ASerializer::DeserializeSharedData(const util::CBuffer &a_buf) const
+{
+	return DeserializeData(a_buf.Data(), a_buf.Data() + a_buf.Size());
 }
 
 AData::Ptr ASerializer::Deserialize(const std::string& a_str) const
@@ -63,6 +153,11 @@ AData::Ptr ASerializer::Deserialize(const std::string& a_str) const
 	return DeserializeData(a_str.c_str(), a_str.c_str() + a_str.size());
 }
 
+IValueScanner::Ptr ASerializer::CreateScanner() const
+{
+	throw std::runtime_error("The " + FormatName() + " format doesn't support incremental parsing.");
+}
+
 }
 }
 
@@ -5,9 +5,18 @@
  */
 
 #include "serialization/format/axon_serializer.h"
+#include "serialization/format/binary_format_common.h"
+
+#include "detail/varint.h"
+#include "detail/bit_pack.h"
+#include "detail/float_xor.h"
+#include "detail/chunked_writer.h"
+#include "detail/buffer_compression.h"
 
 #include <unordered_map>
 #include <type_traits>
+#include <mutex>
+#include <limits>
 
 using namespace std;
 
@@ -18,9 +27,45 @@ typedef uint64_t ulong;
 
 namespace axon { namespace serialization {
 
+using namespace detail;
+
 const uint MAGIC_NUMBER = 0xBADF00D;
 const ushort VERSION = 1;
 
+// Version 2 streams reference names from a CAxonNameDictionary, and are
+// only written in dictionary mode
+const ushort DICT_VERSION = 2;
+
+// Header flag. Set when the reader should add the names in the header
+// to its dictionary
+const byte HEADER_LEARN = 0x1;
+
+// Primitive array write modes
+const byte PRIM_PLAIN = 0;
+const byte PRIM_PACKED = 1; // Variable length integers
+const byte PRIM_BITS = 2; // 1 bit per bool
+const byte PRIM_DELTA = 3; // Packed differences between integers
+const byte PRIM_XOR = 4; // Floats XORed with the previous value
+
+// Array write modes
+const byte ARRAY_PLAIN = 0;
+const byte ARRAY_COLUMNAR = 1; // Structs with the same fields, one column per field
+
+struct CNameTable
+{
+	typedef shared_ptr<const CNameTable> Ptr;
+
+	// Names in order of first use. The position is the name reference
+	vector<string> Names;
+	unordered_map<string, size_t> Index;
+
+	// The name table exactly as it appears in the header
+	// (number of names, followed by each name)
+	string Encoded;
+
+	void Finalize();
+};
+
 struct MasterContext
 	: IDataContext
 {
@@ -29,57 +74,180 @@ struct MasterContext
 
 	size_t StorageSize;
 
-	unordered_map<string, size_t> NameMap;
-	unordered_map<size_t, string> ReverseMap;
+	CNameTable::Ptr Table;
+
+	// Dictionary mode. References below Base are dictionary entries, and
+	// the rest are offset into the name table of this message
+	const CAxonNameDictionary *Dict = nullptr;
+	size_t Base = 0;
+	bool Learn = false;
+
+	// Set while a new name table is being built. When null, the names
+	// are being validated against a cached table instead
+	CNameTable *Building = nullptr;
+	size_t NumSeen = 0;
+	bool Valid = true;
+
+	// Write integer arrays as variable length integers, when that is smaller
+	bool PackIntegers = false;
+
+	// Write bool arrays as 1 bit per value
+	bool PackBools = false;
+
+	// Write arrays of same shaped structs as columns
+	bool Columnar = false;
+
+	// Buffers that ask for compression, and are at least the threshold size,
+	// are compressed with this. Also used to read compressed buffers
+	const ICompressor *Compressor = nullptr;
+	size_t CompressThreshold = 0;
+	size_t MaxDecompressedSize = 0;
+
+	// Set when a buffer was compressed. Its compressed size depends on the
+	// contents, which can change in place, so the storage size isn't reused
+	bool Compressed = false;
+
+	// Limits that are enforced while reading
+	size_t DepthLeft = 0;
+	size_t ElementsLeft = 0;
+
+	// The buffer being read, when buffer data is allowed to reference it
+	const util::CBuffer *Backing = nullptr;
+
+	void ConsumeElements(size_t a_count);
+
+	size_t GetNameRef(const string &a_name);
+	size_t FindNameRef(const string &a_name) const;
+	const string &GetName(size_t a_ref) const;
 };
 
-namespace {
+size_t MasterContext::GetNameRef(const string &a_name)
+{
+	size_t l_ref;
+	if (Dict && Dict->Find(a_name, l_ref))
+		return l_ref;
 
-size_t p_CalcSize(const AData &a_data, MasterContext &a_mc, DataType a_knownType = DataType::Unknown);
-size_t p_CalcHeaderSize(const AData &a_data, MasterContext &a_mc);
+	if (Building)
+	{
+		auto l_iter = Building->Index.find(a_name);
+		if (l_iter == Building->Index.end())
+		{
+			l_iter = Building->Index.emplace(a_name, Building->Names.size()).first;
+			Building->Names.push_back(a_name);
+		}
+		return Base + l_iter->second;
+	}
 
-void WriteHeader(char *&a_buff, const MasterContext &a_mc);
-void WriteData(char *&a_buff, const AData &a_data, const MasterContext &a_mc, DataType a_knownType = DataType::Unknown);
-AData::Ptr ReadData(const char *&a_buff, const MasterContext &a_mc, const CSerializationContext &a_context, DataType a_knownType = DataType::Unknown);
-void ReadHeader(const char *&a_buff, MasterContext &a_mc);
+	if (!Valid)
+		return 0;
 
-inline size_t CalcEncodeSize(size_t a_size)
+	// A cached table is only usable if every name is referenced in the same
+	// order of first use that the table was built with
+	auto l_iter = Table->Index.find(a_name);
+	if (l_iter == Table->Index.end() || l_iter->second > NumSeen)
+	{
+		Valid = false;
+		return 0;
+	}
+
+	if (l_iter->second == NumSeen)
+		++NumSeen;
+
+	return l_iter->second;
+}
+
+size_t MasterContext::FindNameRef(const string &a_name) const
+{
+	size_t l_ref;
+	if (Dict && Dict->Find(a_name, l_ref))
+		return l_ref;
+
+	return Base + Table->Index.find(a_name)->second;
+}
+
+const string &MasterContext::GetName(size_t a_ref) const
 {
-	size_t l_ret = 1;
+	if (a_ref < Base)
+		return Dict->Get(a_ref);
 
-	for (; a_size > 0x7f; ++l_ret, a_size >>= 7);
+	a_ref -= Base;
 
-	return l_ret;
+	if (a_ref >= Table->Names.size())
+		throw runtime_error("Unknown property name.");
+
+	return Table->Names[a_ref];
 }
 
-inline void EncodeSize(char *&a_buffer, size_t a_size)
+void MasterContext::ConsumeElements(size_t a_count)
 {
-	for (; a_size > 0x7f; ++a_buffer, a_size >>= 7)
-	{
-		*a_buffer = char(0x80 | (a_size & 0x7F));
-	}
+	if (a_count > ElementsLeft)
+		throw runtime_error("The data exceeds the maximum number of elements.");
 
-	*a_buffer++ = char(a_size);
+	ElementsLeft -= a_count;
 }
 
-inline void DecodeSize(const char *&a_buffer, size_t &a_size)
+class CAxonSerializer::CNameCache
 {
-	a_size = 0;
+private:
+	static const size_t MAX_TABLES = 64;
+
+	mutable mutex m_lock;
+	unordered_map<size_t, CNameTable::Ptr> m_tables;
+	CNameTable::Ptr m_lastRead;
+
+public:
+	CNameTable::Ptr Find(size_t a_shapeKey) const
+	{
+		lock_guard<mutex> l_lock(m_lock);
 
-	size_t shift = 0;
-	for (; *a_buffer & 0x80; ++a_buffer, shift += 7)
+		auto l_iter = m_tables.find(a_shapeKey);
+
+		if (l_iter == m_tables.end())
+			return CNameTable::Ptr();
+
+		return l_iter->second;
+	}
+
+	void Store(size_t a_shapeKey, CNameTable::Ptr a_table)
 	{
-		a_size |= size_t(*a_buffer & 0x7F) << shift;
+		lock_guard<mutex> l_lock(m_lock);
+
+		if (m_tables.size() >= MAX_TABLES)
+			m_tables.clear();
+
+		m_tables[a_shapeKey] = move(a_table);
 	}
 
-	a_size |= size_t(*a_buffer++) << shift;
-}
+	CNameTable::Ptr LastRead() const
+	{
+		lock_guard<mutex> l_lock(m_lock);
+		return m_lastRead;
+	}
+
+	void SetLastRead(CNameTable::Ptr a_table)
+	{
+		lock_guard<mutex> l_lock(m_lock);
+		m_lastRead = move(a_table);
+	}
+};
+
+namespace {
+
+size_t p_ShapeKey(const AData &a_data);
+size_t p_CalcSize(const AData &a_data, MasterContext &a_mc, DataType a_knownType = DataType::Unknown);
+size_t p_CalcHeaderSize(const MasterContext &a_mc);
+
+void WriteHeader(char *&a_buff, const MasterContext &a_mc);
+void WriteData(char *&a_buff, const AData &a_data, const MasterContext &a_mc, DataType a_knownType = DataType::Unknown);
+AData::Ptr ReadData(const char *&a_buff, const char *a_endBuff, MasterContext &a_mc, const CSerializationContext &a_context, DataType a_knownType = DataType::Unknown);
+void ReadHeader(const char *&a_buff, const char *a_endBuff, MasterContext &a_mc, const CNameTable::Ptr &a_lastRead);
 
-inline size_t DecodeSize(const char *&a_buff)
+// Every read checks the remaining input first, so truncated or corrupt
+// data can never cause a read past the end of the buffer
+inline void CheckRead(const char *a_buff, const char *a_endBuff, size_t a_size)
 {
-	size_t l_ret;
-	DecodeSize(a_buff, l_ret);
-	return l_ret;
+	if (size_t(a_endBuff - a_buff) < a_size)
+		throw CBufferOverflowException();
 }
 
 template<typename T>
@@ -121,22 +289,26 @@ inline void WriteValue(char *&a_buff, const string &a_str)
 }
 
 template<typename T>
-void ReadValueImpl(const char *&a_buff, typename enable_if<is_trivial<T>::value, T>::type &a_val)
+void ReadValueImpl(const char *&a_buff, const char *a_endBuff, typename enable_if<is_trivial<T>::value, T>::type &a_val)
 {
+	CheckRead(a_buff, a_endBuff, sizeof(T));
+
 	memcpy(&a_val, a_buff, sizeof(T));
 	a_buff += sizeof(T);
 }
 
 template<typename T>
-void ReadValue(const char *&a_buff, T &a_val)
+void ReadValue(const char *&a_buff, const char *a_endBuff, T &a_val)
 {
-	ReadValueImpl<T>(a_buff, a_val);
+	ReadValueImpl<T>(a_buff, a_endBuff, a_val);
 }
 
-inline void ReadValue(const char *&a_buff, string &a_str)
+inline void ReadValue(const char *&a_buff, const char *a_endBuff, string &a_str)
 {
 	size_t l_size;
-	DecodeSize(a_buff, l_size);
+	DecodeSize(a_buff, a_endBuff, l_size);
+
+	CheckRead(a_buff, a_endBuff, l_size);
 
 	a_str = string(l_size, '\0');
 
@@ -145,22 +317,131 @@ inline void ReadValue(const char *&a_buff, string &a_str)
 	a_buff += l_size;
 }
 
+inline void ReadValue(const char *&a_buff, const char *a_endBuff, bool &a_val)
+{
+	// Any byte other than 0 is true. Copying the byte directly into a bool
+	// isn't safe for values other than 0 and 1
+	byte l_val;
+	ReadValueImpl<byte>(a_buff, a_endBuff, l_val);
+
+	a_val = 0 != l_val;
+}
+
 template<typename T>
-T ReadValue(const char *&a_buff)
+T ReadValue(const char *&a_buff, const char *a_endBuff)
 {
 	T l_ret;
-	ReadValue(a_buff, l_ret);
+	ReadValue(a_buff, a_endBuff, l_ret);
 	return move(l_ret);
 }
 
 }
 
+void CNameTable::Finalize()
+{
+	size_t l_size = CalcEncodeSize(Names.size());
+
+	for (const string &l_name : Names)
+		l_size += CalcValueSize(l_name);
+
+	Encoded.resize(l_size);
+
+	char *l_write = &Encoded[0];
+
+	EncodeSize(l_write, Names.size());
+
+	for (const string &l_name : Names)
+		WriteValue(l_write, l_name);
+}
+
+CAxonSerializer::CAxonSerializer()
+	: m_nameCache(make_shared<CNameCache>()),
+	  m_maxDepth(DEFAULT_MAX_DEPTH),
+	  m_maxElements(numeric_limits<size_t>::max()),
+	  m_packIntegers(false),
+	  m_packBools(false),
+	  m_columnar(false)
+{
+}
+
 size_t CAxonSerializer::CalcSize(const AData& a_data) const
 {
+	const size_t l_shapeKey = p_ShapeKey(a_data);
+
+	MasterContext::Ptr l_master(new MasterContext);
+	l_master->Table = m_nameCache->Find(l_shapeKey);
+	l_master->PackIntegers = m_packIntegers;
+	l_master->PackBools = m_packBools;
+	l_master->Columnar = m_columnar;
+	l_master->Compressor = m_bufferCompressor.get();
+	l_master->CompressThreshold = m_compressThreshold;
+
+	size_t l_dataSize = 0;
+
+	if (l_master->Table)
+	{
+		l_dataSize = p_CalcSize(a_data, *l_master);
+
+		if (!l_master->Valid || l_master->NumSeen != l_master->Table->Names.size())
+		{
+			// Same shape key, but a different set of names, so start over
+			l_master.reset(new MasterContext);
+			l_master->PackIntegers = m_packIntegers;
+			l_master->PackBools = m_packBools;
+			l_master->Columnar = m_columnar;
+			l_master->Compressor = m_bufferCompressor.get();
+			l_master->CompressThreshold = m_compressThreshold;
+		}
+	}
+
+	if (!l_master->Table)
+	{
+		auto l_table = make_shared<CNameTable>();
+
+		l_master->Building = l_table.get();
+		l_dataSize = p_CalcSize(a_data, *l_master);
+		l_master->Building = nullptr;
+
+		l_table->Finalize();
+		l_master->Table = l_table;
+
+		m_nameCache->Store(l_shapeKey, l_master->Table);
+	}
+
+	l_dataSize += p_CalcHeaderSize(*l_master);
+
+	l_master->StorageSize = l_dataSize;
+	a_data.SetDataContext(move(l_master));
+
+	return l_dataSize;
+}
+
+size_t CAxonSerializer::CalcSize(const AData &a_data, const CAxonNameDictionary &a_dict) const
+{
+	// The local name table depends on the contents of the dictionary, so
+	// the shape cache doesn't apply here
 	MasterContext::Ptr l_master(new MasterContext);
+	l_master->Dict = &a_dict;
+	l_master->Base = a_dict.Size();
+	l_master->PackIntegers = m_packIntegers;
+	l_master->PackBools = m_packBools;
+	l_master->Columnar = m_columnar;
+	l_master->Compressor = m_bufferCompressor.get();
+	l_master->CompressThreshold = m_compressThreshold;
+
+	auto l_table = make_shared<CNameTable>();
 
+	l_master->Building = l_table.get();
 	size_t l_dataSize = p_CalcSize(a_data, *l_master);
-	l_dataSize += p_CalcHeaderSize(a_data, *l_master);
+	l_master->Building = nullptr;
+
+	l_table->Finalize();
+	l_master->Table = move(l_table);
+
+	// Once the dictionary is full, new names are sent with every message
+	l_master->Learn = l_master->Base + l_master->Table->Names.size() <= a_dict.MaxNames();
+
+	l_dataSize += p_CalcHeaderSize(*l_master);
 
 	l_master->StorageSize = l_dataSize;
 	a_data.SetDataContext(move(l_master));
@@ -168,6 +449,42 @@ size_t CAxonSerializer::CalcSize(const AData& a_data) const
 	return l_dataSize;
 }
 
+size_t CAxonSerializer::SerializeInto(const AData &a_data, char *a_buffer, size_t a_bufferSize,
+                                      CAxonNameDictionary &a_dict) const
+{
+	auto l_cxt = dynamic_cast<MasterContext*>(a_data.GetDataContext());
+
+	size_t l_writeSize;
+
+	// The context is only valid if it was calculated against the current
+	// state of this dictionary
+	if (!l_cxt || l_cxt->Dict != &a_dict || l_cxt->Base != a_dict.Size() || l_cxt->Compressed)
+		l_writeSize = CalcSize(a_data, a_dict);
+	else
+		l_writeSize = l_cxt->StorageSize;
+
+	if (l_writeSize > a_bufferSize)
+		return l_writeSize;
+
+	const MasterContext &l_mc = *static_cast<MasterContext*>(a_data.GetDataContext());
+
+	char *l_write = a_buffer;
+
+	WriteHeader(l_write, l_mc);
+	WriteData(l_write, a_data, l_mc);
+
+	if (size_t(l_write - a_buffer) != l_writeSize)
+		throw runtime_error("The serialized data size did not match the calculated size.");
+
+	if (l_mc.Learn)
+	{
+		for (const string &l_name : l_mc.Table->Names)
+			a_dict.Add(l_name);
+	}
+
+	return l_writeSize;
+}
+
 size_t CAxonSerializer::SerializeInto(const AData& a_data,
 		char* a_buffer, size_t a_bufferSize) const
 {
@@ -191,14 +508,71 @@ size_t CAxonSerializer::SerializeInto(const AData& a_data,
 
 AData::Ptr CAxonSerializer::DeserializeData(
 		const char* a_buf, const char* a_endBuf) const
+{
+	return p_DeserializeData(a_buf, a_endBuf, nullptr);
+}
+
+AData::Ptr CAxonSerializer::DeserializeSharedData(const util::CBuffer &a_buf) const
+{
+	return p_DeserializeData(a_buf.Data(), a_buf.Data() + a_buf.Size(), &a_buf);
+}
+
+AData::Ptr CAxonSerializer::p_DeserializeData(const char *a_buf, const char *a_endBuf,
+                                              const util::CBuffer *a_backing) const
+{
+	CNameTable::Ptr l_lastRead = m_nameCache->LastRead();
+
+	MasterContext l_mc;
+	l_mc.Backing = a_backing;
+	l_mc.Compressor = m_bufferCompressor.get();
+	l_mc.MaxDecompressedSize = m_maxDecompressedSize;
+	ReadHeader(a_buf, a_endBuf, l_mc, l_lastRead);
+
+	if (l_mc.Table != l_lastRead)
+		m_nameCache->SetLastRead(l_mc.Table);
+
+	// Without a dictionary, only streams that don't reference one can be read
+	if (l_mc.Base != 0 || l_mc.Learn)
+		throw CNameDictionaryException();
+
+	l_mc.DepthLeft = m_maxDepth;
+	l_mc.ElementsLeft = m_maxElements;
+
+	AData::Ptr l_ret = ReadData(a_buf, a_endBuf, l_mc, CSerializationContext());
+
+	return move(l_ret);
+}
+
+AData::Ptr CAxonSerializer::DeserializeData(const char *a_buf, const char *a_endBuf,
+                                            CAxonNameDictionary &a_dict) const
 {
 	MasterContext l_mc;
-	ReadHeader(a_buf, l_mc);
+	l_mc.Dict = &a_dict;
+	l_mc.Compressor = m_bufferCompressor.get();
+	l_mc.MaxDecompressedSize = m_maxDecompressedSize;
+
+	ReadHeader(a_buf, a_endBuf, l_mc, CNameTable::Ptr());
+
+	// Version 1 streams have a base of 0, and never learn, so they are always accepted
+	if (l_mc.Base != 0 || l_mc.Learn)
+	{
+		if (l_mc.Base != a_dict.Size())
+			throw CNameDictionaryException();
+
+		if (l_mc.Learn && l_mc.Base + l_mc.Table->Names.size() > a_dict.MaxNames())
+			throw CNameDictionaryException();
+	}
+
+	l_mc.DepthLeft = m_maxDepth;
+	l_mc.ElementsLeft = m_maxElements;
 
-	AData::Ptr l_ret = ReadData(a_buf, l_mc, CSerializationContext());
+	AData::Ptr l_ret = ReadData(a_buf, a_endBuf, l_mc, CSerializationContext());
 
-	if (a_buf > a_endBuf)
-		throw runtime_error("The specified byte stream was invalid. A data corruption has occurred.");
+	if (l_mc.Learn)
+	{
+		for (const string &l_name : l_mc.Table->Names)
+			a_dict.Add(l_name);
+	}
 
 	return move(l_ret);
 }
@@ -224,7 +598,8 @@ size_t CAxonSerializer::p_EstablishSize(const AData& a_data) const
 {
 	auto l_cxt = dynamic_cast<MasterContext*>(a_data.GetDataContext());
 
-	if (!l_cxt)
+	// Contexts established against a dictionary can't be written without it
+	if (!l_cxt || l_cxt->Dict || l_cxt->Compressed)
 	{
 		// Calculating the size of the data will establish the context
 		return CalcSize(a_data);
@@ -237,38 +612,86 @@ size_t CAxonSerializer::p_EstablishSize(const AData& a_data) const
 
 namespace {
 
-inline size_t CalcBufferSize(const CBufferData &a_data)
+inline const CCompressedBuffer *GetCompressed(const CBufferData &a_data, const MasterContext &a_mc,
+                                              CCompressedBuffer::Ptr &a_scratch)
+{
+	return GetCompressed(a_data, a_mc.Compressor, a_mc.CompressThreshold, a_scratch);
+}
+
+inline size_t CalcBufferSize(const CBufferData &a_data, MasterContext &a_mc)
 {
 	size_t l_size = 0;
 
-	l_size += CalcEncodeSize(0); // Size of compressed buffer,
-								 // which isn't currently supported, so store 0
+	CCompressedBuffer::Ptr l_scratch;
+	const CCompressedBuffer *l_comp = GetCompressed(a_data, a_mc, l_scratch);
+
+	if (l_comp)
+		a_mc.Compressed = true;
+
+	const size_t l_compSize = l_comp ? l_comp->Size : 0;
+
+	l_size += CalcEncodeSize(l_compSize); // Size of compressed buffer, 0 when it isn't compressed
 	l_size += CalcEncodeSize(a_data.BufferSize()); // Size of buffer
-	l_size += a_data.BufferSize(); // Buffer
+	l_size += l_comp ? l_compSize : a_data.BufferSize(); // Buffer
 
 	return l_size;
 }
 
-inline void WriteBuffer(char *&a_buff, const CBufferData &a_data)
+inline void WriteBuffer(char *&a_buff, const CBufferData &a_data, const MasterContext &a_mc)
 {
-	EncodeSize(a_buff, 0); // Size of compressed buffer
+	CCompressedBuffer::Ptr l_scratch;
+	const CCompressedBuffer *l_comp = GetCompressed(a_data, a_mc, l_scratch);
+
+	EncodeSize(a_buff, l_comp ? l_comp->Size : 0); // Size of compressed buffer
 	EncodeSize(a_buff, a_data.BufferSize());
 
+	if (l_comp)
+	{
+		memcpy(a_buff, l_comp->Data.get(), l_comp->Size);
+		a_buff += l_comp->Size;
+		return;
+	}
+
 	memcpy(a_buff, a_data.GetBuffer().Data(), a_data.BufferSize());
 	a_buff += a_data.BufferSize();
 }
 
-inline AData::Ptr ReadBuffer(const char *&a_buff, const CSerializationContext &a_context)
+inline AData::Ptr ReadBuffer(const char *&a_buff, const char *a_endBuff, const MasterContext &a_mc,
+                             const CSerializationContext &a_context)
 {
-	size_t l_compSize = DecodeSize(a_buff);
+	size_t l_compSize = DecodeSize(a_buff, a_endBuff);
+
+	size_t l_buffSize = DecodeSize(a_buff, a_endBuff);
 
 	if (0 != l_compSize)
-		throw runtime_error("Buffer decompression not supported.");
+	{
+		CheckRead(a_buff, a_endBuff, l_compSize);
+
+		util::CBuffer l_buff = Decompress(a_mc.Compressor, a_buff, l_compSize, l_buffSize,
+		                                        a_mc.MaxDecompressedSize);
+		a_buff += l_compSize;
 
-	size_t l_buffSize = DecodeSize(a_buff);
+		return CBufferData::Ptr(new CBufferData(move(l_buff), true, a_context));
+	}
+
+	CheckRead(a_buff, a_endBuff, l_buffSize);
+
+	util::CBuffer l_buff;
+
+	if (a_mc.Backing && l_buffSize > 0)
+	{
+		// Reference the input instead of copying it
+		util::CBuffer::TPtr l_backing = a_mc.Backing->SPData();
+		util::CBuffer::TPtr l_view(const_cast<char *>(a_buff), [l_backing] (const char *) {});
+
+		l_buff = util::CBuffer(l_buffSize, move(l_view));
+	}
+	else
+	{
+		l_buff.Reset(l_buffSize);
+		memcpy(l_buff.Data(), a_buff, l_buffSize);
+	}
 
-	util::CBuffer l_buff(l_buffSize);
-	memcpy(l_buff.Data(), a_buff, l_buffSize);
 	a_buff += l_buffSize;
 
 	return CBufferData::Ptr(new CBufferData(move(l_buff), a_context));
@@ -283,14 +706,7 @@ inline size_t p_CalcStructSize(const CStructData &a_data, MasterContext &a_mc)
 
 	for (const auto &l_prop : a_data)
 	{
-		// Add the property name to the name table
-		auto l_iter = a_mc.NameMap.find(l_prop.first);
-		if (l_iter == a_mc.NameMap.end())
-		{
-			l_iter = a_mc.NameMap.emplace(l_prop.first, a_mc.NameMap.size()).first;
-		}
-
-		l_size += CalcEncodeSize(l_iter->second); // Name reference
+		l_size += CalcEncodeSize(a_mc.GetNameRef(l_prop.first)); // Name reference
 		l_size += p_CalcSize(*l_prop.second, a_mc); // Child value
 	}
 
@@ -304,44 +720,127 @@ inline void WriteStruct(char *&a_buff, const CStructData &a_data, const MasterCo
 
 	for (const auto &l_prop : a_data)
 	{
-		EncodeSize(a_buff, a_mc.NameMap.find(l_prop.first)->second);
+		EncodeSize(a_buff, a_mc.FindNameRef(l_prop.first));
 		WriteData(a_buff, *l_prop.second, a_mc);
 	}
 }
 
-inline AData::Ptr ReadStruct(const char *&a_buff, const MasterContext &a_mc, const CSerializationContext &a_context)
+inline AData::Ptr ReadStruct(const char *&a_buff, const char *a_endBuff, MasterContext &a_mc,
+                             const CSerializationContext &a_context)
 {
-	if (0 != ReadValue<byte>(a_buff))
+	if (0 != ReadValue<byte>(a_buff, a_endBuff))
 		throw runtime_error("Unsupported struct format.");
 
 	CStructData::Ptr l_ret(new CStructData(a_context));
 
-	size_t l_numProps = DecodeSize(a_buff);
+	size_t l_numProps = DecodeSize(a_buff, a_endBuff);
+
+	// Each property takes at least 2 bytes (name and type)
+	if (l_numProps > size_t(a_endBuff - a_buff) / 2)
+		throw CBufferOverflowException();
+
+	a_mc.ConsumeElements(l_numProps);
 
 	for (size_t i = 0; i < l_numProps; ++i)
 	{
-		size_t l_nameId = DecodeSize(a_buff);
+		const string &l_name = a_mc.GetName(DecodeSize(a_buff, a_endBuff));
+
+		AData::Ptr l_child = ReadData(a_buff, a_endBuff, a_mc, a_context);
+
+		l_ret->Add(l_name, move(l_child));
+	}
+
+	return move(l_ret);
+}
+
+// Columnar arrays hold at least 2 structs, which all have the same fields
+// in the same order, and each field has the same type in every struct. The
+// schema (name reference and type of each field) is written once, followed
+// by the values of each field in turn, without their types. At least one
+// field has to hold something other than null
+inline bool IsColumnar(const CArrayData &a_data, const MasterContext &a_mc)
+{
+	if (!a_mc.Columnar || a_data.size() < 2)
+		return false;
+
+	const AData &l_first = **a_data.begin();
+
+	if (l_first.Type() != DataType::Struct)
+		return false;
+
+	const CStructData &l_schema = static_cast<const CStructData &>(l_first);
+
+	bool l_hasValues = false;
+
+	for (const auto &l_prop : l_schema)
+	{
+		if (l_prop.second->Type() != DataType::Null)
+			l_hasValues = true;
+	}
 
-		auto l_nameIter = a_mc.ReverseMap.find(l_nameId);
+	if (!l_hasValues)
+		return false;
+
+	for (const auto &l_val : a_data)
+	{
+		if (l_val->Type() != DataType::Struct)
+			return false;
 
-		if (l_nameIter == a_mc.ReverseMap.end())
-			throw runtime_error("Unknown property name.");
+		const CStructData &l_row = static_cast<const CStructData &>(*l_val);
 
-		AData::Ptr l_child = ReadData(a_buff, a_mc, a_context);
+		if (l_row.size() != l_schema.size())
+			return false;
 
-		l_ret->Add(l_nameIter->second, move(l_child));
+		auto l_field = l_schema.begin();
+		for (const auto &l_prop : l_row)
+		{
+			if (l_prop.first != l_field->first ||
+				l_prop.second->Type() != l_field->second->Type())
+				return false;
+			++l_field;
+		}
 	}
 
-	return move(l_ret);
+	return true;
+}
+
+inline const AData &GetField(const AData &a_row, size_t a_field)
+{
+	return *(static_cast<const CStructData &>(a_row).begin() + a_field)->second;
 }
 
 inline size_t p_CalcArraySize(const CArrayData &a_data, MasterContext &a_mc)
 {
 	size_t l_size = 0;
 
-	l_size += sizeof(byte); // Write Mode (Currently only plain supported)
+	l_size += sizeof(byte); // Write Mode
 	l_size += CalcEncodeSize(a_data.size()); // Number of children
 
+	if (IsColumnar(a_data, a_mc))
+	{
+		const CStructData &l_schema = static_cast<const CStructData &>(**a_data.begin());
+
+		l_size += CalcEncodeSize(l_schema.size()); // Number of fields
+
+		for (const auto &l_prop : l_schema)
+		{
+			l_size += CalcEncodeSize(a_mc.GetNameRef(l_prop.first)); // Name reference
+			l_size += sizeof(byte); // Data Type
+		}
+
+		for (size_t i = 0; i < l_schema.size(); ++i)
+		{
+			const DataType l_type = GetField(l_schema, i).Type();
+
+			for (const auto &l_val : a_data)
+			{
+				l_size += p_CalcSize(GetField(*l_val, i), a_mc, l_type);
+			}
+		}
+
+		return l_size;
+	}
+
 	for (const auto &l_val : a_data)
 	{
 		l_size += p_CalcSize(*l_val, a_mc);
@@ -352,7 +851,33 @@ inline size_t p_CalcArraySize(const CArrayData &a_data, MasterContext &a_mc)
 
 inline void WriteArray(char *&a_buff, const CArrayData &a_data, const MasterContext &a_mc)
 {
-	WriteValue(a_buff, byte(0)); // Write Mode (Plain)
+	if (IsColumnar(a_data, a_mc))
+	{
+		const CStructData &l_schema = static_cast<const CStructData &>(**a_data.begin());
+
+		WriteValue(a_buff, ARRAY_COLUMNAR);
+		EncodeSize(a_buff, a_data.size());
+		EncodeSize(a_buff, l_schema.size());
+
+		for (const auto &l_prop : l_schema)
+		{
+			EncodeSize(a_buff, a_mc.FindNameRef(l_prop.first));
+			WriteValue(a_buff, (byte)l_prop.second->Type());
+		}
+
+		for (size_t i = 0; i < l_schema.size(); ++i)
+		{
+			const DataType l_type = GetField(l_schema, i).Type();
+
+			for (const auto &l_val : a_data)
+			{
+				WriteData(a_buff, GetField(*l_val, i), a_mc, l_type);
+			}
+		}
+		return;
+	}
+
+	WriteValue(a_buff, ARRAY_PLAIN);
 	EncodeSize(a_buff, a_data.size());
 
 	for (const auto &l_val : a_data)
@@ -361,30 +886,104 @@ inline void WriteArray(char *&a_buff, const CArrayData &a_data, const MasterCont
 	}
 }
 
-inline AData::Ptr ReadArray(const char *&a_buff, const MasterContext &a_mc,
-                            const CSerializationContext &a_context)
+inline AData::Ptr ReadColumnarArray(const char *&a_buff, const char *a_endBuff, MasterContext &a_mc,
+                                    const CSerializationContext &a_context)
 {
-	if (0 != ReadValue<byte>(a_buff))
-		throw runtime_error("Invalid array format.");
+	const size_t l_numRows = DecodeSize(a_buff, a_endBuff);
+	const size_t l_numFields = DecodeSize(a_buff, a_endBuff);
 
-	CArrayData::Ptr l_ret(new CArrayData(a_context));
+	// Each field of the schema takes 2 bytes (name and type)
+	if (l_numFields > size_t(a_endBuff - a_buff) / 2)
+		throw CBufferOverflowException();
 
-	size_t l_arrSize = DecodeSize(a_buff);
+	vector<pair<const string *, DataType>> l_schema;
+	l_schema.reserve(l_numFields);
 
-	for (size_t i = 0; i < l_arrSize; ++i)
+	bool l_hasValues = false;
+
+	for (size_t i = 0; i < l_numFields; ++i)
 	{
-		l_ret->Add(ReadData(a_buff, a_mc, a_context));
-	}
+		const string &l_name = a_mc.GetName(DecodeSize(a_buff, a_endBuff));
+		const DataType l_type = (DataType)ReadValue<byte>(a_buff, a_endBuff);
 
-	return move(l_ret);
-}
+		if (l_type == DataType::Unknown || l_type > DataType::PrimArray)
+			throw runtime_error("Unsupported data type.");
 
-template<typename T>
-size_t p_CalcPrimArraySizeImpl(const CPrimArrayData<T> &a_data)
-{
-	size_t l_size = 0;
+		if (l_type != DataType::Null)
+			l_hasValues = true;
 
-	l_size += sizeof(T) * a_data.size(); // Elements
+		l_schema.emplace_back(&l_name, l_type);
+	}
+
+	if (!l_hasValues)
+		throw runtime_error("Invalid array format.");
+
+	// Every non-null value takes at least 1 byte
+	if (l_numRows > size_t(a_endBuff - a_buff))
+		throw CBufferOverflowException();
+
+	a_mc.ConsumeElements(l_numRows);
+
+	CArrayData::Ptr l_ret(new CArrayData(a_context));
+
+	vector<CStructData *> l_rows;
+	l_rows.reserve(l_numRows);
+
+	for (size_t i = 0; i < l_numRows; ++i)
+	{
+		a_mc.ConsumeElements(l_numFields);
+
+		CStructData::Ptr l_row(new CStructData(a_context));
+		l_rows.push_back(l_row.get());
+		l_ret->Add(move(l_row));
+	}
+
+	for (const auto &l_field : l_schema)
+	{
+		for (CStructData *l_row : l_rows)
+		{
+			l_row->Add(*l_field.first, ReadData(a_buff, a_endBuff, a_mc, a_context, l_field.second));
+		}
+	}
+
+	return move(l_ret);
+}
+
+inline AData::Ptr ReadArray(const char *&a_buff, const char *a_endBuff, MasterContext &a_mc,
+                            const CSerializationContext &a_context)
+{
+	const byte l_mode = ReadValue<byte>(a_buff, a_endBuff);
+
+	if (l_mode == ARRAY_COLUMNAR)
+		return ReadColumnarArray(a_buff, a_endBuff, a_mc, a_context);
+
+	if (l_mode != ARRAY_PLAIN)
+		throw runtime_error("Invalid array format.");
+
+	CArrayData::Ptr l_ret(new CArrayData(a_context));
+
+	size_t l_arrSize = DecodeSize(a_buff, a_endBuff);
+
+	// Each element takes at least 1 byte (type)
+	if (l_arrSize > size_t(a_endBuff - a_buff))
+		throw CBufferOverflowException();
+
+	a_mc.ConsumeElements(l_arrSize);
+
+	for (size_t i = 0; i < l_arrSize; ++i)
+	{
+		l_ret->Add(ReadData(a_buff, a_endBuff, a_mc, a_context));
+	}
+
+	return move(l_ret);
+}
+
+template<typename T>
+size_t p_CalcPrimArraySizeImpl(const CPrimArrayData<T> &a_data)
+{
+	size_t l_size = 0;
+
+	l_size += sizeof(T) * a_data.size(); // Elements
 
 	return l_size;
 }
@@ -401,7 +1000,88 @@ inline size_t p_CalcPrimArraySizeImpl(const CPrimArrayData<string> &a_data)
 	return l_size;
 }
 
-inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data)
+// Returns the size of the packed elements, or 0 if the array should be
+// written plain
+inline size_t CalcPackedPrimArraySize(const APrimArrayDataBase &a_data, const MasterContext &a_mc)
+{
+#define PACKED_SIZE(name, type) \
+	case DataType::name: \
+		l_packed = CalcPackedSize(static_cast<const CPrimArrayData<type> &>(a_data).Data(), a_data.Size()); \
+		l_plain = sizeof(type) * a_data.Size(); \
+		break
+
+	if (!a_mc.PackIntegers)
+		return 0;
+
+	size_t l_packed, l_plain;
+
+	switch (a_data.InnerType())
+	{
+	PACKED_SIZE(Short, short);
+	PACKED_SIZE(UShort, unsigned short);
+	PACKED_SIZE(Int, int);
+	PACKED_SIZE(UInt, unsigned int);
+	PACKED_SIZE(Long, int64_t);
+	PACKED_SIZE(ULong, uint64_t);
+
+	default:
+		return 0;
+	}
+
+	return l_packed < l_plain ? l_packed : 0;
+
+#undef PACKED_SIZE
+}
+
+template<typename T>
+size_t CalcDeltaSizeImpl(const CPrimArrayData<T> &a_data, true_type, false_type)
+{
+	return CalcDeltaSize(a_data.Data(), a_data.size());
+}
+
+template<typename T>
+size_t CalcDeltaSizeImpl(const CPrimArrayData<T> &a_data, false_type, true_type)
+{
+	return CalcXorSize(a_data.Data(), a_data.size());
+}
+
+// Delta coding is only used when the array asks for it, and when that
+// is smaller than the plain encoding. Returns 0 otherwise
+inline size_t CalcDeltaPrimArraySize(const APrimArrayDataBase &a_data)
+{
+#define DELTA_SIZE(name, type) \
+	case DataType::name: \
+		l_delta = CalcDeltaSizeImpl(static_cast<const CPrimArrayData<type> &>(a_data), \
+				is_packable<type>(), is_floating_point<type>()); \
+		l_plain = sizeof(type) * a_data.Size(); \
+		break
+
+	if (!a_data.Delta())
+		return 0;
+
+	size_t l_delta, l_plain;
+
+	switch (a_data.InnerType())
+	{
+	DELTA_SIZE(Short, short);
+	DELTA_SIZE(UShort, unsigned short);
+	DELTA_SIZE(Int, int);
+	DELTA_SIZE(UInt, unsigned int);
+	DELTA_SIZE(Long, int64_t);
+	DELTA_SIZE(ULong, uint64_t);
+	DELTA_SIZE(Float, float);
+	DELTA_SIZE(Double, double);
+
+	default:
+		return 0;
+	}
+
+	return l_delta < l_plain ? l_delta : 0;
+
+#undef DELTA_SIZE
+}
+
+inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data, const MasterContext &a_mc)
 {
 #define CALC_SIZE(name, type) \
 	case DataType::name: \
@@ -414,6 +1094,19 @@ inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data)
 	l_size += sizeof(byte); // Inner Type
 	l_size += CalcEncodeSize(a_data.Size()); // Number of elements
 
+	if (a_data.InnerType() == DataType::Bool && a_mc.PackBools)
+		return l_size + CalcBitPackedSize(a_data.Size());
+
+	const size_t l_delta = CalcDeltaPrimArraySize(a_data);
+
+	if (l_delta)
+		return l_size + l_delta;
+
+	const size_t l_packed = CalcPackedPrimArraySize(a_data, a_mc);
+
+	if (l_packed)
+		return l_size + l_packed;
+
 	switch (a_data.InnerType())
 	{
 	CALC_SIZE(SByte, signed char);
@@ -422,8 +1115,8 @@ inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data)
 	CALC_SIZE(UShort, unsigned short);
 	CALC_SIZE(Int, int);
 	CALC_SIZE(UInt, unsigned int);
-	CALC_SIZE(Long, long long);
-	CALC_SIZE(ULong, unsigned long);
+	CALC_SIZE(Long, int64_t);
+	CALC_SIZE(ULong, uint64_t);
 	CALC_SIZE(Float, float);
 	CALC_SIZE(Double, double);
 	CALC_SIZE(Bool, bool);
@@ -439,8 +1132,50 @@ inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data)
 }
 
 template<typename T>
-void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<T> &a_data)
+void WritePackedImpl(char *&a_buff, const CPrimArrayData<T> &a_data, true_type)
+{
+	WritePacked(a_buff, a_data.Data(), a_data.size());
+}
+
+template<typename T>
+void WritePackedImpl(char *&a_buff, const CPrimArrayData<T> &a_data, false_type)
+{
+	throw runtime_error("Only integer arrays can be packed.");
+}
+
+template<typename T>
+void WriteDeltaImpl(char *&a_buff, const CPrimArrayData<T> &a_data, true_type, false_type)
 {
+	WriteDelta(a_buff, a_data.Data(), a_data.size(), T(0));
+}
+
+template<typename T>
+void WriteDeltaImpl(char *&a_buff, const CPrimArrayData<T> &a_data, false_type, true_type)
+{
+	WriteXor(a_buff, a_data.Data(), a_data.size(), T(0));
+}
+
+template<typename T>
+void WriteDeltaImpl(char *&a_buff, const CPrimArrayData<T> &a_data, false_type, false_type)
+{
+	throw runtime_error("Only integer and float arrays can be delta coded.");
+}
+
+template<typename T>
+void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<T> &a_data, byte a_mode)
+{
+	if (a_mode == PRIM_PACKED)
+	{
+		WritePackedImpl(a_buff, a_data, is_packable<T>());
+		return;
+	}
+
+	if (a_mode == PRIM_DELTA || a_mode == PRIM_XOR)
+	{
+		WriteDeltaImpl(a_buff, a_data, is_packable<T>(), is_floating_point<T>());
+		return;
+	}
+
 	// Straight copy the primitive values into the output buffer
 	size_t l_size = sizeof(T) * a_data.size();
 	memcpy(a_buff, a_data.Data(), l_size);
@@ -449,15 +1184,21 @@ void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<T> &a_data)
 
 // Need to specialize this because of the boneheaded decision to make vector<bool>
 // a bitset
-inline void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<bool> &a_data)
+inline void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<bool> &a_data, byte a_mode)
 {
+	if (a_mode == PRIM_BITS)
+	{
+		WriteBitPacked(a_buff, a_data.begin(), a_data.size());
+		return;
+	}
+
 	for (bool l_b : a_data)
 	{
 		WriteValue(a_buff, l_b);
 	}
 }
 
-inline void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<string> &a_data)
+inline void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<string> &a_data, byte)
 {
 	for (const string &l_val : a_data)
 	{
@@ -465,14 +1206,31 @@ inline void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<string> &a_da
 	}
 }
 
-inline void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data)
+inline byte GetPrimArrayMode(const APrimArrayDataBase &a_data, const MasterContext &a_mc)
+{
+	if (a_data.InnerType() == DataType::Bool)
+		return a_mc.PackBools ? PRIM_BITS : PRIM_PLAIN;
+
+	if (0 != CalcDeltaPrimArraySize(a_data))
+	{
+		const DataType l_inner = a_data.InnerType();
+
+		return l_inner == DataType::Float || l_inner == DataType::Double ? PRIM_XOR : PRIM_DELTA;
+	}
+
+	return 0 != CalcPackedPrimArraySize(a_data, a_mc) ? PRIM_PACKED : PRIM_PLAIN;
+}
+
+inline void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data, const MasterContext &a_mc)
 {
 #define WRITE_PRIM(name, type) \
 	case DataType::name: \
-		WritePrimArrayImpl(a_buff, static_cast<const CPrimArrayData<type> &>(a_data)); \
+		WritePrimArrayImpl(a_buff, static_cast<const CPrimArrayData<type> &>(a_data), l_mode); \
 		break
 
-	WriteValue(a_buff, byte(0)); // Write Mode
+	const byte l_mode = GetPrimArrayMode(a_data, a_mc);
+
+	WriteValue(a_buff, l_mode); // Write Mode
 	WriteValue(a_buff, (byte)a_data.InnerType());
 	EncodeSize(a_buff, a_data.Size());
 
@@ -484,8 +1242,8 @@ inline void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data)
 	WRITE_PRIM(UShort, unsigned short);
 	WRITE_PRIM(Int, int);
 	WRITE_PRIM(UInt, unsigned int);
-	WRITE_PRIM(Long, long long);
-	WRITE_PRIM(ULong, unsigned long);
+	WRITE_PRIM(Long, int64_t);
+	WRITE_PRIM(ULong, uint64_t);
 	WRITE_PRIM(Float, float);
 	WRITE_PRIM(Double, double);
 	WRITE_PRIM(Bool, bool);
@@ -499,8 +1257,11 @@ inline void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data)
 }
 
 template<typename T>
-void ReadPrimArrayImpl2(const char *&a_buff, CPrimArrayData<T> &a_data, size_t a_size)
+void ReadPrimArrayImpl2(const char *&a_buff, const char *a_endBuff, CPrimArrayData<T> &a_data, size_t a_size)
 {
+	if (a_size > size_t(a_endBuff - a_buff) / sizeof(T))
+		throw CBufferOverflowException();
+
 	const T *l_t = reinterpret_cast<const T *>(a_buff);
 
 	auto l_end = l_t + a_size;
@@ -510,38 +1271,179 @@ void ReadPrimArrayImpl2(const char *&a_buff, CPrimArrayData<T> &a_data, size_t a
 	a_buff = reinterpret_cast<const char *>(l_end);
 }
 
-inline void ReadPrimArrayImpl2(const char *&a_buff, CPrimArrayData<string> &a_data, size_t a_size)
+inline void ReadPrimArrayImpl2(const char *&a_buff, const char *a_endBuff, CPrimArrayData<bool> &a_data, size_t a_size)
+{
+	if (a_size > size_t(a_endBuff - a_buff))
+		throw CBufferOverflowException();
+
+	a_data.Resize(a_size);
+
+	for (auto l_iter = a_data.begin(), l_end = a_data.end(); l_iter != l_end; ++l_iter)
+	{
+		*l_iter = 0 != *a_buff++;
+	}
+}
+
+inline void ReadPrimArrayImpl2(const char *&a_buff, const char *a_endBuff, CPrimArrayData<string> &a_data, size_t a_size)
 {
+	// Each string takes at least 1 byte (size)
+	if (a_size > size_t(a_endBuff - a_buff))
+		throw CBufferOverflowException();
+
 	for (size_t i = 0; i < a_size; ++i)
 	{
 		string l_str;
-		ReadValue(a_buff, l_str);
+		ReadValue(a_buff, a_endBuff, l_str);
 
 		a_data.Add(move(l_str));
 	}
 }
 
 template<typename T>
-AData::Ptr ReadPrimArrayImpl(const char *&a_buff, size_t a_size, const CSerializationContext &a_context)
+AData::Ptr ReadPrimArrayImpl(const char *&a_buff, const char *a_endBuff, size_t a_size, const CSerializationContext &a_context)
+{
+	typename CPrimArrayData<T>::Ptr l_ret(new CPrimArrayData<T>(a_context));
+	ReadPrimArrayImpl2(a_buff, a_endBuff, *l_ret, a_size);
+	return move(l_ret);
+}
+
+template<typename T>
+AData::Ptr ReadPackedPrimArray(const char *&a_buff, const char *a_endBuff, size_t a_size, const CSerializationContext &a_context)
+{
+	// Each packed value takes at least 1 byte
+	if (a_size > size_t(a_endBuff - a_buff))
+		throw CBufferOverflowException();
+
+	typename CPrimArrayData<T>::Ptr l_ret(new CPrimArrayData<T>(a_context));
+	l_ret->Resize(a_size);
+
+	ReadPacked(a_buff, a_endBuff, l_ret->Data(), a_size);
+
+	return move(l_ret);
+}
+
+template<typename T>
+void ReadDeltaImpl(const char *&a_buff, const char *a_endBuff, T *a_vals, size_t a_size, false_type)
+{
+	ReadDelta(a_buff, a_endBuff, a_vals, a_size);
+}
+
+template<typename T>
+void ReadDeltaImpl(const char *&a_buff, const char *a_endBuff, T *a_vals, size_t a_size, true_type)
+{
+	ReadXor(a_buff, a_endBuff, a_vals, a_size);
+}
+
+template<typename T>
+AData::Ptr ReadDeltaPrimArray(const char *&a_buff, const char *a_endBuff, size_t a_size, const CSerializationContext &a_context)
 {
+	// Each delta coded value takes at least 1 byte
+	if (a_size > size_t(a_endBuff - a_buff))
+		throw CBufferOverflowException();
+
 	typename CPrimArrayData<T>::Ptr l_ret(new CPrimArrayData<T>(a_context));
-	ReadPrimArrayImpl2(a_buff, *l_ret, a_size);
+	l_ret->Resize(a_size);
+
+	ReadDeltaImpl(a_buff, a_endBuff, l_ret->Data(), a_size, is_floating_point<T>());
+
+	return move(l_ret);
+}
+
+inline AData::Ptr ReadBitPackedPrimArray(const char *&a_buff, const char *a_endBuff, DataType a_inner,
+                                         size_t a_size, const CSerializationContext &a_context)
+{
+	if (a_inner != DataType::Bool)
+		throw runtime_error("Only bool arrays can be bit packed.");
+
+	CheckRead(a_buff, a_endBuff, CalcBitPackedSize(a_size));
+
+	CPrimArrayData<bool>::Ptr l_ret(new CPrimArrayData<bool>(a_context));
+	l_ret->Resize(a_size);
+
+	ReadBitPacked(a_buff, l_ret->begin(), a_size);
+
 	return move(l_ret);
 }
 
-inline AData::Ptr ReadPrimArray(const char *&a_buff, const CSerializationContext &a_context)
+inline AData::Ptr ReadPackedPrimArray(const char *&a_buff, const char *a_endBuff, DataType a_inner,
+                                      size_t a_size, const CSerializationContext &a_context)
+{
+#define READ_PACKED(name, type) \
+	case DataType::name: \
+		return ReadPackedPrimArray<type>(a_buff, a_endBuff, a_size, a_context);
+
+	switch (a_inner)
+	{
+	READ_PACKED(Short, short);
+	READ_PACKED(UShort, unsigned short);
+	READ_PACKED(Int, int);
+	READ_PACKED(UInt, unsigned int);
+	READ_PACKED(Long, int64_t);
+	READ_PACKED(ULong, uint64_t);
+	}
+
+	throw runtime_error("Unsupported packed primitive type.");
+
+#undef READ_PACKED
+}
+
+inline AData::Ptr ReadDeltaPrimArray(const char *&a_buff, const char *a_endBuff, byte a_mode, DataType a_inner,
+                                     size_t a_size, const CSerializationContext &a_context)
+{
+	if (a_mode == PRIM_XOR)
+	{
+		if (a_inner == DataType::Float)
+			return ReadDeltaPrimArray<float>(a_buff, a_endBuff, a_size, a_context);
+		if (a_inner == DataType::Double)
+			return ReadDeltaPrimArray<double>(a_buff, a_endBuff, a_size, a_context);
+
+		throw runtime_error("Only float arrays can be XOR coded.");
+	}
+
+#define READ_DELTA(name, type) \
+	case DataType::name: \
+		return ReadDeltaPrimArray<type>(a_buff, a_endBuff, a_size, a_context);
+
+	switch (a_inner)
+	{
+	READ_DELTA(Short, short);
+	READ_DELTA(UShort, unsigned short);
+	READ_DELTA(Int, int);
+	READ_DELTA(UInt, unsigned int);
+	READ_DELTA(Long, int64_t);
+	READ_DELTA(ULong, uint64_t);
+	}
+
+	throw runtime_error("Unsupported delta coded primitive type.");
+
+#undef READ_DELTA
+}
+
+inline AData::Ptr ReadPrimArray(const char *&a_buff, const char *a_endBuff, MasterContext &a_mc,
+                                const CSerializationContext &a_context)
 {
-	if (0 != ReadValue<byte>(a_buff))
+	const byte l_mode = ReadValue<byte>(a_buff, a_endBuff);
+
+	if (l_mode > PRIM_XOR)
 		throw runtime_error("Unsupported primitive array write mode.");
 
-	DataType l_inner = (DataType)ReadValue<byte>(a_buff);
+	DataType l_inner = (DataType)ReadValue<byte>(a_buff, a_endBuff);
+
+	size_t l_numElems = DecodeSize(a_buff, a_endBuff);
 
-	size_t l_numElems = DecodeSize(a_buff);
+	a_mc.ConsumeElements(l_numElems);
+
+	if (l_mode == PRIM_PACKED)
+		return ReadPackedPrimArray(a_buff, a_endBuff, l_inner, l_numElems, a_context);
+	if (l_mode == PRIM_BITS)
+		return ReadBitPackedPrimArray(a_buff, a_endBuff, l_inner, l_numElems, a_context);
+	if (l_mode == PRIM_DELTA || l_mode == PRIM_XOR)
+		return ReadDeltaPrimArray(a_buff, a_endBuff, l_mode, l_inner, l_numElems, a_context);
 
 
 #define READ_PRIM(name, type) \
 	case DataType::name: \
-		return ReadPrimArrayImpl<type>(a_buff, l_numElems, a_context);
+		return ReadPrimArrayImpl<type>(a_buff, a_endBuff, l_numElems, a_context);
 
 	switch (l_inner)
 	{
@@ -551,8 +1453,8 @@ inline AData::Ptr ReadPrimArray(const char *&a_buff, const CSerializationContext
 	READ_PRIM(UShort, unsigned short);
 	READ_PRIM(Int, int);
 	READ_PRIM(UInt, unsigned int);
-	READ_PRIM(Long, long long);
-	READ_PRIM(ULong, unsigned long);
+	READ_PRIM(Long, int64_t);
+	READ_PRIM(ULong, uint64_t);
 	READ_PRIM(Float, float);
 	READ_PRIM(Double, double);
 	READ_PRIM(Bool, bool);
@@ -589,7 +1491,7 @@ inline size_t p_CalcSize(const AData& a_data, MasterContext& a_mc, DataType a_kn
 	PRIM_SIZE(UShort, ushort);
 	PRIM_SIZE(Int, int);
 	PRIM_SIZE(UInt, uint);
-	PRIM_SIZE(Long, long long);
+	PRIM_SIZE(Long, int64_t);
 	PRIM_SIZE(ULong, ulong);
 	PRIM_SIZE(Float, float);
 	PRIM_SIZE(Double, double);
@@ -609,11 +1511,11 @@ inline size_t p_CalcSize(const AData& a_data, MasterContext& a_mc, DataType a_kn
 		break;
 
 	case DataType::Buffer:
-		l_size += CalcBufferSize(static_cast<const CBufferData &>(a_data));
+		l_size += CalcBufferSize(static_cast<const CBufferData &>(a_data), a_mc);
 		break;
 
 	case DataType::PrimArray:
-		l_size += CalcPrimArraySize(static_cast<const APrimArrayDataBase &>(a_data));
+		l_size += CalcPrimArraySize(static_cast<const APrimArrayDataBase &>(a_data), a_mc);
 		break;
 	}
 
@@ -643,7 +1545,7 @@ inline void WriteData(char*& a_buff, const AData& a_data, const MasterContext& a
 	WRITE_PRIM(UShort, ushort);
 	WRITE_PRIM(Int, int);
 	WRITE_PRIM(UInt, uint);
-	WRITE_PRIM(Long, long long);
+	WRITE_PRIM(Long, int64_t);
 	WRITE_PRIM(ULong, ulong);
 	WRITE_PRIM(Float, float);
 	WRITE_PRIM(Double, double);
@@ -663,11 +1565,11 @@ inline void WriteData(char*& a_buff, const AData& a_data, const MasterContext& a
 		break;
 
 	case DataType::Buffer:
-		WriteBuffer(a_buff, static_cast<const CBufferData &>(a_data));
+		WriteBuffer(a_buff, static_cast<const CBufferData &>(a_data), a_mc);
 		break;
 
 	case DataType::PrimArray:
-		WritePrimArray(a_buff, static_cast<const APrimArrayDataBase &>(a_data));
+		WritePrimArray(a_buff, static_cast<const APrimArrayDataBase &>(a_data), a_mc);
 		break;
 
 	default:
@@ -677,17 +1579,33 @@ inline void WriteData(char*& a_buff, const AData& a_data, const MasterContext& a
 #undef WRITE_PRIM
 }
 
-inline AData::Ptr ReadData(const char*& a_buff, const MasterContext& a_mc, const CSerializationContext &a_context, DataType a_knownType)
+inline AData::Ptr ReadData(const char*& a_buff, const char *a_endBuff, MasterContext& a_mc,
+                           const CSerializationContext &a_context, DataType a_knownType)
 {
 #define READ_PRIM(name, type) \
 	case DataType::name: \
-		return MakePrim(ReadValue<type>(a_buff), a_context)
+		return MakePrim(ReadValue<type>(a_buff, a_endBuff), a_context)
 
 	if (a_knownType == DataType::Unknown)
 	{
-		a_knownType = (DataType)ReadValue<byte>(a_buff);
+		a_knownType = (DataType)ReadValue<byte>(a_buff, a_endBuff);
 	}
 
+	// Containers recurse, so their depth is limited
+	struct CDepthScope
+	{
+		MasterContext &m_mc;
+
+		CDepthScope(MasterContext &a_mc)
+			: m_mc(a_mc)
+		{
+			if (m_mc.DepthLeft == 0)
+				throw runtime_error("The data exceeds the maximum nesting depth.");
+			--m_mc.DepthLeft;
+		}
+		~CDepthScope() { ++m_mc.DepthLeft; }
+	};
+
 	switch (a_knownType)
 	{
 	READ_PRIM(SByte, byte);
@@ -696,7 +1614,7 @@ inline AData::Ptr ReadData(const char*& a_buff, const MasterContext& a_mc, const
 	READ_PRIM(UShort, ushort);
 	READ_PRIM(Int, int);
 	READ_PRIM(UInt, uint);
-	READ_PRIM(Long, long long);
+	READ_PRIM(Long, int64_t);
 	READ_PRIM(ULong, ulong);
 	READ_PRIM(Float, float);
 	READ_PRIM(Double, double);
@@ -707,16 +1625,22 @@ inline AData::Ptr ReadData(const char*& a_buff, const MasterContext& a_mc, const
 		return CNullData::Create(a_context);
 
 	case DataType::Struct:
-		return ReadStruct(a_buff, a_mc, a_context);
+	{
+		CDepthScope l_scope(a_mc);
+		return ReadStruct(a_buff, a_endBuff, a_mc, a_context);
+	}
 
 	case DataType::Array:
-		return ReadArray(a_buff, a_mc, a_context);
+	{
+		CDepthScope l_scope(a_mc);
+		return ReadArray(a_buff, a_endBuff, a_mc, a_context);
+	}
 
 	case DataType::Buffer:
-		return ReadBuffer(a_buff, a_context);
+		return ReadBuffer(a_buff, a_endBuff, a_mc, a_context);
 
 	case DataType::PrimArray:
-		return ReadPrimArray(a_buff, a_context);
+		return ReadPrimArray(a_buff, a_endBuff, a_mc, a_context);
 	}
 
 	throw runtime_error("Unsupported data type.");
@@ -724,82 +1648,759 @@ inline AData::Ptr ReadData(const char*& a_buff, const MasterContext& a_mc, const
 #undef READ_PRIM
 }
 
-inline size_t p_CalcHeaderSize(const AData& a_data, MasterContext& a_mc)
-{
-	size_t l_size = 0;
+// Writing to a stream. Containers are written a piece at a time, and every
+// other value is encoded into the writer's buffer as a whole. Values that
+// are larger than the buffer are written in slices instead
+void StreamData(CChunkedWriter &a_out, const AData &a_data, MasterContext &a_mc, DataType a_knownType = DataType::Unknown);
 
-	l_size += sizeof(MAGIC_NUMBER); // Magic Number
-	l_size += sizeof(VERSION); // Version
-	l_size += CalcEncodeSize(a_mc.NameMap.size()); // Name table size
+template<typename T>
+void StreamPackedImpl(CChunkedWriter &a_out, const CPrimArrayData<T> &a_data, true_type)
+{
+	const size_t l_slice = a_out.Capacity() / MAX_ENCODE_SIZE;
 
-	for (const auto &l_nameRec : a_mc.NameMap)
+	for (size_t i = 0; i < a_data.size(); i += l_slice)
 	{
-		l_size += CalcValueSize(l_nameRec.first);
-		// Don't need to store the key because the names
-		// will be written out in monotonically increasing order
+		const size_t l_num = min(l_slice, a_data.size() - i);
+
+		char *l_write = a_out.Reserve(l_num * MAX_ENCODE_SIZE);
+		WritePacked(l_write, a_data.Data() + i, l_num);
+		a_out.Commit(l_write);
 	}
+}
 
-	return l_size;
+template<typename T>
+void StreamPackedImpl(CChunkedWriter &a_out, const CPrimArrayData<T> &a_data, false_type)
+{
+	throw runtime_error("Only integer arrays can be packed.");
 }
 
-inline void WriteHeader(char*& a_buff, const MasterContext& a_mc)
+template<typename T>
+void StreamDeltaImpl(CChunkedWriter &a_out, const CPrimArrayData<T> &a_data, true_type, false_type)
 {
-	typedef pair<size_t, const string*> record;
+	const size_t l_slice = a_out.Capacity() / MAX_ENCODE_SIZE;
 
-	WriteValue(a_buff, MAGIC_NUMBER);
-	WriteValue(a_buff, VERSION);
+	for (size_t i = 0; i < a_data.size(); i += l_slice)
+	{
+		const size_t l_num = min(l_slice, a_data.size() - i);
 
-	EncodeSize(a_buff, a_mc.NameMap.size());
+		char *l_write = a_out.Reserve(l_num * MAX_ENCODE_SIZE);
+		WriteDelta(l_write, a_data.Data() + i, l_num, i ? a_data[i - 1] : T(0));
+		a_out.Commit(l_write);
+	}
+}
 
-	if (a_mc.NameMap.empty())
-		return;
+template<typename T>
+void StreamDeltaImpl(CChunkedWriter &a_out, const CPrimArrayData<T> &a_data, false_type, true_type)
+{
+	const size_t l_slice = a_out.Capacity() / MaxXorSize<T>();
 
-	vector<record> l_sorted;
-	l_sorted.reserve(a_mc.NameMap.size());
-	for (const auto &l_pair : a_mc.NameMap)
+	for (size_t i = 0; i < a_data.size(); i += l_slice)
 	{
-		l_sorted.push_back(record(l_pair.second, &l_pair.first));
+		const size_t l_num = min(l_slice, a_data.size() - i);
+
+		char *l_write = a_out.Reserve(l_num * MaxXorSize<T>());
+		WriteXor(l_write, a_data.Data() + i, l_num, i ? a_data[i - 1] : T(0));
+		a_out.Commit(l_write);
 	}
+}
 
-	sort(l_sorted.begin(), l_sorted.end(),
-			[] (const record &a, const record &b)
-			{
-				return a.first < b.first;
-			});
+template<typename T>
+void StreamDeltaImpl(CChunkedWriter &a_out, const CPrimArrayData<T> &a_data, false_type, false_type)
+{
+	throw runtime_error("Only integer and float arrays can be delta coded.");
+}
 
-	if (l_sorted.front().first != 0)
-		throw runtime_error("Invalid first record.");
+template<typename T>
+void StreamPrimArrayImpl(CChunkedWriter &a_out, const CPrimArrayData<T> &a_data, byte a_mode)
+{
+	if (a_mode == PRIM_PACKED)
+	{
+		StreamPackedImpl(a_out, a_data, is_packable<T>());
+		return;
+	}
 
-	for (const record &l_rec : l_sorted)
+	if (a_mode == PRIM_DELTA || a_mode == PRIM_XOR)
 	{
-		WriteValue(a_buff, *l_rec.second);
+		StreamDeltaImpl(a_out, a_data, is_packable<T>(), is_floating_point<T>());
+		return;
 	}
+
+	a_out.Write(reinterpret_cast<const char *>(a_data.Data()), sizeof(T) * a_data.size());
 }
 
-inline void ReadHeader(const char*& a_buff, MasterContext& a_mc)
+inline void StreamPrimArrayImpl(CChunkedWriter &a_out, const CPrimArrayData<bool> &a_data, byte a_mode)
 {
-	if (ReadValue<remove_const<decltype(MAGIC_NUMBER)>::type>(a_buff) != MAGIC_NUMBER)
-		throw runtime_error("The specified binary stream is not valid.");
+	// Whole words of bits, so that the slices line up
+	const size_t l_slice = a_mode == PRIM_BITS ? (a_out.Capacity() / 8) * 64 : a_out.Capacity();
 
-	if (ReadValue<remove_const<decltype(VERSION)>::type>(a_buff) != 1)
-		throw runtime_error("Only Version 1 byte streams are currently supported.");
-
-	size_t l_tableSize = DecodeSize(a_buff);
-
-	for (size_t i = 0; i < l_tableSize; ++i)
+	for (size_t i = 0; i < a_data.size(); i += l_slice)
 	{
-		string l_key;
-		ReadValue(a_buff, l_key);
+		const size_t l_num = min(l_slice, a_data.size() - i);
 
-		a_mc.ReverseMap.emplace(i, move(l_key));
-	}
-}
+		auto l_iter = a_data.begin() + i;
 
+		if (a_mode == PRIM_BITS)
+		{
+			char *l_write = a_out.Reserve(CalcBitPackedSize(l_num));
+			WriteBitPacked(l_write, l_iter, l_num);
+			a_out.Commit(l_write);
+		}
+		else
+		{
+			char *l_write = a_out.Reserve(l_num);
+			for (auto l_end = l_iter + l_num; l_iter != l_end; ++l_iter)
+			{
+				WriteValue(l_write, bool(*l_iter));
+			}
+			a_out.Commit(l_write);
+		}
+	}
 }
 
+inline void StreamString(CChunkedWriter &a_out, const string &a_val)
+{
+	if (CalcValueSize(a_val) <= a_out.Capacity())
+	{
+		char *l_write = a_out.Reserve(CalcValueSize(a_val));
+		WriteValue(l_write, a_val);
+		a_out.Commit(l_write);
+		return;
+	}
 
+	char *l_write = a_out.Reserve(MAX_ENCODE_SIZE);
+	EncodeSize(l_write, a_val.size());
+	a_out.Commit(l_write);
 
+	a_out.Write(a_val.data(), a_val.size());
 }
+
+inline void StreamPrimArrayImpl(CChunkedWriter &a_out, const CPrimArrayData<string> &a_data, byte)
+{
+	for (const string &l_val : a_data)
+	{
+		StreamString(a_out, l_val);
+	}
+}
+
+inline void StreamPrimArray(CChunkedWriter &a_out, const APrimArrayDataBase &a_data, const MasterContext &a_mc,
+                            bool a_writeType)
+{
+#define STREAM_PRIM(name, type) \
+	case DataType::name: \
+		StreamPrimArrayImpl(a_out, static_cast<const CPrimArrayData<type> &>(a_data), l_mode); \
+		break
+
+	const byte l_mode = GetPrimArrayMode(a_data, a_mc);
+
+	char *l_write = a_out.Reserve(3 * sizeof(byte) + MAX_ENCODE_SIZE);
+	if (a_writeType)
+		WriteValue(l_write, (byte)DataType::PrimArray);
+	WriteValue(l_write, l_mode);
+	WriteValue(l_write, (byte)a_data.InnerType());
+	EncodeSize(l_write, a_data.Size());
+	a_out.Commit(l_write);
+
+	switch (a_data.InnerType())
+	{
+	STREAM_PRIM(SByte, signed char);
+	STREAM_PRIM(UByte, unsigned char);
+	STREAM_PRIM(Short, short);
+	STREAM_PRIM(UShort, unsigned short);
+	STREAM_PRIM(Int, int);
+	STREAM_PRIM(UInt, unsigned int);
+	STREAM_PRIM(Long, int64_t);
+	STREAM_PRIM(ULong, uint64_t);
+	STREAM_PRIM(Float, float);
+	STREAM_PRIM(Double, double);
+	STREAM_PRIM(Bool, bool);
+	STREAM_PRIM(String, string);
+
+	default:
+		throw runtime_error("Unsupported primitive type.");
+	}
+
+#undef STREAM_PRIM
+}
+
+inline void StreamData(CChunkedWriter &a_out, const AData &a_data, MasterContext &a_mc, DataType a_knownType)
+{
+	// Columns of a columnar array are written without their types
+	const bool l_writeType = a_knownType == DataType::Unknown;
+
+	switch (a_data.Type())
+	{
+	case DataType::Struct:
+	{
+		const CStructData &l_struct = static_cast<const CStructData &>(a_data);
+
+		char *l_write = a_out.Reserve(2 * sizeof(byte) + MAX_ENCODE_SIZE);
+		if (l_writeType)
+			WriteValue(l_write, (byte)DataType::Struct);
+		WriteValue(l_write, byte(0)); // Write Mode (Plain)
+		EncodeSize(l_write, l_struct.size());
+		a_out.Commit(l_write);
+
+		for (const auto &l_prop : l_struct)
+		{
+			l_write = a_out.Reserve(MAX_ENCODE_SIZE);
+			EncodeSize(l_write, a_mc.FindNameRef(l_prop.first));
+			a_out.Commit(l_write);
+
+			StreamData(a_out, *l_prop.second, a_mc);
+		}
+		return;
+	}
+
+	case DataType::Array:
+	{
+		const CArrayData &l_arr = static_cast<const CArrayData &>(a_data);
+
+		const bool l_columnar = IsColumnar(l_arr, a_mc);
+
+		char *l_write = a_out.Reserve(2 * sizeof(byte) + 2 * MAX_ENCODE_SIZE);
+		if (l_writeType)
+			WriteValue(l_write, (byte)DataType::Array);
+		WriteValue(l_write, l_columnar ? ARRAY_COLUMNAR : ARRAY_PLAIN);
+		EncodeSize(l_write, l_arr.size());
+
+		if (!l_columnar)
+		{
+			a_out.Commit(l_write);
+
+			for (const auto &l_val : l_arr)
+			{
+				StreamData(a_out, *l_val, a_mc);
+			}
+			return;
+		}
+
+		const CStructData &l_schema = static_cast<const CStructData &>(**l_arr.begin());
+
+		EncodeSize(l_write, l_schema.size());
+		a_out.Commit(l_write);
+
+		for (const auto &l_prop : l_schema)
+		{
+			l_write = a_out.Reserve(MAX_ENCODE_SIZE + sizeof(byte));
+			EncodeSize(l_write, a_mc.FindNameRef(l_prop.first));
+			WriteValue(l_write, (byte)l_prop.second->Type());
+			a_out.Commit(l_write);
+		}
+
+		for (size_t i = 0; i < l_schema.size(); ++i)
+		{
+			const DataType l_type = GetField(l_schema, i).Type();
+
+			for (const auto &l_val : l_arr)
+			{
+				StreamData(a_out, GetField(*l_val, i), a_mc, l_type);
+			}
+		}
+		return;
+	}
+
+	default:
+		break;
+	}
+
+	const size_t l_size = p_CalcSize(a_data, a_mc, a_knownType);
+
+	if (l_size <= a_out.Capacity())
+	{
+		char *l_write = a_out.Reserve(l_size);
+		WriteData(l_write, a_data, a_mc, a_knownType);
+		a_out.Commit(l_write);
+		return;
+	}
+
+	switch (a_data.Type())
+	{
+	case DataType::String:
+	{
+		if (l_writeType)
+		{
+			char *l_write = a_out.Reserve(sizeof(byte));
+			WriteValue(l_write, (byte)DataType::String);
+			a_out.Commit(l_write);
+		}
+
+		StreamString(a_out, static_cast<const CStringData &>(a_data).GetValue());
+		break;
+	}
+
+	case DataType::Buffer:
+	{
+		const CBufferData &l_buff = static_cast<const CBufferData &>(a_data);
+
+		CCompressedBuffer::Ptr l_scratch;
+		const CCompressedBuffer *l_comp = GetCompressed(l_buff, a_mc, l_scratch);
+
+		char *l_write = a_out.Reserve(sizeof(byte) + 2 * MAX_ENCODE_SIZE);
+		if (l_writeType)
+			WriteValue(l_write, (byte)DataType::Buffer);
+		EncodeSize(l_write, l_comp ? l_comp->Size : 0); // Size of compressed buffer
+		EncodeSize(l_write, l_buff.BufferSize());
+		a_out.Commit(l_write);
+
+		if (l_comp)
+			a_out.Write(l_comp->Data.get(), l_comp->Size);
+		else
+			a_out.Write(l_buff.GetBuffer().Data(), l_buff.BufferSize());
+		break;
+	}
+
+	case DataType::PrimArray:
+		StreamPrimArray(a_out, static_cast<const APrimArrayDataBase &>(a_data), a_mc, l_writeType);
+		break;
+
+	default:
+		throw runtime_error("Unknown data type.");
+	}
+}
+
+inline size_t p_ShapeKey(const AData &a_data)
+{
+	// Cheap key for the name table cache. Only looks at the top level
+	// struct (or the first element of an array) since the full set of
+	// names is validated while calculating the size anyways
+	size_t l_key = size_t(a_data.Type());
+
+	auto l_combine = [&l_key] (size_t a_val)
+		{
+			l_key ^= a_val + 0x9e3779b9 + (l_key << 6) + (l_key >> 2);
+		};
+
+	switch (a_data.Type())
+	{
+	case DataType::Struct:
+		for (const auto &l_prop : static_cast<const CStructData &>(a_data))
+		{
+			l_combine(hash<string>()(l_prop.first));
+		}
+		break;
+
+	case DataType::Array:
+	{
+		const CArrayData &l_arr = static_cast<const CArrayData &>(a_data);
+		if (l_arr.size())
+			l_combine(p_ShapeKey(**l_arr.begin()));
+		break;
+	}
+
+	default:
+		break;
+	}
+
+	return l_key;
+}
+
+inline size_t p_CalcHeaderSize(const MasterContext& a_mc)
+{
+	size_t l_size = 0;
+
+	l_size += sizeof(MAGIC_NUMBER); // Magic Number
+	l_size += sizeof(VERSION); // Version
+
+	if (a_mc.Dict)
+	{
+		l_size += sizeof(byte); // Flags
+		l_size += CalcEncodeSize(a_mc.Base); // Dictionary size
+	}
+
+	l_size += a_mc.Table->Encoded.size(); // Name table
+
+	return l_size;
+}
+
+inline void WriteHeader(char*& a_buff, const MasterContext& a_mc)
+{
+	WriteValue(a_buff, MAGIC_NUMBER);
+
+	if (a_mc.Dict)
+	{
+		WriteValue(a_buff, DICT_VERSION);
+		WriteValue(a_buff, byte(a_mc.Learn ? HEADER_LEARN : 0));
+		EncodeSize(a_buff, a_mc.Base);
+	}
+	else
+	{
+		WriteValue(a_buff, VERSION);
+	}
+
+	const string &l_names = a_mc.Table->Encoded;
+
+	memcpy(a_buff, l_names.data(), l_names.size());
+	a_buff += l_names.size();
+}
+
+inline void ReadHeader(const char*& a_buff, const char *a_endBuff, MasterContext& a_mc,
+                       const CNameTable::Ptr &a_lastRead)
+{
+	if (ReadValue<remove_const<decltype(MAGIC_NUMBER)>::type>(a_buff, a_endBuff) != MAGIC_NUMBER)
+		throw runtime_error("The specified binary stream is not valid.");
+
+	ushort l_version = ReadValue<ushort>(a_buff, a_endBuff);
+
+	if (l_version == DICT_VERSION)
+	{
+		a_mc.Learn = 0 != (ReadValue<byte>(a_buff, a_endBuff) & HEADER_LEARN);
+		a_mc.Base = DecodeSize(a_buff, a_endBuff);
+	}
+	else if (l_version != VERSION)
+	{
+		throw runtime_error("Only Version 1 and 2 byte streams are currently supported.");
+	}
+
+	// Messages of the same shape have byte-identical name tables, so
+	// skip decoding when the table matches the last one that was read
+	if (a_lastRead)
+	{
+		const string &l_enc = a_lastRead->Encoded;
+
+		if (size_t(a_endBuff - a_buff) >= l_enc.size() &&
+			0 == memcmp(a_buff, l_enc.data(), l_enc.size()))
+		{
+			a_mc.Table = a_lastRead;
+			a_buff += l_enc.size();
+			return;
+		}
+	}
+
+	const char *l_start = a_buff;
+
+	auto l_table = make_shared<CNameTable>();
+
+	size_t l_tableSize = DecodeSize(a_buff, a_endBuff);
+
+	// Each name takes at least 1 byte (size)
+	if (l_tableSize > size_t(a_endBuff - a_buff))
+		throw CBufferOverflowException();
+
+	for (size_t i = 0; i < l_tableSize; ++i)
+	{
+		string l_key;
+		ReadValue(a_buff, a_endBuff, l_key);
+
+		l_table->Names.push_back(move(l_key));
+	}
+
+	l_table->Encoded.assign(l_start, a_buff);
+
+	a_mc.Table = move(l_table);
+}
+
+// Walks a value without decoding it, to find where it ends. Running out
+// of input throws CBufferOverflowException, and records how large the
+// input needs to be before it is worth trying again
+class CAxonSkipper
+{
+public:
+	CAxonSkipper(const char *a_buff, const char *a_endBuff, size_t a_maxDepth)
+		: m_start(a_buff), m_curr(a_buff), m_end(a_endBuff), m_depthLeft(a_maxDepth), m_needed(0) { }
+
+	size_t Offset() const { return m_curr - m_start; }
+	size_t Needed() const { return m_needed; }
+
+	void SkipHeader()
+	{
+		if (ReadValue<remove_const<decltype(MAGIC_NUMBER)>::type>(m_curr, m_end) != MAGIC_NUMBER)
+			throw runtime_error("The specified binary stream is not valid.");
+
+		ushort l_version = ReadValue<ushort>(m_curr, m_end);
+
+		if (l_version == DICT_VERSION)
+		{
+			Skip(sizeof(byte)); // Flags
+			DecodeSize(m_curr, m_end); // Base
+		}
+		else if (l_version != VERSION)
+		{
+			throw runtime_error("Only Version 1 and 2 byte streams are currently supported.");
+		}
+
+		for (size_t i = 0, l_tableSize = DecodeSize(m_curr, m_end); i < l_tableSize; ++i)
+		{
+			Skip(DecodeSize(m_curr, m_end));
+		}
+	}
+
+	void SkipData(DataType a_knownType = DataType::Unknown)
+	{
+#define SKIP_PRIM(name, type) \
+	case DataType::name: \
+		Skip(sizeof(type)); \
+		return
+
+		if (a_knownType == DataType::Unknown)
+			a_knownType = (DataType)ReadValue<byte>(m_curr, m_end);
+
+		switch (a_knownType)
+		{
+		SKIP_PRIM(SByte, byte);
+		SKIP_PRIM(UByte, byte);
+		SKIP_PRIM(Short, short);
+		SKIP_PRIM(UShort, ushort);
+		SKIP_PRIM(Int, int);
+		SKIP_PRIM(UInt, uint);
+		SKIP_PRIM(Long, int64_t);
+		SKIP_PRIM(ULong, ulong);
+		SKIP_PRIM(Float, float);
+		SKIP_PRIM(Double, double);
+		SKIP_PRIM(Bool, bool);
+
+		case DataType::String:
+			Skip(DecodeSize(m_curr, m_end));
+			return;
+
+		case DataType::Null:
+			return;
+
+		case DataType::Struct:
+		case DataType::Array:
+			SkipContainer(a_knownType == DataType::Struct);
+			return;
+
+		case DataType::Buffer:
+		{
+			const size_t l_compSize = DecodeSize(m_curr, m_end);
+			const size_t l_size = DecodeSize(m_curr, m_end);
+
+			Skip(l_compSize ? l_compSize : l_size);
+			return;
+		}
+
+		case DataType::PrimArray:
+			SkipPrimArray();
+			return;
+		}
+
+		throw runtime_error("Unsupported data type.");
+
+#undef SKIP_PRIM
+	}
+
+private:
+	void Skip(size_t a_size)
+	{
+		if (a_size > size_t(m_end - m_curr))
+		{
+			m_needed = Offset() + a_size;
+			throw CBufferOverflowException();
+		}
+
+		m_curr += a_size;
+	}
+
+	void SkipContainer(bool a_struct)
+	{
+		if (m_depthLeft == 0)
+			throw runtime_error("The data exceeds the maximum nesting depth.");
+		--m_depthLeft;
+
+		const byte l_mode = ReadValue<byte>(m_curr, m_end);
+
+		if (!a_struct && l_mode == ARRAY_COLUMNAR)
+		{
+			SkipColumns();
+		}
+		else
+		{
+			for (size_t i = 0, l_size = DecodeSize(m_curr, m_end); i < l_size; ++i)
+			{
+				if (a_struct)
+					DecodeSize(m_curr, m_end); // Name reference
+
+				SkipData();
+			}
+		}
+
+		++m_depthLeft;
+	}
+
+	void SkipColumns()
+	{
+		const size_t l_numRows = DecodeSize(m_curr, m_end);
+
+		vector<DataType> l_types;
+
+		for (size_t i = 0, l_numFields = DecodeSize(m_curr, m_end); i < l_numFields; ++i)
+		{
+			DecodeSize(m_curr, m_end); // Name reference
+
+			const DataType l_type = (DataType)ReadValue<byte>(m_curr, m_end);
+
+			if (l_type == DataType::Unknown)
+				throw runtime_error("Unsupported data type.");
+
+			// Null columns take no space
+			if (l_type != DataType::Null)
+				l_types.push_back(l_type);
+		}
+
+		if (l_types.empty())
+			throw runtime_error("Invalid array format.");
+
+		for (DataType l_type : l_types)
+		{
+			for (size_t i = 0; i < l_numRows; ++i)
+			{
+				SkipData(l_type);
+			}
+		}
+	}
+
+	void SkipPrimArray()
+	{
+#define SKIP_PRIM(name, type) \
+	case DataType::name: \
+		Skip(sizeof(type) * l_numElems); \
+		return
+
+		const byte l_mode = ReadValue<byte>(m_curr, m_end);
+		const DataType l_inner = (DataType)ReadValue<byte>(m_curr, m_end);
+		const size_t l_numElems = DecodeSize(m_curr, m_end);
+
+		if (l_mode == PRIM_BITS)
+		{
+			Skip(CalcBitPackedSize(l_numElems));
+			return;
+		}
+
+		if (l_mode == PRIM_XOR)
+		{
+			// A control byte, followed by the stored bytes it counts
+			for (size_t i = 0; i < l_numElems; ++i)
+			{
+				Skip(ReadValue<byte>(m_curr, m_end) & 0xF);
+			}
+			return;
+		}
+
+		if (l_mode == PRIM_PACKED || l_mode == PRIM_DELTA || l_inner == DataType::String)
+		{
+			// One variable length value (or string size) per element
+			for (size_t i = 0; i < l_numElems; ++i)
+			{
+				size_t l_val = DecodeSize(m_curr, m_end);
+
+				if (l_inner == DataType::String)
+					Skip(l_val);
+			}
+			return;
+		}
+
+		if (l_mode != PRIM_PLAIN)
+			throw runtime_error("Unsupported primitive array write mode.");
+
+		if (l_numElems > numeric_limits<size_t>::max() / sizeof(ulong))
+			throw runtime_error("The primitive array is too large.");
+
+		switch (l_inner)
+		{
+		SKIP_PRIM(SByte, signed char);
+		SKIP_PRIM(UByte, unsigned char);
+		SKIP_PRIM(Short, short);
+		SKIP_PRIM(UShort, unsigned short);
+		SKIP_PRIM(Int, int);
+		SKIP_PRIM(UInt, unsigned int);
+		SKIP_PRIM(Long, int64_t);
+		SKIP_PRIM(ULong, uint64_t);
+		SKIP_PRIM(Float, float);
+		SKIP_PRIM(Double, double);
+		SKIP_PRIM(Bool, bool);
+		}
+
+		throw runtime_error("Unsupported primitive type.");
+
+#undef SKIP_PRIM
+	}
+
+	const char *m_start;
+	const char *m_curr;
+	const char *m_end;
+	size_t m_depthLeft;
+	size_t m_needed;
+};
+
+class CAxonScanner
+	: public IValueScanner
+{
+public:
+	CAxonScanner(size_t a_maxDepth)
+		: m_maxDepth(a_maxDepth), m_needed(0) { }
+
+	virtual size_t Scan(const char *a_buf, const char *a_endBuf) override
+	{
+		// Don't walk the value again until the piece that was missing
+		// has arrived
+		if (size_t(a_endBuf - a_buf) < m_needed)
+			return 0;
+
+		CAxonSkipper l_skipper(a_buf, a_endBuf, m_maxDepth);
+
+		try
+		{
+			l_skipper.SkipHeader();
+			l_skipper.SkipData();
+		}
+		catch (CBufferOverflowException &)
+		{
+			m_needed = max(l_skipper.Needed(), size_t(a_endBuf - a_buf) + 1);
+			return 0;
+		}
+
+		return l_skipper.Offset();
+	}
+
+	virtual void Reset() override
+	{
+		m_needed = 0;
+	}
+
+private:
+	size_t m_maxDepth;
+	size_t m_needed;
+};
+
+}
+
+void CAxonSerializer::SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const
+{
+	const size_t l_writeSize = p_EstablishSize(a_data);
+
+	MasterContext &l_mc = *static_cast<MasterContext*>(a_data.GetDataContext());
+
+	CChunkedWriter l_out(a_stream);
+
+	const size_t l_headerSize = p_CalcHeaderSize(l_mc);
+
+	if (l_headerSize <= l_out.Capacity())
+	{
+		char *l_write = l_out.Reserve(l_headerSize);
+		WriteHeader(l_write, l_mc);
+		l_out.Commit(l_write);
+	}
+	else
+	{
+		// Only a very large name table gets here
+		string l_header(l_headerSize, '\0');
+		char *l_write = &l_header[0];
+		WriteHeader(l_write, l_mc);
+		l_out.Write(l_header.data(), l_header.size());
+	}
+
+	StreamData(l_out, a_data, l_mc);
+
+	l_out.Flush();
+
+	if (l_out.Written() != l_writeSize)
+		throw runtime_error("The serialized data size did not match the calculated size.");
 }
 
+IValueScanner::Ptr CAxonSerializer::CreateScanner() const
+{
+	return IValueScanner::Ptr(new CAxonScanner(m_maxDepth));
+}
 
+}
+}
@@ -0,0 +1,163 @@
+/*
+ * File description: bit_pack.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef BIT_PACK_H_
+#define BIT_PACK_H_
+
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <vector>
+
+namespace axon { namespace serialization { namespace detail {
+
+// Packed bool arrays use 1 bit per value. Value i is stored in byte i / 8,
+// starting from the least significant bit, so the layout doesn't depend
+// on the byte order of the machine
+inline size_t CalcBitPackedSize(size_t a_count)
+{
+	return (a_count + 7) / 8;
+}
+
+inline void StoreWord(char *a_out, uint64_t a_word, size_t a_numBytes)
+{
+	for (size_t i = 0; i < a_numBytes; ++i, a_word >>= 8)
+	{
+		a_out[i] = char(a_word & 0xFF);
+	}
+}
+
+inline uint64_t LoadWord(const char *a_in, size_t a_numBytes)
+{
+	uint64_t l_word = 0;
+
+	for (size_t i = 0; i < a_numBytes; ++i)
+	{
+		l_word |= uint64_t(uint8_t(a_in[i])) << (8 * i);
+	}
+
+	return l_word;
+}
+
+// Same as LoadWord, for input with at least 8 bytes left. Little endian
+// targets read it with a single load, and mask off the extra bytes
+inline uint64_t LoadWordPadded(const char *a_in, size_t a_numBytes)
+{
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+	uint64_t l_word;
+	memcpy(&l_word, a_in, sizeof(l_word));
+
+	// Shifted in two steps, since 8 bytes would shift by 64
+	return l_word & ~(~uint64_t(0) << (4 * a_numBytes) << (4 * a_numBytes));
+#else
+	return LoadWord(a_in, a_numBytes);
+#endif
+}
+
+// The values are gathered into 64 bit words, which are then written
+// 8 bytes at a time
+template<typename BoolIter>
+void WriteBitPacked(char *&a_buff, BoolIter a_iter, size_t a_count)
+{
+	for (size_t i = 0; i < a_count; i += 64)
+	{
+		const size_t l_num = a_count - i < 64 ? a_count - i : 64;
+
+		uint64_t l_word = 0;
+
+		for (size_t j = 0; j < l_num; ++j, ++a_iter)
+		{
+			l_word |= uint64_t(bool(*a_iter)) << j;
+		}
+
+		const size_t l_numBytes = CalcBitPackedSize(l_num);
+
+		StoreWord(a_buff, l_word, l_numBytes);
+		a_buff += l_numBytes;
+	}
+}
+
+// The input must hold at least CalcBitPackedSize(a_count) bytes
+template<typename BoolIter>
+void ReadBitPacked(const char *&a_buff, BoolIter a_iter, size_t a_count)
+{
+	for (size_t i = 0; i < a_count; i += 64)
+	{
+		const size_t l_num = a_count - i < 64 ? a_count - i : 64;
+		const size_t l_numBytes = CalcBitPackedSize(l_num);
+
+		const uint64_t l_word = LoadWord(a_buff, l_numBytes);
+		a_buff += l_numBytes;
+
+		for (size_t j = 0; j < l_num; ++j, ++a_iter)
+		{
+			*a_iter = 0 != ((l_word >> j) & 1);
+		}
+	}
+}
+
+#if defined(__GLIBCXX__) && __SIZEOF_LONG__ == 8
+// libstdc++ stores vector<bool> in 64 bit words, with value i at bit i % 64
+// of word i / 64, which is the packed layout already. So bool arrays are
+// packed and unpacked a word at a time, instead of a value at a time.
+// Iterators that don't start on a word boundary take the generic path
+inline uint64_t BitMask(size_t a_num)
+{
+	return a_num < 64 ? (uint64_t(1) << a_num) - 1 : ~uint64_t(0);
+}
+
+inline void WriteBitPacked(char *&a_buff, std::vector<bool>::const_iterator a_iter, size_t a_count)
+{
+	if (a_iter._M_offset != 0)
+	{
+		WriteBitPacked<std::vector<bool>::const_iterator>(a_buff, a_iter, a_count);
+		return;
+	}
+
+	const std::_Bit_type *l_words = a_iter._M_p;
+
+	for (size_t i = 0; i < a_count; i += 64, ++l_words)
+	{
+		const size_t l_num = a_count - i < 64 ? a_count - i : 64;
+		const size_t l_numBytes = CalcBitPackedSize(l_num);
+
+		// The bits past the end of the vector aren't necessarily clear
+		StoreWord(a_buff, *l_words & BitMask(l_num), l_numBytes);
+		a_buff += l_numBytes;
+	}
+}
+
+inline void WriteBitPacked(char *&a_buff, std::vector<bool>::iterator a_iter, size_t a_count)
+{
+	WriteBitPacked(a_buff, std::vector<bool>::const_iterator(a_iter), a_count);
+}
+
+inline void ReadBitPacked(const char *&a_buff, std::vector<bool>::iterator a_iter, size_t a_count)
+{
+	if (a_iter._M_offset != 0)
+	{
+		ReadBitPacked<std::vector<bool>::iterator>(a_buff, a_iter, a_count);
+		return;
+	}
+
+	std::_Bit_type *l_words = a_iter._M_p;
+
+	for (size_t i = 0; i < a_count; i += 64, ++l_words)
+	{
+		const size_t l_num = a_count - i < 64 ? a_count - i : 64;
+		const size_t l_numBytes = CalcBitPackedSize(l_num);
+		const uint64_t l_mask = BitMask(l_num);
+
+		// The rest of the last word belongs to the values after the range
+		*l_words = (*l_words & ~l_mask) | (LoadWord(a_buff, l_numBytes) & l_mask);
+		a_buff += l_numBytes;
+	}
+}
+#endif
+
+} } }
+
+#endif /* BIT_PACK_H_ */
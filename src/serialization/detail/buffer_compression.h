@@ -0,0 +1,101 @@
+/*
+ * File description: buffer_compression.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef BUFFER_COMPRESSION_H_
+#define BUFFER_COMPRESSION_H_
+
+#include <memory>
+#include <stdexcept>
+
+#include "serialization/base/buffer_data.h"
+#include "serialization/format/i_compressor.h"
+#include "util/crc_calc.h"
+
+namespace axon { namespace serialization { namespace detail {
+
+// The compressed form of buffer data. It is kept in the data context of the
+// buffer, so that the compression that was done to calculate the size is
+// reused when the buffer is written. The buffer can be changed in place
+// between serializations, so the cached form is matched by a CRC of the
+// contents as well, which is much cheaper than compressing them again
+struct CCompressedBuffer
+	: IDataContext
+{
+	typedef std::unique_ptr<CCompressedBuffer> Ptr;
+
+	const ICompressor *Compressor;
+	const char *Source;
+	size_t SourceSize;
+	uint32_t SourceCRC;
+
+	std::unique_ptr<char[]> Data;
+	size_t Size; // 0 when compressing didn't make the buffer smaller
+};
+
+/*
+ * Returns the compressed buffer, or null when the buffer should be stored
+ * as is. a_scratch holds the result when the data context of the buffer is
+ * already in use.
+ */
+inline const CCompressedBuffer *GetCompressed(const CBufferData &a_data, const ICompressor *a_compressor,
+                                              size_t a_threshold, CCompressedBuffer::Ptr &a_scratch)
+{
+	if (!a_compressor || !a_data.Compress() || a_data.BufferSize() == 0 ||
+		a_data.BufferSize() < a_threshold)
+		return nullptr;
+
+	const char *l_source = a_data.GetBuffer().Data();
+	const uint32_t l_crc = util::CalcCRC32(l_source, a_data.BufferSize());
+
+	auto l_cached = dynamic_cast<CCompressedBuffer *>(a_data.GetDataContext());
+
+	if (!l_cached || l_cached->Compressor != a_compressor ||
+		l_cached->Source != l_source || l_cached->SourceSize != a_data.BufferSize() ||
+		l_cached->SourceCRC != l_crc)
+	{
+		CCompressedBuffer::Ptr l_comp(new CCompressedBuffer);
+		l_comp->Compressor = a_compressor;
+		l_comp->Source = l_source;
+		l_comp->SourceSize = a_data.BufferSize();
+		l_comp->SourceCRC = l_crc;
+
+		a_compressor->Compress(l_source, a_data.BufferSize(), l_comp->Data, l_comp->Size);
+
+		if (l_comp->Size >= a_data.BufferSize())
+			l_comp->Size = 0;
+
+		l_cached = l_comp.get();
+
+		if (!a_data.GetDataContext() || dynamic_cast<CCompressedBuffer *>(a_data.GetDataContext()))
+			a_data.SetDataContext(std::move(l_comp));
+		else
+			a_scratch = std::move(l_comp);
+	}
+
+	return l_cached->Size ? l_cached : nullptr;
+}
+
+inline util::CBuffer Decompress(const ICompressor *a_compressor, const char *a_compressed,
+                                size_t a_compSize, size_t a_rawSize, size_t a_maxRawSize)
+{
+	if (!a_compressor)
+		throw std::runtime_error("A compressor is required to read compressed buffers.");
+
+	if (a_rawSize > a_maxRawSize)
+		throw std::runtime_error("The compressed buffer exceeds the maximum decompressed size.");
+
+	// Compressed buffers are only stored when they are smaller
+	if (a_compSize >= a_rawSize)
+		throw std::runtime_error("The specified compressed data is corrupted.");
+
+	std::unique_ptr<char[]> l_raw = a_compressor->Decompress(a_compressed, a_compSize, a_rawSize);
+
+	return util::CBuffer(a_rawSize, l_raw.release(), util::CBuffer::TakeOwnership);
+}
+
+} } }
+
+#endif /* BUFFER_COMPRESSION_H_ */
@@ -0,0 +1,96 @@
+/*
+ * File description: chunked_writer.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef CHUNKED_WRITER_H_
+#define CHUNKED_WRITER_H_
+
+#include <cstring>
+#include <memory>
+#include <ostream>
+#include <stdexcept>
+
+namespace axon { namespace serialization { namespace detail {
+
+// Buffered output for the serializers that write to a stream. Values are
+// encoded into a fixed size buffer, which is written out whenever the next
+// value doesn't fit. Anything larger than the buffer has to be written in
+// pieces, or passed straight through with Write
+class CChunkedWriter
+{
+public:
+	static const size_t BUFFER_SIZE = 64 * 1024;
+
+	CChunkedWriter(std::ostream &a_stream)
+		: m_stream(a_stream), m_buff(new char[BUFFER_SIZE]), m_curr(m_buff.get()),
+		  m_written(0) { }
+
+	size_t Capacity() const { return BUFFER_SIZE; }
+
+	// Total number of bytes, including the ones that are still buffered
+	size_t Written() const { return m_written + (m_curr - m_buff.get()); }
+
+	// Returns space for at least a_size bytes, which can't be more than the
+	// capacity. Call Commit with the end of what was actually written
+	char *Reserve(size_t a_size)
+	{
+		if (a_size > size_t(End() - m_curr))
+			Flush();
+
+		return m_curr;
+	}
+
+	void Commit(char *a_end)
+	{
+		m_curr = a_end;
+	}
+
+	// The end of the reserved space, for the encoders that check bounds
+	char *End() const { return m_buff.get() + BUFFER_SIZE; }
+
+	void Write(const char *a_data, size_t a_size)
+	{
+		if (a_size <= size_t(End() - m_curr))
+		{
+			memcpy(m_curr, a_data, a_size);
+			m_curr += a_size;
+			return;
+		}
+
+		Flush();
+
+		m_stream.write(a_data, a_size);
+		m_written += a_size;
+
+		Check();
+	}
+
+	void Flush()
+	{
+		const size_t l_size = m_curr - m_buff.get();
+
+		m_stream.write(m_buff.get(), l_size);
+		m_written += l_size;
+		m_curr = m_buff.get();
+
+		Check();
+	}
+
+private:
+	void Check()
+	{
+		if (!m_stream)
+			throw std::runtime_error("Failed to write the serialized data to the stream.");
+	}
+
+	std::ostream &m_stream;
+	std::unique_ptr<char[]> m_buff;
+	char *m_curr;
+	size_t m_written;
+};
+
+} } }
+
+#endif /* CHUNKED_WRITER_H_ */
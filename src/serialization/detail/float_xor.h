@@ -0,0 +1,180 @@
+/*
+ * File description: float_xor.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef FLOAT_XOR_H_
+#define FLOAT_XOR_H_
+
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "serialization/format/binary_format_common.h"
+#include "bit_pack.h"
+
+namespace axon { namespace serialization { namespace detail {
+
+// XOR coded float arrays, a byte aligned version of the Gorilla encoding.
+// Each value is XORed with the previous one (the first one with the value
+// before the slice, 0 for the whole array). Neighbouring values of a slowly
+// changing series share their sign, exponent and high mantissa bits, and
+// often end in zeros, so the result has zero bytes at both ends. Only the
+// bytes in between are stored, after a control byte that holds the number
+// of trailing zero bytes (high nibble) and of stored bytes (low nibble).
+// A repeated value takes a single byte
+template<typename T>
+struct CFloatBits;
+
+template<>
+struct CFloatBits<float>
+{
+	typedef uint32_t type;
+};
+
+template<>
+struct CFloatBits<double>
+{
+	typedef uint64_t type;
+};
+
+template<typename T>
+inline uint64_t ToBits(T a_val)
+{
+	typename CFloatBits<T>::type l_bits;
+	memcpy(&l_bits, &a_val, sizeof(T));
+	return l_bits;
+}
+
+template<typename T>
+inline T FromBits(uint64_t a_bits)
+{
+	const typename CFloatBits<T>::type l_bits = typename CFloatBits<T>::type(a_bits);
+
+	T l_val;
+	memcpy(&l_val, &l_bits, sizeof(T));
+	return l_val;
+}
+
+// The number of trailing zero bytes, and of bytes after those that have to
+// be stored. Both are 0 when the value is 0
+inline void XorSpan(uint64_t a_xor, size_t &a_trail, size_t &a_stored)
+{
+	// Counted from the lowest and highest set bits. The bits that are set
+	// for the 0 case keep the builtins defined, and keep it from branching
+	const size_t l_trail = size_t(__builtin_ctzll(a_xor | (uint64_t(1) << 63))) / 8;
+	const size_t l_end = size_t(71 - __builtin_clzll(a_xor | 1)) / 8;
+
+	a_trail = a_xor ? l_trail : 0;
+	a_stored = a_xor ? l_end - l_trail : 0;
+}
+
+// The longest encoding of a single value
+template<typename T>
+inline size_t MaxXorSize()
+{
+	return 1 + sizeof(T);
+}
+
+template<typename T>
+size_t CalcXorSize(const T *a_vals, size_t a_count)
+{
+	size_t l_size = a_count; // Control bytes
+
+	uint64_t l_prev = 0;
+
+	for (size_t i = 0; i < a_count; ++i)
+	{
+		const uint64_t l_bits = ToBits(a_vals[i]);
+
+		size_t l_trail, l_stored;
+		XorSpan(l_bits ^ l_prev, l_trail, l_stored);
+
+		l_size += l_stored;
+		l_prev = l_bits;
+	}
+
+	return l_size;
+}
+
+template<typename T>
+void WriteXor(char *&a_buff, const T *a_vals, size_t a_count, T a_prev)
+{
+	uint64_t l_prev = ToBits(a_prev);
+
+	// Written through a local, since the stores could otherwise alias a_buff
+	char *l_write = a_buff;
+
+	for (size_t i = 0; i < a_count; ++i)
+	{
+		const uint64_t l_bits = ToBits(a_vals[i]);
+		const uint64_t l_xor = l_bits ^ l_prev;
+
+		size_t l_trail, l_stored;
+		XorSpan(l_xor, l_trail, l_stored);
+
+		*l_write++ = char((l_trail << 4) | l_stored);
+
+		StoreWord(l_write, l_xor >> (8 * l_trail), l_stored);
+		l_write += l_stored;
+
+		l_prev = l_bits;
+	}
+
+	a_buff = l_write;
+}
+
+template<typename T>
+void ReadXor(const char *&a_buff, const char *a_endBuff, T *a_vals, size_t a_count)
+{
+	uint64_t l_prev = 0;
+
+	size_t i = 0;
+
+	// Each value depends on the one before it, and starts where the one
+	// before it ends, so the values are decoded in order. The stored bytes
+	// are read with a single load while a control byte and a whole word
+	// are left, which leaves the byte loop to the end of the input
+	for (; i < a_count && size_t(a_endBuff - a_buff) > sizeof(uint64_t); ++i)
+	{
+		const uint8_t l_control = uint8_t(*a_buff++);
+
+		const size_t l_trail = l_control >> 4;
+		const size_t l_stored = l_control & 0xF;
+
+		if (l_trail + l_stored > sizeof(T) || (l_stored == 0 && l_trail != 0))
+			throw std::runtime_error("Invalid XOR coded value.");
+
+		l_prev ^= LoadWordPadded(a_buff, l_stored) << (8 * l_trail);
+		a_buff += l_stored;
+
+		a_vals[i] = FromBits<T>(l_prev);
+	}
+
+	for (; i < a_count; ++i)
+	{
+		if (a_buff == a_endBuff)
+			throw CBufferOverflowException();
+
+		const uint8_t l_control = uint8_t(*a_buff++);
+
+		const size_t l_trail = l_control >> 4;
+		const size_t l_stored = l_control & 0xF;
+
+		if (l_trail + l_stored > sizeof(T) || (l_stored == 0 && l_trail != 0))
+			throw std::runtime_error("Invalid XOR coded value.");
+
+		if (l_stored > size_t(a_endBuff - a_buff))
+			throw CBufferOverflowException();
+
+		l_prev ^= LoadWord(a_buff, l_stored) << (8 * l_trail);
+		a_buff += l_stored;
+
+		a_vals[i] = FromBits<T>(l_prev);
+	}
+}
+
+} } }
+
+#endif /* FLOAT_XOR_H_ */
@@ -0,0 +1,326 @@
+/*
+ * File description: varint.h
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#ifndef VARINT_H_
+#define VARINT_H_
+
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "serialization/format/binary_format_common.h"
+
+namespace axon { namespace serialization { namespace detail {
+
+// Variable length sizes. 7 bits per byte, least significant group first,
+// with the high bit set on every byte except the last one
+inline size_t CalcEncodeSize(size_t a_size)
+{
+	if (a_size < 0x80)
+		return 1;
+
+	size_t l_ret = 2;
+
+	for (a_size >>= 14; a_size > 0; ++l_ret, a_size >>= 7);
+
+	return l_ret;
+}
+
+inline void EncodeSize(char *&a_buffer, size_t a_size)
+{
+	// Almost every size is a single byte
+	if (a_size < 0x80)
+	{
+		*a_buffer++ = char(a_size);
+		return;
+	}
+
+	for (; a_size > 0x7f; ++a_buffer, a_size >>= 7)
+	{
+		*a_buffer = char(0x80 | (a_size & 0x7F));
+	}
+
+	*a_buffer++ = char(a_size);
+}
+
+// The longest valid encoding of a size_t
+const size_t MAX_ENCODE_SIZE = (sizeof(size_t) * 8 + 6) / 7;
+
+inline void DecodeSize(const char *&a_buffer, const char *a_endBuff, size_t &a_size)
+{
+	if (a_buffer == a_endBuff)
+		throw CBufferOverflowException();
+
+	// Single byte fast path
+	if (!(*a_buffer & 0x80))
+	{
+		a_size = size_t(*a_buffer++);
+		return;
+	}
+
+	a_size = 0;
+
+	// When the longest encoding fits in the input, only the length of the
+	// encoding needs to be checked
+	const bool l_fits = size_t(a_endBuff - a_buffer) >= MAX_ENCODE_SIZE;
+
+	for (size_t shift = 0; ; shift += 7)
+	{
+		if (shift >= sizeof(size_t) * 8)
+			throw std::runtime_error("Invalid size encoding.");
+		if (!l_fits && a_buffer == a_endBuff)
+			throw CBufferOverflowException();
+
+		const uint8_t l_val = uint8_t(*a_buffer++);
+
+		a_size |= size_t(l_val & 0x7F) << shift;
+
+		if (!(l_val & 0x80))
+			break;
+	}
+}
+
+inline size_t DecodeSize(const char *&a_buff, const char *a_endBuff)
+{
+	size_t l_ret;
+	DecodeSize(a_buff, a_endBuff, l_ret);
+	return l_ret;
+}
+
+// Packed integer arrays. Each value is written as a variable length size.
+// Signed values are zig-zag encoded first, so that small negative values
+// stay small
+template<typename T>
+struct is_packable
+	: std::integral_constant<bool, std::is_integral<T>::value && (sizeof(T) > 1)>
+{
+};
+
+template<typename T>
+inline uint64_t ZigZagEncode(T a_val)
+{
+	typedef typename std::make_unsigned<T>::type U;
+
+	if (std::is_signed<T>::value)
+		return uint64_t(U(U(a_val) << 1) ^ U(a_val < 0 ? -1 : 0));
+	else
+		return uint64_t(U(a_val));
+}
+
+template<typename T>
+inline T ZigZagDecode(uint64_t a_val)
+{
+	typedef typename std::make_unsigned<T>::type U;
+
+	if (std::is_signed<T>::value)
+		return T(U(a_val >> 1) ^ U(0 - U(a_val & 1)));
+	else
+		return T(a_val);
+}
+
+template<typename T>
+size_t CalcPackedSize(const T *a_vals, size_t a_count)
+{
+	size_t l_size = a_count;
+
+	// One byte more for every 7 bits past the first 7, counted from the
+	// highest set bit so that mixed lengths don't branch
+	for (size_t i = 0; i < a_count; ++i)
+	{
+		l_size += size_t(63 - __builtin_clzll(ZigZagEncode(a_vals[i]) | 1)) / 7;
+	}
+
+	return l_size;
+}
+
+template<typename T>
+void WritePacked(char *&a_buff, const T *a_vals, size_t a_count)
+{
+	for (size_t i = 0; i < a_count; ++i)
+	{
+		EncodeSize(a_buff, size_t(ZigZagEncode(a_vals[i])));
+	}
+}
+
+template<typename T>
+inline T ReadPackedValue(const char *&a_buff, const char *a_endBuff, uint64_t a_max)
+{
+	const size_t l_val = DecodeSize(a_buff, a_endBuff);
+
+	if (l_val > a_max)
+		throw std::runtime_error("Packed integer out of range.");
+
+	return ZigZagDecode<T>(l_val);
+}
+
+#ifdef __SSE2__
+// Decodes a value of 1 to 8 bytes from a single little endian load, without
+// a branch per byte. The input must have 8 bytes left
+inline uint64_t DecodeWord(const char *a_buff, unsigned a_numBytes)
+{
+	uint64_t l_word;
+	memcpy(&l_word, a_buff, sizeof(l_word));
+
+	if (a_numBytes < 8)
+		l_word &= (uint64_t(1) << (a_numBytes * 8)) - 1;
+
+#ifdef __BMI2__
+	return _pext_u64(l_word, 0x7F7F7F7F7F7F7F7Full);
+#else
+	// Joins the 7 bit groups pairwise, into 14, 28 and then 56 bits
+	l_word &= 0x7F7F7F7F7F7F7F7Full;
+	l_word = (l_word & 0x007F007F007F007Full) | ((l_word & 0x7F007F007F007F00ull) >> 1);
+	l_word = (l_word & 0x00003FFF00003FFFull) | ((l_word & 0x3FFF00003FFF0000ull) >> 2);
+	l_word = (l_word & 0x000000000FFFFFFFull) | ((l_word & 0x0FFFFFFF00000000ull) >> 4);
+
+	return l_word;
+#endif
+}
+#endif
+
+template<typename T>
+void ReadPacked(const char *&a_buff, const char *a_endBuff, T *a_vals, size_t a_count)
+{
+	const uint64_t l_max = ZigZagEncode(std::numeric_limits<T>::max()) |
+	                       ZigZagEncode(std::numeric_limits<T>::min());
+
+	size_t i = 0;
+
+#ifdef __SSE2__
+	// Small values dominate most integer arrays, so look for blocks of 16
+	// bytes without any continuation bits. Those are 16 complete values that
+	// only need to be widened. Otherwise the bytes without a continuation bit
+	// mark where each value in the block ends, so the values are decoded
+	// from their own loads instead of one byte after another. The loads can
+	// read 8 bytes past the block
+	while (a_count - i >= 16 && size_t(a_endBuff - a_buff) >= 24)
+	{
+		const __m128i l_block = _mm_loadu_si128(reinterpret_cast<const __m128i *>(a_buff));
+
+		unsigned l_stops = ~unsigned(_mm_movemask_epi8(l_block)) & 0xFFFF;
+
+		if (l_stops == 0xFFFF)
+		{
+			for (size_t j = 0; j < 16; ++j)
+			{
+				a_vals[i + j] = ZigZagDecode<T>(uint8_t(a_buff[j]));
+			}
+
+			i += 16;
+			a_buff += 16;
+			continue;
+		}
+
+		// Values longer than 8 bytes, and blocks without the end of a value,
+		// go through the checks of the scalar decode
+		unsigned l_start = 0;
+
+		for (; l_stops; l_stops &= l_stops - 1, ++i)
+		{
+			const unsigned l_end = unsigned(__builtin_ctz(l_stops)) + 1;
+
+			uint64_t l_val;
+
+			if (l_end - l_start <= 8)
+			{
+				l_val = DecodeWord(a_buff + l_start, l_end - l_start);
+			}
+			else
+			{
+				const char *l_value = a_buff + l_start;
+				l_val = DecodeSize(l_value, a_endBuff);
+			}
+
+			if (l_val > l_max)
+				throw std::runtime_error("Packed integer out of range.");
+
+			a_vals[i] = ZigZagDecode<T>(l_val);
+
+			l_start = l_end;
+		}
+
+		if (l_start == 0)
+		{
+			a_vals[i++] = ReadPackedValue<T>(a_buff, a_endBuff, l_max);
+		}
+
+		a_buff += l_start;
+	}
+#endif
+
+	for (; i < a_count; ++i)
+	{
+		a_vals[i] = ReadPackedValue<T>(a_buff, a_endBuff, l_max);
+	}
+}
+
+// Delta coded integer arrays. Each value is stored as its difference from
+// the previous one (the first one from the value before the slice, 0 for
+// the whole array), packed as above. Slowly changing series, like counters
+// and timestamps, mostly take a single byte per value
+template<typename T>
+inline typename std::make_signed<T>::type DeltaOf(T a_val, T a_prev)
+{
+	typedef typename std::make_unsigned<T>::type U;
+
+	return typename std::make_signed<T>::type(U(U(a_val) - U(a_prev)));
+}
+
+template<typename T>
+size_t CalcDeltaSize(const T *a_vals, size_t a_count)
+{
+	size_t l_size = a_count;
+
+	for (size_t i = 0; i < a_count; ++i)
+	{
+		uint64_t l_val = ZigZagEncode(DeltaOf(a_vals[i], i ? a_vals[i - 1] : T(0))) >> 7;
+
+		for (; l_val; ++l_size, l_val >>= 7);
+	}
+
+	return l_size;
+}
+
+template<typename T>
+void WriteDelta(char *&a_buff, const T *a_vals, size_t a_count, T a_prev)
+{
+	for (size_t i = 0; i < a_count; a_prev = a_vals[i++])
+	{
+		EncodeSize(a_buff, size_t(ZigZagEncode(DeltaOf(a_vals[i], a_prev))));
+	}
+}
+
+template<typename T>
+void ReadDelta(const char *&a_buff, const char *a_endBuff, T *a_vals, size_t a_count)
+{
+	typedef typename std::make_signed<T>::type S;
+	typedef typename std::make_unsigned<T>::type U;
+
+	// The differences are decoded in place, so that they go through the
+	// block decoder above, and then summed
+	ReadPacked(a_buff, a_endBuff, reinterpret_cast<S *>(a_vals), a_count);
+
+	U l_sum = 0;
+
+	for (size_t i = 0; i < a_count; ++i)
+	{
+		l_sum += U(a_vals[i]);
+		a_vals[i] = T(l_sum);
+	}
+}
+
+} } }
+
+#endif /* VARINT_H_ */
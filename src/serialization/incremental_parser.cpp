@@ -0,0 +1,59 @@
+/*
+ * File description: incremental_parser.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include "serialization/format/incremental_parser.h"
+
+namespace axon { namespace serialization {
+
+CIncrementalParser::CIncrementalParser(ASerializer::Ptr a_serializer)
+	: m_serializer(std::move(a_serializer)), m_start(0)
+{
+	if (!m_serializer)
+		throw std::runtime_error("The serializer cannot be null.");
+
+	m_scanner = m_serializer->CreateScanner();
+}
+
+void CIncrementalParser::Feed(const char *a_buf, size_t a_size)
+{
+	// Drop the values that were already returned, once they take up
+	// most of the buffer
+	if (m_start > 0 && m_start >= Buffered())
+	{
+		m_buffer.erase(m_buffer.begin(), m_buffer.begin() + m_start);
+		m_start = 0;
+	}
+
+	m_buffer.insert(m_buffer.end(), a_buf, a_buf + a_size);
+}
+
+AData::Ptr CIncrementalParser::Next()
+{
+	if (Buffered() == 0)
+		return AData::Ptr();
+
+	const char *l_buf = m_buffer.data() + m_start;
+
+	size_t l_size = m_scanner->Scan(l_buf, m_buffer.data() + m_buffer.size());
+
+	if (l_size == 0)
+		return AData::Ptr();
+
+	AData::Ptr l_ret = m_serializer->DeserializeData(l_buf, l_buf + l_size);
+
+	m_start += l_size;
+	m_scanner->Reset();
+
+	if (m_start == m_buffer.size())
+	{
+		m_buffer.clear();
+		m_start = 0;
+	}
+
+	return l_ret;
+}
+
+} }
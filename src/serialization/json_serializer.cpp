@@ -6,139 +6,362 @@
 
 #include "serialization/format/json_serializer.h"
 
-#include "rapidjson/document.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <ostream>
+
 #include "rapidjson/prettywriter.h"
-#include "rapidjson/stringbuffer.h"
+#include "rapidjson/reader.h"
 
 namespace axon { namespace serialization {
 
-void WriteValue(rapidjson::Document &a_doc, rapidjson::Value &a_jsVal, const AData &a_data);
-AData::Ptr ReadValue(const rapidjson::Document &a_doc, const rapidjson::Value &a_jsVal, const CSerializationContext &a_context);
+// Output stream for the rapidjson writers that appends to a string
+class CJsonStringStream
+{
+public:
+	typedef char Ch;
 
+	CJsonStringStream(std::string &a_str)
+		: m_str(a_str) { }
 
-std::string CJsonSerializer::SerializeData(
-		const AData& a_data) const
+	void Put(char a_c) { m_str.push_back(a_c); }
+
+private:
+	std::string &m_str;
+};
+
+// Output stream for the rapidjson writers that collects the output in a
+// fixed size buffer, and writes it to the std::ostream whenever it fills up
+class CJsonOStream
 {
-	rapidjson::Document l_doc;
-	WriteValue(l_doc, l_doc, a_data);
+public:
+	typedef char Ch;
 
-	rapidjson::StringBuffer l_buff;
-	rapidjson::PrettyWriter<decltype(l_buff)> l_writer(l_buff);
+	static const size_t BUFFER_SIZE = 64 * 1024;
 
-	l_doc.Accept(l_writer);
+	CJsonOStream(std::ostream &a_stream)
+		: m_stream(a_stream), m_buff(new char[BUFFER_SIZE]), m_curr(m_buff.get()),
+		  m_end(m_buff.get() + BUFFER_SIZE) { }
 
-	return std::string(l_buff.GetString(), l_buff.Size());
-}
+	void Put(char a_c)
+	{
+		if (m_curr == m_end)
+			Flush();
 
-AData::Ptr CJsonSerializer::DeserializeData(
-		const char* a_buf, const char* a_endBuf) const
+		*m_curr++ = a_c;
+	}
+
+	void Flush()
+	{
+		m_stream.write(m_buff.get(), m_curr - m_buff.get());
+		m_curr = m_buff.get();
+
+		if (!m_stream)
+			throw std::runtime_error("Failed to write the JSON document to the stream.");
+	}
+
+private:
+	std::ostream &m_stream;
+	std::unique_ptr<char[]> m_buff;
+	char *m_curr;
+	char *m_end;
+};
+
+// Enough for any double that FormatDouble prints
+const size_t DOUBLE_BUFFER_SIZE = 64;
+
+// Prints the fewest digits that read back as the same double. The rapidjson
+// writers print 6. Integral values keep a fraction, so that they are read
+// back as doubles, and denormals are shifted to an exponent of -308, which
+// is the smallest one the rapidjson reader accepts
+inline size_t FormatDouble(char *a_buff, double a_val)
 {
-	if (!a_buf || a_endBuf <= a_buf)
-		throw std::runtime_error("Invalid JSON document.");
+	int l_len = snprintf(a_buff, DOUBLE_BUFFER_SIZE, "%.15g", a_val);
 
-	rapidjson::Document l_doc;
+	if (strtod(a_buff, nullptr) != a_val)
+		l_len = snprintf(a_buff, DOUBLE_BUFFER_SIZE, "%.17g", a_val);
 
-	std::string l_buffStr;
+	const char *l_exp = strchr(a_buff, 'e');
 
-	if (*(a_endBuf -1) == '\0')
+	if (!l_exp)
 	{
-		l_doc.Parse<0>(a_buf);
+		// Leaves nan and inf alone
+		if (!strpbrk(a_buff, ".ni"))
+		{
+			strcpy(a_buff + l_len, ".0");
+			l_len += 2;
+		}
+
+		return l_len;
 	}
-	else
+
+	const int l_exp10 = atoi(l_exp + 1);
+
+	if (l_exp10 >= -308)
+		return l_len;
+
+	const bool l_negative = a_buff[0] == '-';
+
+	char l_digits[DOUBLE_BUFFER_SIZE];
+	size_t l_numDigits = 0;
+
+	for (const char *l_curr = a_buff + l_negative; l_curr != l_exp; ++l_curr)
 	{
-		l_buffStr = std::string(a_buf, a_endBuf);
-		l_doc.ParseInsitu<0>(const_cast<char*>(l_buffStr.c_str()));
+		if (*l_curr != '.')
+			l_digits[l_numDigits++] = *l_curr;
 	}
 
-	return ReadValue(l_doc, l_doc, CSerializationContext());
+	char *l_write = a_buff;
+
+	if (l_negative)
+		*l_write++ = '-';
+
+	*l_write++ = '0';
+	*l_write++ = '.';
+
+	for (int i = l_exp10 + 1; i < -308; ++i)
+		*l_write++ = '0';
+
+	memcpy(l_write, l_digits, l_numDigits);
+	l_write += l_numDigits;
+
+	strcpy(l_write, "e-308");
+
+	return l_write - a_buff + 5;
 }
 
-void WriteString(rapidjson::Document &a_doc, rapidjson::Value &a_jsVal, const CPrimData<std::string> &a_data)
+template<typename Stream>
+void PutInt64(Stream &a_stream, int64_t a_val)
 {
-	a_jsVal.SetString(a_data.GetValue().data(), a_data.GetValue().size());
+	uint64_t l_val = a_val;
+
+	if (a_val < 0)
+	{
+		a_stream.Put('-');
+		l_val = 0 - l_val;
+	}
+
+	char l_buff[20];
+	char *l_curr = l_buff;
+
+	do
+	{
+		*l_curr++ = char('0' + l_val % 10);
+		l_val /= 10;
+	} while (l_val > 0);
+
+	while (l_curr != l_buff)
+		a_stream.Put(*--l_curr);
 }
 
-void WriteStruct(rapidjson::Document &a_doc, rapidjson::Value &a_jsVal, const CStructData &a_data)
+template<typename Stream>
+void PutDouble(Stream &a_stream, double a_val)
 {
-	a_jsVal.SetObject();
+	char l_buff[DOUBLE_BUFFER_SIZE];
 
-	for (const auto &prop : a_data)
+	const size_t l_len = FormatDouble(l_buff, a_val);
+
+	for (size_t i = 0; i < l_len; ++i)
+		a_stream.Put(l_buff[i]);
+}
+
+// The rapidjson writers, but with doubles that keep all of their digits,
+// and negative integers that are written without negating them, which
+// overflows for the minimum value
+template<typename Stream>
+class CJsonWriter
+	: public rapidjson::Writer<Stream>
+{
+private:
+	typedef rapidjson::Writer<Stream> Base;
+
+public:
+	CJsonWriter(Stream &a_stream)
+		: Base(a_stream) { }
+
+	CJsonWriter &Int(int a_val) { return Int64(a_val); }
+	CJsonWriter &Int64(int64_t a_val)
+	{
+		Base::Prefix(rapidjson::kNumberType);
+		PutInt64(Base::stream_, a_val);
+		return *this;
+	}
+	CJsonWriter &Double(double a_val)
+	{
+		Base::Prefix(rapidjson::kNumberType);
+		PutDouble(Base::stream_, a_val);
+		return *this;
+	}
+};
+
+template<typename Stream>
+class CJsonPrettyWriter
+	: public rapidjson::PrettyWriter<Stream>
+{
+private:
+	typedef rapidjson::PrettyWriter<Stream> Base;
+
+public:
+	CJsonPrettyWriter(Stream &a_stream)
+		: Base(a_stream) { }
+
+	CJsonPrettyWriter &Int(int a_val) { return Int64(a_val); }
+	CJsonPrettyWriter &Int64(int64_t a_val)
 	{
-		rapidjson::Value l_val;
-		WriteValue(a_doc, l_val, *prop.second);
+		Base::PrettyPrefix(rapidjson::kNumberType);
+		PutInt64(Base::stream_, a_val);
+		return *this;
+	}
+	CJsonPrettyWriter &Double(double a_val)
+	{
+		Base::PrettyPrefix(rapidjson::kNumberType);
+		PutDouble(Base::stream_, a_val);
+		return *this;
+	}
+};
+
+template<typename Writer>
+void WriteValue(Writer &a_writer, const AData &a_data);
 
-		a_jsVal.AddMember(prop.first.c_str(), l_val, a_doc.GetAllocator());
+template<typename Writer>
+void WriteString(Writer &a_writer, const std::string &a_val)
+{
+	a_writer.String(a_val.data(), a_val.size());
+}
+
+template<typename Writer>
+void WritePrim(Writer &a_writer, int a_val) { a_writer.Int(a_val); }
+template<typename Writer>
+void WritePrim(Writer &a_writer, unsigned int a_val) { a_writer.Uint(a_val); }
+template<typename Writer>
+void WritePrim(Writer &a_writer, int64_t a_val) { a_writer.Int64(a_val); }
+template<typename Writer>
+void WritePrim(Writer &a_writer, uint64_t a_val) { a_writer.Uint64(a_val); }
+template<typename Writer>
+void WritePrim(Writer &a_writer, double a_val) { a_writer.Double(a_val); }
+template<typename Writer>
+void WritePrim(Writer &a_writer, bool a_val) { a_writer.Bool(a_val); }
+template<typename Writer>
+void WritePrim(Writer &a_writer, const std::string &a_val) { WriteString(a_writer, a_val); }
+
+template<typename Writer>
+void WriteStruct(Writer &a_writer, const CStructData &a_data)
+{
+	a_writer.StartObject();
+
+	for (const auto &prop : a_data)
+	{
+		WriteString(a_writer, prop.first);
+		WriteValue(a_writer, *prop.second);
 	}
+
+	a_writer.EndObject();
 }
 
-void WriteArray(rapidjson::Document &a_doc, rapidjson::Value &a_jsVal, const CArrayData &a_data)
+template<typename Writer>
+void WriteArray(Writer &a_writer, const CArrayData &a_data)
 {
-	a_jsVal.SetArray();
+	a_writer.StartArray();
 
 	for (const auto &val : a_data)
 	{
-		rapidjson::Value l_val;
-		WriteValue(a_doc, l_val, *val);
+		WriteValue(a_writer, *val);
+	}
+
+	a_writer.EndArray();
+}
 
-		a_jsVal.PushBack(l_val, a_doc.GetAllocator());
+template<typename Writer, typename T, typename WriteType>
+void WritePrimArrayImpl(Writer &a_writer, const CPrimArrayData<T> &a_data)
+{
+	for (const T &val : a_data)
+	{
+		WritePrim(a_writer, WriteType(val));
 	}
 }
 
-void WritePrimArray(rapidjson::Document &a_doc, rapidjson::Value &a_jsVal, const APrimArrayDataBase &a_data)
+template<typename Writer>
+void WritePrimArray(Writer &a_writer, const APrimArrayDataBase &a_data)
 {
-	a_jsVal.SetObject();
-	a_jsVal.AddMember("_t", "_prim", a_doc.GetAllocator());
-	a_jsVal.AddMember("_it", (int)a_data.InnerType(), a_doc.GetAllocator());
+#define WRITE_PRIM(name, type, writeType) \
+	case DataType::name: \
+		WritePrimArrayImpl<Writer, type, writeType>(a_writer, static_cast<const CPrimArrayData<type> &>(a_data)); \
+		break
 
-	auto l_reg = a_data.ToRegArray();
+	a_writer.StartObject();
+	a_writer.String("_t");
+	a_writer.String("_prim");
+	a_writer.String("_it");
+	a_writer.Int((int)a_data.InnerType());
+	a_writer.String("_v");
 
-	rapidjson::Value l_arr(rapidjson::kArrayType);
+	a_writer.StartArray();
 
-	for (const auto &val : *l_reg)
+	switch (a_data.InnerType())
 	{
-		rapidjson::Value l_val;
-		WriteValue(a_doc, l_val, *val);
+	WRITE_PRIM(SByte, signed char, int);
+	WRITE_PRIM(UByte, unsigned char, int);
+	WRITE_PRIM(Short, short, int);
+	WRITE_PRIM(UShort, unsigned short, int);
+	WRITE_PRIM(Int, int, int);
+	WRITE_PRIM(UInt, unsigned int, unsigned int);
+	WRITE_PRIM(Long, int64_t, int64_t);
+	WRITE_PRIM(ULong, uint64_t, uint64_t);
+	WRITE_PRIM(Float, float, double);
+	WRITE_PRIM(Double, double, double);
+	WRITE_PRIM(Bool, bool, bool);
+	WRITE_PRIM(String, std::string, const std::string &);
 
-		l_arr.PushBack(l_val, a_doc.GetAllocator());
+	default:
+		throw std::runtime_error("Unsupported primitive type.");
 	}
 
-	a_jsVal.AddMember("_v", l_arr, a_doc.GetAllocator());
-}
+	a_writer.EndArray();
 
-void WriteBuffer(rapidjson::Document &a_doc, rapidjson::Value &a_jsVal, const CBufferData &a_data)
-{
-	a_jsVal.SetObject();
+	a_writer.EndObject();
 
-	a_jsVal.AddMember("_t", "_buffer", a_doc.GetAllocator());
+#undef WRITE_PRIM
+}
 
+template<typename Writer>
+void WriteBuffer(Writer &a_writer, const CBufferData &a_data)
+{
 	std::string l_encoded = util::CBase64::Encode(a_data.GetBuffer().Data(), a_data.GetBuffer().Size());
 
-	a_jsVal.AddMember("_enclen", l_encoded.size(), a_doc.GetAllocator());
-	a_jsVal.AddMember("_rawlen", a_data.GetBuffer().Size(), a_doc.GetAllocator());
-	a_jsVal.AddMember("_compressed", false, a_doc.GetAllocator()); // TODO: Support compression
+	a_writer.StartObject();
+
+	a_writer.String("_t");
+	a_writer.String("_buffer");
+	a_writer.String("_enclen");
+	a_writer.Uint64(l_encoded.size());
+	a_writer.String("_rawlen");
+	a_writer.Uint64(a_data.GetBuffer().Size());
+	a_writer.String("_compressed");
+	a_writer.Bool(false); // TODO: Support compression
 
-	rapidjson::Value l_arr(rapidjson::kArrayType);
+	a_writer.String("_data");
+	a_writer.StartArray();
 
 	for (size_t i = 0; i < l_encoded.size(); i += 80)
 	{
 		size_t l_end = std::min(i + 80, l_encoded.size());
 
-		std::string l_subVal(l_encoded.substr(i, l_end - i));
-
-		rapidjson::Value l_val(rapidjson::kStringType);
-		l_val.SetString(l_subVal.c_str(), l_subVal.size());
-
-		l_arr.PushBack(l_val, a_doc.GetAllocator());
+		a_writer.String(l_encoded.data() + i, l_end - i);
 	}
 
-	a_jsVal.AddMember("_data", l_arr, a_doc.GetAllocator());
+	a_writer.EndArray();
+
+	a_writer.EndObject();
 }
 
-void WriteValue(rapidjson::Document &a_doc, rapidjson::Value &a_jsVal, const AData &a_data)
+template<typename Writer>
+void WriteValue(Writer &a_writer, const AData &a_data)
 {
 #define VALSET(datatype, jsname, type) \
 	case DataType::datatype: \
-		a_jsVal.Set ## jsname(static_cast<const CPrimData<type> &>(a_data).GetValue()); \
+		a_writer.jsname(static_cast<const CPrimData<type> &>(a_data).GetValue()); \
 		break
 
 	switch (a_data.Type())
@@ -149,81 +372,264 @@ void WriteValue(rapidjson::Document &a_doc, rapidjson::Value &a_jsVal, const ADa
 	VALSET(UShort, Int, unsigned short);
 	VALSET(Int, Int, int);
 	VALSET(UInt, Uint, unsigned int);
-	VALSET(Long, Int64, long long);
-	VALSET(ULong, Uint64, unsigned long long);
+	VALSET(Long, Int64, int64_t);
+	VALSET(ULong, Uint64, uint64_t);
 	VALSET(Float, Double, float);
 	VALSET(Double, Double, double);
 	VALSET(Bool, Bool, bool);
 
 	case DataType::String:
-		WriteString(a_doc, a_jsVal, static_cast<const CPrimData<std::string> &>(a_data));
+		WriteString(a_writer, static_cast<const CPrimData<std::string> &>(a_data).GetValue());
 		break;
 	case DataType::Struct:
-		WriteStruct(a_doc, a_jsVal, static_cast<const CStructData &>(a_data));
+		WriteStruct(a_writer, static_cast<const CStructData &>(a_data));
 		break;
 	case DataType::Array:
-		WriteArray(a_doc, a_jsVal, static_cast<const CArrayData &>(a_data));
+		WriteArray(a_writer, static_cast<const CArrayData &>(a_data));
 		break;
 	case DataType::Buffer:
-		WriteBuffer(a_doc, a_jsVal, static_cast<const CBufferData &>(a_data));
+		WriteBuffer(a_writer, static_cast<const CBufferData &>(a_data));
 		break;
 	case DataType::Null:
-		a_jsVal.SetNull();
+		a_writer.Null();
 		break;
 	case DataType::PrimArray:
-		WritePrimArray(a_doc, a_jsVal, static_cast<const APrimArrayDataBase &>(a_data));
+		WritePrimArray(a_writer, static_cast<const APrimArrayDataBase &>(a_data));
 		break;
 
 	default:
 		throw std::runtime_error("Unsupported data type.");
 	}
 
+#undef VALSET
+}
 
+template<typename Stream>
+void WriteDocument(Stream &a_stream, const AData &a_data, bool a_pretty)
+{
+	if (a_pretty)
+	{
+		CJsonPrettyWriter<Stream> l_writer(a_stream);
+		WriteValue(l_writer, a_data);
+	}
+	else
+	{
+		CJsonWriter<Stream> l_writer(a_stream);
+		WriteValue(l_writer, a_data);
+	}
+}
 
-#undef VALSET
+CJsonSerializer::CJsonSerializer()
+	: m_pretty(true)
+{
+}
+
+std::string CJsonSerializer::SerializeData(
+		const AData& a_data) const
+{
+	std::string l_ret;
+
+	CJsonStringStream l_stream(l_ret);
+
+	WriteDocument(l_stream, a_data, m_pretty);
+
+	return l_ret;
+}
+
+void CJsonSerializer::SerializeDataToStream(
+		std::ostream &a_stream, const AData &a_data) const
+{
+	CJsonOStream l_stream(a_stream);
+
+	WriteDocument(l_stream, a_data, m_pretty);
+
+	l_stream.Flush();
+}
+
+// Input stream for the rapidjson reader over a buffer that doesn't have
+// to be null terminated. The end of the buffer reads as '\0', which is
+// how the reader detects the end of the input
+class CJsonInputStream
+{
+public:
+	typedef char Ch;
+
+	CJsonInputStream(const char *a_buf, const char *a_endBuf)
+		: m_head(a_buf), m_curr(a_buf), m_end(a_endBuf) { }
+
+	char Peek() const { return m_curr == m_end ? '\0' : *m_curr; }
+	char Take() { return m_curr == m_end ? '\0' : *m_curr++; }
+	size_t Tell() const { return m_curr - m_head; }
+
+	// Parses the number that starts at the current position with strtod,
+	// or returns a_default if there isn't one
+	double ParseDouble(double a_default) const
+	{
+		const char *l_end = m_curr;
+
+		while (l_end != m_end && ((*l_end >= '0' && *l_end <= '9') || *l_end == '-' || *l_end == '+' ||
+								  *l_end == '.' || *l_end == 'e' || *l_end == 'E'))
+		{
+			++l_end;
+		}
+
+		if (l_end == m_curr)
+			return a_default;
+
+		// The buffer isn't null terminated
+		const std::string l_text(m_curr, l_end);
+
+		char *l_parsed;
+		const double l_ret = strtod(l_text.c_str(), &l_parsed);
+
+		return l_parsed == l_text.c_str() + l_text.size() ? l_ret : a_default;
+	}
+
+	char *PutBegin() { RAPIDJSON_ASSERT(false); return 0; }
+	void Put(char) { RAPIDJSON_ASSERT(false); }
+	size_t PutEnd(char *) { RAPIDJSON_ASSERT(false); return 0; }
+
+private:
+	const char *m_head;
+	const char *m_curr;
+	const char *m_end;
+};
+
+APrimArrayDataBase::Ptr CreatePrimArray(DataType a_innerType, const CSerializationContext &a_context)
+{
+#define CREATE_PRIM(name, type) \
+	case DataType::name: \
+		return APrimArrayDataBase::Ptr(new CPrimArrayData<type>(a_context))
+
+	switch (a_innerType)
+	{
+	CREATE_PRIM(SByte, signed char);
+	CREATE_PRIM(UByte, unsigned char);
+	CREATE_PRIM(Short, short);
+	CREATE_PRIM(UShort, unsigned short);
+	CREATE_PRIM(Int, int);
+	CREATE_PRIM(UInt, unsigned int);
+	CREATE_PRIM(Long, int64_t);
+	CREATE_PRIM(ULong, uint64_t);
+	CREATE_PRIM(Float, float);
+	CREATE_PRIM(Double, double);
+	CREATE_PRIM(Bool, bool);
+	CREATE_PRIM(String, std::string);
+
+	default:
+		throw std::runtime_error("Invalid primitive array type.");
+	}
+
+#undef CREATE_PRIM
 }
 
-const rapidjson::Value *GetMemVal(const rapidjson::Value &a_jsVal, const char *a_name, bool a_force = true)
+template<typename V>
+void AddPrimValue(APrimArrayDataBase &a_arr, const V &a_val)
 {
-	for (auto iter = a_jsVal.MemberBegin(), end = a_jsVal.MemberEnd(); iter != end; ++iter)
+#define ADD_PRIM(name, type) \
+	case DataType::name: \
+		static_cast<CPrimArrayData<type> &>(a_arr).Add(cast_to<type>(a_val)); \
+		break
+
+	switch (a_arr.InnerType())
 	{
-		if (0 == strcmp(iter->name.GetString(), a_name))
-			return &iter->value;
+	ADD_PRIM(SByte, signed char);
+	ADD_PRIM(UByte, unsigned char);
+	ADD_PRIM(Short, short);
+	ADD_PRIM(UShort, unsigned short);
+	ADD_PRIM(Int, int);
+	ADD_PRIM(UInt, unsigned int);
+	ADD_PRIM(Long, int64_t);
+	ADD_PRIM(ULong, uint64_t);
+	ADD_PRIM(Float, float);
+	ADD_PRIM(Double, double);
+	ADD_PRIM(Bool, bool);
+	ADD_PRIM(String, std::string);
+
+	default:
+		throw std::runtime_error("Invalid primitive array type.");
 	}
 
-	if (a_force)
-		throw std::runtime_error("The specified member does not exist.");
+#undef ADD_PRIM
+}
+
+void AddPrimData(APrimArrayDataBase &a_arr, const AData &a_val)
+{
+#define ADD_PRIM(name, type) \
+	case DataType::name: \
+		static_cast<CPrimArrayData<type> &>(a_arr).Add(Deserialize<type>(a_val)); \
+		break
+
+	switch (a_arr.InnerType())
+	{
+	ADD_PRIM(SByte, signed char);
+	ADD_PRIM(UByte, unsigned char);
+	ADD_PRIM(Short, short);
+	ADD_PRIM(UShort, unsigned short);
+	ADD_PRIM(Int, int);
+	ADD_PRIM(UInt, unsigned int);
+	ADD_PRIM(Long, int64_t);
+	ADD_PRIM(ULong, uint64_t);
+	ADD_PRIM(Float, float);
+	ADD_PRIM(Double, double);
+	ADD_PRIM(Bool, bool);
+	ADD_PRIM(String, std::string);
+
+	default:
+		throw std::runtime_error("Invalid primitive array type.");
+	}
 
-	return nullptr;
+#undef ADD_PRIM
 }
 
-AData::Ptr ReadBuffer(const rapidjson::Document& a_doc, const rapidjson::Value& a_jsVal, const CSerializationContext &a_context)
+AData::Ptr &GetMember(CStructData &a_data, const char *a_name)
 {
-	auto l_encLen = GetMemVal(a_jsVal, "_enclen")->GetUint64();
-	auto l_rawLen = GetMemVal(a_jsVal, "_rawlen")->GetUint64();
-	auto l_compressed = GetMemVal(a_jsVal, "_compressed")->GetBool();
+	for (auto &prop : a_data)
+	{
+		if (prop.first == a_name)
+			return prop.second;
+	}
+
+	throw std::runtime_error("The specified member does not exist.");
+}
+
+bool IsTypeTag(const CStructData &a_data, const char *a_tag)
+{
+	const AData *l_type = a_data.Find("_t");
+
+	return l_type && l_type->Type() == DataType::String &&
+		   static_cast<const CPrimData<std::string> *>(l_type)->GetValue() == a_tag;
+}
+
+AData::Ptr ReadBuffer(CStructData &a_data, const CSerializationContext &a_context)
+{
+	auto l_rawLen = Deserialize<uint64_t>(*GetMember(a_data, "_rawlen"));
+	auto l_compressed = Deserialize<bool>(*GetMember(a_data, "_compressed"));
 
 	if (l_compressed)
 		throw std::runtime_error("Compressed buffers not currently supported.");
 
-	const rapidjson::Value &l_data = *GetMemVal(a_jsVal, "_data");
+	const AData &l_data = *GetMember(a_data, "_data");
 
-	std::unique_ptr<char[]> l_encBuff(new char[l_encLen]);
+	if (l_data.Type() != DataType::Array)
+		throw std::runtime_error("The Base 64 encoded value was corrupt.");
 
-	char *l_encCurr = l_encBuff.get();
-	for (size_t i = 0, end = l_data.Size(); i < end; ++i)
+	std::string l_encoded;
+	l_encoded.reserve(Deserialize<uint64_t>(*GetMember(a_data, "_enclen")));
+
+	for (const AData::Ptr &l_part : static_cast<const CArrayData &>(l_data))
 	{
-		const rapidjson::Value &l_part = l_data[i];
+		if (l_part->Type() != DataType::String)
+			throw std::runtime_error("The Base 64 encoded value was corrupt.");
 
-		std::copy(l_part.GetString(), l_part.GetString() + l_part.GetStringLength(), l_encCurr);
-		l_encCurr += l_part.GetStringLength();
+		l_encoded += static_cast<const CPrimData<std::string> &>(*l_part).GetValue();
 	}
 
 	util::CBuffer l_buff(l_rawLen);
 
 	if (l_rawLen)
 	{
-		size_t l_decLen = util::CBase64::Decode(l_encBuff.get(), l_encLen, (unsigned char*)l_buff.Data(), l_buff.Size());
+		size_t l_decLen = util::CBase64::Decode(l_encoded, (unsigned char*)l_buff.Data(), l_buff.Size());
 
 		if (l_decLen != l_rawLen)
 			throw std::runtime_error("The Base 64 encoded value was corrupt.");
@@ -232,146 +638,308 @@ AData::Ptr ReadBuffer(const rapidjson::Document& a_doc, const rapidjson::Value&
 	return AData::Ptr(new CBufferData(std::move(l_buff), l_compressed, a_context));
 }
 
-AData::Ptr ReadArray(const rapidjson::Document& a_doc, const rapidjson::Value& a_jsVal, const CSerializationContext &a_context)
+AData::Ptr ReadPrimArray(CStructData &a_data, const CSerializationContext &a_context)
 {
-	CArrayData::Ptr l_ret(new CArrayData(a_context));
+	AData::Ptr &l_vals = GetMember(a_data, "_v");
+
+	// The values were read straight into a primitive array
+	if (l_vals->Type() == DataType::PrimArray)
+		return std::move(l_vals);
+
+	if (l_vals->Type() != DataType::Array)
+		throw std::runtime_error("Unsupported primitive type.");
+
+	// The values came before the inner type, so they have to be converted
+	DataType l_innerType = (DataType)Deserialize<int>(*GetMember(a_data, "_it"));
 
-	for (auto iter = a_jsVal.Begin(), end = a_jsVal.End(); iter != end; ++iter)
+	APrimArrayDataBase::Ptr l_ret = CreatePrimArray(l_innerType, a_context);
+
+	for (const AData::Ptr &l_val : static_cast<const CArrayData &>(*l_vals))
 	{
-		l_ret->Add(ReadValue(a_doc, *iter, a_context));
+		AddPrimData(*l_ret, *l_val);
 	}
 
 	return std::move(l_ret);
 }
 
-template<typename T>
-APrimArrayDataBase::Ptr ReadPrimArrayImpl(const rapidjson::Document &a_doc, const rapidjson::Value &a_jsVal, const CSerializationContext &a_context)
+// Builds the data directly from the events of the rapidjson reader, so the
+// document is never parsed into a DOM first
+class CJsonDataBuilder
 {
-	typename CPrimArrayData<T>::Ptr l_ret(new CPrimArrayData<T>(a_context));
+public:
+	CJsonDataBuilder(const CJsonInputStream &a_stream, CSerializationContext a_context)
+		: m_stream(a_stream), m_context(std::move(a_context)) { }
+
+	AData::Ptr Result() { return std::move(m_result); }
 
-	auto l_arr = GetMemVal(a_jsVal, "_v");
+	void Null() { Add(CNullData::Create(m_context)); }
+	void Bool(bool a_val) { AddValue(a_val); }
+
+	// Integers use the smallest of int, unsigned int, int64 and uint64
+	// that holds the value
+	void Int(int a_val) { AddValue(a_val); }
+	void Uint(unsigned a_val)
+	{
+		if (a_val <= unsigned(std::numeric_limits<int>::max()))
+			AddValue(int(a_val));
+		else
+			AddValue(a_val);
+	}
+	void Int64(int64_t a_val)
+	{
+		if (a_val >= std::numeric_limits<int>::min() && a_val <= std::numeric_limits<int>::max())
+			AddValue(int(a_val));
+		else
+			AddValue(a_val);
+	}
+	void Uint64(uint64_t a_val)
+	{
+		if (a_val <= std::numeric_limits<unsigned>::max())
+			Uint(unsigned(a_val));
+		else if (a_val <= uint64_t(std::numeric_limits<int64_t>::max()))
+			AddValue(int64_t(a_val));
+		else
+			AddValue(a_val);
+	}
+	// The reader keeps 16 digits, and scales them by a power of 10, which
+	// isn't exact. It reads a number from a copy of the stream, and only
+	// moves the stream past the number after this, so it still points to
+	// the text of the number, which is parsed again
+	void Double(double a_val) { AddValue(m_stream.ParseDouble(a_val)); }
 
-	for (auto iter = l_arr->Begin(), end = l_arr->End(); iter != end; ++iter)
+	void String(const char *a_str, rapidjson::SizeType a_length, bool)
 	{
-		switch (iter->GetType())
+		if (!m_frames.empty())
 		{
-		case rapidjson::kFalseType:
-			l_ret->Add(cast_to<T>(false));
-			break;
-		case rapidjson::kTrueType:
-			l_ret->Add(cast_to<T>(true));
-			break;
-		case rapidjson::kNumberType:
-			l_ret->Add(cast_to<T>(iter->GetDouble()));
-			break;
-		case rapidjson::kStringType:
-			l_ret->Add(cast_to<T>(iter->GetString()));
-			break;
-		default:
-			throw std::runtime_error("Unsupported primitive type.");
+			CFrame &l_top = m_frames.back();
+
+			if (l_top.Type == DataType::Struct && !l_top.HasKey)
+			{
+				l_top.Key.assign(a_str, a_length);
+				l_top.HasKey = true;
+				return;
+			}
 		}
+
+		AddValue(std::string(a_str, a_length));
 	}
 
-	return std::move(l_ret);
-}
+	void StartObject()
+	{
+		CheckNotPrim();
 
-AData::Ptr ReadPrimArray(const rapidjson::Document &a_doc, const rapidjson::Value &a_jsVal, const CSerializationContext &a_context)
-{
-#define READ_PRIM(name, type) \
-	case DataType::name: \
-		return ReadPrimArrayImpl<type>(a_doc, a_jsVal, a_context)
+		m_frames.emplace_back(DataType::Struct, AData::Ptr(new CStructData(m_context)));
+	}
+
+	void EndObject(rapidjson::SizeType)
+	{
+		AData::Ptr l_data = std::move(m_frames.back().Data);
+		m_frames.pop_back();
+
+		CStructData &l_struct = static_cast<CStructData &>(*l_data);
+
+		if (IsTypeTag(l_struct, "_buffer"))
+			l_data = ReadBuffer(l_struct, m_context);
+		else if (IsTypeTag(l_struct, "_prim"))
+			l_data = ReadPrimArray(l_struct, m_context);
+
+		Add(std::move(l_data));
+	}
+
+	void StartArray()
+	{
+		CheckNotPrim();
+
+		// Primitive arrays are written as {"_t":"_prim", "_it":<type>, "_v":[...]},
+		// so when the type is already known, the values can be read
+		// straight into the primitive array
+		if (!m_frames.empty())
+		{
+			CFrame &l_top = m_frames.back();
+
+			if (l_top.Type == DataType::Struct && l_top.Key == "_v" &&
+				IsTypeTag(static_cast<const CStructData &>(*l_top.Data), "_prim"))
+			{
+				const AData *l_innerType = static_cast<const CStructData &>(*l_top.Data).Find("_it");
+
+				if (l_innerType)
+				{
+					m_frames.emplace_back(DataType::PrimArray,
+						CreatePrimArray((DataType)Deserialize<int>(*l_innerType), m_context));
+					return;
+				}
+			}
+		}
 
-	DataType l_innerType = (DataType)GetMemVal(a_jsVal, "_it")->GetInt();
+		m_frames.emplace_back(DataType::Array, AData::Ptr(new CArrayData(m_context)));
+	}
 
-	switch (l_innerType)
+	void EndArray(rapidjson::SizeType)
 	{
-	READ_PRIM(SByte, signed char);
-	READ_PRIM(UByte, unsigned char);
-	READ_PRIM(Short, short);
-	READ_PRIM(UShort, unsigned short);
-	READ_PRIM(Int, int);
-	READ_PRIM(UInt, unsigned int);
-	READ_PRIM(Long, long long);
-	READ_PRIM(ULong, unsigned long);
-	READ_PRIM(Float, float);
-	READ_PRIM(Double, double);
-	READ_PRIM(Bool, bool);
-	READ_PRIM(String, std::string);
+		AData::Ptr l_data = std::move(m_frames.back().Data);
+		m_frames.pop_back();
+
+		Add(std::move(l_data));
 	}
 
-	throw std::runtime_error("Invalid primitive array type.");
+private:
+	struct CFrame
+	{
+		CFrame(DataType a_type, AData::Ptr a_data)
+			: Type(a_type), Data(std::move(a_data)) { }
 
-#undef READ_PRIM
-}
+		DataType Type;
+		AData::Ptr Data;
 
-AData::Ptr ReadObject(const rapidjson::Document& a_doc, const rapidjson::Value& a_jsVal, const CSerializationContext &a_context)
-{
-	const rapidjson::Value *l_typeVal = GetMemVal(a_jsVal, "_t", false);
+		// The name of the next struct member
+		std::string Key;
+		bool HasKey = false;
+	};
 
-	if (l_typeVal)
+	void CheckNotPrim() const
 	{
-		if (0 == strcmp(l_typeVal->GetString(), "_buffer"))
+		if (!m_frames.empty() && m_frames.back().Type == DataType::PrimArray)
+			throw std::runtime_error("Unsupported primitive type.");
+	}
+
+	template<typename T>
+	void AddValue(T a_val)
+	{
+		if (!m_frames.empty() && m_frames.back().Type == DataType::PrimArray)
+			AddPrimValue(static_cast<APrimArrayDataBase &>(*m_frames.back().Data), a_val);
+		else
+			Add(MakePrim(std::move(a_val), m_context));
+	}
+
+	void Add(AData::Ptr a_data)
+	{
+		if (m_frames.empty())
 		{
-			return ReadBuffer(a_doc, a_jsVal, a_context);
+			m_result = std::move(a_data);
+			return;
 		}
-		else if (0 == strcmp(l_typeVal->GetString(), "_prim"))
+
+		CFrame &l_top = m_frames.back();
+
+		switch (l_top.Type)
 		{
-			return ReadPrimArray(a_doc, a_jsVal, a_context);
+		case DataType::Struct:
+			static_cast<CStructData &>(*l_top.Data).Add(std::move(l_top.Key), std::move(a_data));
+			l_top.Key.clear();
+			l_top.HasKey = false;
+			break;
+		case DataType::Array:
+			static_cast<CArrayData &>(*l_top.Data).Add(std::move(a_data));
+			break;
+		default:
+			throw std::runtime_error("Unsupported primitive type.");
 		}
 	}
 
-	CStructData::Ptr l_ret(new CStructData(a_context));
+	const CJsonInputStream &m_stream;
+	CSerializationContext m_context;
+	std::vector<CFrame> m_frames;
+	AData::Ptr m_result;
+};
+
+// Finds where a document ends by following the brackets and strings.
+// The scan picks up where the previous call stopped, so the input is only
+// looked at once
+class CJsonScanner
+	: public IValueScanner
+{
+public:
+	CJsonScanner()
+	{
+		Reset();
+	}
 
-	for (auto iter = a_jsVal.MemberBegin(), end = a_jsVal.MemberEnd(); iter != end; ++iter)
+	virtual size_t Scan(const char *a_buf, const char *a_endBuf) override
 	{
-		AData::Ptr l_val = ReadValue(a_doc, iter->value, a_context);
+		const size_t l_size = a_endBuf - a_buf;
 
-		l_ret->Add(std::string(iter->name.GetString(), iter->name.GetStringLength()), std::move(l_val));
+		for (; m_pos < l_size; ++m_pos)
+		{
+			const char c = a_buf[m_pos];
+
+			if (m_inString)
+			{
+				if (m_escape)
+					m_escape = false;
+				else if (c == '\\')
+					m_escape = true;
+				else if (c == '"')
+					m_inString = false;
+				continue;
+			}
+
+			if (!m_started)
+			{
+				if (c == ' ' || c == '\t' || c == '\r' || c == '\n')
+					continue;
+				if (c != '{' && c != '[')
+					throw std::runtime_error("Invalid JSON document.");
+				m_started = true;
+			}
+
+			switch (c)
+			{
+			case '"':
+				m_inString = true;
+				break;
+			case '{':
+			case '[':
+				++m_depth;
+				break;
+			case '}':
+			case ']':
+				if (--m_depth == 0)
+					return ++m_pos;
+				break;
+			}
+		}
+
+		return 0;
 	}
 
-	return std::move(l_ret);
-}
+	virtual void Reset() override
+	{
+		m_pos = 0;
+		m_depth = 0;
+		m_started = false;
+		m_inString = false;
+		m_escape = false;
+	}
+
+private:
+	size_t m_pos;
+	size_t m_depth;
+	bool m_started;
+	bool m_inString;
+	bool m_escape;
+};
+
+AData::Ptr CJsonSerializer::DeserializeData(
+		const char* a_buf, const char* a_endBuf) const
+{
+	if (!a_buf || a_endBuf <= a_buf)
+		throw std::runtime_error("Invalid JSON document.");
 
+	CJsonInputStream l_stream(a_buf, a_endBuf);
+	CJsonDataBuilder l_builder(l_stream, CSerializationContext());
 
+	rapidjson::Reader l_reader;
 
-AData::Ptr ReadValue(const rapidjson::Document& a_doc, const rapidjson::Value& a_jsVal, const CSerializationContext &a_context)
+	if (!l_reader.Parse<rapidjson::kParseDefaultFlags>(l_stream, l_builder))
+		throw std::runtime_error(std::string("Invalid JSON document. ") + l_reader.GetParseError());
+
+	return l_builder.Result();
+}
+
+IValueScanner::Ptr CJsonSerializer::CreateScanner() const
 {
-	switch (a_jsVal.GetType())
-	{
-	case rapidjson::kNullType:
-		return CNullData::Create(a_context);
-	case rapidjson::kTrueType:
-		return MakePrim(true, a_context);
-	case rapidjson::kFalseType:
-		return MakePrim(false, a_context);
-
-	case rapidjson::kNumberType:
-		if (a_jsVal.IsInt())
-			return MakePrim(a_jsVal.GetInt(), a_context);
-		if (a_jsVal.IsUint())
-			return MakePrim(a_jsVal.GetUint(), a_context);
-		if (a_jsVal.IsInt64())
-			return MakePrim(a_jsVal.GetInt64(), a_context);
-		if (a_jsVal.IsUint64())
-			return MakePrim(a_jsVal.GetUint64(), a_context);
-		if (a_jsVal.IsDouble())
-			return MakePrim(a_jsVal.GetDouble(), a_context);
-
-		throw std::runtime_error("Unknown number type.");
-
-	case rapidjson::kStringType:
-		return MakePrim(std::string(a_jsVal.GetString(), a_jsVal.GetStringLength()), a_context);
-
-	case rapidjson::kObjectType:
-		return ReadObject(a_doc, a_jsVal, a_context);
-	case rapidjson::kArrayType:
-		return ReadArray(a_doc, a_jsVal, a_context);
-	}
-
-	throw std::runtime_error("Unknown JSON type.");
+	return IValueScanner::Ptr(new CJsonScanner());
 }
 
 }
 }
-
-
@@ -0,0 +1,54 @@
+#include "serialization/format/lz4_compressor.h"
+
+#include <lz4.h>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+using namespace std;
+
+namespace axon { namespace serialization {
+
+CLZ4Compressor::CLZ4Compressor(int a_acceleration)
+    : m_acceleration(a_acceleration)
+{
+}
+
+void CLZ4Compressor::Compress(const char *a_input, size_t a_inputSize, 
+                              unique_ptr<char[]> &a_output, size_t &a_outputSize) const 
+{
+    if (a_inputSize > size_t(LZ4_MAX_INPUT_SIZE))
+        throw runtime_error("The input is too large to be compressed with LZ4.");
+
+    const int l_bound = LZ4_compressBound(int(a_inputSize));
+
+    a_output.reset(new char[l_bound]);
+
+    const int l_size = LZ4_compress_fast(a_input, a_output.get(), int(a_inputSize),
+                                         l_bound, m_acceleration);
+
+    if (l_size <= 0 && a_inputSize > 0)
+        throw runtime_error("Failed to compress the data with LZ4.");
+
+    a_outputSize = size_t(l_size);
+}
+
+unique_ptr<char[]> CLZ4Compressor::Decompress(const char *a_compressed, size_t a_compressedSize, 
+                                              size_t a_decompressedSize) const 
+{
+    if (a_compressedSize > size_t(numeric_limits<int>::max()) ||
+        a_decompressedSize > size_t(numeric_limits<int>::max()))
+        throw runtime_error("The specified compressed data is corrupted.");
+
+    unique_ptr<char[]> l_ret(new char[a_decompressedSize]);
+
+    const int l_size = LZ4_decompress_safe(a_compressed, l_ret.get(), int(a_compressedSize),
+                                           int(a_decompressedSize));
+
+    if (l_size < 0 || size_t(l_size) != a_decompressedSize)
+        throw runtime_error("The specified compressed data is corrupted.");
+
+    return move(l_ret);
+}
+
+} }
@@ -7,6 +7,7 @@
 
 #include "serialization/format/msgpack_serializer.h"
 
+#include <limits>
 #include <unordered_map>
 #include <type_traits>
 #include <assert.h>
@@ -14,7 +15,12 @@
 
 #include "serialization/format/binary_format_common.h"
 
+#include "detail/bit_pack.h"
+#include "detail/chunked_writer.h"
+#include "detail/buffer_compression.h"
+
 using namespace std;
+using namespace axon::serialization::detail;
 
 typedef unsigned char byte;
 typedef uint16_t ushort;
@@ -36,6 +42,9 @@ const byte TRUE = 0xc3;
 const byte BIN_8 = 0xc4;
 const byte BIN_16 = 0xc5;
 const byte BIN_32 = 0xc6;
+const byte EXT_8 = 0xc7;
+const byte EXT_16 = 0xc8;
+const byte EXT_32 = 0xc9;
 const byte FLOAT_32 = 0xca;
 const byte FLOAT_64 = 0xcb;
 const byte UINT_8 = 0xcc;
@@ -46,6 +55,11 @@ const byte INT_8 = 0xd0;
 const byte INT_16 = 0xd1;
 const byte INT_32 = 0xd2;
 const byte INT_64 = 0xd3;
+const byte FIXEXT_1 = 0xd4;
+const byte FIXEXT_2 = 0xd5;
+const byte FIXEXT_4 = 0xd6;
+const byte FIXEXT_8 = 0xd7;
+const byte FIXEXT_16 = 0xd8;
 const byte STR_8 = 0xd9;
 const byte STR_16 = 0xda;
 const byte STR_32 = 0xdb;
@@ -56,6 +70,30 @@ const byte MAP_32 = 0xdf;
 const byte NEG_FIX_INT = 0xe0;
 //--------------------------------------------------
 
+//--------- Extension Types -------------------------
+// Bool array with 1 bit per value. The payload is the number of
+// values (uint32), followed by the packed bits
+const int8_t EXT_BOOL_ARRAY = 1;
+// Compressed binary data. The payload is the uncompressed size (uint64),
+// followed by the compressed bytes
+const int8_t EXT_COMPRESSED_BIN = 2;
+//--------------------------------------------------
+
+// Serializer options that apply while writing
+struct CWriteOptions
+{
+    bool PackBools;
+    const ICompressor *Compressor;
+    size_t CompressThreshold;
+};
+
+// Serializer options that apply while reading
+struct CReadOptions
+{
+    const ICompressor *Compressor;
+    size_t MaxDecompressedSize;
+};
+
 template<typename IntType, bool IsSigned>
 struct int_helper_t;
 
@@ -209,65 +247,69 @@ struct num_helper_t<NumType, false>
 template<typename IntType>
 struct int_helper_t<IntType, true>
 {
+    typedef typename make_unsigned<IntType>::type UIntType;
+
+    // Negative numbers use the smallest signed type that holds them. Their
+    // magnitude isn't taken, since that overflows for the minimum value
     static size_t CalcSize(IntType val)
     {
-        if (val < 0)
+        if (val >= 0)
         {
-            IntType v2 = -val;
+            // This number is positive, so just treat it as unsigned
+            return int_helper_t<UIntType, false>::CalcSize(UIntType(val));
+        }
+
+        const int64_t l_val = val;
 
-            if (v2 <= IntType(0x1f))
-                return sizeof(byte);
+        // negative fixint
+        if (l_val >= -32)
+            return sizeof(byte);
 
-            // Have to catch this case because the positive number
-            // case can pack more bits
-            if (v2 <= IntType(0xff))
-                return 2 * sizeof(byte);
+        if (l_val >= numeric_limits<int8_t>::min())
+            return 2 * sizeof(byte);
 
-            // Just use the same size semantics as the signed version.
-            // Must use v2 because it is positive
-            return int_helper_t<IntType, false>::CalcSize(v2);
-        }
-        else
-        {
-            // This number is positive, so just treat it as unsigned
-            return int_helper_t<IntType, false>::CalcSize(val);
-        }
+        if (l_val >= numeric_limits<int16_t>::min())
+            return 3 * sizeof(byte);
+
+        if (l_val >= numeric_limits<int32_t>::min())
+            return 5 * sizeof(byte);
+
+        return 9 * sizeof(byte);
     }
 
     static void Encode(char *&a_buff, IntType val, const char *a_endBuff)
     {
-        if (val < 0)
+        if (val >= 0)
         {
-            IntType v2 = -val;
+            int_helper_t<UIntType, false>::Encode(a_buff, UIntType(val), a_endBuff);
+            return;
+        }
 
-            if (v2 <= IntType(0x1f))
-            {
-                WriteValue<uint8_t>(a_buff, NEG_FIX_INT | (int8_t(val) & 0x1f), a_endBuff);
-            }
-            else if (v2 <= IntType(0x7f))
-            {
-                WriteValue(a_buff, INT_8, a_endBuff);
-                WriteValue(a_buff, int8_t(val), a_endBuff);
-            }
-            else if (v2 <= IntType(0x7fff))
-            {
-                WriteValue(a_buff, INT_16, a_endBuff);
-                WriteValue(a_buff, int16_t(val), a_endBuff);
-            }
-            else if (v2 <= IntType(0x7fffffff))
-            {
-                WriteValue(a_buff, INT_32, a_endBuff);
-                WriteValue(a_buff, int32_t(val), a_endBuff);
-            }
-            else
-            {
-                WriteValue(a_buff, INT_64, a_endBuff);
-                WriteValue(a_buff, int64_t(val), a_endBuff);
-            }
+        const int64_t l_val = val;
+
+        if (l_val >= -32)
+        {
+            WriteValue<uint8_t>(a_buff, NEG_FIX_INT | (int8_t(l_val) & 0x1f), a_endBuff);
+        }
+        else if (l_val >= numeric_limits<int8_t>::min())
+        {
+            WriteValue(a_buff, INT_8, a_endBuff);
+            WriteValue(a_buff, int8_t(l_val), a_endBuff);
+        }
+        else if (l_val >= numeric_limits<int16_t>::min())
+        {
+            WriteValue(a_buff, INT_16, a_endBuff);
+            WriteValue(a_buff, int16_t(l_val), a_endBuff);
+        }
+        else if (l_val >= numeric_limits<int32_t>::min())
+        {
+            WriteValue(a_buff, INT_32, a_endBuff);
+            WriteValue(a_buff, int32_t(l_val), a_endBuff);
         }
         else
         {
-            int_helper_t<IntType, false>::Encode(a_buff, val, a_endBuff);
+            WriteValue(a_buff, INT_64, a_endBuff);
+            WriteValue(a_buff, l_val, a_endBuff);
         }
     }
 };
@@ -383,6 +425,91 @@ inline void WriteRawBytes(char *&a_opBuff, const char *a_ipBuff, size_t a_len, c
     a_opBuff += a_len;
 }
 
+// The largest header of a string, binary, array or map
+const size_t MAX_HEADER_SIZE = 5;
+
+inline void WriteStrHeader(char *&a_buff, size_t a_len, const char *a_endBuff)
+{
+    if (a_len <= 0x1f)
+    {
+        WriteValue<uint8_t>(a_buff, FIX_STR | byte(a_len), a_endBuff);
+    }
+    else if (a_len <= 0xff)
+    {
+        WriteValue(a_buff, STR_8, a_endBuff);
+        WriteValue<uint8_t>(a_buff, a_len, a_endBuff);
+    }
+    else if (a_len <= 0xffff)
+    {
+        WriteValue(a_buff, STR_16, a_endBuff);
+        WriteValue<uint16_t>(a_buff, a_len, a_endBuff);
+    }
+    else
+    {
+        WriteValue(a_buff, STR_32, a_endBuff);
+        WriteValue<uint32_t>(a_buff, a_len, a_endBuff);
+    }
+}
+
+inline void WriteBinHeader(char *&a_buff, size_t a_len, const char *a_endBuff)
+{
+    if (a_len <= 0xff)
+    {
+        WriteValue(a_buff, BIN_8, a_endBuff);
+        WriteValue<uint8_t>(a_buff, a_len, a_endBuff);
+    }
+    else if (a_len <= 0xffff)
+    {
+        WriteValue(a_buff, BIN_16, a_endBuff);
+        WriteValue<uint16_t>(a_buff, a_len, a_endBuff);
+    }
+    else if (a_len <= 0xffffffff)
+    {
+        WriteValue(a_buff, BIN_32, a_endBuff);
+        WriteValue<uint32_t>(a_buff, a_len, a_endBuff);
+    }
+    else
+    {
+        throw runtime_error("Cannot write a buffer larger than (2^32)-1");
+    }
+}
+
+inline void WriteArrayHeader(char *&a_buff, size_t a_size, const char *a_endBuff)
+{
+    if (a_size <= 0xf)
+    {
+        WriteValue<uint8_t>(a_buff, FIX_ARRAY | byte(a_size), a_endBuff);
+    }
+    else if (a_size <= 0xffff)
+    {
+        WriteValue(a_buff, ARR_16, a_endBuff);
+        WriteValue<uint16_t>(a_buff, a_size, a_endBuff);
+    }
+    else
+    {
+        WriteValue(a_buff, ARR_32, a_endBuff);
+        WriteValue<uint32_t>(a_buff, a_size, a_endBuff);
+    }
+}
+
+inline void WriteMapHeader(char *&a_buff, size_t a_size, const char *a_endBuff)
+{
+    if (a_size <= 0xf)
+    {
+        WriteValue<byte>(a_buff, FIX_MAP | byte(a_size), a_endBuff);
+    }
+    else if (a_size <= 0xffff)
+    {
+        WriteValue(a_buff, MAP_16, a_endBuff);
+        WriteValue<uint16_t>(a_buff, a_size, a_endBuff);
+    }
+    else
+    {
+        WriteValue(a_buff, MAP_32, a_endBuff);
+        WriteValue<uint32_t>(a_buff, a_size, a_endBuff);
+    }
+}
+
 template<>
 struct prim_helper<string>
 {
@@ -393,26 +520,7 @@ struct prim_helper<string>
 
     static void Encode(char *&a_buff, const string &a_val, const char *a_endBuff)
     {
-        if (a_val.size() <= 0x1f)
-        {
-            WriteValue<uint8_t>(a_buff, FIX_STR | byte(a_val.size()), a_endBuff);
-        }
-        else if (a_val.size() <= 0xff)
-        {
-            WriteValue(a_buff, STR_8, a_endBuff);
-            WriteValue<uint8_t>(a_buff, a_val.size(), a_endBuff);
-        }
-        else if (a_val.size() <= 0xffff)
-        {
-            WriteValue(a_buff, STR_16, a_endBuff);
-            WriteValue<uint16_t>(a_buff, a_val.size(), a_endBuff);
-        }
-        else
-        {
-            WriteValue(a_buff, STR_32, a_endBuff);
-            WriteValue<uint32_t>(a_buff, a_val.size(), a_endBuff);
-        }
-
+        WriteStrHeader(a_buff, a_val.size(), a_endBuff);
         WriteRawBytes(a_buff, a_val.c_str(), a_val.size(), a_endBuff);
     }
 };
@@ -430,12 +538,12 @@ void WritePrimitive(char *&a_buff, const T &a_val, const char *a_endBuff)
     prim_helper<T>::Encode(a_buff, a_val, a_endBuff);
 }
 
-size_t CalcStructSize(const CStructData &a_data);
-size_t CalcArraySize(const CArrayData &a_data);
-size_t CalcBufferSize(const CBufferData &a_data);
-size_t CalcPrimArraySize(const APrimArrayDataBase &a_data);
+size_t CalcStructSize(const CStructData &a_data, const CWriteOptions &a_opts);
+size_t CalcArraySize(const CArrayData &a_data, const CWriteOptions &a_opts);
+size_t CalcBufferSize(const CBufferData &a_data, const CWriteOptions &a_opts);
+size_t CalcPrimArraySize(const APrimArrayDataBase &a_data, const CWriteOptions &a_opts);
 
-inline size_t CalcDataSize(const AData &a_data)
+inline size_t CalcDataSize(const AData &a_data, const CWriteOptions &a_opts)
 {
 #define PRIM_SIZE(name, type) \
     case DataType::name: \
@@ -443,13 +551,13 @@ inline size_t CalcDataSize(const AData &a_data)
 
     switch (a_data.Type())
     {
-    PRIM_SIZE(SByte, byte);
-    PRIM_SIZE(UByte, byte);
+    PRIM_SIZE(SByte, int8_t);
+    PRIM_SIZE(UByte, uint8_t);
     PRIM_SIZE(Short, short);
     PRIM_SIZE(UShort, ushort);
     PRIM_SIZE(Int, int);
     PRIM_SIZE(UInt, uint);
-    PRIM_SIZE(Long, long long);
+    PRIM_SIZE(Long, int64_t);
     PRIM_SIZE(ULong, ulong);
     PRIM_SIZE(Float, float);
     PRIM_SIZE(Double, double);
@@ -460,16 +568,16 @@ inline size_t CalcDataSize(const AData &a_data)
         return 1;
 
     case DataType::Struct:
-        return CalcStructSize(static_cast<const CStructData &>(a_data));
+        return CalcStructSize(static_cast<const CStructData &>(a_data), a_opts);
 
     case DataType::Array:
-        return CalcArraySize(static_cast<const CArrayData &>(a_data));
+        return CalcArraySize(static_cast<const CArrayData &>(a_data), a_opts);
 
     case DataType::Buffer:
-        return CalcBufferSize(static_cast<const CBufferData &>(a_data));
+        return CalcBufferSize(static_cast<const CBufferData &>(a_data), a_opts);
 
     case DataType::PrimArray:
-        return CalcPrimArraySize(static_cast<const APrimArrayDataBase &>(a_data));
+        return CalcPrimArraySize(static_cast<const APrimArrayDataBase &>(a_data), a_opts);
 
     default:
         throw runtime_error("Unknown serialization type.");
@@ -478,12 +586,12 @@ inline size_t CalcDataSize(const AData &a_data)
 #undef PRIM_SIZE
 }
 
-void WriteStruct(char *&a_buff, const CStructData &a_data, const char *a_endBuff);
-void WriteArray(char *&a_buff, const CArrayData &a_data, const char *a_endBuff);
-void WriteBuffer(char *&a_buff, const CBufferData &a_data, const char *a_endBuff);
-void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data, const char *a_endBuff);
+void WriteStruct(char *&a_buff, const CStructData &a_data, const char *a_endBuff, const CWriteOptions &a_opts);
+void WriteArray(char *&a_buff, const CArrayData &a_data, const char *a_endBuff, const CWriteOptions &a_opts);
+void WriteBuffer(char *&a_buff, const CBufferData &a_data, const char *a_endBuff, const CWriteOptions &a_opts);
+void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data, const char *a_endBuff, const CWriteOptions &a_opts);
 
-inline void WriteData(char *&a_buff, const AData &a_data, const char *a_endBuff)
+inline void WriteData(char *&a_buff, const AData &a_data, const char *a_endBuff, const CWriteOptions &a_opts)
 {
 #define WRITE_PRIM(name, type) \
     case DataType::name: \
@@ -498,7 +606,7 @@ inline void WriteData(char *&a_buff, const AData &a_data, const char *a_endBuff)
     WRITE_PRIM(UShort, ushort);
     WRITE_PRIM(Int, int);
     WRITE_PRIM(UInt, uint);
-    WRITE_PRIM(Long, long long);
+    WRITE_PRIM(Long, int64_t);
     WRITE_PRIM(ULong, ulong);
     WRITE_PRIM(Float, float);
     WRITE_PRIM(Double, double);
@@ -510,19 +618,19 @@ inline void WriteData(char *&a_buff, const AData &a_data, const char *a_endBuff)
         break;
 
     case DataType::Struct:
-        WriteStruct(a_buff, static_cast<const CStructData &>(a_data), a_endBuff);
+        WriteStruct(a_buff, static_cast<const CStructData &>(a_data), a_endBuff, a_opts);
         break;
 
     case DataType::Array:
-        WriteArray(a_buff, static_cast<const CArrayData &>(a_data), a_endBuff);
+        WriteArray(a_buff, static_cast<const CArrayData &>(a_data), a_endBuff, a_opts);
         break;
 
     case DataType::Buffer:
-        WriteBuffer(a_buff, static_cast<const CBufferData &>(a_data), a_endBuff);
+        WriteBuffer(a_buff, static_cast<const CBufferData &>(a_data), a_endBuff, a_opts);
         break;
 
     case DataType::PrimArray:
-        WritePrimArray(a_buff, static_cast<const APrimArrayDataBase &>(a_data), a_endBuff);
+        WritePrimArray(a_buff, static_cast<const APrimArrayDataBase &>(a_data), a_endBuff, a_opts);
         break;
 
     default:
@@ -535,13 +643,16 @@ inline void WriteData(char *&a_buff, const AData &a_data, const char *a_endBuff)
 AData::Ptr ReadString(const char *&a_buff, byte a_type, const CSerializationContext &a_context,
                       size_t a_length, const char *a_endBuff);
 AData::Ptr ReadArray(const char *&a_buff, byte a_type, const CSerializationContext &a_context,
-                     size_t a_length, const char *a_endBuff);
+                     size_t a_length, const char *a_endBuff, const CReadOptions &a_opts);
 AData::Ptr ReadStruct(const char *&a_buff, byte a_type, const CSerializationContext &a_context,
-                      size_t a_length, const char *a_endBuff);
+                      size_t a_length, const char *a_endBuff, const CReadOptions &a_opts);
 AData::Ptr ReadBuffer(const char *&a_buff, byte a_type, const CSerializationContext &a_context,
                       const char *a_endBuff);
+AData::Ptr ReadExt(const char *&a_buff, byte a_type, const CSerializationContext &a_context,
+                   const char *a_endBuff, const CReadOptions &a_opts);
 
-inline AData::Ptr ReadData(const char *&a_buff, const CSerializationContext &a_context, const char *a_endBuff)
+inline AData::Ptr ReadData(const char *&a_buff, const CSerializationContext &a_context, const char *a_endBuff,
+                           const CReadOptions &a_opts)
 {
     auto l_type = ReadValue<byte>(a_buff, a_endBuff);
 
@@ -562,12 +673,12 @@ inline AData::Ptr ReadData(const char *&a_buff, const CSerializationContext &a_c
     else if ((l_type & 0xf0) == FIX_ARRAY)
     {
         size_t l_len = l_type & ~FIX_ARRAY;
-        return ReadArray(a_buff, FIX_ARRAY, a_context, l_len, a_endBuff);
+        return ReadArray(a_buff, FIX_ARRAY, a_context, l_len, a_endBuff, a_opts);
     }
     else if ((l_type & 0xf0) == FIX_MAP)
     {
         size_t l_len = l_type & ~FIX_MAP;
-        return ReadStruct(a_buff, FIX_MAP, a_context, l_len, a_endBuff);
+        return ReadStruct(a_buff, FIX_MAP, a_context, l_len, a_endBuff, a_opts);
     }
 
     switch (l_type)
@@ -615,13 +726,23 @@ inline AData::Ptr ReadData(const char *&a_buff, const CSerializationContext &a_c
     case BIN_32:
         return ReadBuffer(a_buff, l_type, a_context, a_endBuff);
 
+    case FIXEXT_1:
+    case FIXEXT_2:
+    case FIXEXT_4:
+    case FIXEXT_8:
+    case FIXEXT_16:
+    case EXT_8:
+    case EXT_16:
+    case EXT_32:
+        return ReadExt(a_buff, l_type, a_context, a_endBuff, a_opts);
+
     case ARR_16:
     case ARR_32:
-        return ReadArray(a_buff, l_type, a_context, SIZE_MAX, a_endBuff);
+        return ReadArray(a_buff, l_type, a_context, SIZE_MAX, a_endBuff, a_opts);
 
     case MAP_16:
     case MAP_32:
-        return ReadStruct(a_buff, l_type, a_context, SIZE_MAX, a_endBuff);
+        return ReadStruct(a_buff, l_type, a_context, SIZE_MAX, a_endBuff, a_opts);
 
     default:
         throw runtime_error("Unsupported format type '" +
@@ -660,7 +781,7 @@ inline AData::Ptr ReadString(const char *&a_buff, byte a_type,
     return MakePrim(move(l_val), a_context);
 }
 
-inline size_t CalcStructSize(const CStructData &a_data)
+inline size_t CalcStructSize(const CStructData &a_data, const CWriteOptions &a_opts)
 {
     size_t len = 0;
 
@@ -684,39 +805,27 @@ inline size_t CalcStructSize(const CStructData &a_data)
     for (const CStructData::TProp &l_prop : a_data)
     {
         len += CalcSize(l_prop.first);
-        len += CalcDataSize(*l_prop.second);
+        len += CalcDataSize(*l_prop.second, a_opts);
     }
 
     return len;
 }
 
-inline void WriteStruct(char *&a_buff, const CStructData &a_data, const char *a_endBuff)
+inline void WriteStruct(char *&a_buff, const CStructData &a_data, const char *a_endBuff, const CWriteOptions &a_opts)
 {
-    if (a_data.size() <= 0xf)
-    {
-        WriteValue<byte>(a_buff, FIX_MAP | byte(a_data.size()), a_endBuff);
-    }
-    else if (a_data.size() <= 0xffff)
-    {
-        WriteValue(a_buff, MAP_16, a_endBuff);
-        WriteValue<uint16_t>(a_buff, a_data.size(), a_endBuff);
-    }
-    else
-    {
-        WriteValue(a_buff, MAP_32, a_endBuff);
-        WriteValue<uint32_t>(a_buff, a_data.size(), a_endBuff);
-    }
+    WriteMapHeader(a_buff, a_data.size(), a_endBuff);
 
     for (const CStructData::TProp &l_prop : a_data)
     {
         WritePrimitive(a_buff, l_prop.first, a_endBuff);
-        WriteData(a_buff, *l_prop.second, a_endBuff);
+        WriteData(a_buff, *l_prop.second, a_endBuff, a_opts);
     }
 }
 
 inline AData::Ptr ReadStruct(const char *&a_buff, byte a_type,
                              const CSerializationContext &a_context,
-                             size_t a_length, const char *a_endBuff)
+                             size_t a_length, const char *a_endBuff,
+                             const CReadOptions &a_opts)
 {
     if (a_length == SIZE_MAX)
     {
@@ -746,8 +855,8 @@ inline AData::Ptr ReadStruct(const char *&a_buff, byte a_type,
     bool l_allStrings = true;
     for (size_t i = 0; i < a_length; ++i)
     {
-        AData::Ptr l_key = ReadData(a_buff, a_context, a_endBuff);
-        AData::Ptr l_value = ReadData(a_buff, a_context, a_endBuff);
+        AData::Ptr l_key = ReadData(a_buff, a_context, a_endBuff, a_opts);
+        AData::Ptr l_value = ReadData(a_buff, a_context, a_endBuff, a_opts);
 
         if (l_key->Type() != DataType::String)
         {
@@ -787,7 +896,7 @@ inline AData::Ptr ReadStruct(const char *&a_buff, byte a_type,
     }
 }
 
-inline size_t CalcArraySize(const CArrayData &a_data)
+inline size_t CalcArraySize(const CArrayData &a_data, const CWriteOptions &a_opts)
 {
     size_t len = 0;
 
@@ -810,38 +919,26 @@ inline size_t CalcArraySize(const CArrayData &a_data)
 
     for (const AData::Ptr &l_data : a_data)
     {
-        len += CalcDataSize(*l_data);
+        len += CalcDataSize(*l_data, a_opts);
     }
 
     return len;
 }
 
-inline void WriteArray(char *&a_buff, const CArrayData &a_data, const char *a_endBuff)
+inline void WriteArray(char *&a_buff, const CArrayData &a_data, const char *a_endBuff, const CWriteOptions &a_opts)
 {
-    if (a_data.size() <= 0xf)
-    {
-        WriteValue<uint8_t>(a_buff, FIX_ARRAY | byte(a_data.size()), a_endBuff);
-    }
-    else if (a_data.size() <= 0xffff)
-    {
-        WriteValue(a_buff, ARR_16, a_endBuff);
-        WriteValue<uint16_t>(a_buff, a_data.size(), a_endBuff);
-    }
-    else
-    {
-        WriteValue(a_buff, ARR_32, a_endBuff);
-        WriteValue<uint32_t>(a_buff, a_data.size(), a_endBuff);
-    }
+    WriteArrayHeader(a_buff, a_data.size(), a_endBuff);
 
     for (const AData::Ptr &l_data : a_data)
     {
-        WriteData(a_buff, *l_data, a_endBuff);
+        WriteData(a_buff, *l_data, a_endBuff, a_opts);
     }
 }
 
 inline AData::Ptr ReadArray(const char *&a_buff, byte a_type,
                             const CSerializationContext &a_context,
-                            size_t a_length, const char *a_endBuff)
+                            size_t a_length, const char *a_endBuff,
+                            const CReadOptions &a_opts)
 {
     if (a_length == SIZE_MAX)
     {
@@ -864,7 +961,7 @@ inline AData::Ptr ReadArray(const char *&a_buff, byte a_type,
 
     for (size_t i = 0; i < a_length; ++i)
     {
-        l_ret->Add(ReadData(a_buff, a_context, a_endBuff));
+        l_ret->Add(ReadData(a_buff, a_context, a_endBuff, a_opts));
     }
 
     return move(l_ret);
@@ -903,29 +1000,140 @@ size_t p_CalcPrimArraySizeImpl(const CPrimArrayData<T> &a_data)
 template<typename T>
 void WritePrimArrayImpl(char *&a_buff, const CPrimArrayData<T> &a_data, const char *a_endBuff)
 {
-    if (a_data.size() <= 0xf)
+    WriteArrayHeader(a_buff, a_data.size(), a_endBuff);
+
+    for (const T &l_val : a_data)
     {
-        WriteValue<uint8_t>(a_buff, FIX_ARRAY | byte(a_data.size()), a_endBuff);
+        WritePrimitive(a_buff, l_val, a_endBuff);
     }
-    else if (a_data.size() <= 0xffff)
+}
+
+inline size_t CalcExtSize(size_t len)
+{
+    switch (len)
     {
-        WriteValue(a_buff, ARR_16, a_endBuff);
-        WriteValue<uint16_t>(a_buff, a_data.size(), a_endBuff);
+    case 1:
+    case 2:
+    case 4:
+    case 8:
+    case 16:
+        return len + 2;
+    }
+
+    if (len <= 0xff)
+    {
+        return len + 3;
+    }
+    else if (len <= 0xffff)
+    {
+        return len + 4;
+    }
+    else if (len <= 0xffffffff)
+    {
+        return len + 6;
     }
     else
     {
-        WriteValue(a_buff, ARR_32, a_endBuff);
-        WriteValue<uint32_t>(a_buff, a_data.size(), a_endBuff);
+        throw runtime_error("Cannot write an extension larger than (2^32)-1");
     }
+}
 
-    for (const T &l_val : a_data)
+inline void WriteExtHeader(char *&a_buff, int8_t a_extType, size_t len, const char *a_endBuff)
+{
+    switch (len)
     {
-        WritePrimitive(a_buff, l_val, a_endBuff);
+    case 1:
+        WriteValue(a_buff, FIXEXT_1, a_endBuff);
+        break;
+    case 2:
+        WriteValue(a_buff, FIXEXT_2, a_endBuff);
+        break;
+    case 4:
+        WriteValue(a_buff, FIXEXT_4, a_endBuff);
+        break;
+    case 8:
+        WriteValue(a_buff, FIXEXT_8, a_endBuff);
+        break;
+    case 16:
+        WriteValue(a_buff, FIXEXT_16, a_endBuff);
+        break;
+
+    default:
+        if (len <= 0xff)
+        {
+            WriteValue(a_buff, EXT_8, a_endBuff);
+            WriteValue<uint8_t>(a_buff, len, a_endBuff);
+        }
+        else if (len <= 0xffff)
+        {
+            WriteValue(a_buff, EXT_16, a_endBuff);
+            WriteValue<uint16_t>(a_buff, len, a_endBuff);
+        }
+        else
+        {
+            WriteValue(a_buff, EXT_32, a_endBuff);
+            WriteValue<uint32_t>(a_buff, len, a_endBuff);
+        }
     }
+
+    WriteValue(a_buff, a_extType, a_endBuff);
+}
+
+inline void WriteBoolArrayExt(char *&a_buff, const CPrimArrayData<bool> &a_data, const char *a_endBuff)
+{
+    const size_t l_bitsSize = CalcBitPackedSize(a_data.size());
+
+    WriteExtHeader(a_buff, EXT_BOOL_ARRAY, sizeof(uint32_t) + l_bitsSize, a_endBuff);
+    WriteValue<uint32_t>(a_buff, a_data.size(), a_endBuff);
+
+    if (a_buff + l_bitsSize > a_endBuff)
+        throw CBufferOverflowException();
+
+    WriteBitPacked(a_buff, a_data.begin(), a_data.size());
+}
+
+inline AData::Ptr ReadBoolArrayExt(const char *&a_buff, size_t a_length,
+                                   const CSerializationContext &a_context,
+                                   const char *a_endBuff)
+{
+    if (a_length < sizeof(uint32_t))
+        throw runtime_error("Invalid bool array extension.");
+
+    const size_t l_count = ReadValue<uint32_t>(a_buff, a_endBuff);
+
+    if (a_length != sizeof(uint32_t) + CalcBitPackedSize(l_count))
+        throw runtime_error("Invalid bool array extension.");
+
+    if (CalcBitPackedSize(l_count) > size_t(a_endBuff - a_buff))
+        throw CBufferOverflowException();
+
+    CPrimArrayData<bool>::Ptr l_ret(new CPrimArrayData<bool>(a_context));
+    l_ret->Resize(l_count);
+
+    ReadBitPacked(a_buff, l_ret->begin(), l_count);
+
+    return move(l_ret);
+}
+
+// Bool arrays are only bit packed when that is smaller than writing
+// each value as a separate bool
+inline bool ShouldPackBools(const APrimArrayDataBase &a_data, bool a_packBools)
+{
+    if (!a_packBools || a_data.InnerType() != DataType::Bool)
+        return false;
+
+    if (a_data.Size() > 0xffffffff)
+        throw runtime_error("Cannot encode more array elements than (2^32)-1");
+
+    return CalcExtSize(sizeof(uint32_t) + CalcBitPackedSize(a_data.Size())) <
+           p_CalcPrimArraySizeImpl(static_cast<const CPrimArrayData<bool> &>(a_data));
 }
 
-inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data)
+inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data, const CWriteOptions &a_opts)
 {
+    if (ShouldPackBools(a_data, a_opts.PackBools))
+        return CalcExtSize(sizeof(uint32_t) + CalcBitPackedSize(a_data.Size()));
+
 #define CALC_SIZE(name, type) \
     case DataType::name: \
         return p_CalcPrimArraySizeImpl(static_cast<const CPrimArrayData<type> &>(a_data))
@@ -938,8 +1146,8 @@ inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data)
     CALC_SIZE(UShort, unsigned short);
     CALC_SIZE(Int, int);
     CALC_SIZE(UInt, unsigned int);
-    CALC_SIZE(Long, long long);
-    CALC_SIZE(ULong, unsigned long);
+    CALC_SIZE(Long, int64_t);
+    CALC_SIZE(ULong, uint64_t);
     CALC_SIZE(Float, float);
     CALC_SIZE(Double, double);
     CALC_SIZE(Bool, bool);
@@ -952,13 +1160,19 @@ inline size_t CalcPrimArraySize(const APrimArrayDataBase &a_data)
 #undef CALC_SIZE
 }
 
-inline void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data, const char *a_endBuff)
+inline void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data, const char *a_endBuff, const CWriteOptions &a_opts)
 {
 #define WRITE_PRIM(name, type) \
     case DataType::name: \
         WritePrimArrayImpl(a_buff, static_cast<const CPrimArrayData<type> &>(a_data), a_endBuff); \
         break
 
+    if (ShouldPackBools(a_data, a_opts.PackBools))
+    {
+        WriteBoolArrayExt(a_buff, static_cast<const CPrimArrayData<bool> &>(a_data), a_endBuff);
+        return;
+    }
+
     switch (a_data.InnerType())
     {
     WRITE_PRIM(SByte, signed char);
@@ -967,8 +1181,8 @@ inline void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data, cons
     WRITE_PRIM(UShort, unsigned short);
     WRITE_PRIM(Int, int);
     WRITE_PRIM(UInt, unsigned int);
-    WRITE_PRIM(Long, long long);
-    WRITE_PRIM(ULong, unsigned long);
+    WRITE_PRIM(Long, int64_t);
+    WRITE_PRIM(ULong, uint64_t);
     WRITE_PRIM(Float, float);
     WRITE_PRIM(Double, double);
     WRITE_PRIM(Bool, bool);
@@ -981,33 +1195,47 @@ inline void WritePrimArray(char *&a_buff, const APrimArrayDataBase &a_data, cons
 #undef WRITE_PRIM
 }
 
-inline size_t CalcBufferSize(const CBufferData &a_data)
+inline const CCompressedBuffer *GetCompressed(const CBufferData &a_data, const CWriteOptions &a_opts,
+                                              CCompressedBuffer::Ptr &a_scratch)
 {
-    return CalcRawSize(a_data.BufferSize());
+    const CCompressedBuffer *l_comp = GetCompressed(a_data, a_opts.Compressor, a_opts.CompressThreshold, a_scratch);
+
+    // The extension can't be larger than (2^32)-1
+    if (l_comp && l_comp->Size > 0xffffffff - sizeof(uint64_t))
+        return nullptr;
+
+    return l_comp;
 }
 
-inline void WriteBuffer(char *&a_buff, const CBufferData &a_data, const char *a_endBuff)
+inline size_t CalcBufferSize(const CBufferData &a_data, const CWriteOptions &a_opts)
 {
-    if (a_data.BufferSize() <= 0xff)
-    {
-        WriteValue(a_buff, BIN_8, a_endBuff);
-        WriteValue<uint8_t>(a_buff, a_data.BufferSize(), a_endBuff);
-    }
-    else if (a_data.BufferSize() <= 0xffff)
-    {
-        WriteValue(a_buff, BIN_16, a_endBuff);
-        WriteValue<uint16_t>(a_buff, a_data.BufferSize(), a_endBuff);
-    }
-    else if (a_data.BufferSize() <= 0xffffffff)
-    {
-        WriteValue(a_buff, BIN_32, a_endBuff);
-        WriteValue<uint32_t>(a_buff, a_data.BufferSize(), a_endBuff);
-    }
-    else
+    CCompressedBuffer::Ptr l_scratch;
+
+    if (const CCompressedBuffer *l_comp = GetCompressed(a_data, a_opts, l_scratch))
+        return CalcExtSize(sizeof(uint64_t) + l_comp->Size);
+
+    // Binary data has no fixed size form, unlike strings
+    const size_t len = a_data.BufferSize();
+
+    if (len <= 0xff)
+        return len + 2;
+
+    return CalcRawSize(len);
+}
+
+inline void WriteBuffer(char *&a_buff, const CBufferData &a_data, const char *a_endBuff, const CWriteOptions &a_opts)
+{
+    CCompressedBuffer::Ptr l_scratch;
+
+    if (const CCompressedBuffer *l_comp = GetCompressed(a_data, a_opts, l_scratch))
     {
-        throw runtime_error("Cannot write a buffer larger than (2^32)-1");
+        WriteExtHeader(a_buff, EXT_COMPRESSED_BIN, sizeof(uint64_t) + l_comp->Size, a_endBuff);
+        WriteValue<uint64_t>(a_buff, a_data.BufferSize(), a_endBuff);
+        WriteRawBytes(a_buff, l_comp->Data.get(), l_comp->Size, a_endBuff);
+        return;
     }
 
+    WriteBinHeader(a_buff, a_data.BufferSize(), a_endBuff);
     WriteRawBytes(a_buff, a_data.GetBuffer().data(), a_data.BufferSize(), a_endBuff);
 }
 
@@ -1043,18 +1271,444 @@ inline AData::Ptr ReadBuffer(const char *&a_buff, byte a_type,
     return CBufferData::Ptr(new CBufferData(move(l_buff), a_context));
 }
 
+inline AData::Ptr ReadCompressedBinExt(const char *&a_buff, size_t a_length,
+                                       const CSerializationContext &a_context,
+                                       const char *a_endBuff, const CReadOptions &a_opts)
+{
+    if (a_length < sizeof(uint64_t))
+        throw runtime_error("Invalid compressed binary extension.");
+
+    const size_t l_rawSize = ReadValue<uint64_t>(a_buff, a_endBuff);
+    const size_t l_compSize = a_length - sizeof(uint64_t);
+
+    if (l_compSize > size_t(a_endBuff - a_buff))
+        throw CBufferOverflowException();
+
+    util::CBuffer l_buff = Decompress(a_opts.Compressor, a_buff, l_compSize, l_rawSize,
+                                      a_opts.MaxDecompressedSize);
+    a_buff += l_compSize;
+
+    return CBufferData::Ptr(new CBufferData(move(l_buff), true, a_context));
+}
+
+inline AData::Ptr ReadExt(const char *&a_buff, byte a_type,
+                          const CSerializationContext &a_context,
+                          const char *a_endBuff, const CReadOptions &a_opts)
+{
+    size_t l_length;
+    switch (a_type)
+    {
+    case FIXEXT_1:
+        l_length = 1;
+        break;
+    case FIXEXT_2:
+        l_length = 2;
+        break;
+    case FIXEXT_4:
+        l_length = 4;
+        break;
+    case FIXEXT_8:
+        l_length = 8;
+        break;
+    case FIXEXT_16:
+        l_length = 16;
+        break;
+    case EXT_8:
+        l_length = ReadValue<uint8_t>(a_buff, a_endBuff);
+        break;
+    case EXT_16:
+        l_length = ReadValue<uint16_t>(a_buff, a_endBuff);
+        break;
+    case EXT_32:
+        l_length = ReadValue<uint32_t>(a_buff, a_endBuff);
+        break;
+    default:
+        throw runtime_error("Unsupported ext type '" +
+                            to_string(a_type) +
+                            "'");
+    }
+
+    const int8_t l_extType = ReadValue<int8_t>(a_buff, a_endBuff);
+
+    switch (l_extType)
+    {
+    case EXT_BOOL_ARRAY:
+        return ReadBoolArrayExt(a_buff, l_length, a_context, a_endBuff);
+
+    case EXT_COMPRESSED_BIN:
+        return ReadCompressedBinExt(a_buff, l_length, a_context, a_endBuff, a_opts);
+
+    default:
+        throw runtime_error("Unsupported extension type '" +
+                            to_string(l_extType) +
+                            "'");
+    }
+}
+
+// Writing to a stream. Containers are written a piece at a time, and every
+// other value is encoded into the writer's buffer as a whole. Values that
+// are larger than the buffer are written in pieces instead
+void StreamData(CChunkedWriter &a_out, const AData &a_data, const CWriteOptions &a_opts);
+
+template<typename T>
+void StreamPrimitive(CChunkedWriter &a_out, const T &a_val)
+{
+    char *l_write = a_out.Reserve(CalcSize(a_val));
+    WritePrimitive(l_write, a_val, a_out.End());
+    a_out.Commit(l_write);
+}
+
+inline void StreamPrimitive(CChunkedWriter &a_out, const string &a_val)
+{
+    if (CalcSize(a_val) <= a_out.Capacity())
+    {
+        char *l_write = a_out.Reserve(CalcSize(a_val));
+        WritePrimitive(l_write, a_val, a_out.End());
+        a_out.Commit(l_write);
+        return;
+    }
+
+    char *l_write = a_out.Reserve(MAX_HEADER_SIZE);
+    WriteStrHeader(l_write, a_val.size(), a_out.End());
+    a_out.Commit(l_write);
+
+    a_out.Write(a_val.data(), a_val.size());
+}
+
+template<typename T>
+void StreamPrimArrayImpl(CChunkedWriter &a_out, const CPrimArrayData<T> &a_data)
+{
+    char *l_write = a_out.Reserve(MAX_HEADER_SIZE);
+    WriteArrayHeader(l_write, a_data.size(), a_out.End());
+    a_out.Commit(l_write);
+
+    for (const T &l_val : a_data)
+    {
+        StreamPrimitive(a_out, l_val);
+    }
+}
+
+inline void StreamBoolArrayExt(CChunkedWriter &a_out, const CPrimArrayData<bool> &a_data)
+{
+    const size_t l_bitsSize = CalcBitPackedSize(a_data.size());
+
+    char *l_write = a_out.Reserve(MAX_HEADER_SIZE + 1 + sizeof(uint32_t));
+    WriteExtHeader(l_write, EXT_BOOL_ARRAY, sizeof(uint32_t) + l_bitsSize, a_out.End());
+    WriteValue<uint32_t>(l_write, a_data.size(), a_out.End());
+    a_out.Commit(l_write);
+
+    // Whole words of bits, so that the slices line up
+    const size_t l_slice = (a_out.Capacity() / 8) * 64;
+
+    for (size_t i = 0; i < a_data.size(); i += l_slice)
+    {
+        const size_t l_num = min(l_slice, a_data.size() - i);
+
+        l_write = a_out.Reserve(CalcBitPackedSize(l_num));
+        WriteBitPacked(l_write, a_data.begin() + i, l_num);
+        a_out.Commit(l_write);
+    }
+}
+
+inline void StreamPrimArray(CChunkedWriter &a_out, const APrimArrayDataBase &a_data, const CWriteOptions &a_opts)
+{
+#define STREAM_PRIM(name, type) \
+    case DataType::name: \
+        StreamPrimArrayImpl(a_out, static_cast<const CPrimArrayData<type> &>(a_data)); \
+        break
+
+    if (ShouldPackBools(a_data, a_opts.PackBools))
+    {
+        StreamBoolArrayExt(a_out, static_cast<const CPrimArrayData<bool> &>(a_data));
+        return;
+    }
+
+    switch (a_data.InnerType())
+    {
+    STREAM_PRIM(SByte, signed char);
+    STREAM_PRIM(UByte, unsigned char);
+    STREAM_PRIM(Short, short);
+    STREAM_PRIM(UShort, unsigned short);
+    STREAM_PRIM(Int, int);
+    STREAM_PRIM(UInt, unsigned int);
+    STREAM_PRIM(Long, int64_t);
+    STREAM_PRIM(ULong, uint64_t);
+    STREAM_PRIM(Float, float);
+    STREAM_PRIM(Double, double);
+    STREAM_PRIM(Bool, bool);
+    STREAM_PRIM(String, string);
+
+    default:
+        throw runtime_error("Unsupported primitive type.");
+    }
+
+#undef STREAM_PRIM
+}
+
+inline void StreamData(CChunkedWriter &a_out, const AData &a_data, const CWriteOptions &a_opts)
+{
+    switch (a_data.Type())
+    {
+    case DataType::Struct:
+    {
+        const CStructData &l_struct = static_cast<const CStructData &>(a_data);
+
+        char *l_write = a_out.Reserve(MAX_HEADER_SIZE);
+        WriteMapHeader(l_write, l_struct.size(), a_out.End());
+        a_out.Commit(l_write);
+
+        for (const CStructData::TProp &l_prop : l_struct)
+        {
+            StreamPrimitive(a_out, l_prop.first);
+            StreamData(a_out, *l_prop.second, a_opts);
+        }
+        return;
+    }
+
+    case DataType::Array:
+    {
+        const CArrayData &l_arr = static_cast<const CArrayData &>(a_data);
+
+        char *l_write = a_out.Reserve(MAX_HEADER_SIZE);
+        WriteArrayHeader(l_write, l_arr.size(), a_out.End());
+        a_out.Commit(l_write);
+
+        for (const AData::Ptr &l_val : l_arr)
+        {
+            StreamData(a_out, *l_val, a_opts);
+        }
+        return;
+    }
+
+    default:
+        break;
+    }
+
+    const size_t l_size = CalcDataSize(a_data, a_opts);
+
+    if (l_size <= a_out.Capacity())
+    {
+        char *l_write = a_out.Reserve(l_size);
+        WriteData(l_write, a_data, a_out.End(), a_opts);
+        a_out.Commit(l_write);
+        return;
+    }
+
+    switch (a_data.Type())
+    {
+    case DataType::String:
+        StreamPrimitive(a_out, static_cast<const CStringData &>(a_data).GetValue());
+        break;
+
+    case DataType::Buffer:
+    {
+        const CBufferData &l_buff = static_cast<const CBufferData &>(a_data);
+
+        CCompressedBuffer::Ptr l_scratch;
+
+        if (const CCompressedBuffer *l_comp = GetCompressed(l_buff, a_opts, l_scratch))
+        {
+            char *l_write = a_out.Reserve(MAX_HEADER_SIZE + 1 + sizeof(uint64_t));
+            WriteExtHeader(l_write, EXT_COMPRESSED_BIN, sizeof(uint64_t) + l_comp->Size, a_out.End());
+            WriteValue<uint64_t>(l_write, l_buff.BufferSize(), a_out.End());
+            a_out.Commit(l_write);
+
+            a_out.Write(l_comp->Data.get(), l_comp->Size);
+            break;
+        }
+
+        char *l_write = a_out.Reserve(MAX_HEADER_SIZE);
+        WriteBinHeader(l_write, l_buff.BufferSize(), a_out.End());
+        a_out.Commit(l_write);
+
+        a_out.Write(l_buff.GetBuffer().data(), l_buff.BufferSize());
+        break;
+    }
+
+    case DataType::PrimArray:
+        StreamPrimArray(a_out, static_cast<const APrimArrayDataBase &>(a_data), a_opts);
+        break;
+
+    default:
+        throw runtime_error("Unsupported data type.");
+    }
+}
+
+// Finds where a value ends without decoding it. Rather than recursing, this
+// keeps a count of the values that are still to come, so deeply nested
+// input can't exhaust the stack
+class CMsgPackScanner
+    : public IValueScanner
+{
+public:
+    CMsgPackScanner()
+        : m_needed(0) { }
+
+    virtual size_t Scan(const char *a_buf, const char *a_endBuf) override
+    {
+        // Don't walk the value again until the piece that was missing
+        // has arrived
+        if (size_t(a_endBuf - a_buf) < m_needed)
+            return 0;
+
+        const char *l_curr = a_buf;
+
+        try
+        {
+            for (size_t l_pending = 1; l_pending > 0; --l_pending)
+            {
+                l_pending += SkipValue(a_buf, l_curr, a_endBuf);
+            }
+        }
+        catch (CBufferOverflowException &)
+        {
+            m_needed = max(m_needed, size_t(a_endBuf - a_buf) + 1);
+            return 0;
+        }
+
+        return l_curr - a_buf;
+    }
+
+    virtual void Reset() override
+    {
+        m_needed = 0;
+    }
+
+private:
+    void Skip(const char *a_buf, const char *&a_curr, const char *a_endBuf, size_t a_size)
+    {
+        if (a_size > size_t(a_endBuf - a_curr))
+        {
+            m_needed = (a_curr - a_buf) + a_size;
+            throw CBufferOverflowException();
+        }
+
+        a_curr += a_size;
+    }
+
+    // Skips the next value, apart from the children of containers.
+    // Returns the number of children
+    size_t SkipValue(const char *a_buf, const char *&a_curr, const char *a_endBuf)
+    {
+        auto l_type = ReadValue<byte>(a_curr, a_endBuf);
+
+        if ((l_type & 0x80) == 0 || (l_type & 0xe0) == NEG_FIX_INT)
+            return 0;
+        if ((l_type & 0xe0) == FIX_STR)
+        {
+            Skip(a_buf, a_curr, a_endBuf, l_type & ~FIX_STR);
+            return 0;
+        }
+        if ((l_type & 0xf0) == FIX_ARRAY)
+            return l_type & ~FIX_ARRAY;
+        if ((l_type & 0xf0) == FIX_MAP)
+            return 2 * size_t(l_type & ~FIX_MAP);
+
+        switch (l_type)
+        {
+        case NIL:
+        case TRUE:
+        case FALSE:
+            return 0;
+
+        case UINT_8:
+        case INT_8:
+            Skip(a_buf, a_curr, a_endBuf, 1);
+            return 0;
+        case UINT_16:
+        case INT_16:
+            Skip(a_buf, a_curr, a_endBuf, 2);
+            return 0;
+        case UINT_32:
+        case INT_32:
+        case FLOAT_32:
+            Skip(a_buf, a_curr, a_endBuf, 4);
+            return 0;
+        case UINT_64:
+        case INT_64:
+        case FLOAT_64:
+            Skip(a_buf, a_curr, a_endBuf, 8);
+            return 0;
+
+        case STR_8:
+        case BIN_8:
+            Skip(a_buf, a_curr, a_endBuf, ReadValue<uint8_t>(a_curr, a_endBuf));
+            return 0;
+        case STR_16:
+        case BIN_16:
+            Skip(a_buf, a_curr, a_endBuf, ReadValue<uint16_t>(a_curr, a_endBuf));
+            return 0;
+        case STR_32:
+        case BIN_32:
+            Skip(a_buf, a_curr, a_endBuf, ReadValue<uint32_t>(a_curr, a_endBuf));
+            return 0;
+
+        // Extensions have a type byte in front of the payload
+        case FIXEXT_1:
+            Skip(a_buf, a_curr, a_endBuf, 1 + 1);
+            return 0;
+        case FIXEXT_2:
+            Skip(a_buf, a_curr, a_endBuf, 1 + 2);
+            return 0;
+        case FIXEXT_4:
+            Skip(a_buf, a_curr, a_endBuf, 1 + 4);
+            return 0;
+        case FIXEXT_8:
+            Skip(a_buf, a_curr, a_endBuf, 1 + 8);
+            return 0;
+        case FIXEXT_16:
+            Skip(a_buf, a_curr, a_endBuf, 1 + 16);
+            return 0;
+        case EXT_8:
+            Skip(a_buf, a_curr, a_endBuf, 1 + size_t(ReadValue<uint8_t>(a_curr, a_endBuf)));
+            return 0;
+        case EXT_16:
+            Skip(a_buf, a_curr, a_endBuf, 1 + size_t(ReadValue<uint16_t>(a_curr, a_endBuf)));
+            return 0;
+        case EXT_32:
+            Skip(a_buf, a_curr, a_endBuf, 1 + size_t(ReadValue<uint32_t>(a_curr, a_endBuf)));
+            return 0;
+
+        case ARR_16:
+            return ReadValue<uint16_t>(a_curr, a_endBuf);
+        case ARR_32:
+            return ReadValue<uint32_t>(a_curr, a_endBuf);
+        case MAP_16:
+            return 2 * size_t(ReadValue<uint16_t>(a_curr, a_endBuf));
+        case MAP_32:
+            return 2 * size_t(ReadValue<uint32_t>(a_curr, a_endBuf));
+
+        default:
+            throw runtime_error("Unsupported format type '" +
+                                to_string(l_type) +
+                                "'");
+        }
+    }
+
+    size_t m_needed;
+};
+
+}
+
+CMsgPackSerializer::CMsgPackSerializer()
+    : m_packBools(false)
+{
 }
 
 size_t CMsgPackSerializer::CalcSize(const AData &a_data) const
 {
-    return CalcDataSize(a_data);
+    const CWriteOptions l_opts = { m_packBools, m_bufferCompressor.get(), m_compressThreshold };
+
+    return CalcDataSize(a_data, l_opts);
 }
 
 size_t CMsgPackSerializer::SerializeInto(const AData &a_data, char *a_buffer, size_t a_bufferSize) const
 {
     char *l_writeBuff = a_buffer;
 
-    WriteData(l_writeBuff, a_data, l_writeBuff + a_bufferSize);
+    const CWriteOptions l_opts = { m_packBools, m_bufferCompressor.get(), m_compressThreshold };
+
+    WriteData(l_writeBuff, a_data, l_writeBuff + a_bufferSize, l_opts);
 
     size_t l_writeSize = l_writeBuff - a_buffer;
 
@@ -1069,15 +1723,33 @@ string CMsgPackSerializer::SerializeData(const AData &a_data) const
 
     string l_ret(l_writeSize, '\0');
 
-    assert(SerializeInto(a_data, &l_ret[0], l_writeSize));
+    if (SerializeInto(a_data, &l_ret[0], l_writeSize) != l_writeSize)
+        throw runtime_error("The serialized data size did not match the calculated size.");
 
     return move(l_ret);
 }
 
+void CMsgPackSerializer::SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const
+{
+    CChunkedWriter l_out(a_stream);
+
+    const CWriteOptions l_opts = { m_packBools, m_bufferCompressor.get(), m_compressThreshold };
+
+    StreamData(l_out, a_data, l_opts);
+
+    l_out.Flush();
+}
+
+IValueScanner::Ptr CMsgPackSerializer::CreateScanner() const
+{
+    return IValueScanner::Ptr(new CMsgPackScanner());
+}
 
 AData::Ptr CMsgPackSerializer::DeserializeData(const char *a_buf, const char *a_endBuf) const
 {
-    AData::Ptr l_ret = ReadData(a_buf, CSerializationContext(), a_endBuf);
+    const CReadOptions l_opts = { m_bufferCompressor.get(), m_maxDecompressedSize };
+
+    AData::Ptr l_ret = ReadData(a_buf, CSerializationContext(), a_endBuf, l_opts);
 
     assert(a_buf <= a_endBuf);
 
@@ -0,0 +1,578 @@
+/*
+ * File description: record_log.cpp
+ * Author information: Mike Raninger mikeranzinger@gmail.com
+ * Copyright information: Copyright Mike Ranzinger
+ */
+
+#include "serialization/format/record_log.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#include "util/crc_calc.h"
+
+#include "detail/varint.h"
+
+using namespace std;
+using namespace axon::util;
+using namespace axon::serialization::detail;
+
+namespace axon { namespace serialization {
+
+namespace {
+
+// Log header:
+//   magic (4), version (2), length of the compressor name (2), name of the
+//   compressor that the blocks were written with, empty without one.
+//   Version 1 logs end after the version, and don't record the compressor
+const uint32_t LOG_MAGIC = 0x41584C47;
+const uint16_t LOG_VERSION = 2;
+const uint16_t LOG_VERSION_NO_NAME = 1;
+const size_t LOG_HEADER_SIZE = sizeof(uint32_t) + sizeof(uint16_t);
+
+// Block header:
+//   magic (4), number of records (4), stored size (8), size before
+//   compression (8), flags (1), CRC of the preceding fields (4),
+//   CRC of the stored data (4)
+const uint32_t BLOCK_MAGIC = 0x424C4B31;
+const size_t BLOCK_HEADER_SIZE = 33;
+const size_t BLOCK_CRC_OFFSET = 25;
+const uint8_t BLOCK_COMPRESSED = 0x1;
+
+// Trailer, after the index entries:
+//   index offset (8), number of blocks (8), number of records (8),
+//   CRC of the index and the preceding fields (4), magic (4)
+const uint32_t INDEX_MAGIC = 0x49445831;
+const size_t TRAILER_SIZE = 32;
+const size_t INDEX_ENTRY_SIZE = 2 * sizeof(uint64_t);
+
+template<typename T>
+void Store(char *&a_buff, T a_val)
+{
+	memcpy(a_buff, &a_val, sizeof(T));
+	a_buff += sizeof(T);
+}
+
+template<typename T>
+T Load(const char *&a_buff)
+{
+	T l_ret;
+	memcpy(&l_ret, a_buff, sizeof(T));
+	a_buff += sizeof(T);
+	return l_ret;
+}
+
+}
+
+CRecordLogWriter::CRecordLogWriter(const std::string &a_fileName, ASerializer::Ptr a_serializer)
+	: m_fileName(a_fileName), m_serializer(move(a_serializer)), m_blockSize(DEFAULT_BLOCK_SIZE),
+	  m_blockRecords(0), m_numRecords(0), m_offset(0)
+{
+	if (!m_serializer)
+		throw runtime_error("The serializer cannot be null.");
+
+	m_file.open(a_fileName, ios_base::binary | ios_base::trunc);
+
+	if (!m_file)
+		throw runtime_error("Unable to open the file '" + a_fileName + "'.");
+
+	// The header records the compressor, so it is written along with the
+	// first block, once the compressor can no longer change
+}
+
+CRecordLogWriter::~CRecordLogWriter()
+{
+	try
+	{
+		Close();
+	}
+	catch (...)
+	{
+		// Destructors can't throw. Call Close to find out about errors
+	}
+}
+
+void CRecordLogWriter::SetCompressor(ICompressor::Ptr a_compressor)
+{
+	if (m_offset != 0)
+		throw runtime_error("The compressor can't be changed once the record log has been written to.");
+
+	m_compressor = move(a_compressor);
+}
+
+void CRecordLogWriter::SetBlockSize(size_t a_size)
+{
+	if (a_size == 0)
+		throw runtime_error("The block size must be greater than 0.");
+
+	m_blockSize = a_size;
+}
+
+void CRecordLogWriter::AppendData(const AData &a_data)
+{
+	if (!m_file.is_open())
+		throw runtime_error("The record log has already been closed.");
+
+	const size_t l_size = m_serializer->CalcSize(a_data);
+
+	// Each record is its size, followed by the serialized data
+	const size_t l_start = m_block.size();
+	m_block.resize(l_start + CalcEncodeSize(l_size) + l_size);
+
+	char *l_write = &m_block[l_start];
+	EncodeSize(l_write, l_size);
+
+	if (m_serializer->SerializeInto(a_data, l_write, l_size) != l_size)
+	{
+		m_block.resize(l_start);
+		throw runtime_error("The serialized record size did not match the calculated size.");
+	}
+
+	++m_blockRecords;
+	++m_numRecords;
+
+	if (m_block.size() >= m_blockSize || m_blockRecords == numeric_limits<uint32_t>::max())
+		p_WriteBlock();
+}
+
+void CRecordLogWriter::Flush()
+{
+	if (!m_file.is_open())
+		return;
+
+	p_WriteHeader();
+	p_WriteBlock();
+
+	m_file.flush();
+
+	if (!m_file)
+		throw runtime_error("Failed to write the file '" + m_fileName + "'.");
+}
+
+void CRecordLogWriter::Close()
+{
+	if (!m_file.is_open())
+		return;
+
+	p_WriteHeader();
+	p_WriteBlock();
+
+	const uint64_t l_indexOffset = m_offset;
+
+	string l_index(m_index.size() * INDEX_ENTRY_SIZE + TRAILER_SIZE, '\0');
+	char *l_write = &l_index[0];
+
+	for (const CRecordLogBlock &l_block : m_index)
+	{
+		Store(l_write, l_block.FirstRecord);
+		Store(l_write, l_block.Offset);
+	}
+
+	Store(l_write, l_indexOffset);
+	Store(l_write, uint64_t(m_index.size()));
+	Store(l_write, m_numRecords);
+	Store(l_write, CalcCRC32(l_index.data(), l_write - l_index.data()));
+	Store(l_write, INDEX_MAGIC);
+
+	p_Write(l_index.data(), l_index.size());
+
+	m_file.close();
+
+	if (!m_file)
+		throw runtime_error("Failed to write the file '" + m_fileName + "'.");
+}
+
+void CRecordLogWriter::p_WriteHeader()
+{
+	if (m_offset != 0)
+		return;
+
+	const string l_name = m_compressor ? m_compressor->Name() : string();
+
+	if (l_name.size() > numeric_limits<uint16_t>::max())
+		throw runtime_error("The compressor name is too long to be stored in the record log.");
+
+	string l_header(LOG_HEADER_SIZE + sizeof(uint16_t) + l_name.size(), '\0');
+	char *l_write = &l_header[0];
+	Store(l_write, LOG_MAGIC);
+	Store(l_write, LOG_VERSION);
+	Store(l_write, uint16_t(l_name.size()));
+	l_name.copy(l_write, l_name.size());
+
+	p_Write(l_header.data(), l_header.size());
+}
+
+void CRecordLogWriter::p_WriteBlock()
+{
+	if (m_blockRecords == 0)
+		return;
+
+	p_WriteHeader();
+
+	const char *l_data = m_block.data();
+	uint64_t l_size = m_block.size();
+	uint8_t l_flags = 0;
+
+	unique_ptr<char[]> l_compData;
+	size_t l_compSize = 0;
+
+	if (m_compressor)
+	{
+		m_compressor->Compress(m_block.data(), m_block.size(), l_compData, l_compSize);
+
+		// Data that doesn't compress is stored as is
+		if (l_compSize < m_block.size())
+		{
+			l_data = l_compData.get();
+			l_size = l_compSize;
+			l_flags = BLOCK_COMPRESSED;
+		}
+	}
+
+	char l_header[BLOCK_HEADER_SIZE];
+	char *l_write = l_header;
+	Store(l_write, BLOCK_MAGIC);
+	Store(l_write, m_blockRecords);
+	Store(l_write, l_size);
+	Store(l_write, uint64_t(m_block.size()));
+	Store(l_write, l_flags);
+	Store(l_write, CalcCRC32(l_header, BLOCK_CRC_OFFSET));
+	Store(l_write, CalcCRC32(l_data, l_size));
+
+	m_index.push_back({ m_numRecords - m_blockRecords, m_offset });
+
+	p_Write(l_header, sizeof(l_header));
+	p_Write(l_data, l_size);
+
+	m_block.clear();
+	m_blockRecords = 0;
+}
+
+void CRecordLogWriter::p_Write(const void *a_data, size_t a_size)
+{
+	m_file.write(static_cast<const char *>(a_data), a_size);
+
+	if (!m_file)
+		throw runtime_error("Failed to write the file '" + m_fileName + "'.");
+
+	m_offset += a_size;
+}
+
+CRecordLogReader::CRecordLogReader(const std::string &a_fileName, ASerializer::Ptr a_serializer)
+	: m_fileName(a_fileName), m_serializer(move(a_serializer)),
+	  m_compressor(ICompressor::DEFAULT_INSTANCE), m_maxBlockSize(DEFAULT_MAX_BLOCK_SIZE),
+	  m_hasCompressorName(false), m_dataStart(0), m_numRecords(0), m_dataEnd(0),
+	  m_currBlock(numeric_limits<size_t>::max()), m_next(0)
+{
+	if (!m_serializer)
+		throw runtime_error("The serializer cannot be null.");
+
+	m_file.open(a_fileName, ios_base::binary);
+
+	if (!m_file)
+		throw runtime_error("Unable to open the file '" + a_fileName + "'.");
+
+	m_file.seekg(0, m_file.end);
+	const uint64_t l_fileSize = m_file.tellg();
+	m_file.seekg(0, m_file.beg);
+
+	char l_header[LOG_HEADER_SIZE];
+
+	if (l_fileSize < sizeof(l_header) || !m_file.read(l_header, sizeof(l_header)))
+		throw runtime_error("The file '" + a_fileName + "' is not a record log.");
+
+	const char *l_read = l_header;
+
+	if (Load<uint32_t>(l_read) != LOG_MAGIC)
+		throw runtime_error("The file '" + a_fileName + "' is not a record log.");
+	const uint16_t l_version = Load<uint16_t>(l_read);
+
+	if (l_version != LOG_VERSION && l_version != LOG_VERSION_NO_NAME)
+		throw runtime_error("Unsupported record log version.");
+
+	m_dataStart = LOG_HEADER_SIZE;
+
+	if (l_version == LOG_VERSION)
+	{
+		char l_nameSize[sizeof(uint16_t)];
+
+		if (!m_file.read(l_nameSize, sizeof(l_nameSize)))
+			throw runtime_error("The record log is truncated.");
+
+		l_read = l_nameSize;
+		m_compressorName.resize(Load<uint16_t>(l_read));
+
+		if (!m_compressorName.empty() && !m_file.read(&m_compressorName[0], m_compressorName.size()))
+			throw runtime_error("The record log is truncated.");
+
+		m_hasCompressorName = true;
+		m_dataStart += sizeof(uint16_t) + m_compressorName.size();
+	}
+
+	if (!p_ReadIndex(l_fileSize))
+		p_ScanBlocks(l_fileSize);
+}
+
+AData::Ptr CRecordLogReader::ReadData(uint64_t a_record)
+{
+	if (a_record >= m_numRecords)
+		throw runtime_error("The record number is out of range.");
+
+	Seek(a_record);
+
+	return Next();
+}
+
+void CRecordLogReader::Seek(uint64_t a_record)
+{
+	if (a_record > m_numRecords)
+		throw runtime_error("The record number is out of range.");
+
+	m_next = a_record;
+}
+
+AData::Ptr CRecordLogReader::Next()
+{
+	if (m_next >= m_numRecords)
+		return AData::Ptr();
+
+	// Usually still in the current block
+	if (m_currBlock >= m_index.size() ||
+		m_next < m_index[m_currBlock].FirstRecord ||
+		m_next - m_index[m_currBlock].FirstRecord >= m_recordOffsets.size())
+	{
+		auto l_iter = upper_bound(m_index.begin(), m_index.end(), m_next,
+			[] (uint64_t a_record, const CRecordLogBlock &a_block)
+			{
+				return a_record < a_block.FirstRecord;
+			});
+
+		p_LoadBlock((l_iter - m_index.begin()) - 1);
+	}
+
+	const size_t l_idx = m_next - m_index[m_currBlock].FirstRecord;
+
+	const char *l_read = m_blockData.data() + m_recordOffsets[l_idx];
+	const char *l_end = m_blockData.data() + m_blockData.size();
+
+	const size_t l_size = DecodeSize(l_read, l_end);
+
+	AData::Ptr l_ret = m_serializer->DeserializeData(l_read, l_read + l_size);
+
+	++m_next;
+
+	return l_ret;
+}
+
+bool CRecordLogReader::p_ReadIndex(uint64_t a_fileSize)
+{
+	if (a_fileSize < m_dataStart + TRAILER_SIZE)
+		return false;
+
+	char l_trailer[TRAILER_SIZE];
+
+	m_file.seekg(a_fileSize - TRAILER_SIZE);
+
+	if (!m_file.read(l_trailer, TRAILER_SIZE))
+	{
+		m_file.clear();
+		return false;
+	}
+
+	const char *l_read = l_trailer;
+	const uint64_t l_indexOffset = Load<uint64_t>(l_read);
+	const uint64_t l_numBlocks = Load<uint64_t>(l_read);
+	const uint64_t l_numRecords = Load<uint64_t>(l_read);
+	const uint32_t l_crc = Load<uint32_t>(l_read);
+
+	if (Load<uint32_t>(l_read) != INDEX_MAGIC)
+		return false;
+
+	if (l_indexOffset < m_dataStart ||
+		l_indexOffset > a_fileSize - TRAILER_SIZE ||
+		l_numBlocks != (a_fileSize - TRAILER_SIZE - l_indexOffset) / INDEX_ENTRY_SIZE)
+	{
+		return false;
+	}
+
+	string l_index(a_fileSize - l_indexOffset, '\0');
+
+	m_file.seekg(l_indexOffset);
+
+	if (!m_file.read(&l_index[0], l_index.size()))
+	{
+		m_file.clear();
+		return false;
+	}
+
+	if (CalcCRC32(l_index.data(), l_index.size() - 2 * sizeof(uint32_t)) != l_crc)
+		return false;
+
+	l_read = l_index.data();
+
+	m_index.resize(l_numBlocks);
+
+	for (CRecordLogBlock &l_block : m_index)
+	{
+		l_block.FirstRecord = Load<uint64_t>(l_read);
+		l_block.Offset = Load<uint64_t>(l_read);
+	}
+
+	m_numRecords = l_numRecords;
+	m_dataEnd = l_indexOffset;
+
+	return true;
+}
+
+void CRecordLogReader::p_ScanBlocks(uint64_t a_fileSize)
+{
+	// Without an index, walk the block headers. The data doesn't have to be
+	// read, and anything after the last complete block is ignored
+	m_index.clear();
+	m_numRecords = 0;
+
+	uint64_t l_offset = m_dataStart;
+
+	while (a_fileSize - l_offset >= BLOCK_HEADER_SIZE)
+	{
+		char l_header[BLOCK_HEADER_SIZE];
+
+		m_file.seekg(l_offset);
+
+		if (!m_file.read(l_header, BLOCK_HEADER_SIZE))
+			break;
+
+		const char *l_read = l_header;
+
+		if (Load<uint32_t>(l_read) != BLOCK_MAGIC)
+			break;
+
+		const uint32_t l_count = Load<uint32_t>(l_read);
+		const uint64_t l_size = Load<uint64_t>(l_read);
+
+		l_read = l_header + BLOCK_CRC_OFFSET;
+
+		if (Load<uint32_t>(l_read) != CalcCRC32(l_header, BLOCK_CRC_OFFSET))
+			break;
+
+		if (l_size > a_fileSize - l_offset - BLOCK_HEADER_SIZE)
+			break;
+
+		m_index.push_back({ m_numRecords, l_offset });
+
+		m_numRecords += l_count;
+		l_offset += BLOCK_HEADER_SIZE + l_size;
+	}
+
+	m_dataEnd = l_offset;
+
+	m_file.clear();
+}
+
+void CRecordLogReader::p_LoadBlock(size_t a_block)
+{
+	m_currBlock = numeric_limits<size_t>::max();
+	m_recordOffsets.clear();
+
+	char l_header[BLOCK_HEADER_SIZE];
+
+	m_file.seekg(m_index[a_block].Offset);
+
+	if (!m_file.read(l_header, BLOCK_HEADER_SIZE))
+	{
+		m_file.clear();
+		throw runtime_error("The record log is truncated.");
+	}
+
+	const char *l_read = l_header;
+
+	if (Load<uint32_t>(l_read) != BLOCK_MAGIC)
+		throw runtime_error("The record log is corrupted.");
+
+	const uint32_t l_count = Load<uint32_t>(l_read);
+	const uint64_t l_size = Load<uint64_t>(l_read);
+	const uint64_t l_rawSize = Load<uint64_t>(l_read);
+	const uint8_t l_flags = Load<uint8_t>(l_read);
+	const uint32_t l_headerCrc = Load<uint32_t>(l_read);
+	const uint32_t l_dataCrc = Load<uint32_t>(l_read);
+
+	if (l_headerCrc != CalcCRC32(l_header, BLOCK_CRC_OFFSET))
+		throw runtime_error("The record log is corrupted.");
+
+	// The header CRC has been checked, but the sizes still come from the
+	// file, so don't trust them with an allocation larger than the file
+	const uint64_t l_next = a_block + 1 < m_index.size() ?
+			m_index[a_block + 1].Offset : m_dataEnd;
+
+	if (l_size > l_next - m_index[a_block].Offset - BLOCK_HEADER_SIZE)
+		throw runtime_error("The record log is corrupted.");
+
+	// The same goes for the decompressed size. Every record takes at least
+	// a byte, so that bounds the count too
+	const uint64_t l_dataSize = (l_flags & BLOCK_COMPRESSED) ? l_rawSize : l_size;
+
+	if (l_dataSize > m_maxBlockSize)
+		throw runtime_error("The record log block exceeds the maximum block size.");
+
+	if (l_count > l_dataSize)
+		throw runtime_error("The record log is corrupted.");
+
+	m_blockData.resize(l_size);
+
+	if (l_size > 0 && !m_file.read(m_blockData.data(), l_size))
+	{
+		m_file.clear();
+		throw runtime_error("The record log is truncated.");
+	}
+
+	if (l_dataCrc != CalcCRC32(m_blockData.data(), l_size))
+		throw runtime_error("The record log is corrupted.");
+
+	if (l_flags & BLOCK_COMPRESSED)
+	{
+		// Logs from before the compressor was recorded have to be read with
+		// whichever one the reader was given
+		if (m_hasCompressorName && (!m_compressor || m_compressor->Name() != m_compressorName))
+		{
+			throw runtime_error("The record log needs the compressor '" + m_compressorName +
+					"' to be read, but the reader has " +
+					(m_compressor ? "'" + m_compressor->Name() + "'." : "none."));
+		}
+
+		if (!m_compressor)
+			throw runtime_error("A compressor is required to read this record log.");
+
+		unique_ptr<char[]> l_raw = m_compressor->Decompress(m_blockData.data(), l_size, l_rawSize);
+
+		m_blockData.assign(l_raw.get(), l_raw.get() + l_rawSize);
+	}
+
+	// Find where each record starts, so that any of them can be read
+	const char *l_start = m_blockData.data();
+	const char *l_end = l_start + m_blockData.size();
+
+	m_recordOffsets.reserve(l_count);
+
+	for (const char *l_curr = l_start; l_curr != l_end; )
+	{
+		m_recordOffsets.push_back(l_curr - l_start);
+
+		const size_t l_recSize = DecodeSize(l_curr, l_end);
+
+		if (l_recSize > size_t(l_end - l_curr))
+			throw runtime_error("The record log is corrupted.");
+
+		l_curr += l_recSize;
+	}
+
+	if (m_recordOffsets.size() != l_count)
+	{
+		m_recordOffsets.clear();
+		throw runtime_error("The record log is corrupted.");
+	}
+
+	m_currBlock = a_block;
+}
+
+} }
@@ -19,6 +19,14 @@ void CSnappyCompressor::Compress(const char *a_input, size_t a_inputSize,
 unique_ptr<char[]> CSnappyCompressor::Decompress(const char *a_compressed, size_t a_compressedSize, 
                                                size_t a_decompressedSize) const 
 {
+    // The stream carries its own length, which is what RawUncompress writes,
+    // so it has to match the buffer before anything is written into it
+    size_t l_length;
+
+    if (!snappy::GetUncompressedLength(a_compressed, a_compressedSize, &l_length) ||
+        l_length != a_decompressedSize)
+        throw runtime_error("The specified compressed data is corrupted.");
+
     unique_ptr<char[]> l_ret(new char[a_decompressedSize]);
 
     if (!snappy::RawUncompress(a_compressed, a_compressedSize, l_ret.get()))
@@ -20,16 +20,26 @@ void WriteValue(xml_node a_node, const AData &a_data);
 AData::Ptr ReadValue(xml_node a_node, const CSerializationContext &a_context);
 
 std::string CXmlSerializer::SerializeData(const AData& a_data) const
+{
+	stringstream l_ss;
+	SerializeDataToStream(l_ss, a_data);
+
+	return l_ss.str();
+}
+
+void CXmlSerializer::SerializeDataToStream(std::ostream &a_stream, const AData &a_data) const
 {
 	xml_document l_doc;
 
 	auto l_root = l_doc.append_child("Root");
 	WriteValue(l_root, a_data);
 
-	stringstream l_ss;
-	l_doc.save(l_ss);
+	// pugixml writes the document to the stream as it goes, so the text
+	// is never held in memory as a whole
+	l_doc.save(a_stream);
 
-	return l_ss.str();
+	if (!a_stream)
+		throw std::runtime_error("Failed to write the XML document to the stream.");
 }
 
 AData::Ptr CXmlSerializer::DeserializeData(const char* a_buf, const char* a_endBuf) const
@@ -201,8 +211,8 @@ AData::Ptr ReadPrimArray(xml_node a_node, const CSerializationContext &a_context
 	READ_PRIM(UShort, unsigned short);
 	READ_PRIM(Int, int);
 	READ_PRIM(UInt, unsigned int);
-	READ_PRIM(Long, long long);
-	READ_PRIM(ULong, unsigned long);
+	READ_PRIM(Long, int64_t);
+	READ_PRIM(ULong, uint64_t);
 	READ_PRIM(Float, float);
 	READ_PRIM(Double, double);
 	READ_PRIM(Bool, bool);
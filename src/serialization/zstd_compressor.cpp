@@ -0,0 +1,239 @@
+#include "serialization/format/zstd_compressor.h"
+
+#include <zstd.h>
+#include <zdict.h>
+#include <cstring>
+#include <memory>
+#include <stdexcept>
+
+#include "util/crc_calc.h"
+
+using namespace std;
+
+namespace axon { namespace serialization {
+
+namespace {
+
+typedef unique_ptr<ZSTD_CCtx, size_t (*)(ZSTD_CCtx *)> CCtxPtr;
+typedef unique_ptr<ZSTD_DCtx, size_t (*)(ZSTD_DCtx *)> DCtxPtr;
+
+void CheckZstd(size_t a_ret, const char *a_what)
+{
+    if (ZSTD_isError(a_ret))
+        throw runtime_error(string(a_what) + ZSTD_getErrorName(a_ret));
+}
+
+// The contexts keep the window of the previous messages, and each
+// message ends with a flush instead of ending the frame
+class CZstdStream
+    : public ICompressionStream
+{
+private:
+    int m_level;
+    shared_ptr<ZSTD_CDict_s> m_cdict;
+    shared_ptr<ZSTD_DDict_s> m_ddict;
+    CCtxPtr m_cctx;
+    DCtxPtr m_dctx;
+
+public:
+    CZstdStream(int a_level, shared_ptr<ZSTD_CDict_s> a_cdict, shared_ptr<ZSTD_DDict_s> a_ddict)
+        : m_level(a_level), m_cdict(move(a_cdict)), m_ddict(move(a_ddict)),
+          m_cctx(nullptr, ZSTD_freeCCtx), m_dctx(nullptr, ZSTD_freeDCtx)
+    {
+    }
+
+    virtual void Compress(const char *a_input, size_t a_inputSize,
+                          unique_ptr<char[]> &a_output, size_t &a_outputSize) override
+    {
+        if (!m_cctx)
+        {
+            m_cctx.reset(ZSTD_createCCtx());
+
+            if (!m_cctx)
+                throw runtime_error("Failed to create the zstd compression context.");
+
+            if (m_cdict)
+                CheckZstd(ZSTD_CCtx_refCDict(m_cctx.get(), m_cdict.get()),
+                          "Failed to load the zstd dictionary: ");
+            else
+                CheckZstd(ZSTD_CCtx_setParameter(m_cctx.get(), ZSTD_c_compressionLevel, m_level),
+                          "Failed to set the zstd compression level: ");
+        }
+
+        size_t l_capacity = ZSTD_compressBound(a_inputSize);
+        a_output.reset(new char[l_capacity]);
+
+        ZSTD_inBuffer l_in = { a_input, a_inputSize, 0 };
+        ZSTD_outBuffer l_out = { a_output.get(), l_capacity, 0 };
+
+        while (true)
+        {
+            const size_t l_left = ZSTD_compressStream2(m_cctx.get(), &l_out, &l_in, ZSTD_e_flush);
+
+            CheckZstd(l_left, "Failed to compress the data with zstd: ");
+
+            if (l_left == 0)
+                break;
+
+            // Only happens when the flush needs more than the bound
+            unique_ptr<char[]> l_bigger(new char[l_capacity * 2]);
+            memcpy(l_bigger.get(), a_output.get(), l_out.pos);
+
+            a_output = move(l_bigger);
+            l_capacity *= 2;
+
+            l_out.dst = a_output.get();
+            l_out.size = l_capacity;
+        }
+
+        a_outputSize = l_out.pos;
+    }
+
+    virtual unique_ptr<char[]> Decompress(const char *a_compressed, size_t a_compressedSize,
+                                          size_t a_decompressedSize) override
+    {
+        if (!m_dctx)
+        {
+            m_dctx.reset(ZSTD_createDCtx());
+
+            if (!m_dctx)
+                throw runtime_error("Failed to create the zstd decompression context.");
+
+            if (m_ddict)
+                CheckZstd(ZSTD_DCtx_refDDict(m_dctx.get(), m_ddict.get()),
+                          "Failed to load the zstd dictionary: ");
+        }
+
+        unique_ptr<char[]> l_ret(new char[a_decompressedSize]);
+
+        ZSTD_inBuffer l_in = { a_compressed, a_compressedSize, 0 };
+        ZSTD_outBuffer l_out = { l_ret.get(), a_decompressedSize, 0 };
+
+        while (l_in.pos < l_in.size)
+        {
+            const size_t l_inPos = l_in.pos;
+            const size_t l_outPos = l_out.pos;
+
+            const size_t l_hint = ZSTD_decompressStream(m_dctx.get(), &l_out, &l_in);
+
+            if (ZSTD_isError(l_hint) || (l_in.pos == l_inPos && l_out.pos == l_outPos))
+                throw runtime_error("The specified compressed data is corrupted.");
+        }
+
+        if (l_out.pos != a_decompressedSize)
+            throw runtime_error("The specified compressed data is corrupted.");
+
+        return move(l_ret);
+    }
+};
+
+}
+
+CZstdCompressor::CZstdCompressor(int a_level)
+    : m_level(a_level), m_name("zstd")
+{
+}
+
+CZstdCompressor::CZstdCompressor(int a_level, const string &a_dictionary)
+    : CZstdCompressor(a_level)
+{
+    if (a_dictionary.empty())
+        return;
+
+    m_cdict.reset(ZSTD_createCDict(a_dictionary.data(), a_dictionary.size(), a_level),
+                  ZSTD_freeCDict);
+    m_ddict.reset(ZSTD_createDDict(a_dictionary.data(), a_dictionary.size()),
+                  ZSTD_freeDDict);
+
+    if (!m_cdict || !m_ddict)
+        throw runtime_error("Failed to load the zstd dictionary.");
+
+    // Raw content dictionaries don't have an ID, so they are told apart by their CRC
+    unsigned l_dictId = ZSTD_getDictID_fromDict(a_dictionary.data(), a_dictionary.size());
+
+    if (l_dictId == 0)
+        l_dictId = util::CalcCRC32(a_dictionary.data(), a_dictionary.size());
+
+    m_name += "/" + to_string(l_dictId);
+}
+
+void CZstdCompressor::Compress(const char *a_input, size_t a_inputSize, 
+                               unique_ptr<char[]> &a_output, size_t &a_outputSize) const 
+{
+    const size_t l_bound = ZSTD_compressBound(a_inputSize);
+
+    a_output.reset(new char[l_bound]);
+
+    CCtxPtr l_ctx(ZSTD_createCCtx(), ZSTD_freeCCtx);
+
+    if (!l_ctx)
+        throw runtime_error("Failed to create the zstd compression context.");
+
+    const size_t l_size = m_cdict ?
+            ZSTD_compress_usingCDict(l_ctx.get(), a_output.get(), l_bound,
+                                     a_input, a_inputSize, m_cdict.get())
+          : ZSTD_compressCCtx(l_ctx.get(), a_output.get(), l_bound,
+                              a_input, a_inputSize, m_level);
+
+    if (ZSTD_isError(l_size))
+        throw runtime_error(string("Failed to compress the data with zstd: ") +
+                            ZSTD_getErrorName(l_size));
+
+    a_outputSize = l_size;
+}
+
+unique_ptr<char[]> CZstdCompressor::Decompress(const char *a_compressed, size_t a_compressedSize, 
+                                               size_t a_decompressedSize) const 
+{
+    unique_ptr<char[]> l_ret(new char[a_decompressedSize]);
+
+    DCtxPtr l_ctx(ZSTD_createDCtx(), ZSTD_freeDCtx);
+
+    if (!l_ctx)
+        throw runtime_error("Failed to create the zstd decompression context.");
+
+    const size_t l_size = m_ddict ?
+            ZSTD_decompress_usingDDict(l_ctx.get(), l_ret.get(), a_decompressedSize,
+                                       a_compressed, a_compressedSize, m_ddict.get())
+          : ZSTD_decompressDCtx(l_ctx.get(), l_ret.get(), a_decompressedSize,
+                                a_compressed, a_compressedSize);
+
+    if (ZSTD_isError(l_size) || l_size != a_decompressedSize)
+        throw runtime_error("The specified compressed data is corrupted.");
+
+    return move(l_ret);
+}
+
+ICompressionStream::Ptr CZstdCompressor::CreateStream() const
+{
+    return ICompressionStream::Ptr(new CZstdStream(m_level, m_cdict, m_ddict));
+}
+
+string CZstdCompressor::TrainDictionary(const vector<string> &a_samples, size_t a_maxSize)
+{
+    string l_samples;
+    vector<size_t> l_sizes;
+    l_sizes.reserve(a_samples.size());
+
+    for (const string &l_sample : a_samples)
+    {
+        l_samples += l_sample;
+        l_sizes.push_back(l_sample.size());
+    }
+
+    string l_dict(a_maxSize, '\0');
+
+    const size_t l_size = ZDICT_trainFromBuffer(&l_dict[0], l_dict.size(),
+                                                l_samples.data(), l_sizes.data(),
+                                                unsigned(l_sizes.size()));
+
+    if (ZDICT_isError(l_size))
+        throw runtime_error(string("Failed to train the zstd dictionary: ") +
+                            ZDICT_getErrorName(l_size));
+
+    l_dict.resize(l_size);
+
+    return l_dict;
+}
+
+} }